@@ -0,0 +1,198 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_ANIMATION_H
+#define FPLBASE_ANIMATION_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/fpl_common.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace animdef {
+struct AnimClip;
+}
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_animation
+/// @{
+
+class Mesh;
+
+/// @class AnimClip
+/// @brief Skeletal animation, loaded from an `.fplanim` FlatBuffer.
+///
+/// The mesh_pipeline outputs one clip per take in an FBX file. The clip's
+/// skeleton matches that of the mesh output from the same file, so a clip's
+/// poses can be applied directly to the mesh's bones.
+class AnimClip {
+ public:
+  AnimClip() : def_(nullptr) {}
+
+  /// @brief Load a clip from an `.fplanim` file.
+  /// @param filename The file to load.
+  /// @return Returns false if the file could not be loaded or is invalid.
+  bool Load(const char *filename);
+
+  /// @brief Load a clip from an `.fplanim` FlatBuffer in memory.
+  ///
+  /// The buffer is copied, so it can be freed once this returns.
+  ///
+  /// @param buffer The FlatBuffer data.
+  /// @param size The length of `buffer`, in bytes.
+  /// @return Returns false if the buffer is not a valid clip.
+  bool LoadFromMemory(const void *buffer, size_t size);
+
+  /// @brief Whether a clip has been loaded.
+  bool IsValid() const { return def_ != nullptr; }
+
+  /// @brief The length of the clip, in seconds.
+  float duration() const;
+
+  /// @brief The number of bones in the clip's skeleton.
+  size_t num_bones() const;
+
+  /// @brief The parent of each bone, or 0xFF for root bones.
+  /// @return Returns an array of length num_bones().
+  const uint8_t *bone_parents() const;
+
+  /// @brief The FlatBuffer definition of the clip.
+  const animdef::AnimClip *def() const { return def_; }
+
+ private:
+  // `def_` points into `data_`, so a copy would point into the original.
+  FPL_DISALLOW_COPY_AND_ASSIGN(AnimClip);
+
+  std::string data_;
+  const animdef::AnimClip *def_;
+};
+
+/// @class AnimPose
+/// @brief The local transform of every bone in a skeleton.
+///
+/// Transforms are stored as separate arrays of translations, rotations and
+/// scales, so that sampling and blending are a handful of 4-wide vector
+/// operations per bone.
+class AnimPose {
+ public:
+  /// @brief Set the number of bones, resetting every bone to identity.
+  void Reset(size_t num_bones);
+
+  /// @brief The number of bones in the pose.
+  size_t num_bones() const { return translations_.size(); }
+
+  /// @brief Sample `clip` at `time` seconds.
+  ///
+  /// @param clip The clip to sample. Its bone count sets the pose's.
+  /// @param time Seconds from the start of the clip.
+  /// @param loop If true, `time` wraps around the end of the clip. Otherwise
+  ///        it is clamped to the clip.
+  void Sample(const AnimClip &clip, float time, bool loop);
+
+  /// @brief Blend this pose towards `other`.
+  ///
+  /// @param other A pose with the same number of bones.
+  /// @param weight 0 leaves this pose unchanged; 1 makes it equal `other`.
+  void Blend(const AnimPose &other, float weight);
+
+  /// @brief Concatenate the bones' local transforms into object space.
+  ///
+  /// @param bone_parents The parent of each bone, or 0xFF for root bones.
+  ///        Parents must come before their children.
+  /// @param transforms Output array of length num_bones(). Suitable for
+  ///        Mesh::GatherShaderTransforms().
+  void GlobalTransforms(const uint8_t *bone_parents,
+                        mathfu::AffineTransform *transforms) const;
+
+  /// @brief Translation of each bone, relative to its parent.
+  const std::vector<mathfu::vec3_packed> &translations() const {
+    return translations_;
+  }
+  /// @brief Rotation of each bone, as a quaternion (vector.xyz, scalar).
+  const std::vector<mathfu::vec4_packed> &rotations() const {
+    return rotations_;
+  }
+  /// @brief Scale of each bone.
+  const std::vector<mathfu::vec3_packed> &scales() const { return scales_; }
+
+ private:
+  std::vector<mathfu::vec3_packed> translations_;
+  std::vector<mathfu::vec4_packed> rotations_;
+  std::vector<mathfu::vec3_packed> scales_;
+};
+
+/// @brief The animation state of one instance of a skinned mesh.
+struct AnimInstance {
+  AnimInstance()
+      : clip(nullptr),
+        time(0.0f),
+        blend_clip(nullptr),
+        blend_time(0.0f),
+        blend_weight(0.0f),
+        loop(true) {}
+
+  const AnimClip *clip;  ///< The clip to play.
+  float time;            ///< Seconds into `clip`.
+
+  /// Optional second clip, e.g. the next clip in a cross-fade. Ignored if
+  /// null or if `blend_weight` is 0.
+  const AnimClip *blend_clip;
+  float blend_time;    ///< Seconds into `blend_clip`.
+  float blend_weight;  ///< 0 plays only `clip`; 1 plays only `blend_clip`.
+
+  bool loop;  ///< Whether both clips wrap around their ends.
+};
+
+/// @class AnimSampler
+/// @brief Sample animations for many instances of a skinned mesh.
+///
+/// A sampler holds only scratch memory. Instances are independent, so a large
+/// batch can be split into ranges that are sampled on separate threads, with
+/// one AnimSampler per thread.
+class AnimSampler {
+ public:
+  AnimSampler() : num_global_transforms_(0) {}
+
+  /// @brief Sample and blend `count` instances of `mesh`.
+  ///
+  /// @param mesh The skinned mesh. Its skeleton must match the clips'.
+  /// @param instances Array of length `count`.
+  /// @param count The number of instances.
+  /// @param shader_transforms Output array of length
+  ///        `count * mesh.num_shader_bones()`. Each instance's transforms are
+  ///        ready to pass to Renderer::SetBoneTransforms().
+  void SampleInstances(const Mesh &mesh, const AnimInstance *instances,
+                       size_t count,
+                       mathfu::AffineTransform *shader_transforms);
+
+ private:
+  AnimPose pose_;
+  AnimPose blend_pose_;
+
+  // Note that vector<AffineTransform> is not possible on Visual Studio 2010
+  // because it doesn't support vectors of aligned types.
+  std::unique_ptr<mathfu::AffineTransform[]> global_transforms_;
+  size_t num_global_transforms_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_ANIMATION_H
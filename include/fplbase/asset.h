@@ -16,6 +16,7 @@
 #define FPLBASE_ASSET_H
 
 #include <assert.h>
+#include <stdint.h>
 
 namespace fplbase {
 
@@ -25,7 +26,7 @@ class AssetManager;
 /// @brief Base class of all assets that _may_ be managed by Assetmanager.
 class Asset {
  public:
-  Asset() : refcount_(1) {}
+  Asset() : refcount_(1), owner_(nullptr) {}
   virtual ~Asset() {}
 
   /// @brief indicate there is an additional owner of this asset.
@@ -45,6 +46,9 @@ class Asset {
   };
 
   int refcount_;
+  // The AssetManager that loaded this asset, if any, so that its handles
+  // only resolve while it's loaded.
+  const AssetManager *owner_;
 };
 
 }  // namespace fplbase
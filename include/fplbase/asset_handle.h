@@ -0,0 +1,80 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef FPLBASE_ASSET_HANDLE_H
+#define FPLBASE_ASSET_HANDLE_H
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/object_pool.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_asset_manager
+/// @{
+
+/// @class AssetHandle
+/// @brief A reference to an asset of type `T` owned by an AssetManager, which
+///        stops resolving once the asset is unloaded.
+///
+/// Assets are allocated in `T::pool()`, so the handle is the 32-bit
+/// ObjectPoolHandle of the asset's slot there: the slot's index and its
+/// generation, which changes each time the slot is reused. A
+/// default-constructed handle is null.
+template <typename T>
+class AssetHandle {
+ public:
+  AssetHandle() {}
+  /// @brief Make a handle from pool_handle() of another.
+  explicit AssetHandle(const ObjectPoolHandle &pool_handle)
+      : pool_handle_(pool_handle) {}
+
+  /// @brief True for a default-constructed handle. A non-null handle may
+  /// still be stale; resolve it with AssetManager::Get() to check.
+  bool is_null() const { return pool_handle_.generation() == 0; }
+
+  /// @brief The handle of the asset in `T::pool()`.
+  const ObjectPoolHandle &pool_handle() const { return pool_handle_; }
+
+  bool operator==(const AssetHandle &other) const {
+    return pool_handle_ == other.pool_handle_;
+  }
+  bool operator!=(const AssetHandle &other) const {
+    return pool_handle_ != other.pool_handle_;
+  }
+
+ private:
+  ObjectPoolHandle pool_handle_;
+};
+
+class FileAsset;
+class Material;
+class Mesh;
+class Shader;
+class Texture;
+class TextureAtlas;
+
+typedef AssetHandle<FileAsset> FileAssetHandle;
+typedef AssetHandle<Material> MaterialAssetHandle;
+typedef AssetHandle<Mesh> MeshAssetHandle;
+typedef AssetHandle<Shader> ShaderAssetHandle;
+typedef AssetHandle<Texture> TextureAssetHandle;
+typedef AssetHandle<TextureAtlas> TextureAtlasAssetHandle;
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_ASSET_HANDLE_H
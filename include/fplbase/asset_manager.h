@@ -16,14 +16,18 @@
 #define FPLBASE_ASSET_MANAGER_H
 
 #include <map>
+#include <memory>
 #include <string>
 
 #include "fplbase/config.h"  // Must come first.
 
+#include "fplbase/asset_handle.h"
 #include "fplbase/async_loader.h"
 #include "fplbase/fpl_common.h"
 #include "fplbase/renderer.h"
+#include "fplbase/texture_array.h"
 #include "fplbase/texture_atlas.h"
+#include "fplbase/texture_staging.h"
 
 namespace fplbase {
 
@@ -39,6 +43,11 @@ class FileAsset : public AsyncAsset {
   virtual bool IsValid();
  public:
   std::string contents;
+
+  /// @brief The pool that heap-allocated FileAssets live in.
+  static ObjectPool<FileAsset> &pool();
+
+  FPLBASE_DEFINE_POOLED_NEW_DELETE(FileAsset)
 };
 
 /// @class AssetManager
@@ -158,6 +167,29 @@ class AssetManager {
   /// StartLoadingTextures.
   void StopLoadingTextures();
 
+  /// @brief Create textures and mesh buffers on the loader thread, through a
+  /// GL context shared with the renderer's, so that TryFinalize() only has
+  /// to publish them.
+  ///
+  /// Call before StartLoadingTextures(). See
+  /// AsyncLoader::EnableBackgroundUploads().
+  /// @return Returns false if contexts can't be shared, in which case
+  /// TryFinalize() uploads them on this thread, as before.
+  bool EnableBackgroundUploads();
+
+  /// @brief Have the loader thread write async textures into mapped pixel
+  /// unpack buffers, so that TryFinalize() only has to issue their uploads
+  /// from them. See TextureStagingPool.
+  ///
+  /// Call before loading the textures to stage. Textures that don't fit in a
+  /// free buffer, compressed textures and cubemaps are loaded as usual.
+  /// @param[in] buffer_size The size of each buffer. 64MB fits a 4096x4096
+  /// RGBA texture.
+  /// @param[in] num_buffers The number of buffers, which bounds the number of
+  /// staged textures in flight.
+  /// @return Returns false if staging isn't supported.
+  bool EnableStagedTextureUploads(size_t buffer_size, int num_buffers);
+
   /// @brief Check for the status of async loading resources.
   ///
   /// Call this repeatedly until it returns true, which signals all resources
@@ -168,6 +200,30 @@ class AssetManager {
   /// @return Returns true when all resources have been loaded & finalized.
   bool TryFinalize();
 
+  /// @brief Add the assets loaded from now on to `group`.
+  ///
+  /// Until this is called again, every texture, shader and mesh loaded,
+  /// including those already loaded or loading, is added to `group`, so that
+  /// the group can be waited on, or its progress shown, separately from
+  /// other loads in flight. Textures that a mesh's materials load when the
+  /// mesh is finalized are added to the group the mesh was loaded in.
+  ///
+  /// @param group The group to add assets to, or nullptr to stop adding
+  /// them. It may be destroyed while its assets are loading.
+  void SetLoadGroup(FinalizeGroup *group);
+
+  /// @brief Finalize assets until every asset in `group` is finalized.
+  ///
+  /// Starts the loader if needed, then blocks, calling TryFinalize(). Other
+  /// assets finalized meanwhile aren't affected. Call on the main thread.
+  /// Returns early if the loader runs out of work before the group is
+  /// complete, such as when an asset in it was never queued.
+  ///
+  /// @param group The group to wait for.
+  /// @return Returns true if every asset in the group was finalized and
+  /// loaded successfully.
+  bool FinishLoadGroup(const FinalizeGroup::Future &group);
+
   /// @brief Deletes the previously loaded texture.
   ///
   /// Deletes the texture and removes it from the material manager. Any
@@ -277,6 +333,30 @@ class AssetManager {
   /// If its reference count was >1, it will be decreased instead of unloaded.
   void UnloadFileAsset(const char *filename);
 
+  /// @brief Returns the handle of an asset loaded by this AssetManager.
+  ///
+  /// Unlike pointers, handles are safe to hold after the asset is unloaded:
+  /// Get() then returns nullptr.
+  ///
+  /// @return Returns a null handle if `asset` is null, or was not loaded by
+  /// Load*() (for example, materials embedded in meshes), or is a subclass
+  /// that isn't allocated in `T::pool()`.
+  template <typename T>
+  AssetHandle<T> GetHandle(const T *asset) const {
+    return asset && asset->owner_ == this
+               ? AssetHandle<T>(T::pool().GetHandle(asset))
+               : AssetHandle<T>();
+  }
+
+  /// @brief Returns the asset `handle` refers to, in constant time.
+  ///
+  /// @return Returns nullptr if the asset has been unloaded.
+  template <typename T>
+  T *Get(AssetHandle<T> handle) const {
+    T *asset = T::pool().Get(handle.pool_handle());
+    return asset && asset->owner_ == this ? asset : nullptr;
+  }
+
   /// @brief Handy accessor for the renderer.
   ///
   /// @return Returns the renderer.
@@ -316,6 +396,29 @@ class AssetManager {
   Shader *LoadShaderHelper(const char *basename,
                            const std::vector<std::string> &local_defines,
                            const char *alias, bool async);
+  // Add `asset` to the current load group, if any.
+  template <typename T>
+  T *AddToLoadGroup(T *asset) {
+    if (asset && load_group_.valid()) load_group_.Add(asset);
+    return asset;
+  }
+
+  // Let `asset`'s handle resolve. Call when adding it to its map.
+  template <typename T>
+  T *Register(T *asset) {
+    asset->owner_ = this;
+    return asset;
+  }
+
+  // Stop `asset`'s handle resolving. Call when removing it from its map.
+  template <typename T>
+  void Unregister(T *asset) {
+    asset->owner_ = nullptr;
+  }
+
+  // Load `filename` into a layer of a shared TextureArray, for materials with
+  // `texture_array` set. Returns an empty layer if arrays aren't supported.
+  TextureLayer LoadTextureLayer(const char *filename, TextureFlags flags);
   FPL_DISALLOW_COPY_AND_ASSIGN(AssetManager);
 
   // This implements the mechanism for each asset to be both loadable
@@ -326,22 +429,26 @@ class AssetManager {
   T *LoadOrQueue(T *asset, std::map<std::string, T *> &asset_map, bool async,
                  const char *alias) {
     asset_map[alias != nullptr ? alias : asset->filename()] = asset;
+    Register(asset);
     if (async) {
       loader_.QueueJob(asset);
     } else {
       asset->LoadNow();
     }
-    return asset;
+    return AddToLoadGroup(asset);
   }
 
   Renderer &renderer_;
   std::map<std::string, Shader *> shader_map_;
   std::map<std::string, Texture *> texture_map_;
   std::map<std::string, TextureAtlas *> texture_atlas_map_;
+  TextureArrayPool texture_arrays_;
   std::map<std::string, Material *> material_map_;
   std::map<std::string, Mesh *> mesh_map_;
   std::map<std::string, FileAsset *> file_map_;
+  std::unique_ptr<TextureStagingPool> texture_staging_;
   AsyncLoader loader_;
+  FinalizeGroup::Future load_group_;
   mathfu::vec2 texture_scale_;
 
   std::vector<std::string> defines_to_add_;
@@ -16,6 +16,7 @@
 #define FPLBASE_ASYNC_LOADER_H
 
 #include <stdint.h>
+#include <atomic>
 #include <deque>
 #include <functional>
 #include <string>
@@ -23,6 +24,7 @@
 
 #include "fplbase/config.h"  // Must come first.
 #include "fplbase/asset.h"
+#include "fplbase/finalize_callback.h"
 
 #ifdef FPLBASE_BACKEND_STDLIB
 #include <mutex>
@@ -41,6 +43,31 @@ typedef void *Mutex;
 typedef void *Semaphore;
 
 class AsyncLoader;
+class Environment;
+
+/// @class CancellationToken
+/// @brief Lets one thread ask work running on another to stop early.
+///
+/// Long-running work, such as decoding a large image, checks IsCancelled()
+/// at convenient points and returns early if it's set.
+class CancellationToken {
+ public:
+  CancellationToken() : cancelled_(false) {}
+
+  /// @brief Ask the work to stop.
+  void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+  /// @brief Whether Cancel() has been called.
+  bool IsCancelled() const {
+    return cancelled_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<bool> cancelled_;
+
+  CancellationToken(const CancellationToken &);
+  void operator=(const CancellationToken &);
+};
 
 /// @class AsyncResource
 /// @brief Any resource that can be loaded asynchronously should inherit from
@@ -48,10 +75,14 @@ class AsyncLoader;
 class AsyncAsset : public Asset {
  public:
   /// @brief A function pointer to an asset loaded callback function.
-  typedef std::function<void()> AssetFinalizedCallback;
+  typedef FinalizeCallback AssetFinalizedCallback;
 
   /// @brief Default constructor for an empty AsyncAsset.
-  AsyncAsset() : data_(nullptr), finalized_(false) {}
+  AsyncAsset()
+      : data_(nullptr),
+        data_size_(0),
+        finalized_(false),
+        upload_fence_(nullptr) {}
 
   /// @brief Construct an AsyncAsset with a given file name.
   /// @param[in] filename A C-string corresponding to the name of the asset
@@ -59,8 +90,9 @@ class AsyncAsset : public Asset {
   explicit AsyncAsset(const char *filename)
       : filename_(filename),
         data_(nullptr),
-        finalize_callbacks_(0),
-        finalized_(false) {}
+        data_size_(0),
+        finalized_(false),
+        upload_fence_(nullptr) {}
 
   /// @brief AsyncAsset destructor.
   virtual ~AsyncAsset() {}
@@ -72,15 +104,30 @@ class AsyncAsset : public Asset {
   /// thread, so should not access any program state outside of this object.
   /// Since there will be only one loader thread, any libraries called by Load
   /// need not be MT-safe as long as they're not also called by the main thread.
+  /// Long loads should check cancellation_token() and return early once it's
+  /// cancelled; anything they load is then discarded.
   virtual void Load() = 0;
 
   /// @brief Override with converting the data into the resource.
   ///
   /// This should implement the behavior of turning data_ into the actual
   /// desired resource. Called on the main thread only.
-  /// Should check if data_ is null.
+  /// Should check if data_ is null. If Upload() created the GPU resources,
+  /// this only needs to publish them.
   virtual bool Finalize() = 0;
 
+  /// @brief Override to create GPU resources from data_ on the loader thread.
+  ///
+  /// Called after Load(), only if AsyncLoader::EnableBackgroundUploads() has
+  /// given the loader thread a GL context shared with the main thread's.
+  /// Like Load(), it should not access program state outside of this object,
+  /// and should keep what it creates apart from members the main thread may
+  /// read until Finalize() publishes it. Finalize() isn't called until the
+  /// GPU has finished the upload. DiscardData(), or the destructor, must free
+  /// what it made.
+  /// @return Returns true if anything was uploaded.
+  virtual bool Upload() { return false; }
+
   /// @brief Whether this object has been loaded and finalized. This does not
   /// signal success or not -- check IsValid for that.
   bool IsFinalized() const { return finalized_; }
@@ -113,10 +160,23 @@ class AsyncAsset : public Asset {
   /// @return Returns the filename.
   const std::string &filename() const { return filename_; }
 
+  /// @brief Set once AsyncLoader::AbortJob() has cancelled this asset's load.
+  const CancellationToken &cancellation_token() const {
+    return cancellation_token_;
+  }
+
+  /// @brief The number of bytes Load() loaded, for progress reporting.
+  ///
+  /// Only meaningful once the asset has been finalized. For compressed
+  /// textures, this is an estimate.
+  size_t data_size() const { return data_size_; }
+
   /// @brief Adds a callback to be called when the asset is finalized.
   ///
   /// Add a callback so logic can be executed when an asset is done loading.
-  /// This does nothing if the asset has already been finalized.
+  /// This does nothing if the asset has already been finalized. Small
+  /// callbacks, such as lambdas capturing a few pointers, don't allocate. To
+  /// wait for many assets, use a FinalizeGroup.
   ///
   /// @param callback The function to be called.
   /// @return Returns true if the asset is not finalized and the callback was
@@ -125,20 +185,22 @@ class AsyncAsset : public Asset {
     if (finalized_) {
       return false;
     }
-    finalize_callbacks_.push_back(callback);
+    finalize_callbacks_.Add(std::move(callback));
     return true;
   }
 
  protected:
+  /// @brief Free data_, if Load() set it, without finalizing the asset.
+  ///
+  /// Called on the main thread for assets whose load was aborted after
+  /// Load() returned. Override if the destructor doesn't free data_.
+  virtual void DiscardData() {}
+
   /// @brief Calls app callbacks when an asset is ready to be used.
   ///
   /// This should be called by descendants as soon as they are finalized.
   void CallFinalizeCallback() {
-    for (auto it = finalize_callbacks_.begin();
-         it != finalize_callbacks_.end(); ++it) {
-      (*it)();
-    }
-    finalize_callbacks_.clear();
+    finalize_callbacks_.CallAll();
     finalized_ = true;
   }
 
@@ -146,15 +208,127 @@ class AsyncAsset : public Asset {
   std::string filename_;
   /// @brief The resource data.
   const uint8_t *data_;
+  /// @brief The number of bytes loaded into data_. Set by Load().
+  size_t data_size_;
 
   /// @brief List of callbacks to be invoked when the asset is finalized.
-  std::vector<AssetFinalizedCallback> finalize_callbacks_;
+  FinalizeCallbackList finalize_callbacks_;
   /// @brief Whether the asset has been finalized.
   bool finalized_;
+  /// @brief Cancelled when the asset's load is aborted.
+  CancellationToken cancellation_token_;
+
+ private:
+  // Signalled once the GPU has finished the work Upload() issued. A GLsync.
+  void *upload_fence_;
 
   friend class AsyncLoader;
 };
 
+/// @brief How far the assets of a FinalizeGroup have got.
+struct LoadProgress {
+  LoadProgress()
+      : num_assets(0), num_finalized(0), num_failed(0), bytes_loaded(0) {}
+
+  /// @brief The fraction of the assets that have been finalized, from 0 to 1.
+  float fraction() const {
+    return num_assets > 0 ? static_cast<float>(num_finalized) / num_assets
+                          : 1.0f;
+  }
+
+  /// The number of assets in the group.
+  int num_assets;
+  /// The number of those that have been finalized, successfully or not.
+  int num_finalized;
+  /// The number of finalized assets that failed to load, or were destroyed
+  /// before they were finalized.
+  int num_failed;
+  /// The sum of AsyncAsset::data_size() over the finalized assets.
+  size_t bytes_loaded;
+};
+
+/// @class FinalizeGroup
+/// @brief Calls back once when every asset in a set has been finalized.
+///
+/// Each asset costs one small FinalizeCallback, rather than a callback per
+/// asset from the caller. Assets destroyed before they're finalized count as
+/// finalized. Like AsyncAsset callbacks, use it on the main thread only.
+///
+/// Used as a load group, with AssetManager::SetLoadGroup(), it collects the
+/// assets loaded for, say, one room of a level, so their loading can be
+/// tracked separately from everything else in flight.
+class FinalizeGroup {
+ private:
+  struct State;
+
+ public:
+  /// @class Future
+  /// @brief A copyable handle to a group's progress, which stays valid after
+  ///        the group itself is destroyed.
+  class Future {
+   public:
+    /// @brief Construct a handle to no group. valid() returns false.
+    Future() : state_(nullptr) {}
+    Future(const Future &other);
+    Future &operator=(const Future &other);
+    ~Future();
+
+    /// @brief Whether this refers to a group.
+    bool valid() const { return state_ != nullptr; }
+
+    /// @brief Whether every asset in the group has been finalized.
+    bool IsReady() const;
+
+    /// @brief The progress of the group's assets.
+    LoadProgress progress() const;
+
+    /// @brief Add `asset` to the group. See FinalizeGroup::Add().
+    void Add(AsyncAsset *asset) const;
+
+   private:
+    friend class FinalizeGroup;
+    explicit Future(State *state);
+
+    State *state_;
+  };
+
+  FinalizeGroup();
+  /// @brief Destroying the group cancels its OnComplete() callback.
+  ~FinalizeGroup();
+
+  /// @brief Add `asset` to the group. Assets that are already finalized
+  /// count as finalized immediately.
+  void Add(AsyncAsset *asset);
+
+  /// @brief Set the function to call once every asset added has been
+  /// finalized. It's called immediately if they already are, so add the
+  /// assets first.
+  void OnComplete(FinalizeCallback callback);
+
+  /// @brief The number of assets added.
+  int size() const;
+
+  /// @brief The number of assets added that have been finalized.
+  int num_finalized() const;
+
+  /// @brief Whether every asset added has been finalized.
+  bool IsComplete() const;
+
+  /// @brief The progress of the assets added.
+  LoadProgress progress() const;
+
+  /// @brief Get a handle to the group's progress, for code that doesn't own
+  /// the group.
+  Future GetFuture() const { return Future(state_); }
+
+ private:
+  class MemberCallback;
+
+  State *state_;
+
+  FPL_DISALLOW_COPY_AND_ASSIGN(FinalizeGroup);
+};
+
 /// @class AsyncLoader
 /// @brief Handles loading AsyncAsset objects.
 class AsyncLoader {
@@ -171,11 +345,16 @@ class AsyncLoader {
 
   /// @brief Aborts any pending operations for the given asset.
   ///
-  /// If the given asset is currently loading, this blocks until it is complete.
-  /// If it has not yet been loaded, this removes it from the queue.
+  /// Never blocks. If the asset has not yet been loaded, this removes it from
+  /// the queue. If it's loaded but not yet finalized, its data is discarded.
+  /// If it's currently loading, its cancellation token is cancelled, and the
+  /// loader takes ownership of it, deleting it on the main thread (in
+  /// TryFinalize()) once Load() returns.
   ///
   /// @param res The resource to abort performing any operations on.
-  void AbortJob(AsyncAsset *res);
+  /// @return Returns true if the loader took ownership of `res`. Otherwise the
+  /// caller still owns it, and may delete it.
+  bool AbortJob(AsyncAsset *res);
 
   /// @brief Launches the loading thread for the previously queued jobs.
   void StartLoading();
@@ -195,9 +374,9 @@ class AsyncLoader {
   /// @brief Call to Finalize any resources that have finished loading.
   ///
   /// Call this once per frame after StartLoading. Will call Finalize on any
-  /// resources that have finished loading. One it returns true, that means
-  /// the queue is empty, all resources have been processed, and the loading
-  /// thread has terminated.
+  /// resources that have finished loading, and delete any whose load was
+  /// aborted. One it returns true, that means the queue is empty, all
+  /// resources have been processed, and the loading thread has terminated.
   ///
   /// @return Returns true once the queue is empty.
   bool TryFinalize();
@@ -205,6 +384,21 @@ class AsyncLoader {
   /// @brief Shuts down the loader after completing all pending loads.
   void Stop();
 
+  /// @brief Create GPU resources on the loader thread, through a GL context
+  /// shared with the main thread's, so that Finalize() only has to publish
+  /// them. See AsyncAsset::Upload().
+  ///
+  /// Call before StartLoading(), on the thread whose context is current.
+  /// Requires kFeatureLevel30, for fences.
+  /// @param environment The environment whose context to share. It must
+  /// outlive the loader.
+  /// @return Returns false if the context can't be shared, in which case
+  /// assets are uploaded by Finalize() on the main thread, as before.
+  bool EnableBackgroundUploads(Environment *environment);
+
+  /// @brief Whether assets are uploaded on the loader thread.
+  bool background_uploads() const { return upload_environment_ != nullptr; }
+
  private:
 #ifdef FPLBASE_BACKEND_SDL
   void Lock(const std::function<void()> &body);
@@ -219,9 +413,30 @@ class AsyncLoader {
   void LoaderWorker();
   static int LoaderThread(void *user_data);
 
+  // Deletes the assets in reclaim_. Call on the main thread.
+  void DeleteReclaimed();
+
+  // Make the upload context current on the loader thread, if uploads are
+  // enabled. Returns whether it did.
+  bool BindUploadContext();
+  void UnbindUploadContext();
+  // Called on the loader thread in place of res->Load(). Also uploads the
+  // asset, and fences the upload, if `uploading`.
+  static void LoadAndUpload(AsyncAsset *res, bool uploading);
+  // Whether res's upload, if any, has finished, so it can be finalized.
+  // Call on the main thread.
+  static bool UploadFinished(AsyncAsset *res);
+  // Free res's upload fence and loaded data. Call on the main thread.
+  static void DiscardAsset(AsyncAsset *res);
+
   std::deque<AsyncAsset *> queue_, done_;
+  // Assets whose load was aborted while loading, to be deleted once Load()
+  // has returned.
+  std::vector<AsyncAsset *> reclaim_;
   AsyncAsset *loading_;
   int num_pending_requests_;
+  // Set by EnableBackgroundUploads().
+  Environment *upload_environment_;
 #ifdef FPLBASE_BACKEND_SDL
   // Keep handle to the worker thread around so that we can wait for it to
   // finish before destroying the class.
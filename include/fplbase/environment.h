@@ -19,6 +19,7 @@
 
 #include "fplbase/config.h"  // Must come first.
 
+#include "fplbase/frame_pacer.h"
 #include "mathfu/glsl_mappings.h"
 
 namespace fplbase {
@@ -67,6 +68,22 @@ class Environment {
   void ShutDown();
   void AdvanceFrame(bool minimized);
 
+  // Make the rendering context current on the calling thread, or release it
+  // from the calling thread so another thread can make it current. Return
+  // false if the backend can't move its context between threads.
+  bool MakeContextCurrent();
+  bool ReleaseContext();
+
+  // Create a second rendering context, sharing textures and buffers with the
+  // main one, for a loader thread to upload with. Call on the thread the main
+  // context is current on. Returns false if the backend can't share
+  // contexts. It's destroyed by ShutDown().
+  bool CreateUploadContext();
+  // Make the upload context current on, or release it from, the calling
+  // thread.
+  bool MakeUploadContextCurrent();
+  void ReleaseUploadContext();
+
   // This is typically called by backends when they detect a size change.
   // Should typically be called in between frames to keep rendering consistent.
   void SetWindowSize(const mathfu::vec2i &window_size) {
@@ -82,10 +99,15 @@ class Environment {
 
   const std::string &last_error() const { return last_error_; }
 
+  // Paces the frames AdvanceFrame() presents.
+  FramePacer &frame_pacer() { return frame_pacer_; }
+  const FramePacer &frame_pacer() const { return frame_pacer_; }
+
  private:
   FeatureLevel feature_level_;
   mathfu::vec2i window_size_;
   std::string last_error_;
+  FramePacer frame_pacer_;
   std::unique_ptr<EnvironmentHandles> handles_;
 };
 
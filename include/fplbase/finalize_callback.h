@@ -0,0 +1,200 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_FINALIZE_CALLBACK_H
+#define FPLBASE_FINALIZE_CALLBACK_H
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/fpl_common.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_async_loader
+/// @{
+
+/// @class FinalizeCallback
+/// @brief A move-only `void()` function object.
+///
+/// Unlike `std::function`, functors of up to kInlineSize bytes, such as
+/// lambdas capturing a few pointers, are stored without allocating.
+class FinalizeCallback {
+ public:
+  /// @brief The largest functor stored without allocating.
+  static const size_t kInlineSize = 4 * sizeof(void *);
+
+  /// @brief Construct an empty callback.
+  FinalizeCallback() : ops_(nullptr) {}
+
+  /// @brief Construct a callback that calls `function`.
+  template <typename F,
+            typename = typename std::enable_if<!std::is_same<
+                typename std::decay<F>::type, FinalizeCallback>::value>::type>
+  FinalizeCallback(F &&function)  // NOLINT: implicit, like std::function.
+      : ops_(nullptr) {
+    typedef typename std::decay<F>::type Fn;
+    Model<Fn>::Construct(&storage_, std::forward<F>(function));
+    ops_ = &Model<Fn>::kOps;
+  }
+
+  FinalizeCallback(FinalizeCallback &&other) : ops_(nullptr) {
+    *this = std::move(other);
+  }
+
+  FinalizeCallback &operator=(FinalizeCallback &&other) {
+    if (this != &other) {
+      Reset();
+      if (other.ops_) {
+        other.ops_->move(&storage_, &other.storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  ~FinalizeCallback() { Reset(); }
+
+  /// @brief Call the function. The callback must not be empty.
+  void operator()() { ops_->invoke(&storage_); }
+
+  /// @brief Whether the callback holds a function.
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  /// @brief Destroy the function, leaving the callback empty.
+  void Reset() {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+ private:
+  union Storage {
+    void *pointers[kInlineSize / sizeof(void *)];
+    double d;
+    long long ll;
+  };
+
+  struct Ops {
+    void (*invoke)(Storage *storage);
+    void (*move)(Storage *dest, Storage *source);
+    void (*destroy)(Storage *storage);
+  };
+
+  // How a functor of type Fn is stored: in place if it fits, otherwise on the
+  // heap.
+  template <typename Fn,
+            bool kInline = sizeof(Fn) <= sizeof(Storage) &&
+                           alignof(Fn) <= alignof(Storage) &&
+                           std::is_nothrow_move_constructible<Fn>::value>
+  struct Model;
+
+  template <typename Fn>
+  struct Model<Fn, true> {
+    template <typename F>
+    static void Construct(Storage *storage, F &&function) {
+      new (storage) Fn(std::forward<F>(function));
+    }
+    static void Invoke(Storage *storage) {
+      (*reinterpret_cast<Fn *>(storage))();
+    }
+    static void Move(Storage *dest, Storage *source) {
+      Fn *fn = reinterpret_cast<Fn *>(source);
+      new (dest) Fn(std::move(*fn));
+      fn->~Fn();
+    }
+    static void Destroy(Storage *storage) {
+      reinterpret_cast<Fn *>(storage)->~Fn();
+    }
+    static const Ops kOps;
+  };
+
+  template <typename Fn>
+  struct Model<Fn, false> {
+    template <typename F>
+    static void Construct(Storage *storage, F &&function) {
+      storage->pointers[0] = new Fn(std::forward<F>(function));
+    }
+    static void Invoke(Storage *storage) {
+      (*static_cast<Fn *>(storage->pointers[0]))();
+    }
+    static void Move(Storage *dest, Storage *source) {
+      dest->pointers[0] = source->pointers[0];
+    }
+    static void Destroy(Storage *storage) {
+      delete static_cast<Fn *>(storage->pointers[0]);
+    }
+    static const Ops kOps;
+  };
+
+  const Ops *ops_;
+  Storage storage_;
+
+  FPL_DISALLOW_COPY_AND_ASSIGN(FinalizeCallback);
+};
+
+template <typename Fn>
+const FinalizeCallback::Ops FinalizeCallback::Model<Fn, true>::kOps = {
+    &Invoke, &Move, &Destroy};
+
+template <typename Fn>
+const FinalizeCallback::Ops FinalizeCallback::Model<Fn, false>::kOps = {
+    &Invoke, &Move, &Destroy};
+
+/// @class FinalizeCallbackList
+/// @brief An intrusive list of FinalizeCallbacks, called in the order they
+///        were added.
+///
+/// The list itself is two pointers. Its nodes come from an arena shared by
+/// all lists, so adding a callback doesn't allocate once the arena has grown
+/// to the number of callbacks pending at once.
+class FinalizeCallbackList {
+ public:
+  FinalizeCallbackList() : head_(nullptr), tail_(nullptr) {}
+  ~FinalizeCallbackList() { Clear(); }
+
+  /// @brief Whether the list has no callbacks.
+  bool empty() const { return head_ == nullptr; }
+
+  /// @brief Add `callback` to the end of the list.
+  void Add(FinalizeCallback callback);
+
+  /// @brief Call and remove every callback, including any added by the
+  /// callbacks themselves.
+  void CallAll();
+
+  /// @brief Remove every callback without calling it.
+  void Clear();
+
+ private:
+  struct Node;
+  friend class FinalizeCallbackArena;
+
+  Node *head_;
+  Node *tail_;
+
+  FPL_DISALLOW_COPY_AND_ASSIGN(FinalizeCallbackList);
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_FINALIZE_CALLBACK_H
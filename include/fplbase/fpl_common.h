@@ -15,6 +15,10 @@
 #ifndef FPL_COMMON_H
 #define FPL_COMMON_H
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace fplbase {
 
 // A macro to disallow the copy constructor and operator= functions
@@ -46,6 +50,16 @@ namespace fplbase {
 #define FPL_FALLTHROUGH_INTENDED
 #endif
 
+// The address the current function returns to, which identifies its caller.
+// Symbolize it with addr2line or similar. nullptr where unsupported.
+#if defined(__GNUC__) || defined(__clang__)
+#define FPL_RETURN_ADDRESS() __builtin_return_address(0)
+#elif defined(_MSC_VER)
+#define FPL_RETURN_ADDRESS() _ReturnAddress()
+#else
+#define FPL_RETURN_ADDRESS() nullptr
+#endif
+
 }  // namespace fplbase
 
 #endif  // FPL_COMMON_H
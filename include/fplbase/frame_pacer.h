@@ -0,0 +1,128 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef FPLBASE_FRAME_PACER_H
+#define FPLBASE_FRAME_PACER_H
+
+#include <atomic>
+#include <chrono>
+
+#include "fplbase/config.h"  // Must come first.
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_renderer
+/// @{
+
+/// @class FramePacer
+/// @brief Spaces frames evenly at a target rate, aligned to the display's
+///        refresh, and starts each frame as late as it can while still
+///        presenting on time, to cut input-to-display latency.
+///
+/// The refresh interval is estimated from the times buffer swaps return, so
+/// no platform vsync callback is needed. Each Environment has one, driven by
+/// Environment::AdvanceFrame(). It always measures frames, but only sleeps
+/// to pace them once set_pacing_enabled(true) is called.
+///
+/// Call WaitForFrameStart() before reading input for a frame, then
+/// FramePresenting() just before swapping buffers and FramePresented() just
+/// after.
+class FramePacer {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  FramePacer();
+
+  /// @brief Set whether WaitForFrameStart() sleeps until the frame should
+  /// start. Off by default, in which case frames start as soon as the last
+  /// one is presented, as they would without a FramePacer.
+  void set_pacing_enabled(bool enabled) { pacing_enabled_ = enabled; }
+  bool pacing_enabled() const { return pacing_enabled_; }
+
+  /// @brief Set the rate to present frames at, in Hz, such as 30, 45, 60 or
+  /// 120. 0, the default, presents at the display's refresh rate.
+  ///
+  /// With vsync, rates that don't divide the refresh rate alternate between
+  /// the nearest whole numbers of refreshes, to average the target rate.
+  void set_target_frame_rate(double hz) { target_frame_rate_ = hz; }
+  double target_frame_rate() const { return target_frame_rate_; }
+
+  /// @brief Set whether buffer swaps block until vsync. If not, frames are
+  /// presented at exactly the target rate, or 60Hz if it is 0.
+  void set_vsync(bool vsync) { vsync_ = vsync; }
+  bool vsync() const { return vsync_; }
+
+  /// @brief If pacing is enabled, sleep until FrameStartTime(). Sleeps for
+  /// most of the wait, then spins for the last part, as sleeps tend to
+  /// overrun. Then calls FrameStarted().
+  void WaitForFrameStart();
+
+  /// @brief When the next frame should start to be ready just before its
+  /// present deadline, given the time frames have been taking. Only
+  /// meaningful once a frame has been presented.
+  Clock::time_point FrameStartTime() const;
+
+  /// @brief Call when a frame starts, if not calling WaitForFrameStart().
+  void FrameStarted(Clock::time_point time = Clock::now());
+
+  /// @brief Call just before swapping buffers, to measure the frame's work.
+  void FramePresenting(Clock::time_point time = Clock::now());
+
+  /// @brief Call just after swapping buffers. Updates the refresh interval
+  /// estimate and vsync_frame_id().
+  void FramePresented(Clock::time_point time = Clock::now());
+
+  /// @brief Sleep until the next estimated vsync.
+  void WaitForVsync();
+
+  /// @brief The number of refreshes since the first frame, including those
+  /// on which no new frame was presented. May eventually wrap.
+  int vsync_frame_id() const { return vsync_frame_id_.load(); }
+
+  /// @brief The estimated display refresh interval, in seconds.
+  double refresh_interval() const { return refresh_interval_.count(); }
+
+  /// @brief The estimated time from frame start to present, in seconds.
+  double frame_work_time() const { return work_time_.count(); }
+
+ private:
+  typedef std::chrono::duration<double> Seconds;
+
+  // The interval between presents the target rate asks for.
+  Seconds TargetInterval() const;
+  // Sleep, then spin, until `time`.
+  void SleepUntil(Clock::time_point time);
+
+  double target_frame_rate_;
+  bool pacing_enabled_;
+  bool vsync_;
+  bool presented_;
+  Clock::time_point last_present_;
+  // When the next frame would ideally be presented. Accumulates the target
+  // interval, so rates between refresh multiples average out.
+  Clock::time_point next_present_;
+  Clock::time_point frame_start_;
+  Seconds refresh_interval_;
+  Seconds work_time_;
+  // How much longer than asked sleeps take.
+  Seconds oversleep_;
+  std::atomic<int> vsync_frame_id_;
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_FRAME_PACER_H
@@ -0,0 +1,208 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef FPLBASE_FRAME_PIPELINE_H
+#define FPLBASE_FRAME_PIPELINE_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+class Mesh;
+class Renderer;
+class Shader;
+
+/// @file
+/// @addtogroup fplbase_renderer
+/// @{
+
+/// @class FramePacket
+/// @brief The rendering commands of one frame, recorded on one thread to be
+///        executed on another.
+///
+/// The typed helpers copy their arguments into the packet, so the caller can
+/// reuse or free them as soon as the helper returns. Meshes and shaders are
+/// recorded by pointer, and must stay loaded until the frame has executed.
+class FramePacket {
+ public:
+  /// @brief A command run on the thread that owns the GL context.
+  typedef std::function<void(Renderer &renderer)> Command;
+
+  FramePacket();
+  ~FramePacket();
+
+  /// @brief Record an arbitrary command. It must copy, rather than point to,
+  /// any data the recording thread may change before the frame executes.
+  void Add(const Command &command) { commands_.push_back(command); }
+
+  /// @brief Record Renderer::ClearFrameBuffer().
+  void ClearFrameBuffer(const mathfu::vec4 &color);
+
+  /// @brief Record Renderer::set_model_view_projection().
+  void SetModelViewProjection(const mathfu::mat4 &mvp);
+
+  /// @brief Record Renderer::set_model().
+  void SetModel(const mathfu::mat4 &model);
+
+  /// @brief Record Renderer::set_color().
+  void SetColor(const mathfu::vec4 &color);
+
+  /// @brief Record Renderer::set_light_pos().
+  void SetLightPos(const mathfu::vec3 &light_pos);
+
+  /// @brief Record Renderer::set_camera_pos().
+  void SetCameraPos(const mathfu::vec3 &camera_pos);
+
+  /// @brief Record Renderer::SetBoneTransforms(), copying the bone palette
+  /// into the packet.
+  void SetBoneTransforms(const mathfu::AffineTransform *bone_transforms,
+                         int num_bones);
+
+  /// @brief Record Renderer::SetShader().
+  void SetShader(const Shader *shader);
+
+  /// @brief Record Renderer::Render().
+  void Render(Mesh *mesh, bool ignore_material = false, size_t instances = 1);
+
+  /// @brief Run the recorded commands, in order, with `renderer`.
+  void Execute(Renderer &renderer);
+
+  /// @brief Forget the recorded commands, keeping their storage for reuse.
+  void Clear();
+
+  /// @brief The number of commands recorded.
+  size_t size() const { return commands_.size(); }
+
+ private:
+  FramePacket(const FramePacket &);
+  FramePacket &operator=(const FramePacket &);
+
+  std::vector<Command> commands_;
+
+  // Bone palettes copied by SetBoneTransforms(). Commands refer to them by
+  // offset, as the array is reallocated when it grows.
+  // Note that vector<AffineTransform> is not possible on Visual Studio 2010
+  // because it doesn't support vectors of aligned types.
+  std::unique_ptr<mathfu::AffineTransform[]> bones_;
+  size_t num_bones_;
+  size_t bones_capacity_;
+};
+
+/// @class FramePipeline
+/// @brief Renders frames on a thread of their own, so that the next frame
+///        can be simulated while the last one is submitted to the GPU.
+///
+/// While running, the render thread owns the GL context and the Renderer:
+/// it executes each submitted FramePacket, then presents it with
+/// Renderer::AdvanceFrame(). The thread that started the pipeline records
+/// the next packet meanwhile, and must not use the Renderer, or load assets
+/// that need the GL context, until it calls Stop() or records the work as a
+/// command. Two packets are used in turn, so at most one frame is in flight.
+///
+/// If the Environment can't hand its GL context to another thread, Start()
+/// returns false and SubmitFrame() executes and presents each frame on the
+/// calling thread instead, so callers can use the same code either way.
+class FramePipeline {
+ public:
+  /// @brief Presents a frame once its packet has executed.
+  typedef std::function<void(Renderer &renderer, bool minimized, double time)>
+      PresentFunction;
+
+  /// @param[in] renderer The renderer to execute frames with. It must be
+  /// initialized, and outlive the pipeline.
+  /// @param[in] present Called in place of Renderer::AdvanceFrame() to
+  /// present each frame, on the thread that executed it. Empty by default.
+  explicit FramePipeline(Renderer &renderer,
+                         const PresentFunction &present = PresentFunction());
+
+  /// @brief Stops the pipeline if running.
+  ~FramePipeline();
+
+  /// @brief Hand the GL context over to a new render thread.
+  /// @return Returns false if the context can't be made current on another
+  /// thread, in which case it stays current on this one.
+  bool Start();
+
+  /// @brief Wait for submitted frames to be presented, stop the render
+  /// thread, and make the GL context current on this thread again.
+  void Stop();
+
+  /// @brief Whether frames are rendered on the render thread.
+  bool running() const { return running_; }
+
+  /// @brief The packet to record the next frame in. Blocks while the render
+  /// thread is still executing the frame before last.
+  FramePacket &BeginFrame();
+
+  /// @brief Hand the packet returned by BeginFrame() to the render thread.
+  /// @param[in] minimized Passed to Renderer::AdvanceFrame() after the frame
+  /// has executed.
+  /// @param[in] time Passed to Renderer::AdvanceFrame().
+  /// @return Returns the window size after the last frame presented, which
+  /// on the render thread may be the frame before this one. Lay out the next
+  /// frame with it, rather than with Renderer::window_size().
+  mathfu::vec2i SubmitFrame(bool minimized, double time);
+
+  /// @brief Block until every submitted frame has been presented.
+  void Flush();
+
+ private:
+  FramePipeline(const FramePipeline &);
+  FramePipeline &operator=(const FramePipeline &);
+
+  static const int kNumPackets = 2;
+
+  struct Frame {
+    Frame() : in_flight(false), minimized(false), time(0.0) {}
+    FramePacket packet;
+    bool in_flight;  // Submitted, and not yet presented.
+    bool minimized;
+    double time;
+  };
+
+  void RenderThread();
+  void ExecuteFrame(Frame &frame);
+
+  Renderer &renderer_;
+  PresentFunction present_;
+  Frame frames_[kNumPackets];
+  int recording_;  // Index in frames_ of the packet BeginFrame() returns.
+  bool running_;
+
+  std::thread render_thread_;
+  // Protects the members below, and the in_flight flags of frames_.
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<int> submitted_;  // Indices in frames_, oldest first.
+  bool context_handed_off_;    // The render thread has tried to take it.
+  bool context_acquired_;      // The render thread has the context.
+  bool stopping_;
+  mathfu::vec2i window_size_;  // As of the last frame presented.
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_FRAME_PIPELINE_H
@@ -69,7 +69,9 @@
 #define GLBASEEXTS                                                             \
   GLEXT(PFNGLACTIVETEXTUREARBPROC, glActiveTexture, true)                      \
   GLEXT(PFNGLCOMPRESSEDTEXIMAGE2DPROC, glCompressedTexImage2D, true)           \
-  GLEXT(PFNGLBINDSAMPLERPROC, glBindSampler, true)
+  GLEXT(PFNGLBINDSAMPLERPROC, glBindSampler, true)                             \
+  GLEXT(PFNGLTEXIMAGE3DPROC, glTexImage3D, true)                               \
+  GLEXT(PFNGLTEXSUBIMAGE3DPROC, glTexSubImage3D, true)
 #else   // !defined(_WIN32)
 #define GLBASEEXTS
 #endif  // !defined(_WIN32)
@@ -134,6 +136,11 @@
   GLEXT(PFNGLGENVERTEXARRAYSPROC, glGenVertexArrays, true)                     \
   GLEXT(PFNGLDELETEVERTEXARRAYSPROC, glDeleteVertexArrays, true)               \
   GLEXT(PFNGLBINDVERTEXARRAYPROC, glBindVertexArray, true)                     \
+  GLEXT(PFNGLFENCESYNCPROC, glFenceSync, false)                                \
+  GLEXT(PFNGLCLIENTWAITSYNCPROC, glClientWaitSync, false)                      \
+  GLEXT(PFNGLDELETESYNCPROC, glDeleteSync, false)                              \
+  GLEXT(PFNGLMAPBUFFERRANGEPROC, glMapBufferRange, false)                      \
+  GLEXT(PFNGLBUFFERSTORAGEPROC, glBufferStorage, false)                        \
   GLEXT(PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC,                               \
         glFramebufferTextureMultiviewOVR, false)
 
@@ -15,6 +15,8 @@
 #ifndef FPLBASE_GPU_DEBUG_H
 #define FPLBASE_GPU_DEBUG_H
 
+#include <stdint.h>
+
 #include "fplbase/render_state.h"
 
 namespace fplbase {
@@ -25,6 +27,90 @@ namespace fplbase {
 /// the expected render state. In release no checks will occur.
 bool ValidateRenderState(const RenderState& render_state);
 
+/// @brief Parts of a RenderState that can be validated separately.
+enum RenderStateGroup {
+  kRenderStateGroupBlend,
+  kRenderStateGroupCull,
+  kRenderStateGroupScissor,
+  kRenderStateGroupDepth,
+  kRenderStateGroupPoint,
+  kRenderStateGroupStencil,
+  kRenderStateGroupViewport,
+  kRenderStateGroupCount
+};
+
+/// @brief Validates that the current GPU state matches one group of a given
+/// render state. Unlike ValidateRenderState(), doesn't assert.
+bool ValidateRenderStateGroup(const RenderState& render_state,
+                              RenderStateGroup group);
+
+/// @brief How much of the render state RenderStateValidator::Validate()
+/// reads back.
+///
+/// Every glGet stalls the pipeline, so the cheaper modes make it practical to
+/// keep validation enabled in performance-representative builds.
+enum RenderStateValidationMode {
+  /// Every group, every time. The default.
+  kRenderStateValidationAll,
+  /// One group each time, cycling through all of them.
+  kRenderStateValidationRoundRobin,
+  /// The groups set through the Renderer since the last validation, plus one
+  /// other group in round-robin, so that state changed behind the Renderer's
+  /// back is still caught eventually.
+  kRenderStateValidationTouched,
+};
+
+/// @brief The Renderer call that last set a group of render state.
+struct RenderStateCallSite {
+  RenderStateCallSite() : function(nullptr), return_address(nullptr) {}
+  RenderStateCallSite(const char* function, const void* return_address)
+      : function(function), return_address(return_address) {}
+
+  /// The name of the Renderer function.
+  const char* function;
+  /// Where that function was called from.
+  const void* return_address;
+};
+
+/// @class RenderStateValidator
+/// @brief Validates the GPU state against a RenderState incrementally, and
+///        reports mismatches with the call that last set the mismatched
+///        state.
+///
+/// The Renderer uses this when FPLBASE_VERIFY_GPU_STATE is defined.
+class RenderStateValidator {
+ public:
+  RenderStateValidator();
+
+  /// @brief Set how much state Validate() reads back.
+  void set_mode(RenderStateValidationMode mode) { mode_ = mode; }
+  /// @brief How much state Validate() reads back.
+  RenderStateValidationMode mode() const { return mode_; }
+
+  /// @brief Begin a Renderer call that may set render state. Nested calls
+  /// keep the outermost call site.
+  void BeginCall(const RenderStateCallSite& call_site);
+  /// @brief End the call begun by the matching BeginCall().
+  void EndCall();
+
+  /// @brief Record that `group` was set by the current call.
+  void Touch(RenderStateGroup group);
+
+  /// @brief Check the groups selected by mode() against `render_state`,
+  /// logging an error with the call site that last set each group that
+  /// doesn't match.
+  /// @return Returns false if any group doesn't match.
+  bool Validate(const RenderState& render_state);
+
+ private:
+  RenderStateValidationMode mode_;
+  int next_group_;
+  uint32_t touched_;
+  int call_depth_;
+  RenderStateCallSite current_call_;
+  RenderStateCallSite last_set_[kRenderStateGroupCount];
+};
+
 }  // namespace fplbase
 
 #endif  // FPLBASE_GPU_DEBUG_H
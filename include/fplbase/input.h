@@ -143,6 +143,71 @@ struct InputPointer {
   InputPointer() : id(0), mousepos(-1), mousedelta(0), used(false){};
 };
 
+/// @class ControllerSnapshot
+/// @brief Fixed-layout copy of the state of every connected joystick and
+///        gamepad, captured once per frame.
+///
+/// All per-device data is stored in dense arrays indexed by device slot, and
+/// button state is packed into one bitmask per device. Edge detection is a
+/// bitwise operation against the previous frame's mask, and the whole struct
+/// is trivially copyable, so it can be handed to a simulation thread by value.
+///
+/// Devices past kMaxDevices, axes past kMaxAxes, hats past kMaxHats and
+/// buttons past kMaxButtons are not captured.
+struct ControllerSnapshot {
+  static const int kMaxDevices = 8;
+  static const int kMaxAxes = 8;
+  static const int kMaxHats = 4;
+  static const int kMaxButtons = 64;
+
+  /// @brief Bitmask of buttons, bit `i` is button index `i`.
+  typedef uint64_t ButtonMask;
+
+  /// @brief Number of valid device slots.
+  int num_devices;
+
+  /// @brief Frame number (InputSystem::frames()) this snapshot was taken on.
+  int frame;
+
+  /// @brief JoystickId (or Android device id for gamepads) of each slot.
+  uint64_t device_ids[kMaxDevices];
+
+  /// @brief Buttons held down this frame.
+  ButtonMask buttons[kMaxDevices];
+
+  /// @brief Buttons held down the previous frame.
+  ButtonMask previous_buttons[kMaxDevices];
+
+  /// @brief Axis values in the range [-1, 1].
+  float axes[kMaxDevices][kMaxAxes];
+
+  /// @brief Hat directions, see Joystick::GetHat().
+  mathfu::vec2_packed hats[kMaxDevices][kMaxHats];
+
+  ControllerSnapshot() { Clear(); }
+
+  /// @brief Reset all slots to the released, centered state.
+  void Clear();
+
+  /// @brief Buttons that were pressed since the previous frame.
+  ButtonMask WentDown(int device) const {
+    return buttons[device] & ~previous_buttons[device];
+  }
+
+  /// @brief Buttons that were released since the previous frame.
+  ButtonMask WentUp(int device) const {
+    return previous_buttons[device] & ~buttons[device];
+  }
+
+  /// @brief Returns true if `button` on `device` is currently held.
+  bool IsDown(int device, int button) const {
+    return ((buttons[device] >> button) & 1) != 0;
+  }
+
+  /// @brief Returns the slot of the device with the given id, or -1.
+  int FindDevice(uint64_t device_id) const;
+};
+
 /// @class Joystick
 /// @brief Represents the state of a Joystick.
 class Joystick {
@@ -218,6 +283,12 @@ class Joystick {
   /// @brief Returns the number of hats available on the joystick.
   int GetNumHats() const;
 
+  /// @brief Copy the current button, axis and hat state into `device` slot of
+  /// `snapshot`.
+  ///
+  /// Normally only called by InputSystem::AdvanceFrame().
+  void CaptureState(int device, ControllerSnapshot *snapshot) const;
+
  private:
   JoystickData joystick_data_;
   std::vector<float> axis_list_;
@@ -295,6 +366,12 @@ class Gamepad {
     controller_id_ = controller_id;
   }
 
+  /// @brief Copy the current button state into `device` slot of `snapshot`.
+  ///
+  /// Buttons are stored at their GamepadInputButton bit. Normally only called
+  /// by InputSystem::AdvanceFrame().
+  void CaptureState(int device, ControllerSnapshot *snapshot) const;
+
   /// @brief Internal function for translating android input.
   static int GetGamepadCodeFromJavaKeyCode(int java_keycode);
 
@@ -624,6 +701,17 @@ class InputSystem {
     return joystick_map_;
   }
 
+  /// @brief Get the state of all joysticks and gamepads for this frame.
+  ///
+  /// Updated once per frame by AdvanceFrame(). Joysticks occupy the first
+  /// slots, followed by Android gamepads. The returned snapshot is a plain
+  /// value; copy it to hand the frame's controller state to another thread.
+  ///
+  /// @return Returns the snapshot taken by the most recent AdvanceFrame().
+  const ControllerSnapshot &controller_snapshot() const {
+    return controller_snapshots_[current_snapshot_];
+  }
+
 #if ANDROID_GAMEPAD
   /// @brief Get a Gamepad object describing the input state of the specified
   ///        device ID.
@@ -785,6 +873,10 @@ class InputSystem {
   // The event specific part of AdvanceFrame().
   void UpdateEvents(mathfu::vec2i *window_size);
 
+  // Flip the controller snapshots and capture the current joystick and
+  // gamepad state into the new current one.
+  void UpdateControllerSnapshot();
+
   bool exit_requested_;
   bool minimized_;
   std::vector<InputPointer> pointers_;
@@ -798,6 +890,11 @@ class InputSystem {
   std::map<int, Button> button_map_;
   std::map<JoystickId, Joystick> joystick_map_;
 
+  // Double-buffered controller state; the previous frame's snapshot supplies
+  // the `previous_buttons` masks of the current one.
+  ControllerSnapshot controller_snapshots_[2];
+  int current_snapshot_;
+
 #if ANDROID_GAMEPAD
   std::map<AndroidInputDeviceId, Gamepad> gamepad_map_;
   static pthread_mutex_t android_event_mutex;
@@ -16,13 +16,17 @@
 #define FPLBASE_MATERIAL_H
 
 #include <assert.h>
+#include <stdint.h>
+#include <string>
 #include <vector>
 
 #include "fplbase/config.h"  // Must come first.
 
 #include "fplbase/asset.h"
+#include "fplbase/object_pool.h"
 #include "fplbase/render_state.h"
 #include "fplbase/texture.h"
+#include "fplbase/texture_array.h"
 #include "materials_generated.h"
 
 namespace fplbase {
@@ -32,13 +36,26 @@ namespace fplbase {
 /// @{
 
 class Renderer;
+class Shader;
 class Texture;
 
+/// @brief A named shader uniform that a Material sets whenever it's bound,
+/// such as a tint or roughness.
+struct MaterialParam {
+  /// The name of the uniform.
+  std::string name;
+  /// The value: 1, 2, 3, 4 or 16 floats.
+  std::vector<float> value;
+};
+
 /// @brief Collections of textures used for rendering multi-texture models.
 class Material : public Asset {
  public:
   /// @brief Default constructor for Material.
-  Material() : blend_mode_(kBlendModeOff) {}
+  Material()
+      : blend_mode_(kBlendModeOff),
+        textures_sort_key_(0),
+        params_version_(NextParamsVersion()) {}
 
   /// @brief Set the renderer for this Material.
   /// @param[in] renderer The renderer to set for this Material.
@@ -54,6 +71,17 @@ class Material : public Asset {
   /// the Textures from this Material.
   const std::vector<Texture *> &textures() const { return textures_; }
 
+  /// @brief Get the layer of each texture, for textures that are layers of
+  /// a TextureArray, or -1 for textures that aren't.
+  /// @return Returns a `std::vector<int>` reference parallel to textures().
+  std::vector<int> &texture_layers() { return texture_layers_; }
+
+  /// @brief Get the layer of each texture, for textures that are layers of
+  /// a TextureArray, or -1 for textures that aren't.
+  /// @return Returns a const `std::vector<int>` reference parallel to
+  /// textures().
+  const std::vector<int> &texture_layers() const { return texture_layers_; }
+
   /// @brief Get the blend mode for this Material.
   /// @return Returns an `int` corresponding the the @ref fplbase_material
   /// "BlendMode" enum for this Material.
@@ -68,22 +96,98 @@ class Material : public Asset {
     blend_mode_ = blend_mode;
   }
 
-  /// @brief Delete all Textures in this Material.
+  /// @brief Get the parameters set on the shader whenever this Material is
+  /// bound.
+  const std::vector<MaterialParam> &params() const { return params_; }
+
+  /// @brief Set the parameter `name`, adding it if this Material doesn't
+  /// have it yet. It's uploaded the next time the Material is bound.
+  /// @param[in] name The name of the uniform.
+  /// @param[in] value The value to set it to.
+  /// @param[in] num_components The number of floats in `value`: 1, 2, 3, 4 or
+  /// 16.
+  /// @return Returns false if `num_components` isn't supported.
+  bool SetParam(const char *name, const float *value, size_t num_components);
+
+  /// @brief Set the float parameter `name`. See SetParam() above.
+  bool SetParam(const char *name, float value) {
+    return SetParam(name, &value, 1);
+  }
+
+  /// @brief Set the vec2/3/4 parameter `name`. See SetParam() above.
+  template <int N>
+  bool SetParam(const char *name, const mathfu::Vector<float, N> &value) {
+    return SetParam(name, &value[0], N);
+  }
+
+  /// @brief A key for sorting draws so that consecutive draws switch as
+  /// little state as possible.
+  ///
+  /// The blend mode is in the top 4 bits, so opaque materials sort first,
+  /// followed by a hash of the textures. Materials whose textures are layers
+  /// of the same TextureArrays get the same key. The key depends only on the
+  /// material's definition, so it's the same from run to run.
+  /// @return Returns the 32 bit sort key.
+  uint32_t sort_key() const {
+    return (static_cast<uint32_t>(blend_mode_) << 28) | textures_sort_key_;
+  }
+
+  /// @brief Recompute sort_key() after changing textures(). Materials
+  /// loaded with LoadFromMaterialDef() are already up to date.
+  void UpdateSortKey();
+
+  /// @brief Delete all Textures in this Material, except layers of
+  /// TextureArrays, which other Materials may share.
   void DeleteTextures();
 
   /// @brief Create a Material from the specified flatbuffer matdef::Material*.
-  static Material *LoadFromMaterialDef(const matdef::Material *matdef,
-                                       const TextureLoaderFn &tlf);
+  /// @param[in] matdef The material definition.
+  /// @param[in] tlf Loads each texture.
+  /// @param[in] llf If set, loads each texture as a layer of a TextureArray
+  /// when `matdef->texture_array()` is set. Textures it fails to load are
+  /// loaded with `tlf` instead.
+  static Material *LoadFromMaterialDef(
+      const matdef::Material *matdef, const TextureLoaderFn &tlf,
+      const TextureLayerLoaderFn &llf = TextureLayerLoaderFn());
 
   /// @brief Load a .fplmat file, and all the textures referenced from it.
   /// Used by the more convenient AssetManager interface, but can be used
   /// without it.
-  static Material *LoadFromMaterialDef(const char *filename,
-                                       const TextureLoaderFn &tlf);
+  static Material *LoadFromMaterialDef(
+      const char *filename, const TextureLoaderFn &tlf,
+      const TextureLayerLoaderFn &llf = TextureLayerLoaderFn());
+
+  /// @brief The pool that heap-allocated Materials live in, to iterate over
+  /// them all, such as for memory accounting.
+  static ObjectPool<Material> &pool();
+
+  FPLBASE_DEFINE_POOLED_NEW_DELETE(Material)
 
  private:
+  friend class Renderer;
+
+  static uint32_t NextParamsVersion();
+
   std::vector<Texture *> textures_;
+  std::vector<int> texture_layers_;
   BlendMode blend_mode_;
+  uint32_t textures_sort_key_;
+
+  std::vector<MaterialParam> params_;
+  // Changes whenever params_ do, and is unique across Materials, so the
+  // Renderer can tell whether the current shader already has the values.
+  uint32_t params_version_;
+  // Uniform handles of params_ in a Shader, as of the link that gave it
+  // program_version.
+  struct ParamHandles {
+    const Shader *shader;
+    uint32_t program_version;
+    std::vector<UniformHandle> handles;
+  };
+  // The handles of params_ in each shader the Material has been bound
+  // with. Materials are drawn with few shaders, so this is searched
+  // linearly.
+  std::vector<ParamHandles> params_handles_;
 };
 
 /// @}
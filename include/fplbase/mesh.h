@@ -23,6 +23,7 @@
 #include "fplbase/async_loader.h"
 #include "fplbase/handles.h"
 #include "fplbase/material.h"
+#include "fplbase/object_pool.h"
 #include "fplbase/render_state.h"
 #include "fplbase/shader.h"
 #include "mathfu/constants.h"
@@ -107,6 +108,10 @@ class Mesh : public AsyncAsset {
   /// @brief Creates a mesh from 'data_'.
   virtual bool Finalize();
 
+  /// @brief Fills the vertex and index buffers from 'data_' on the loader
+  /// thread, when the loader has a shared context, for Finalize() to adopt.
+  virtual bool Upload();
+
   /// @brief Whether this object loaded and finalized correctly. Call after
   /// Finalize has been called (by AssetManager::TryFinalize).
   bool IsValid();
@@ -145,6 +150,33 @@ class Mesh : public AsyncAsset {
                 size_t num_bones, const uint8_t *shader_bone_indices,
                 size_t num_shader_bones);
 
+  /// @brief Set the bone palette of the IBO at the given index.
+  ///
+  /// Large skeletons may not fit in a shader's bone transform array, so the
+  /// mesh_pipeline can split a mesh's surfaces until each is skinned by few
+  /// enough bones. The bone indices in such a surface's vertices index into
+  /// its palette, which in turn indexes the shader bones.
+  ///
+  /// When an IBO has a palette, Renderer::Render uploads only the palette's
+  /// shader transforms before drawing it, taken from the transforms passed
+  /// to Renderer::SetBoneTransforms(). Set them after Renderer::SetShader()
+  /// to avoid also uploading the whole array there.
+  ///
+  /// @param i The index of the IBO.
+  /// @param shader_bone_indices Shader bone for each palette entry.
+  /// @param num_palette_bones The length of shader_bone_indices.
+  void SetBonePalette(size_t i, const uint8_t *shader_bone_indices,
+                      size_t num_palette_bones);
+
+  /// @brief The bone palette of the IBO at the given index.
+  ///
+  /// @param i The index of the IBO.
+  /// @return Returns the shader bone of each palette entry. Empty if the IBO
+  ///         is skinned with shader bone indices directly.
+  const std::vector<uint8_t> &bone_palette(size_t i) const {
+    return indices_[i].bone_palette;
+  }
+
   /// @brief Convert bone transforms for consumption by a skinning shader.
   ///
   /// Vertices are stored in object space, but we need to manipulate them
@@ -352,7 +384,11 @@ class Mesh : public AsyncAsset {
   // Init mesh from MeshDef FlatBuffer.
   bool InitFromMeshDef(const void *meshdef_buffer);
 
-  MATHFU_DEFINE_CLASS_SIMD_AWARE_NEW_DELETE
+  /// @brief The pool that heap-allocated Meshes live in, to iterate over
+  /// them all, such as for memory accounting.
+  static ObjectPool<Mesh> &pool();
+
+  FPLBASE_DEFINE_POOLED_NEW_DELETE(Mesh)
 
  private:
   // Disallow copies because of pointers bone_transforms_ and
@@ -369,8 +405,8 @@ class Mesh : public AsyncAsset {
   // impl_ class). Implemented in platform-dependent code.
   void ClearPlatformDependent();
 
-  // Backend-specific create and destroy calls. These just call new and delete
-  // on the platform-specific MeshImpl structs.
+  // Backend-specific create and destroy calls. These allocate the
+  // platform-specific MeshImpl structs from a pool.
   static MeshImpl *CreateMeshImpl();
   static void DestroyMeshImpl(MeshImpl *impl);
 
@@ -388,6 +424,7 @@ class Mesh : public AsyncAsset {
     Material *mat;
     uint32_t index_type;
     DeviceMemoryHandle indexBufferMem;
+    std::vector<uint8_t> bone_palette;
   };
 
   MeshImpl *impl_;
@@ -0,0 +1,293 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef FPLBASE_OBJECT_POOL_H
+#define FPLBASE_OBJECT_POOL_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <map>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplutil/mutex.h"
+#include "mathfu/utilities.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_asset_manager
+/// @{
+
+/// @brief The cache line size assumed when laying out pooled objects.
+static const size_t kCacheLineSize = 64;
+
+/// @brief Identifies an object in an ObjectPool, and which use of its slot
+///        it is, in 32 bits.
+///
+/// The low kIndexBits bits are the slot's index, and the rest are the slot's
+/// generation while it held the object, which is always odd. Generations
+/// wrap around, so a handle that is kept while its slot is reused 2048 times
+/// resolves again. A default-constructed handle never resolves.
+struct ObjectPoolHandle {
+  static const uint32_t kIndexBits = 20;
+  static const uint32_t kMaxIndex = (1u << kIndexBits) - 1;
+  static const uint32_t kGenerationMask = (1u << (32 - kIndexBits)) - 1;
+
+  ObjectPoolHandle() : value(0) {}
+  ObjectPoolHandle(uint32_t index, uint32_t generation)
+      : value(generation << kIndexBits | index) {
+    assert(index <= kMaxIndex && generation <= kGenerationMask);
+  }
+
+  /// @brief The slot the object is in.
+  uint32_t index() const { return value & kMaxIndex; }
+  /// @brief The slot's generation while it held the object.
+  uint32_t generation() const { return value >> kIndexBits; }
+
+  bool operator==(const ObjectPoolHandle &other) const {
+    return value == other.value;
+  }
+  bool operator!=(const ObjectPoolHandle &other) const {
+    return value != other.value;
+  }
+
+  /// @brief The generation and index, packed.
+  uint32_t value;
+};
+static_assert(sizeof(ObjectPoolHandle) == 4,
+              "ObjectPoolHandle must pack into 32 bits.");
+
+/// @class ObjectPool
+/// @brief Storage for objects of type `T`, in fixed-capacity blocks of
+///        cache-line-aligned slots, with a generation counter per slot.
+///
+/// Blocks are never moved or freed before the pool is, so objects keep their
+/// addresses. Freed slots are reused, most recently freed first, and each
+/// reuse changes the slot's generation, so Handles to freed objects stop
+/// resolving. A pool holds at most ObjectPoolHandle::kMaxIndex + 1 slots.
+/// Each object starts on its own cache line, and ForEach() walks the blocks
+/// in order.
+///
+/// All functions are thread safe. ForEach() holds the pool's lock, so its
+/// function must not allocate or free objects in the same pool.
+template <typename T, size_t kSlotsPerBlock = 64>
+class ObjectPool {
+ public:
+  /// @brief Identifies an object in this pool. See ObjectPoolHandle.
+  typedef ObjectPoolHandle Handle;
+
+  /// @brief Bytes per slot: `sizeof(T)`, rounded up to whole cache lines.
+  static const size_t kSlotSize =
+      (sizeof(T) + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+
+  ObjectPool() : num_live_(0) {}
+
+  /// @brief Frees the pool's memory. Objects still in it aren't destroyed.
+  ~ObjectPool() {
+    for (auto it = allocations_.begin(); it != allocations_.end(); ++it) {
+      free(*it);
+    }
+  }
+
+  /// @brief Reserve a slot for a `T`, without constructing it.
+  void *Allocate() {
+    fplutil::MutexLock lock(mutex_);
+    if (free_.empty()) Grow();
+    const uint32_t index = free_.back();
+    free_.pop_back();
+    generations_[index] = NextGeneration(generations_[index]);
+    num_live_++;
+    return SlotAddress(index);
+  }
+
+  /// @brief Return a slot from Allocate() to the pool.
+  void Free(void *p) {
+    fplutil::MutexLock lock(mutex_);
+    const int64_t index = IndexOf(p);
+    assert(index >= 0 && (generations_[index] & 1) != 0);
+    num_live_--;
+    generations_[index] = NextGeneration(generations_[index]);
+    free_.push_back(static_cast<uint32_t>(index));
+  }
+
+  /// @brief Construct a `T` in a new slot.
+  template <typename... Args>
+  T *New(Args &&... args) {
+    return new (Allocate()) T(std::forward<Args>(args)...);
+  }
+
+  /// @brief Destroy `object`, made by New(), and free its slot.
+  void Delete(T *object) {
+    if (object == nullptr) return;
+    object->~T();
+    Free(object);
+  }
+
+  /// @brief Whether `p` is the address of a slot in this pool.
+  bool Owns(const void *p) const {
+    fplutil::MutexLock lock(mutex_);
+    return IndexOf(p) >= 0;
+  }
+
+  /// @brief The handle of `object`, or a Handle that never resolves if
+  /// `object` isn't live in this pool.
+  Handle GetHandle(const T *object) const {
+    fplutil::MutexLock lock(mutex_);
+    const int64_t index = IndexOf(object);
+    if (index < 0 || (generations_[index] & 1) == 0) return Handle();
+    return Handle(static_cast<uint32_t>(index), generations_[index]);
+  }
+
+  /// @brief The object `handle` refers to, or nullptr if it has been freed.
+  T *Get(const Handle &handle) const {
+    fplutil::MutexLock lock(mutex_);
+    const uint32_t index = handle.index();
+    if (index >= generations_.size() ||
+        generations_[index] != handle.generation() ||
+        (handle.generation() & 1) == 0) {
+      return nullptr;
+    }
+    return reinterpret_cast<T *>(SlotAddress(index));
+  }
+
+  /// @brief Call `func(T *)` on every allocated object, in slot order.
+  template <typename Func>
+  void ForEach(const Func &func) const {
+    fplutil::MutexLock lock(mutex_);
+    for (size_t i = 0; i < generations_.size(); ++i) {
+      if (generations_[i] & 1) func(reinterpret_cast<T *>(SlotAddress(i)));
+    }
+  }
+
+  /// @brief The number of allocated objects.
+  size_t size() const {
+    fplutil::MutexLock lock(mutex_);
+    return num_live_;
+  }
+
+  /// @brief The number of slots, allocated or free.
+  size_t capacity() const {
+    fplutil::MutexLock lock(mutex_);
+    return generations_.size();
+  }
+
+ private:
+  static_assert(alignof(T) <= kCacheLineSize,
+                "ObjectPool slots are only cache-line aligned.");
+
+  // Generations wrap within the bits a Handle has for them. The mask is
+  // even, so allocated slots keep odd generations, and never 0.
+  static uint16_t NextGeneration(uint16_t generation) {
+    return static_cast<uint16_t>((generation + 1) &
+                                 ObjectPoolHandle::kGenerationMask);
+  }
+
+  uint8_t *SlotAddress(size_t index) const {
+    return blocks_[index / kSlotsPerBlock] + index % kSlotsPerBlock * kSlotSize;
+  }
+
+  // The index of the slot at `p`, or -1 if `p` isn't a slot in this pool.
+  int64_t IndexOf(const void *p) const {
+    const uint8_t *address = static_cast<const uint8_t *>(p);
+    auto it = block_numbers_.upper_bound(address);
+    if (it == block_numbers_.begin()) return -1;
+    --it;
+    const size_t offset = static_cast<size_t>(address - it->first);
+    if (offset >= kSlotsPerBlock * kSlotSize || offset % kSlotSize != 0) {
+      return -1;
+    }
+    return static_cast<int64_t>(it->second * kSlotsPerBlock +
+                                offset / kSlotSize);
+  }
+
+  void Grow() {
+    void *allocation = malloc(kSlotsPerBlock * kSlotSize + kCacheLineSize);
+    assert(allocation);
+    const uintptr_t aligned =
+        (reinterpret_cast<uintptr_t>(allocation) + kCacheLineSize - 1) &
+        ~static_cast<uintptr_t>(kCacheLineSize - 1);
+    uint8_t *block = reinterpret_cast<uint8_t *>(aligned);
+    const uint32_t block_number = static_cast<uint32_t>(blocks_.size());
+    assert((block_number + 1) * kSlotsPerBlock <=
+           ObjectPoolHandle::kMaxIndex + 1);
+    allocations_.push_back(allocation);
+    blocks_.push_back(block);
+    block_numbers_[block] = block_number;
+    const uint32_t first =
+        block_number * static_cast<uint32_t>(kSlotsPerBlock);
+    generations_.resize(first + kSlotsPerBlock, 0);
+    // Push in reverse, so that slots are handed out in address order.
+    for (size_t i = kSlotsPerBlock; i > 0; --i) {
+      free_.push_back(first + static_cast<uint32_t>(i) - 1);
+    }
+  }
+
+  mutable fplutil::Mutex mutex_;
+  // Cache-line-aligned blocks of kSlotsPerBlock slots, and the allocations
+  // they're in.
+  std::vector<uint8_t *> blocks_;
+  std::vector<void *> allocations_;
+  // The index in blocks_ of each block, by address, to find pointers' slots.
+  std::map<const uint8_t *, uint32_t> block_numbers_;
+  // Per slot. Odd while the slot is allocated.
+  std::vector<uint16_t> generations_;
+  // Free slots, with the next to allocate at the back.
+  std::vector<uint32_t> free_;
+  size_t num_live_;
+
+  ObjectPool(const ObjectPool &);
+  void operator=(const ObjectPool &);
+};
+
+/// @brief Define class operator new and delete so that heap instances of
+/// `Class` live in the ObjectPool<Class> returned by `Class::pool()`.
+///
+/// Only allocations of exactly `sizeof(Class)` are pooled. Instances of
+/// subclasses that add members, and arrays, silently use SIMD-aligned heap
+/// memory instead, as MATHFU_DEFINE_CLASS_SIMD_AWARE_NEW_DELETE does. Those
+/// aren't visited by ObjectPool::ForEach(), and have no Handle, so an
+/// AssetManager can't give them an AssetHandle either.
+#define FPLBASE_DEFINE_POOLED_NEW_DELETE(Class)                              \
+  static void *operator new(std::size_t n) {                                 \
+    return n == sizeof(Class) ? pool().Allocate()                            \
+                              : mathfu::AllocateAligned(n);                  \
+  }                                                                          \
+  static void *operator new[](std::size_t n) {                               \
+    return mathfu::AllocateAligned(n);                                       \
+  }                                                                          \
+  static void *operator new(std::size_t, void *p) { return p; }              \
+  static void *operator new[](std::size_t, void *p) { return p; }            \
+  static void operator delete(void *p) {                                     \
+    if (p == nullptr) return;                                                \
+    if (pool().Owns(p)) {                                                    \
+      pool().Free(p);                                                        \
+    } else {                                                                 \
+      mathfu::FreeAligned(p);                                                \
+    }                                                                        \
+  }                                                                          \
+  static void operator delete[](void *p) { mathfu::FreeAligned(p); }         \
+  static void operator delete(void *, void *) {}                             \
+  static void operator delete[](void *, void *) {}
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_OBJECT_POOL_H
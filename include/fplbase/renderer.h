@@ -17,7 +17,10 @@
 
 #include "fplbase/config.h"  // Must come first.
 
+#include <unordered_map>
+
 #include "fplbase/environment.h"
+#include "fplbase/gpu_debug.h"
 #include "fplbase/material.h"
 #include "fplbase/mesh.h"
 #include "fplbase/render_state.h"
@@ -228,6 +231,16 @@ class RendererBase {
   /// @return Returns the max number of uniform components.
   int max_vertex_uniform_components() { return max_vertex_uniform_components_; }
 
+  /// @brief The number of vertex and fragment shaders compiled so far.
+  int shader_stages_compiled() const { return shader_stages_compiled_; }
+
+  /// @brief The number of vertex and fragment shaders that were not compiled,
+  ///        because a program already had a stage with identical source.
+  ///
+  /// Stages are compared after preprocessing, so programs that share a source
+  /// file but enable different defines don't share stages.
+  int shader_stage_cache_hits() const { return shader_stage_cache_hits_; }
+
   /// @brief Returns the version of the FPL Base Library.
   const FplBaseVersion *GetFplBaseVersion() const { return version_; }
 
@@ -252,9 +265,23 @@ class RendererBase {
 
  private:
   friend class Renderer;
-
+  friend class Shader;
+
+  // A compiled vertex or fragment shader, attached to `ref_count` programs.
+  struct ShaderStage {
+    ShaderHandle handle;
+    int ref_count;
+    // The preprocessed source, to tell apart stages whose hashes collide.
+    std::string source;
+  };
+
+  // Compile `source` and attach it to `program`, or attach the stage compiled
+  // earlier from the same preprocessed source. Each stage returned must be
+  // released with ReleaseShaderStage().
   ShaderHandle CompileShader(bool is_vertex_shader, ShaderHandle program,
                              const char *source);
+  // Delete `stage` once no program refers to it.
+  static void ReleaseShaderStage(ShaderHandle stage);
   Shader *CompileAndLinkShaderHelper(const char *vs_source,
                                      const char *ps_source, Shader *shader);
 
@@ -288,6 +315,14 @@ class RendererBase {
 
   int max_vertex_uniform_components_;
 
+  // Compiled stages, keyed by a hash of their type and preprocessed source.
+  // If two sources collide, only the first is cached.
+  std::unordered_map<uint64_t, ShaderStage> shader_stages_;
+  // The key in `shader_stages_` of each stage's handle.
+  std::unordered_map<uint64_t, uint64_t> shader_stage_keys_;
+  int shader_stages_compiled_;
+  int shader_stage_cache_hits_;
+
   // Current version of the library.
   const FplBaseVersion *version_;
 
@@ -414,6 +449,25 @@ class Renderer {
     num_bones_ = num_bones;
   }
 
+  /// @brief Sets the shader uniform texture_layers, an array of floats with
+  /// the layer to sample from the TextureArray bound to each texture unit.
+  ///
+  /// Material::Set() calls this for materials whose textures are layers of
+  /// TextureArrays. Unlike the uniforms above, it's set on the current shader
+  /// immediately, so that consecutive draws can change only the layer.
+  /// @param layers The layer of each texture unit. Negative values, for
+  /// textures that aren't arrays, are passed as 0.
+  void SetTextureLayers(const std::vector<int> &layers);
+
+  /// @brief Uploads the parameters of `material` to the current shader.
+  ///
+  /// Material::Set() calls this. The uniform locations are looked up once per
+  /// shader, and nothing is uploaded if the shader already has the same
+  /// values from the previous call. Setting those uniforms directly with
+  /// Shader::SetUniform() in between isn't detected.
+  /// @param material The material whose parameters to upload.
+  void SetMaterialParams(Material *material);
+
   /// @brief Clears the framebuffer.
   ///
   /// Call this after AdvanceFrame if desired.
@@ -603,6 +657,11 @@ class Renderer {
   /// @brief Returns the current render state.
   const RenderState &GetRenderState() const { return render_state_; }
 
+  /// @brief The validator that BeginRendering() and EndRendering() use to
+  /// check the GPU state when FPLBASE_VERIFY_GPU_STATE is defined. Use it to
+  /// choose a cheaper RenderStateValidationMode.
+  RenderStateValidator &render_state_validator() { return state_validator_; }
+
   /// @brief Sets the render state to match the desired state.
   //
   /// @param render_state The render state to be set.
@@ -646,6 +705,7 @@ class Renderer {
   void SetStencilState(const StencilState &stencil_state);
   void RenderSubMeshHelper(Mesh *mesh, size_t index, bool ignore_material,
                            size_t instances);
+  void SetBonePalette(const std::vector<uint8_t> &palette);
 
   // Platform-dependent data.
   RendererImpl* impl_;
@@ -664,7 +724,21 @@ class Renderer {
   const mathfu::AffineTransform *bone_transforms_;
   int num_bones_;
 
+  // The shader most recently passed to SetShader().
+  const Shader *shader_;
+
+  // The Material::params_version_ most recently uploaded by
+  // SetMaterialParams(), and the shader and Shader::program_version_ it was
+  // uploaded to.
+  uint32_t material_params_version_;
+  const Shader *material_params_shader_;
+  uint32_t material_params_program_version_;
+
+  // Scratch space for uploading a bone palette's transforms.
+  std::vector<float> bone_palette_data_;
+
   RenderState render_state_;
+  RenderStateValidator state_validator_;
 
   BlendMode blend_mode_;
   float blend_amount_;
@@ -21,6 +21,7 @@
 
 #include "fplbase/async_loader.h"
 #include "fplbase/handles.h"
+#include "fplbase/object_pool.h"
 #include "mathfu/glsl_mappings.h"
 
 namespace fplbase {
@@ -110,7 +111,7 @@ class Shader : public AsyncAsset {
   /// @param value The value to set the uniform to.
   /// @param num_components The number of components used by the uniform.
   void SetUniform(UniformHandle uniform_loc, const float *value,
-                  size_t num_components);
+                  size_t num_components) const;
 
   /// @brief Set an non-standard uniform to a vec2/3/4 value.
   ///
@@ -195,6 +196,15 @@ class Shader : public AsyncAsset {
   /// used without it.
   static Shader *LoadFromShaderDef(const char *filename);
 
+  /// @brief The pool that heap-allocated Shaders live in.
+  static ObjectPool<Shader> &pool();
+
+  FPLBASE_DEFINE_POOLED_NEW_DELETE(Shader)
+
+ protected:
+  /// @brief Frees the source loaded by an aborted load.
+  virtual void DiscardData();
+
  private:
   friend class Renderer;
   friend class RendererBase;
@@ -214,6 +224,8 @@ class Shader : public AsyncAsset {
 
   void Reset(ShaderHandle program, ShaderHandle vs, ShaderHandle ps);
 
+  static uint32_t NextProgramVersion();
+
   bool ReloadInternal();
 
   ShaderSourcePair *LoadSourceFile();
@@ -228,6 +240,10 @@ class Shader : public AsyncAsset {
   ShaderHandle program_;
   ShaderHandle vs_;
   ShaderHandle ps_;
+  // Changes whenever program_ does, and is unique across Shaders. GL reuses
+  // the names of deleted programs, so caches of a program's uniforms are
+  // keyed on this instead.
+  uint32_t program_version_;
 
   UniformHandle uniform_model_view_projection_;
   UniformHandle uniform_model_;
@@ -236,6 +252,7 @@ class Shader : public AsyncAsset {
   UniformHandle uniform_camera_pos_;
   UniformHandle uniform_time_;
   UniformHandle uniform_bone_transforms_;
+  UniformHandle uniform_texture_layers_;
 
   Renderer *renderer_;
 
@@ -0,0 +1,130 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_TANGENT_SPACE_H
+#define FPLBASE_TANGENT_SPACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_mesh
+/// @{
+
+/// @brief Runs `fn(i)` once for every `i` in [0, `count`), possibly on
+///        several threads at once. Returns when every call has returned.
+typedef std::function<void(size_t count, const std::function<void(size_t)> &fn)>
+    ParallelForFunction;
+
+/// @brief A strided array of floats, such as one attribute of an interleaved
+///        vertex buffer.
+struct VertexAttributeView {
+  VertexAttributeView() : data(nullptr), stride(0) {}
+  /// @param data The first element.
+  /// @param stride Bytes from the start of one element to the next.
+  VertexAttributeView(const void *data, size_t stride)
+      : data(data), stride(stride) {}
+
+  const float *operator[](size_t i) const {
+    return reinterpret_cast<const float *>(static_cast<const uint8_t *>(data) +
+                                           i * stride);
+  }
+
+  const void *data;
+  size_t stride;
+};
+
+/// @brief The indexed triangle list that tangents are generated for.
+struct TangentSpaceMesh {
+  TangentSpaceMesh()
+      : num_vertices(0),
+        indices16(nullptr),
+        indices32(nullptr),
+        num_indices(0) {}
+
+  VertexAttributeView positions;  ///< 3 floats per vertex.
+  VertexAttributeView normals;    ///< 3 floats per vertex, unit length.
+  VertexAttributeView uvs;        ///< 2 floats per vertex.
+  size_t num_vertices;
+
+  /// Three indices per triangle. Set exactly one of `indices16` and
+  /// `indices32`.
+  const uint16_t *indices16;
+  const uint32_t *indices32;
+  size_t num_indices;
+};
+
+/// @brief Generate a tangent for every vertex of an indexed triangle list.
+///
+/// Follows the conventions of MikkTSpace, so normal maps baked by tools that
+/// use it light correctly: each triangle's tangent and bitangent are
+/// projected onto the plane of each corner's normal, and weighted by the
+/// corner's angle. Tangents are then orthonormalized against the normal.
+///
+/// Vertices are not split. If a vertex is shared by triangles of opposite
+/// handedness, e.g. on a mirrored UV seam, it gets the frame of the side
+/// with the greater weight. Use GenerateCornerTangents() to split such
+/// vertices instead.
+///
+/// @param mesh The triangles. Every index must be less than
+///        `mesh.num_vertices`.
+/// @param tangents Output array of length `mesh.num_vertices`. The w
+///        component is the handedness, +1 or -1, such that the bitangent is
+///        `w * cross(normal, tangent.xyz)`. Vertices that no triangle
+///        references get an arbitrary tangent perpendicular to their normal.
+/// @param parallel_for If set, large meshes are split into ranges of
+///        triangles and vertices that are processed by `parallel_for`. The
+///        output is identical either way.
+void GenerateTangents(const TangentSpaceMesh &mesh,
+                      mathfu::vec4_packed *tangents,
+                      const ParallelForFunction &parallel_for =
+                          ParallelForFunction());
+
+/// @brief Generate a tangent for every index of an indexed triangle list.
+///
+/// As GenerateTangents(), but as in MikkTSpace, the corners of a vertex are
+/// summed separately for each handedness. A vertex shared by triangles of
+/// opposite handedness gets a different tangent on each side, so the caller
+/// should split it.
+///
+/// @param mesh The triangles. Every index must be less than
+///        `mesh.num_vertices`.
+/// @param corner_tangents Output array of length `mesh.num_indices`, holding
+///        the tangent of the vertex referenced by each index. Corners of
+///        triangles without UV area get the vertex's dominant frame.
+/// @param parallel_for As for GenerateTangents().
+void GenerateCornerTangents(const TangentSpaceMesh &mesh,
+                            mathfu::vec4_packed *corner_tangents,
+                            const ParallelForFunction &parallel_for =
+                                ParallelForFunction());
+
+/// @brief Build the quaternion that rotates the z-axis to `normal` and the
+///        x-axis to `tangent.xyz`.
+///
+/// The sign of the scalar component encodes the tangent's handedness, so a
+/// single quaternion stores the whole tangent frame.
+///
+/// @return Returns the quaternion as (vector.xyz, scalar).
+mathfu::vec4 CalculateOrientation(const mathfu::vec3 &normal,
+                                  const mathfu::vec4 &tangent);
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_TANGENT_SPACE_H
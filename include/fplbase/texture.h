@@ -21,13 +21,16 @@
 
 #include "fplbase/async_loader.h"
 #include "fplbase/handles.h"
+#include "fplbase/object_pool.h"
 #include "mathfu/constants.h"
 #include "mathfu/glsl_mappings.h"
 
 namespace fplbase {
 
 class Renderer;
+class TextureStagingPool;
 struct TextureImpl;
+struct TextureStagingBuffer;
 
 /// @file
 /// @addtogroup fplbase_texture
@@ -65,6 +68,20 @@ enum TextureFlags {
   kTextureFlagsPremultiplyAlpha = 1 << 4,
 };
 
+/// @brief Filters used to resample images whose size the GPU doesn't support.
+enum TextureResampleFilter {
+  /// Catmull-Rom when enlarging, Mitchell when shrinking.
+  kTextureResampleFilterDefault,
+  /// Average of the covered pixels. Cheapest, but blurs when enlarging.
+  kTextureResampleFilterBox,
+  /// Bilinear.
+  kTextureResampleFilterTriangle,
+  /// Sharp cubic, which can ring around hard edges.
+  kTextureResampleFilterCatmullRom,
+  /// Cubic balancing sharpness against ringing.
+  kTextureResampleFilterMitchell,
+};
+
 inline TextureFlags operator|(TextureFlags a, TextureFlags b) {
   return static_cast<TextureFlags>(static_cast<int>(a) | static_cast<int>(b));
 }
@@ -125,8 +142,19 @@ class Texture : public AsyncAsset {
                               TextureFormat texture_format);
 
   /// @brief Creates a Texture from `data_` and stores the handle in `id_`.
+  /// If Upload() already created it, just stores its handle.
   virtual bool Finalize();
 
+  /// @brief Creates the texture from `data_` on the loader thread, when the
+  /// loader has a shared context, and frees `data_`.
+  virtual bool Upload();
+
+  /// @brief Have Load() write the texture into a buffer from `pool`, so that
+  /// Finalize() only has to issue the upload from it. Textures that don't
+  /// fit in a free buffer are loaded as usual.
+  /// @param[in] pool The pool to stage into, or nullptr to stop staging.
+  void set_staging_pool(TextureStagingPool *pool) { staging_pool_ = pool; }
+
   /// @brief Whether this object loaded and finalized correctly. Call after
   /// Finalize has been called (by AssetManager::TryFinalize).
   bool IsValid() { return ValidTextureHandle(id_); }
@@ -148,6 +176,7 @@ class Texture : public AsyncAsset {
   void Set(size_t unit) const;
 
   /// @brief Delete the Texture stored in `id_`, and reset `id_` to `0`.
+  /// Also deletes any texture Upload() created that wasn't finalized.
   void Delete();
 
   /// @brief Update (part of) the current texture with new pixel data.
@@ -187,13 +216,16 @@ class Texture : public AsyncAsset {
   /// width and height.
   /// @param[out] texture_format The format of the returned buffer, always
   /// either 888 or 8888.
+  /// @param[in] cancel If not null, decoding stops early, returning `nullptr`,
+  /// once this is cancelled.
   /// @return Returns a RGBA array of the returned dimensions or `nullptr`, if
   /// the format is not understood.
   /// @note You must `free()` on the returned pointer when done.
   static uint8_t *UnpackWebP(const void *webp_buf, size_t size,
                              const mathfu::vec2 &scale, TextureFlags flags,
                              mathfu::vec2i *dimensions,
-                             TextureFormat *texture_format);
+                             TextureFormat *texture_format,
+                             const CancellationToken *cancel = nullptr);
 
   /// @brief Reads a memory buffer containing an ASTC format (.astc) file.
   /// @param[in] astc_buf The ASTC image data.
@@ -293,25 +325,69 @@ class Texture : public AsyncAsset {
   /// width and height.
   /// @param[out] texture_format The format of the returned buffer, always
   /// either 888 or 8888.
+  /// @param[in] cancel If not null, loading stops early, returning `nullptr`,
+  /// once this is cancelled.
   /// @return Returns a RGBA array of the returned dimensions or `nullptr`, if
   /// the format is not understood.
   /// @note You must `free()` on the returned pointer when done.
-  static uint8_t *LoadAndUnpackTexture(const char *filename,
-                                       const mathfu::vec2 &scale,
+  static uint8_t *LoadAndUnpackTexture(
+      const char *filename, const mathfu::vec2 &scale, TextureFlags flags,
+      mathfu::vec2i *dimensions, TextureFormat *texture_format,
+      const CancellationToken *cancel = nullptr);
+
+  /// @brief Returns the power of two nearest to each dimension of `size`.
+  /// A dimension halfway between two powers of two, such as 3 or 12, is
+  /// rounded up, so as not to lose detail.
+  static mathfu::vec2i NearestPowerOfTwoSize(const mathfu::vec2i &size);
+
+  /// @brief Returns true if a texture of `size` and `flags` can only be
+  /// created on GPUs that support non-power-of-two textures.
+  ///
+  /// NPOT textures are supported in ES 2.0 only with clamped texcoords and no
+  /// mipmaps. See Section 3.8.2 of the ES 2.0 spec.
+  static bool RequiresNpotSupport(const mathfu::vec2i &size,
+                                  TextureFlags flags);
+
+  /// @brief Resample an uncompressed image to the nearest power of two in
+  /// size, so that GPUs without NPOT support can mipmap and repeat it.
+  ///
+  /// Each face of a cubemap is resampled separately.
+  /// @param[in] buffer The image, tightly packed.
+  /// @param[in] size The size of `buffer`.
+  /// @param[in] texture_format The format of `buffer`. Must be one of
+  /// kFormat8888, kFormat888, kFormatLuminance or kFormatLuminanceAlpha.
+  /// @param[in] flags Selects how edges wrap, whether alpha is premultiplied,
+  /// and whether `buffer` is a cubemap.
+  /// @param[in] filter The filter to resample with.
+  /// @param[out] new_size The size of the returned image.
+  /// @return Returns the resampled image, or `nullptr` if `texture_format`
+  /// is not supported.
+  /// @note You must `free()` the returned pointer when done.
+  static uint8_t *ResampleToPowerOfTwo(const uint8_t *buffer,
+                                       const mathfu::vec2i &size,
+                                       TextureFormat texture_format,
                                        TextureFlags flags,
-                                       mathfu::vec2i *dimensions,
-                                       TextureFormat *texture_format);
+                                       TextureResampleFilter filter,
+                                       mathfu::vec2i *new_size);
 
   /// @brief Utility function to convert 32bit RGBA (8-bits each) to 16bit RGB
   /// in hex 5551 format.
   /// @note You must `delete[]` the return value afterwards.
   static uint16_t *Convert8888To5551(const uint8_t *buffer,
                                      const mathfu::vec2i &size);
+  /// @brief As Convert8888To5551(), but into `out`, which must hold
+  /// `size.x * size.y` values.
+  static void Convert8888To5551(const uint8_t *buffer,
+                                const mathfu::vec2i &size, uint16_t *out);
   /// @brief Utility function to convert 24bit RGB (8-bits each) to 16bit RGB in
   /// hex 565 format.
   /// @note You must `delete[]` the return value afterwards.
   static uint16_t *Convert888To565(const uint8_t *buffer,
                                    const mathfu::vec2i &size);
+  /// @brief As Convert888To565(), but into `out`, which must hold
+  /// `size.x * size.y` values.
+  static void Convert888To565(const uint8_t *buffer, const mathfu::vec2i &size,
+                              uint16_t *out);
 
   /// @brief Set texture target and id directly for textures that have been
   /// created outside of this class.  The creator is responsible for deleting
@@ -342,7 +418,21 @@ class Texture : public AsyncAsset {
   /// @brief returns the texture flags.
   TextureFlags flags() const { return flags_; }
 
+  /// @brief Get the filter used to resample this texture, if the GPU doesn't
+  /// support its size.
+  TextureResampleFilter resample_filter() const { return resample_filter_; }
+
+  /// @brief Set the filter used to resample this texture to a power of two in
+  /// size, when the GPU doesn't support non-power-of-two textures with its
+  /// flags. Call before loading.
+  void set_resample_filter(TextureResampleFilter filter) {
+    resample_filter_ = filter;
+  }
+
   /// @brief Get the original size of the Texture.
+  ///
+  /// This is the size of the image before any resampling, so it differs from
+  /// size() when the texture was resampled to a power of two.
   /// @return Returns a const `mathfu::vec2i` reference to the original size of
   /// the Texture.
   const mathfu::vec2i &original_size() const { return original_size_; }
@@ -368,9 +458,27 @@ class Texture : public AsyncAsset {
   // For internal use only.
   TextureImpl *impl() { return impl_; }
 
-  MATHFU_DEFINE_CLASS_SIMD_AWARE_NEW_DELETE
+  /// @brief The pool that heap-allocated Textures live in, to iterate over
+  /// them all, such as for memory accounting. Subclasses aren't in it.
+  static ObjectPool<Texture> &pool();
+
+  FPLBASE_DEFINE_POOLED_NEW_DELETE(Texture)
+
+ protected:
+  /// @brief Frees the unpacked image, or uploaded texture, of an aborted
+  /// load.
+  virtual void DiscardData();
+
+  /// @brief Move `data_` into a buffer from the staging pool, converting it
+  /// to the format it will be uploaded in. Called by Load(), on the loader
+  /// thread.
+  /// @return Returns false, leaving `data_` as it was, if there's no pool,
+  /// no free buffer, or the texture's format can't be staged.
+  bool StageData();
 
  private:
+  friend class TextureArray;
+
   // Backend-specific create and destroy calls. These just call new and delete
   // on the platform-specific MeshImpl structs.
   static TextureImpl *CreateTextureImpl();
@@ -407,13 +515,32 @@ class Texture : public AsyncAsset {
   static uint8_t *UnpackImage(const void *img_buf, size_t size,
                               const mathfu::vec2 &scale, TextureFlags flags,
                               mathfu::vec2i *dimensions,
-                              TextureFormat *texture_format);
+                              TextureFormat *texture_format,
+                              const CancellationToken *cancel = nullptr);
 
   /// @brief Backend specific conversion of flags to TextureTarget.
   static TextureTarget TextureTargetFromFlags(TextureFlags flags);
 
+  // If the GPU can't create a texture of `size_` with `flags_`, return a copy
+  // of `buffer` resampled to a power of two in size, and update `size_`.
+  // Otherwise returns nullptr. You must `free()` the returned pointer.
+  uint8_t *ResampleIfNpotUnsupported(const uint8_t *buffer);
+
+  // Delete uploaded_id_, if Upload() created it.
+  void DeleteUploaded();
+
+  // Return staging_buffer_ to its pool, if it wasn't uploaded from.
+  void ReleaseStagingBuffer();
+
   TextureImpl *impl_;
   TextureHandle id_;
+  // Created by Upload() on the loader thread, until Finalize() moves it to
+  // id_.
+  TextureHandle uploaded_id_;
+  TextureStagingPool *staging_pool_;
+  // Holds data_, once StageData() has moved it there, in staged_format_.
+  TextureStagingBuffer *staging_buffer_;
+  TextureFormat staged_format_;
   mathfu::vec2i size_;
   mathfu::vec2i original_size_;
   mathfu::vec2 scale_;
@@ -421,6 +548,7 @@ class Texture : public AsyncAsset {
   TextureTarget target_;
   TextureFormat desired_;
   TextureFlags flags_;
+  TextureResampleFilter resample_filter_;
   bool is_external_;
 };
 
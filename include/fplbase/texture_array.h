@@ -0,0 +1,144 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_TEXTURE_ARRAY_H
+#define FPLBASE_TEXTURE_ARRAY_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+#include "fplbase/texture.h"
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_texture
+/// @{
+
+/// @class TextureArray
+/// @brief A texture made of layers of the same size and format, backed by
+///        a GL_TEXTURE_2D_ARRAY.
+///
+/// Materials that differ only in which layer of an array they use bind the
+/// same texture, so draws with them can be merged, with the layer passed to
+/// the shader per draw (see Renderer::SetTextureLayers()) or per instance.
+/// Shaders sample it with a `sampler2DArray`.
+///
+/// Requires kFeatureLevel30.
+class TextureArray : public Texture {
+ public:
+  /// @brief Constructor. Call Create() before use.
+  /// @param[in] size The size of every layer.
+  /// @param[in] format The format of every layer. Must be kFormat8888,
+  /// kFormat888, kFormatLuminance or kFormatLuminanceAlpha.
+  /// @param[in] num_layers The number of layers.
+  /// @param[in] flags Options for the texture. kTextureFlagsIsCubeMap is not
+  /// supported.
+  TextureArray(const mathfu::vec2i &size, TextureFormat format, int num_layers,
+               TextureFlags flags);
+
+  /// @brief Create the (empty) array on the GPU.
+  /// @return Returns false if the GPU doesn't support texture arrays or the
+  /// format isn't supported.
+  bool Create();
+
+  /// @brief Reserve a free layer.
+  /// @return Returns the layer, or -1 if every layer is in use.
+  int AllocateLayer();
+
+  /// @brief Return `layer` to the free list.
+  void FreeLayer(int layer);
+
+  /// @brief Upload an image to `layer`, and regenerate mipmaps if the array
+  /// has them.
+  /// @param[in] layer A layer returned by AllocateLayer().
+  /// @param[in] data The image, tightly packed, of size() and format().
+  void SetLayer(int layer, const uint8_t *data);
+
+  /// @brief The number of layers.
+  int num_layers() const { return num_layers_; }
+
+  /// @brief The number of layers not yet allocated.
+  int num_free_layers() const { return static_cast<int>(free_layers_.size()); }
+
+ private:
+  int num_layers_;
+  std::vector<int> free_layers_;
+};
+
+/// @brief A layer of a TextureArray.
+struct TextureLayer {
+  TextureLayer() : array(nullptr), layer(-1) {}
+  TextureLayer(TextureArray *array, int layer) : array(array), layer(layer) {}
+
+  TextureArray *array;
+  int layer;
+};
+
+/// @class TextureArrayPool
+/// @brief Packs textures of the same size, format and flags into shared
+///        TextureArrays, creating arrays as they fill up.
+class TextureArrayPool {
+ public:
+  /// @param[in] layers_per_array The number of layers in each array created.
+  explicit TextureArrayPool(int layers_per_array = 16);
+  ~TextureArrayPool();
+
+  /// @brief Return the layer holding `filename`, loading it into a free layer
+  /// of a matching array if it isn't already in one. Each call must be
+  /// matched by a call to UnloadTexture() before the layer is freed.
+  ///
+  /// The file is loaded and uploaded immediately.
+  /// @param[in] filename The texture to load.
+  /// @param[in] scale The scale to load the texture at.
+  /// @param[in] flags The flags of the array to load the texture into.
+  /// @return Returns a layer whose `array` is nullptr if the texture can't be
+  /// loaded or isn't a format that arrays support.
+  TextureLayer LoadTexture(const char *filename, const mathfu::vec2 &scale,
+                           TextureFlags flags);
+
+  /// @brief Release the layer holding `filename`, freeing it once every
+  /// LoadTexture() call has been matched.
+  void UnloadTexture(const char *filename);
+
+  /// @brief Release `layer`, as returned by LoadTexture().
+  void UnloadTexture(const TextureLayer &layer);
+
+  /// @brief Delete every array.
+  void Clear();
+
+ private:
+  int layers_per_array_;
+  std::vector<TextureArray *> arrays_;
+  struct LoadedLayer {
+    TextureLayer layer;
+    int ref_count;
+  };
+  std::map<std::string, LoadedLayer> layers_;
+};
+
+/// @brief used by some functions to allow texture layers to be loaded by the
+/// caller.
+typedef std::function<TextureLayer(const char *filename, TextureFormat format,
+                                   TextureFlags flags)>
+    TextureLayerLoaderFn;
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_TEXTURE_ARRAY_H
@@ -21,6 +21,7 @@
 
 #include "fplbase/config.h"  // Must come first.
 #include "fplbase/asset.h"
+#include "fplbase/object_pool.h"
 
 namespace fplbase {
 
@@ -119,6 +120,12 @@ class TextureAtlas : public Asset {
                                         TextureFormat format,
                                         TextureFlags flags,
                                         const TextureLoaderFn &tlf);
+
+  /// @brief The pool that heap-allocated TextureAtlases live in.
+  static ObjectPool<TextureAtlas> &pool();
+
+  FPLBASE_DEFINE_POOLED_NEW_DELETE(TextureAtlas)
+
  private:
   // Texture being used by this atlas.
   Texture *atlas_texture_;
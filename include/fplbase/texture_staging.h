@@ -0,0 +1,122 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_TEXTURE_STAGING_H
+#define FPLBASE_TEXTURE_STAGING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+#include "fplbase/config.h"  // Must come first.
+
+namespace fplbase {
+
+/// @file
+/// @addtogroup fplbase_texture
+/// @{
+
+/// @brief A mapped staging buffer, reserved with TextureStagingPool::Acquire().
+struct TextureStagingBuffer {
+  /// The mapped memory to write texture data into.
+  uint8_t *data;
+  /// The number of bytes `data` holds.
+  size_t size;
+};
+
+/// @class TextureStagingPool
+/// @brief Mapped pixel unpack buffers that loader threads write texture data
+///        into, so the main thread only has to issue the upload.
+///
+/// The driver then copies the texture from the buffer by DMA, instead of
+/// from client memory while the main thread waits. Each buffer is reused
+/// once a fence shows the GPU has finished reading it.
+///
+/// Buffers are mapped persistently where the GL has buffer storage (GL 4.4,
+/// or ARB_buffer_storage). Otherwise they're mapped while free and unmapped
+/// for the upload. Requires kFeatureLevel30.
+class TextureStagingPool {
+ public:
+  TextureStagingPool();
+
+  /// @brief Deletes the buffers. Call on the main thread, once every buffer
+  /// acquired has been uploaded or released.
+  ~TextureStagingPool();
+
+  /// @brief Create and map the buffers. Call on the main thread.
+  /// @param[in] buffer_size The size of each buffer. Textures whose data is
+  /// larger aren't staged.
+  /// @param[in] num_buffers The number of buffers.
+  /// @return Returns false if staging isn't supported.
+  bool Initialize(size_t buffer_size, int num_buffers);
+
+  /// @brief Reserve a free buffer of at least `size` bytes. Thread safe.
+  /// @return Returns nullptr if every buffer is in use or too small.
+  TextureStagingBuffer *Acquire(size_t size);
+
+  /// @brief Return `buffer` without uploading from it. Thread safe.
+  void Release(TextureStagingBuffer *buffer);
+
+  /// @brief Bind `buffer` as the pixel unpack buffer, so that the pixel data
+  /// pointers passed to texture uploads are offsets into it. Call on the
+  /// main thread, with the buffer's data fully written.
+  void BeginUpload(TextureStagingBuffer *buffer);
+
+  /// @brief Unbind `buffer`, and fence the uploads from it. It's reused by
+  /// Update() once the fence has signalled.
+  void EndUpload(TextureStagingBuffer *buffer);
+
+  /// @brief Make the buffers whose uploads have finished available again.
+  /// Call on the main thread, once per frame.
+  void Update();
+
+  /// @brief Whether 8888 and 888 data should be converted to 5551 and 565,
+  /// as Texture::CreateTexture() would. Decided on the main thread, for
+  /// loader threads to use.
+  bool use_16bpp() const { return use_16bpp_; }
+
+  /// @brief Whether the buffers stay mapped while they're read.
+  bool persistent() const { return persistent_; }
+
+  /// @brief The size of each buffer.
+  size_t buffer_size() const { return buffer_size_; }
+
+ private:
+  struct Slot : TextureStagingBuffer {
+    uint32_t id;
+    void *fence;    // A GLsync, while the GPU reads the buffer.
+    bool in_use;    // Acquired, or being read.
+    bool uploaded;  // Uploaded from, and waiting for Update() to free it.
+  };
+
+  Slot *SlotOf(TextureStagingBuffer *buffer) {
+    return static_cast<Slot *>(buffer);
+  }
+  bool Map(Slot *slot);
+
+  std::vector<Slot> slots_;
+  std::mutex mutex_;  // Protects the in_use flags.
+  size_t buffer_size_;
+  bool persistent_;
+  bool use_16bpp_;
+
+  TextureStagingPool(const TextureStagingPool &);
+  TextureStagingPool &operator=(const TextureStagingPool &);
+};
+
+/// @}
+}  // namespace fplbase
+
+#endif  // FPLBASE_TEXTURE_STAGING_H
@@ -296,15 +296,6 @@ VsyncCallback RegisterVsyncCallback(VsyncCallback callback);
 /// method.
 void CallVsyncCallback();
 
-/// @brief Blocks until the next time a VSync happens.
-void WaitForVsync();
-
-/// @brief Get Vsync frame id.
-/// @return Returns a unique ID representing the frame. Guaranteed to change
-/// every time the frame increments.
-/// @warning May eventually wrap.
-int GetVsyncFrameId();
-
 /// @brief Triggers a keypress event on an Android device.
 /// @param[in] android_keycode The key code corresponding to the
 /// keypress that should be triggered.
@@ -322,6 +313,17 @@ std::string AndroidGetActivityName();
 std::string AndroidGetViewIntentData();
 #endif  // __ANDROID__
 
+/// @brief Blocks until the next time a VSync happens.
+/// @note On Android, VSync events come from the Choreographer. Elsewhere, the
+/// time is estimated by the Environment's FramePacer.
+void WaitForVsync();
+
+/// @brief Get Vsync frame id.
+/// @return Returns a unique ID representing the frame. Guaranteed to change
+/// every time the frame increments.
+/// @warning May eventually wrap.
+int GetVsyncFrameId();
+
 #if defined(__ANDROID__) && defined(FPLBASE_BACKEND_STDLIB)
 /// @brief Set an Android asset manager.
 /// @param[in] manager A pointer to an already-created instance of
@@ -24,7 +24,12 @@ LOCAL_PATH := $(call realpath-portable,$(LOCAL_PATH))
 FPLBASE_DIR := $(LOCAL_PATH)
 
 FPLBASE_COMMON_SRC_FILES := \
+  src/animation.cpp \
   src/asset_manager.cpp \
+  src/async_loader_gl.cpp \
+  src/finalize_callback.cpp \
+  src/frame_pacer.cpp \
+  src/frame_pipeline.cpp \
   src/gpu_debug_gl.cpp \
   src/input.cpp \
   src/material.cpp \
@@ -40,8 +45,12 @@ FPLBASE_COMMON_SRC_FILES := \
   src/renderer_hmd_gl.cpp \
   src/shader_common.cpp \
   src/shader_gl.cpp \
+  src/tangent_space.cpp \
+  src/texture_array_common.cpp \
+  src/texture_array_gl.cpp \
   src/texture_common.cpp \
   src/texture_gl.cpp \
+  src/texture_staging_gl.cpp \
   src/type_conversions_gl.cpp \
   src/utilities.cpp \
   src/version.cpp \
@@ -73,6 +82,7 @@ FPLBASE_SCHEMA_DIR := $(FPLBASE_DIR)/schemas
 FPLBASE_SCHEMA_INCLUDE_DIRS :=
 
 FPLBASE_SCHEMA_FILES := \
+  $(FPLBASE_SCHEMA_DIR)/anim.fbs \
   $(FPLBASE_SCHEMA_DIR)/common.fbs \
   $(FPLBASE_SCHEMA_DIR)/materials.fbs \
   $(FPLBASE_SCHEMA_DIR)/mesh.fbs \
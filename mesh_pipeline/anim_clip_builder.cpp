@@ -0,0 +1,243 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "anim_clip_builder.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+
+#include "anim_generated.h"
+#include "build_cache.h"
+#include "common_generated.h"
+
+namespace fplbase {
+
+using mathfu::vec4;
+
+namespace {
+
+enum ChannelType {
+  kTranslation,
+  kRotation,
+  kScale,
+  kNumChannelTypes
+};
+
+const int kNumComponents[kNumChannelTypes] = {3, 4, 3};
+const vec4 kIdentity[kNumChannelTypes] = {
+    vec4(0.0f, 0.0f, 0.0f, 0.0f), vec4(0.0f, 0.0f, 0.0f, 1.0f),
+    vec4(1.0f, 1.0f, 1.0f, 0.0f)};
+
+const float kQuantizedMax = 65535.0f;
+
+// Return true if the first `num_components` of `a` and `b` differ by no more
+// than `tolerance`.
+bool Near(const vec4& a, const vec4& b, int num_components, float tolerance) {
+  for (int i = 0; i < num_components; ++i) {
+    if (fabsf(a[i] - b[i]) > tolerance) return false;
+  }
+  return true;
+}
+
+// Interpolate the way the runtime does: linearly, then renormalizing
+// rotations.
+vec4 Interpolate(const vec4& a, const vec4& b, float t, ChannelType type) {
+  const vec4 v = vec4::Lerp(a, b, t);
+  return type == kRotation ? v.Normalized() : v;
+}
+
+// Return true if interpolating from key `start` to key `end` reproduces every
+// frame between them.
+bool Reproduces(const std::vector<mathfu::vec4_packed>& values, size_t start,
+                size_t end, ChannelType type, float tolerance) {
+  const vec4 a(values[start]);
+  const vec4 b(values[end]);
+  const float span = static_cast<float>(end - start);
+  for (size_t i = start + 1; i < end; ++i) {
+    const float t = static_cast<float>(i - start) / span;
+    if (!Near(Interpolate(a, b, t, type), vec4(values[i]),
+              kNumComponents[type], tolerance)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Choose the frames to keep as keys. Greedily extends each segment as far as
+// interpolation stays within `tolerance`.
+void ReduceKeys(const std::vector<mathfu::vec4_packed>& values,
+                ChannelType type, float tolerance, std::vector<size_t>* keys) {
+  keys->clear();
+  if (values.empty()) return;
+  keys->push_back(0);
+
+  // A constant channel needs only one key.
+  const vec4 first(values[0]);
+  bool constant = true;
+  for (size_t i = 1; i < values.size() && constant; ++i) {
+    constant = Near(first, vec4(values[i]), kNumComponents[type], tolerance);
+  }
+  if (constant) return;
+
+  size_t start = 0;
+  while (start + 1 < values.size()) {
+    size_t end = start + 1;
+    while (end + 1 < values.size() &&
+           Reproduces(values, start, end + 1, type, tolerance)) {
+      ++end;
+    }
+    keys->push_back(end);
+    start = end;
+  }
+}
+
+}  // namespace
+
+AnimClipBuilder::AnimClipBuilder(const std::string& name,
+                                 float frames_per_second, int num_frames,
+                                 Logger& log)
+    : name_(name),
+      frames_per_second_(frames_per_second),
+      num_frames_(num_frames),
+      log_(log) {}
+
+int AnimClipBuilder::AddBone(const std::string& name, int parent) {
+  assert(parent < static_cast<int>(bones_.size()));
+  bones_.push_back(Bone());
+  Bone& bone = bones_.back();
+  bone.name = name;
+  bone.parent = parent;
+  for (int c = 0; c < kNumChannelTypes; ++c) {
+    bone.channels[c].assign(num_frames_, mathfu::vec4_packed(kIdentity[c]));
+  }
+  return static_cast<int>(bones_.size()) - 1;
+}
+
+void AnimClipBuilder::SetFrame(int bone, int frame,
+                               const mathfu::vec3& translation,
+                               const vec4& rotation,
+                               const mathfu::vec3& scale) {
+  assert(0 <= frame && frame < num_frames_);
+  Bone& b = bones_[bone];
+  b.channels[kTranslation][frame] = vec4(translation, 0.0f);
+  b.channels[kRotation][frame] = rotation.Normalized();
+  b.channels[kScale][frame] = vec4(scale, 0.0f);
+}
+
+bool AnimClipBuilder::Output(const std::string& file_name, float tolerance,
+                             std::vector<std::string>* output_files) {
+  flatbuffers::FlatBufferBuilder fbb;
+  std::vector<flatbuffers::Offset<flatbuffers::String>> bone_names;
+  std::vector<uint8_t> bone_parents;
+  std::vector<flatbuffers::Offset<animdef::BoneAnim>> bones_fb;
+  std::vector<size_t> keys;
+  std::vector<uint16_t> frames;
+  std::vector<uint16_t> values;
+  size_t num_keys = 0;
+
+  for (size_t b = 0; b < bones_.size(); ++b) {
+    Bone& bone = bones_[b];
+    bone_names.push_back(fbb.CreateString(bone.name));
+    bone_parents.push_back(bone.parent < 0 ? 0xFF
+                                           : static_cast<uint8_t>(bone.parent));
+
+    // q and -q are the same rotation, but interpolate differently. Keep
+    // neighboring keys in the same hemisphere so they take the short path.
+    std::vector<mathfu::vec4_packed>& rotations = bone.channels[kRotation];
+    for (size_t i = 1; i < rotations.size(); ++i) {
+      const vec4 prev(rotations[i - 1]);
+      const vec4 cur(rotations[i]);
+      if (vec4::DotProduct(prev, cur) < 0.0f) rotations[i] = -cur;
+    }
+
+    flatbuffers::Offset<animdef::Channel> channels_fb[kNumChannelTypes];
+    for (int c = 0; c < kNumChannelTypes; ++c) {
+      const ChannelType type = static_cast<ChannelType>(c);
+      const std::vector<mathfu::vec4_packed>& channel = bone.channels[c];
+      const int num_components = kNumComponents[c];
+      ReduceKeys(channel, type, tolerance, &keys);
+
+      // Omit channels that never leave their identity value.
+      if (keys.size() <= 1 &&
+          (channel.empty() || Near(vec4(channel[0]), kIdentity[c],
+                                   num_components, tolerance))) {
+        channels_fb[c] = 0;
+        continue;
+      }
+
+      // Quantize the keys' components over their range.
+      vec4 min_value(vec4(channel[keys[0]]));
+      vec4 max_value(min_value);
+      for (size_t k = 1; k < keys.size(); ++k) {
+        const vec4 v(channel[keys[k]]);
+        min_value = vec4::Min(min_value, v);
+        max_value = vec4::Max(max_value, v);
+      }
+      const vec4 scale = (max_value - min_value) / kQuantizedMax;
+      frames.clear();
+      values.clear();
+      for (size_t k = 0; k < keys.size(); ++k) {
+        frames.push_back(static_cast<uint16_t>(keys[k]));
+        const vec4 v(channel[keys[k]]);
+        for (int i = 0; i < num_components; ++i) {
+          const float q = scale[i] > 0.0f
+                              ? (v[i] - min_value[i]) / scale[i] + 0.5f
+                              : 0.0f;
+          values.push_back(
+              static_cast<uint16_t>(std::min(q, kQuantizedMax)));
+        }
+      }
+      num_keys += keys.size();
+
+      const Vec4 min_fb(min_value.x, min_value.y, min_value.z, min_value.w);
+      const Vec4 scale_fb(scale.x, scale.y, scale.z, scale.w);
+      channels_fb[c] = animdef::CreateChannel(fbb, fbb.CreateVector(frames),
+                                              fbb.CreateVector(values),
+                                              &min_fb, &scale_fb);
+    }
+    bones_fb.push_back(animdef::CreateBoneAnim(fbb, channels_fb[kTranslation],
+                                               channels_fb[kRotation],
+                                               channels_fb[kScale]));
+  }
+
+  const auto clip_fb = animdef::CreateAnimClip(
+      fbb, fbb.CreateString(name_), frames_per_second_,
+      static_cast<uint16_t>(num_frames_), fbb.CreateVector(bone_names),
+      fbb.CreateVector(bone_parents), fbb.CreateVector(bones_fb),
+      animdef::AnimVersion_MostRecent);
+  animdef::FinishAnimClipBuffer(fbb, clip_fb);
+
+  const size_t num_samples = bones_.size() * num_frames_ * kNumChannelTypes;
+  log_.Log(kLogInfo, "  %s: %d frames, %d bones, %d of %d keys kept\n",
+           name_.c_str(), num_frames_, static_cast<int>(bones_.size()),
+           static_cast<int>(num_keys), static_cast<int>(num_samples));
+
+  const std::string directory = fplutil::DirectoryName(file_name);
+  if (!directory.empty() && !fplutil::CreateDirectory(directory.c_str())) {
+    log_.Log(kLogError, "Could not create output directory %s\n",
+             directory.c_str());
+    return false;
+  }
+  bool changed;
+  if (!WriteFileIfChanged(file_name, fbb.GetBufferPointer(), fbb.GetSize(),
+                          log_, &changed)) {
+    return false;
+  }
+  output_files->push_back(file_name);
+  return true;
+}
+
+}  // namespace fplbase
@@ -0,0 +1,72 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_MESH_PIPELINE_ANIM_CLIP_BUILDER_H_
+#define FPLBASE_MESH_PIPELINE_ANIM_CLIP_BUILDER_H_
+
+#include <string>
+#include <vector>
+
+#include "fplutil/file_utils.h"
+#include "mathfu/glsl_mappings.h"
+#include "pipeline_utils.h"
+
+namespace fplbase {
+
+/// @class AnimClipBuilder
+/// @brief Collect per-frame bone transforms and output them as an
+///        `.fplanim` FlatBuffer.
+///
+/// Every frame of every bone is recorded. On output, keys that linear
+/// interpolation between their neighbors reproduces are dropped, channels that
+/// never leave their identity value are omitted, and the remaining keys are
+/// quantized to 16 bits per component.
+class AnimClipBuilder {
+ public:
+  AnimClipBuilder(const std::string& name, float frames_per_second,
+                  int num_frames, Logger& log);
+
+  // Append a bone. `parent` is the index of an earlier bone, or -1.
+  // Returns the index of the new bone.
+  int AddBone(const std::string& name, int parent);
+
+  // Set the transform of `bone`, relative to its parent, at `frame`.
+  // `rotation` is a quaternion as (vector.xyz, scalar).
+  void SetFrame(int bone, int frame, const mathfu::vec3& translation,
+                const mathfu::vec4& rotation, const mathfu::vec3& scale);
+
+  // Reduce, quantize and write the clip to `file_name`. Keys are dropped
+  // only if every component of every dropped frame stays within `tolerance`.
+  // On success, `file_name` is appended to `output_files`.
+  bool Output(const std::string& file_name, float tolerance,
+              std::vector<std::string>* output_files);
+
+ private:
+  struct Bone {
+    std::string name;
+    int parent;
+    std::vector<mathfu::vec4_packed> channels[3];  // translation, rotation,
+                                                   // scale
+  };
+
+  std::string name_;
+  float frames_per_second_;
+  int num_frames_;
+  std::vector<Bone> bones_;
+  Logger& log_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_MESH_PIPELINE_ANIM_CLIP_BUILDER_H_
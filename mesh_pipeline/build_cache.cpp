@@ -0,0 +1,227 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "build_cache.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+
+#include "flatbuffers/util.h"
+#include "fplutil/file_utils.h"
+#include "vertex_dedup.h"
+
+namespace fplbase {
+
+// First line of every record. Bump the number if the record format changes.
+static const char kRecordHeader[] = "mesh_pipeline_cache 1";
+
+static std::string HexString(uint64_t value) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016" PRIx64, value);
+  return std::string(buf);
+}
+
+bool HashFile(const std::string& file_name, uint64_t* hash) {
+  std::string contents;
+  if (!flatbuffers::LoadFile(file_name.c_str(), true, &contents)) return false;
+  *hash = HashBytes64(contents.data(), contents.size());
+  return true;
+}
+
+bool WriteFileIfChanged(const std::string& file_name, const void* data,
+                        size_t size, Logger& log, bool* changed) {
+  *changed = false;
+
+  // Leave the file, and its timestamp, alone if the content is unchanged.
+  std::string existing;
+  if (flatbuffers::LoadFile(file_name.c_str(), true, &existing) &&
+      existing.size() == size && memcmp(existing.data(), data, size) == 0) {
+    log.Log(kLogVerbose, "Unchanged %s\n", file_name.c_str());
+    return true;
+  }
+
+  // Write to a temporary file beside the target, then rename it into place.
+  const std::string temp_file_name = file_name + ".tmp";
+  FILE* file = fopen(temp_file_name.c_str(), "wb");
+  if (file == nullptr) {
+    log.Log(kLogError, "Could not open %s for writing\n",
+            temp_file_name.c_str());
+    return false;
+  }
+  log.Log(kLogVerbose, "Writing %s\n", file_name.c_str());
+  const bool written = fwrite(data, 1, size, file) == size;
+  const bool closed = fclose(file) == 0;
+  if (!written || !closed) {
+    log.Log(kLogError, "Could not write %s\n", temp_file_name.c_str());
+    remove(temp_file_name.c_str());
+    return false;
+  }
+
+  // rename() won't replace an existing file on Windows.
+  if (rename(temp_file_name.c_str(), file_name.c_str()) != 0) {
+    remove(file_name.c_str());
+    if (rename(temp_file_name.c_str(), file_name.c_str()) != 0) {
+      log.Log(kLogError, "Could not rename %s to %s\n",
+              temp_file_name.c_str(), file_name.c_str());
+      remove(temp_file_name.c_str());
+      return false;
+    }
+  }
+  *changed = true;
+  return true;
+}
+
+MeshBuildCache::MeshBuildCache(const MeshPipelineArgs& args,
+                               Logger& log)
+    : key_(0), log_(log) {
+  if (args.cache_dir.empty()) return;
+
+  // Every argument that can change the output. Logging and cache options
+  // are deliberately left out.
+  std::ostringstream key;
+  key << kMeshPipelineVersion << '\n'
+      << args.fbx_file << '\n'
+      << args.asset_base_dir << '\n'
+      << args.asset_rel_dir << '\n'
+      << args.texture_extension << '\n';
+  for (size_t i = 0; i < args.texture_formats.size(); ++i) {
+    key << static_cast<int>(args.texture_formats[i]) << ',';
+  }
+  key << '\n'
+      << static_cast<int>(args.blend_mode) << ' '
+      << static_cast<int>(args.axis_system) << ' '
+      << args.distance_unit_scale << ' ' << args.recenter << ' '
+      << args.interleaved << ' ' << args.force32 << ' '
+      << args.embed_materials << ' ' << args.vertex_attributes << ' '
+      << args.gather_textures << ' ' << args.max_bones_per_surface << ' '
+      << args.export_animations << ' ' << args.animation_tolerance << ' '
+      << args.quantization.position_grid << ' '
+      << args.quantization.normal_bits << ' ' << args.quantization.uv_grid
+      << ' ' << args.write_report << '\n';
+  const std::string key_string = key.str();
+  key_ = HashBytes64(key_string.data(), key_string.size());
+
+  // One record per input file and output directory. The base name keeps the
+  // cache directory readable.
+  const std::string location = args.fbx_file + '\n' + args.asset_base_dir +
+                               '\n' + args.asset_rel_dir;
+  record_file_ =
+      fplutil::FormatAsDirectoryName(args.cache_dir) +
+      fplutil::BaseFileName(args.fbx_file) + "_" +
+      HexString(HashBytes64(location.data(), location.size())) + ".cache";
+}
+
+bool MeshBuildCache::Load(uint64_t* key, std::vector<Entry>* inputs,
+                          std::vector<Entry>* outputs) const {
+  std::string contents;
+  if (!flatbuffers::LoadFile(record_file_.c_str(), false, &contents)) {
+    return false;
+  }
+
+  std::istringstream lines(contents);
+  std::string line;
+  if (!std::getline(lines, line) || line != kRecordHeader) return false;
+  bool has_key = false;
+  while (std::getline(lines, line)) {
+    // Each line is `<type> <hex hash> [<file name>]`.
+    const size_t type_end = line.find(' ');
+    if (type_end == std::string::npos) return false;
+    const std::string type = line.substr(0, type_end);
+    const size_t hash_end = line.find(' ', type_end + 1);
+    const std::string hash_string =
+        line.substr(type_end + 1, hash_end == std::string::npos
+                                      ? std::string::npos
+                                      : hash_end - type_end - 1);
+    char* end;
+    const uint64_t hash = strtoull(hash_string.c_str(), &end, 16);
+    if (*end != '\0') return false;
+
+    if (type == "key") {
+      *key = hash;
+      has_key = true;
+    } else if (hash_end != std::string::npos &&
+               (type == "input" || type == "output")) {
+      Entry entry;
+      entry.hash = hash;
+      entry.file_name = line.substr(hash_end + 1);
+      (type == "input" ? inputs : outputs)->push_back(entry);
+    } else {
+      return false;
+    }
+  }
+  return has_key;
+}
+
+bool MeshBuildCache::UpToDate() const {
+  if (!enabled()) return false;
+
+  uint64_t key = 0;
+  std::vector<Entry> inputs;
+  std::vector<Entry> outputs;
+  if (!Load(&key, &inputs, &outputs)) return false;
+  if (key != key_) {
+    log_.Log(kLogInfo, "Arguments or tool version changed since last build\n");
+    return false;
+  }
+
+  // Check inputs before outputs; inputs are the likelier to have changed.
+  for (int pass = 0; pass < 2; ++pass) {
+    const std::vector<Entry>& entries = pass == 0 ? inputs : outputs;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      uint64_t hash;
+      if (!HashFile(entries[i].file_name, &hash) || hash != entries[i].hash) {
+        log_.Log(kLogInfo, "%s changed since last build\n",
+                 entries[i].file_name.c_str());
+        return false;
+      }
+    }
+  }
+  return !inputs.empty();
+}
+
+bool MeshBuildCache::Save(const std::vector<std::string>& input_files,
+                          const std::vector<std::string>& output_files) const {
+  if (!enabled()) return true;
+
+  std::string record = std::string(kRecordHeader) + "\nkey " +
+                       HexString(key_) + "\n";
+  for (int pass = 0; pass < 2; ++pass) {
+    const std::vector<std::string>& files =
+        pass == 0 ? input_files : output_files;
+    for (size_t i = 0; i < files.size(); ++i) {
+      uint64_t hash;
+      if (!HashFile(files[i], &hash)) {
+        log_.Log(kLogError, "Could not read %s\n", files[i].c_str());
+        return false;
+      }
+      record += std::string(pass == 0 ? "input " : "output ") +
+                HexString(hash) + " " + files[i] + "\n";
+    }
+  }
+
+  const std::string cache_dir = fplutil::DirectoryName(record_file_);
+  if (!fplutil::CreateDirectory(cache_dir.c_str())) {
+    log_.Log(kLogError, "Could not create cache directory %s\n",
+             cache_dir.c_str());
+    return false;
+  }
+  bool changed;
+  return WriteFileIfChanged(record_file_, record.data(), record.size(), log_,
+                            &changed);
+}
+
+}  // namespace fplbase
@@ -0,0 +1,77 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_MESH_PIPELINE_BUILD_CACHE_H_
+#define FPLBASE_MESH_PIPELINE_BUILD_CACHE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "mesh_pipeline.h"
+
+namespace fplbase {
+
+// Hash the contents of `file_name` with HashBytes64. Returns false if the
+// file cannot be read.
+bool HashFile(const std::string& file_name, uint64_t* hash);
+
+// Write `size` bytes to `file_name`, unless the file already holds exactly
+// those bytes. The data is written to a temporary file that is then renamed
+// over `file_name`, so readers never see a partial file.
+// Returns false on error. `changed` is set when the file was written.
+bool WriteFileIfChanged(const std::string& file_name, const void* data,
+                        size_t size, Logger& log, bool* changed);
+
+/// @class MeshBuildCache
+/// @brief Record of the files read and written by a previous conversion, so
+///        that RunMeshPipeline can skip conversions whose inputs are unchanged.
+///
+/// The record is keyed on the tool version and every MeshPipelineArgs field
+/// that affects the output. A record is up to date when its key matches, every
+/// input it lists still has the same content hash, and every output it lists
+/// still exists with the content that was written.
+///
+/// Records are stored in `args.cache_dir`, one per input/output-directory
+/// pair. An empty `cache_dir` disables the cache.
+class MeshBuildCache {
+ public:
+  MeshBuildCache(const MeshPipelineArgs& args, Logger& log);
+
+  bool enabled() const { return !record_file_.empty(); }
+
+  // Return true if the previous conversion's outputs can be reused.
+  bool UpToDate() const;
+
+  // Replace the record with the given inputs and outputs, hashing each.
+  bool Save(const std::vector<std::string>& input_files,
+            const std::vector<std::string>& output_files) const;
+
+ private:
+  struct Entry {
+    uint64_t hash;
+    std::string file_name;
+  };
+
+  bool Load(uint64_t* key, std::vector<Entry>* inputs,
+            std::vector<Entry>* outputs) const;
+
+  std::string record_file_;
+  uint64_t key_;
+  Logger& log_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_MESH_PIPELINE_BUILD_CACHE_H_
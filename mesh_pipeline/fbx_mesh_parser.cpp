@@ -0,0 +1,1260 @@
+// Copyright 2015 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "fbx_mesh_parser.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fbxsdk.h>
+
+#include "anim_clip_builder.h"
+#include "anim_generated.h"
+#include "fplutil/file_utils.h"
+#include "mathfu/constants.h"
+#include "mathfu/glsl_mappings.h"
+
+namespace fplbase {
+
+static const FbxColor kDefaultColor(1.0, 1.0, 1.0, 1.0);
+
+// Animation frames are 16-bit, and parent index 0xFF marks root bones.
+static const int kMaxAnimationFrames = 0xFFFF;
+static const size_t kMaxAnimationBones = 0xFF;
+
+// Defines the order in which textures are assigned shader indices.
+// Shader indices are assigned, starting from 0, as textures are found.
+static const char* kTextureProperties[] = {
+    FbxSurfaceMaterial::sDiffuse,
+    FbxSurfaceMaterial::sEmissive,
+    FbxSurfaceMaterial::sNormalMap,
+    FbxSurfaceMaterial::sBump,
+    FbxSurfaceMaterial::sDiffuseFactor,
+    FbxSurfaceMaterial::sEmissiveFactor,
+    FbxSurfaceMaterial::sAmbient,
+    FbxSurfaceMaterial::sAmbientFactor,
+    FbxSurfaceMaterial::sSpecular,
+    FbxSurfaceMaterial::sSpecularFactor,
+    FbxSurfaceMaterial::sShininess,
+    FbxSurfaceMaterial::sTransparentColor,
+    FbxSurfaceMaterial::sTransparencyFactor,
+    FbxSurfaceMaterial::sReflection,
+    FbxSurfaceMaterial::sReflectionFactor,
+};
+
+/// Return the direct index into `element`. If `element` is set up to be indexed
+/// directly, the return value is just `index`. Otherwise, we dereference the
+/// index array to get the direct index.
+template <class T>
+static int ElementDirectIndex(const FbxLayerElementTemplate<T>& element,
+                              int index) {
+  return element.GetReferenceMode() == FbxGeometryElement::eDirect
+             ? index
+             : element.GetIndexArray().GetAt(index);
+}
+
+/// Return element[index], accounting for the index array, if it is used.
+template <class T>
+static T Element(const FbxLayerElementTemplate<T>& element, int index) {
+  const int direct_index = ElementDirectIndex(element, index);
+  return element.GetDirectArray().GetAt(direct_index);
+}
+
+/// Return element[index], accounting for the index array, if it is used.
+template <class T>
+static T ElementFromIndices(const FbxLayerElementTemplate<T>* element,
+                            int control_index, int vertex_counter) {
+  if (!element) return T();
+  const int index =
+      element->GetMappingMode() == FbxGeometryElement::eByControlPoint
+          ? control_index
+          : vertex_counter;
+  return Element(*element, index);
+}
+
+static inline vec4 Vec4FromFbx(const FbxColor& v) {
+  return vec4(static_cast<float>(v.mRed), static_cast<float>(v.mGreen),
+              static_cast<float>(v.mBlue), static_cast<float>(v.mAlpha));
+}
+
+static inline vec4 Vec4FromFbx(const FbxVector4& v) {
+  const FbxDouble* d = v.mData;
+  return vec4(static_cast<float>(d[0]), static_cast<float>(d[1]),
+              static_cast<float>(d[2]), static_cast<float>(d[3]));
+}
+
+static inline vec3 Vec3FromFbx(const FbxVector4& v) {
+  const FbxDouble* d = v.mData;
+  return vec3(static_cast<float>(d[0]), static_cast<float>(d[1]),
+              static_cast<float>(d[2]));
+}
+
+static inline vec2 Vec2FromFbx(const FbxVector2& v) {
+  const FbxDouble* d = v.mData;
+  return vec2(static_cast<float>(d[0]), static_cast<float>(d[1]));
+}
+
+// FBX UV format has the v-coordinate inverted from OpenGL.
+static inline vec2 Vec2FromFbxUv(const FbxVector2& v) {
+  const FbxDouble* d = v.mData;
+  return vec2(static_cast<float>(d[0]), static_cast<float>(1.0 - d[1]));
+}
+
+static inline mat4 Mat4FromFbx(const FbxAMatrix& m) {
+  const double* d = m;
+  return mat4(static_cast<float>(d[0]), static_cast<float>(d[1]),
+              static_cast<float>(d[2]), static_cast<float>(d[3]),
+              static_cast<float>(d[4]), static_cast<float>(d[5]),
+              static_cast<float>(d[6]), static_cast<float>(d[7]),
+              static_cast<float>(d[8]), static_cast<float>(d[9]),
+              static_cast<float>(d[10]), static_cast<float>(d[11]),
+              static_cast<float>(d[12]), static_cast<float>(d[13]),
+              static_cast<float>(d[14]), static_cast<float>(d[15]));
+}
+
+
+// Utility function to get the name of a mesh, or the name of the node that owns
+// it if the mesh attribute is unnamed (which it commonly is).
+static const char* GetMeshOrNodeName(const FbxMesh* mesh) {
+  const char* const mesh_name = mesh->GetName();
+  if (mesh_name && mesh_name[0]) return mesh_name;
+  const FbxNode* const node = mesh->GetNode();
+  return node ? node->GetName() : nullptr;
+}
+
+
+// Return true if `node`, or any node under it, has a mesh.
+static bool NodeHasMesh(FbxNode* node) {
+  for (int i = 0; i < node->GetNodeAttributeCount(); ++i) {
+    const FbxNodeAttribute* attr = node->GetNodeAttributeByIndex(i);
+    if (attr != nullptr &&
+        attr->GetAttributeType() == FbxNodeAttribute::eMesh) {
+      return true;
+    }
+  }
+  for (int i = 0; i < node->GetChildCount(); ++i) {
+    if (NodeHasMesh(node->GetChild(i))) return true;
+  }
+  return false;
+}
+
+// Convert `scene` to a distance unit of `distance_unit_scale` centimeters.
+// Does nothing if `distance_unit_scale` is not positive.
+static void ConvertScale(float distance_unit_scale, FbxScene* scene,
+                         Logger& log) {
+  if (distance_unit_scale <= 0.0f) return;
+  const FbxSystemUnit import_unit = scene->GetGlobalSettings().GetSystemUnit();
+  const FbxSystemUnit export_unit(distance_unit_scale);
+  if (import_unit == export_unit) {
+    log.Log(kLogVerbose, "Scene is already in %s\n",
+            export_unit.GetScaleFactorAsString().Buffer());
+    return;
+  }
+  log.Log(kLogInfo, "Converting scene from %s to %s\n",
+          import_unit.GetScaleFactorAsString().Buffer(),
+          export_unit.GetScaleFactorAsString().Buffer());
+  export_unit.ConvertScene(scene);
+}
+
+// Return the unit vector along `axis`, as output by AxisSystemAxes().
+static vec3 AxisVector(int axis) {
+  vec3 v = kZeros3f;
+  v[abs(axis) - 1] = axis < 0 ? -1.0f : 1.0f;
+  return v;
+}
+
+// Convert `scene` to `axis_system`, unless it's unspecified.
+static void ConvertAxes(AxisSystem axis_system, FbxScene* scene,
+                        Logger& log) {
+  if (axis_system < 0) return;
+  int up, front, left;
+  AxisSystemAxes(axis_system, &up, &front, &left);
+
+  // FBX names the front axis by its parity: even for the first of the two
+  // axes perpendicular to up, in x, y, z order, and odd for the second.
+  const int first_perpendicular = abs(up) == 1 ? 2 : 1;
+  const int parity = abs(front) == first_perpendicular
+                         ? FbxAxisSystem::eParityEven
+                         : FbxAxisSystem::eParityOdd;
+  // In a right-handed system, left is up cross front.
+  const bool right_handed =
+      vec3::DotProduct(vec3::CrossProduct(AxisVector(up), AxisVector(front)),
+                       AxisVector(left)) > 0.0f;
+  const FbxAxisSystem export_axes(
+      static_cast<FbxAxisSystem::EUpVector>(up),
+      static_cast<FbxAxisSystem::EFrontVector>(front < 0 ? -parity : parity),
+      right_handed ? FbxAxisSystem::eRightHanded : FbxAxisSystem::eLeftHanded);
+
+  const FbxAxisSystem import_axes = scene->GetGlobalSettings().GetAxisSystem();
+  if (import_axes == export_axes) {
+    log.Log(kLogVerbose, "Scene already has axes %s\n",
+            AxisSystemNames()[axis_system]);
+    return;
+  }
+  log.Log(kLogInfo, "Converting scene to axes %s\n",
+          AxisSystemNames()[axis_system]);
+  export_axes.ConvertScene(scene);
+}
+
+// Log the names and local transforms of `node` and every node under it.
+static void LogNodesRecursive(FbxNode* node, int depth, Logger& log) {
+  if (log.level() > kLogVerbose) return;
+  const FbxAMatrix& local = node->EvaluateLocalTransform();
+  const FbxVector4 t = local.GetT();
+  const FbxVector4 r = local.GetR();
+  const FbxVector4 s = local.GetS();
+  log.Log(kLogVerbose,
+          "%*s%s: t(%.3f, %.3f, %.3f) r(%.3f, %.3f, %.3f) "
+          "s(%.3f, %.3f, %.3f)\n",
+          2 * depth, "", node->GetName(), t[0], t[1], t[2], r[0], r[1], r[2],
+          s[0], s[1], s[2]);
+  for (int i = 0; i < node->GetChildCount(); ++i) {
+    LogNodesRecursive(node->GetChild(i), depth + 1, log);
+  }
+}
+
+/// @class FbxMeshParser
+/// @brief Load FBX files and save their geometry in our FlatBuffer format.
+class FbxMeshParser {
+ public:
+  // If `shared_manager` is null, the parser creates and owns its own
+  // FbxManager. Otherwise the scene is created in `shared_manager`, which
+  // must only be used by one thread at a time.
+  explicit FbxMeshParser(Logger& log, FbxManager* shared_manager = nullptr)
+      : manager_(shared_manager),
+        owns_manager_(shared_manager == nullptr),
+        scene_(nullptr),
+        log_(log) {
+    // The FbxManager is the gateway to the FBX API.
+    if (owns_manager_) manager_ = CreateManager();
+    if (manager_ == nullptr) {
+      log_.Log(kLogError, "Unable to create FBX manager.\n");
+      return;
+    }
+
+    // Create an FBX scene. This object holds most objects imported/exported
+    // from/to files.
+    scene_ = FbxScene::Create(manager_, "My Scene");
+    if (scene_ == nullptr) {
+      log_.Log(kLogError, "Unable to create FBX scene.\n");
+      return;
+    }
+  }
+
+  ~FbxMeshParser() {
+    if (owns_manager_) {
+      // Delete the FBX Manager and all objects that it created.
+      if (manager_ != nullptr) manager_->Destroy();
+    } else if (scene_ != nullptr) {
+      // Leave the shared manager clean for the next file.
+      scene_->Destroy(true);
+    }
+  }
+
+  // Create an FbxManager with standard IO settings.
+  static FbxManager* CreateManager() {
+    FbxManager* manager = FbxManager::Create();
+    if (manager == nullptr) return nullptr;
+    FbxIOSettings* ios = FbxIOSettings::Create(manager, IOSROOT);
+    manager->SetIOSettings(ios);
+    return manager;
+  }
+
+  bool Valid() const { return manager_ != nullptr && scene_ != nullptr; }
+
+  bool Load(const char* file_name, AxisSystem axis_system,
+            float distance_unit_scale, bool recenter,
+            VertexAttributeBitmask vertex_attributes) {
+    if (!Valid()) return false;
+
+    log_.Log(
+        kLogInfo,
+        "---- mesh_pipeline: %s ------------------------------------------\n",
+        fplutil::BaseFileName(file_name).c_str());
+
+    // Create the importer and initialize with the file.
+    FbxImporter* importer = FbxImporter::Create(manager_, "");
+    const bool init_success =
+        importer->Initialize(file_name, -1, manager_->GetIOSettings());
+    const FbxStatus init_status = importer->GetStatus();
+
+    // Check the SDK and pipeline versions.
+    int sdk_major = 0, sdk_minor = 0, sdk_revision = 0;
+    int file_major = 0, file_minor = 0, file_revision = 0;
+    FbxManager::GetFileFormatVersion(sdk_major, sdk_minor, sdk_revision);
+    importer->GetFileVersion(file_major, file_minor, file_revision);
+
+    // Report version information.
+    log_.Log(kLogVerbose, "File version %d.%d.%d, SDK version %d.%d.%d\n",
+             file_major, file_minor, file_revision, sdk_major, sdk_minor,
+             sdk_revision);
+
+    // Exit on load error.
+    if (!init_success) {
+      log_.Log(kLogError, "init, %s\n\n", init_status.GetErrorString());
+      return false;
+    }
+
+    // Import the scene.
+    const bool import_success = importer->Import(scene_);
+    const FbxStatus import_status = importer->GetStatus();
+
+    // Clean-up temporaries.
+    importer->Destroy();
+
+    // Exit if the import failed.
+    if (!import_success) {
+      log_.Log(kLogError, "import, %s\n\n", import_status.GetErrorString());
+      return false;
+    }
+
+    // Remember the source file name so we can search for textures nearby.
+    mesh_file_name_ = std::string(file_name);
+
+    // Ensure the correct distance unit and axis system are being used.
+    ConvertScale(distance_unit_scale, scene_, log_);
+    ConvertAxes(axis_system, scene_, log_);
+
+    // Bring the geo into our format.
+    ConvertGeometry(recenter, vertex_attributes);
+
+    // Log nodes after we've processed them.
+    log_.Log(kLogVerbose, "Converted scene nodes\n");
+    LogNodesRecursive(scene_->GetRootNode(), 0, log_);
+    return true;
+  }
+
+  // Return an upper bound on the number of vertices in the scene.
+  int NumVertsUpperBound() const {
+    // The scene's been triangulated, so there are three verts per poly.
+    // Many of those verts may be duplicates, but we're only looking for an
+    // upper bound.
+    return 3 * NumPolysRecursive(scene_->GetRootNode());
+  }
+
+  // Files read by Load(). Used by the build cache.
+  std::vector<std::string> InputFiles() const {
+    return std::vector<std::string>(1, mesh_file_name_);
+  }
+
+  // Map FBX nodes to bone indices, used to create bone index references.
+  typedef std::unordered_map<const FbxNode*, unsigned int> NodeToBoneMap;
+
+  static int AddBoneForNode(NodeToBoneMap* node_to_bone_map, FbxNode* node,
+                            int parent_bone_index, FlatMesh* out) {
+    // The node is a bone if it was marked as one by MarkBoneNodesRecursive.
+    const auto found_it = node_to_bone_map->find(node);
+    if (found_it == node_to_bone_map->end()) {
+      return -1;
+    }
+
+    // Add the bone entry.
+    const FbxAMatrix global_transform = node->EvaluateGlobalTransform();
+    const FbxAMatrix default_bone_transform_inverse =
+        global_transform.Inverse();
+    const char* const name = node->GetName();
+    const unsigned int bone_index = out->AppendBone(
+        name, Mat4FromFbx(default_bone_transform_inverse), parent_bone_index);
+    found_it->second = bone_index;
+    return bone_index;
+  }
+
+  // List the nodes marked by MarkBoneNodesRecursive in the order that
+  // GatherBonesRecursive adds them, along with their parent indices.
+  static void GatherBoneNodesRecursive(const NodeToBoneMap& node_to_bone_map,
+                                       FbxNode* node, int parent_bone_index,
+                                       std::vector<FbxNode*>* bone_nodes,
+                                       std::vector<int>* bone_parents) {
+    if (node_to_bone_map.find(node) == node_to_bone_map.end()) return;
+    const int bone_index = static_cast<int>(bone_nodes->size());
+    bone_nodes->push_back(node);
+    bone_parents->push_back(parent_bone_index);
+    for (int i = 0; i != node->GetChildCount(); ++i) {
+      GatherBoneNodesRecursive(node_to_bone_map, node->GetChild(i), bone_index,
+                               bone_nodes, bone_parents);
+    }
+  }
+
+  // Replace characters that are awkward in file names with underscores.
+  static std::string SanitizedName(const char* name) {
+    std::string sanitized(name);
+    for (size_t i = 0; i < sanitized.size(); ++i) {
+      const char c = sanitized[i];
+      if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') {
+        sanitized[i] = '_';
+      }
+    }
+    return sanitized;
+  }
+
+  bool MarkBoneNodesRecursive(NodeToBoneMap* node_to_bone_map,
+                              FbxNode* node) const {
+    // We need a bone for this node if it has a skeleton attribute or a mesh.
+    bool need_bone = (node->GetSkeleton() || node->GetMesh());
+
+    // We also need a bone for this node if it has any such child bones.
+    const int child_count = node->GetChildCount();
+    for (int child_index = 0; child_index != child_count; ++child_index) {
+      FbxNode* const child_node = node->GetChild(child_index);
+      if (MarkBoneNodesRecursive(node_to_bone_map, child_node)) {
+        need_bone = true;
+      }
+    }
+
+    // Flag the node as a bone.
+    if (need_bone) {
+      node_to_bone_map->insert(NodeToBoneMap::value_type(node, -1));
+    }
+    return need_bone;
+  }
+
+  void GatherBonesRecursive(NodeToBoneMap* node_to_bone_map, FbxNode* node,
+                            int parent_bone_index, FlatMesh* out) const {
+    const int bone_index =
+        AddBoneForNode(node_to_bone_map, node, parent_bone_index, out);
+    if (bone_index >= 0) {
+      const int child_count = node->GetChildCount();
+      for (int child_index = 0; child_index != child_count; ++child_index) {
+        FbxNode* const child_node = node->GetChild(child_index);
+        GatherBonesRecursive(node_to_bone_map, child_node, bone_index, out);
+      }
+    }
+  }
+
+  // Gather converted geometry into our `FlatMesh` class.
+  void GatherFlatMesh(bool gather_textures, FlatMesh* out) const {
+    FbxNode* const root_node = scene_->GetRootNode();
+    const int child_count = root_node->GetChildCount();
+    NodeToBoneMap node_to_bone_map;
+
+    // First pass: determine which nodes are to be treated as bones.
+    // We skip the root node so it's not included in the bone hierarchy.
+    for (int child_index = 0; child_index != child_count; ++child_index) {
+      FbxNode* const child_node = root_node->GetChild(child_index);
+      MarkBoneNodesRecursive(&node_to_bone_map, child_node);
+    }
+
+    // Second pass: add bones.
+    // We skip the root node so it's not included in the bone hierarchy.
+    for (int child_index = 0; child_index != child_count; ++child_index) {
+      FbxNode* const child_node = root_node->GetChild(child_index);
+      GatherBonesRecursive(&node_to_bone_map, child_node, -1, out);
+    }
+
+    // Third pass: Traverse the scene and read the vertices of each mesh.
+    // Everything that calls into the FBX SDK, which is not thread safe, or
+    // logs, happens here on one thread.
+    std::vector<SurfaceJob> jobs;
+    std::vector<FlatMesh::SurfaceChunk> chunks;
+    GatherFlatMeshRecursive(gather_textures, &node_to_bone_map, root_node,
+                            root_node, *out, &jobs, &chunks);
+
+    // Final pass: Transform and deduplicate the vertices of each surface on
+    // worker threads. Start with the largest meshes so that the threads
+    // finish together.
+    std::vector<size_t> order(jobs.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return jobs[a].control_indices.size() > jobs[b].control_indices.size();
+    });
+    ParallelFor(order.size(), [&](size_t i) {
+      GatherFlatSurface(jobs[order[i]], &chunks[order[i]]);
+    });
+
+    // Merge the surfaces in scene order, so the output is deterministic.
+    out->AppendSurfaceChunks(&chunks);
+  }
+
+  // Output one .fplanim file per animation stack (take) in the scene. The
+  // clips' bones match those output by GatherFlatMesh(). The file is named
+  // after the mesh, with the take's name appended if there is more than one.
+  bool OutputAnimations(const std::string& mesh_name_unformated,
+                        const std::string& assets_base_dir_unformated,
+                        const std::string& assets_sub_dir_unformated,
+                        float tolerance,
+                        std::vector<std::string>* output_files) const {
+    const int num_stacks = scene_->GetSrcObjectCount<FbxAnimStack>();
+    if (num_stacks == 0) {
+      log_.Log(kLogWarning, "No animations in %s\n", mesh_file_name_.c_str());
+      return true;
+    }
+
+    // Find the bones in the same order as GatherFlatMesh().
+    FbxNode* const root_node = scene_->GetRootNode();
+    NodeToBoneMap node_to_bone_map;
+    std::vector<FbxNode*> bone_nodes;
+    std::vector<int> bone_parents;
+    for (int i = 0; i != root_node->GetChildCount(); ++i) {
+      MarkBoneNodesRecursive(&node_to_bone_map, root_node->GetChild(i));
+    }
+    for (int i = 0; i != root_node->GetChildCount(); ++i) {
+      GatherBoneNodesRecursive(node_to_bone_map, root_node->GetChild(i), -1,
+                               &bone_nodes, &bone_parents);
+    }
+    if (bone_nodes.size() > kMaxAnimationBones) {
+      log_.Log(kLogError, "Too many bones to animate in %s\n",
+               mesh_file_name_.c_str());
+      return false;
+    }
+
+    const std::string mesh_name = fplutil::BaseFileName(mesh_name_unformated);
+    const std::string assets_dir =
+        fplutil::FormatAsDirectoryName(assets_base_dir_unformated) +
+        fplutil::FormatAsDirectoryName(assets_sub_dir_unformated);
+    const FbxTime::EMode time_mode =
+        scene_->GetGlobalSettings().GetTimeMode();
+    const double frames_per_second = FbxTime::GetFrameRate(time_mode);
+
+    log_.Log(kLogInfo, "Animations:\n");
+    for (int s = 0; s < num_stacks; ++s) {
+      FbxAnimStack* stack = scene_->GetSrcObject<FbxAnimStack>(s);
+      scene_->SetCurrentAnimationStack(stack);
+      const FbxTimeSpan span = stack->GetLocalTimeSpan();
+      const FbxLongLong num_frames_in_span =
+          span.GetDuration().GetFrameCount(time_mode) + 1;
+      const int num_frames = static_cast<int>(
+          std::min<FbxLongLong>(num_frames_in_span, kMaxAnimationFrames));
+      if (num_frames < num_frames_in_span) {
+        log_.Log(kLogWarning, "Take %s truncated to %d frames\n",
+                 stack->GetName(), num_frames);
+      }
+
+      AnimClipBuilder clip(stack->GetName(),
+                           static_cast<float>(frames_per_second), num_frames,
+                           log_);
+      for (size_t b = 0; b < bone_nodes.size(); ++b) {
+        clip.AddBone(bone_nodes[b]->GetName(), bone_parents[b]);
+      }
+
+      // Sample every bone relative to its parent bone. Root bones are sampled
+      // in world space, since the scene root is not a bone.
+      for (int f = 0; f < num_frames; ++f) {
+        FbxTime time;
+        time.SetFrame(f, time_mode);
+        time += span.GetStart();
+        for (size_t b = 0; b < bone_nodes.size(); ++b) {
+          FbxNode* node = bone_nodes[b];
+          const FbxAMatrix transform =
+              bone_parents[b] < 0 ? node->EvaluateGlobalTransform(time)
+                                  : node->EvaluateLocalTransform(time);
+          const FbxQuaternion q = transform.GetQ();
+          clip.SetFrame(static_cast<int>(b), f, Vec3FromFbx(transform.GetT()),
+                        vec4(static_cast<float>(q[0]), static_cast<float>(q[1]),
+                             static_cast<float>(q[2]),
+                             static_cast<float>(q[3])),
+                        Vec3FromFbx(transform.GetS()));
+        }
+      }
+
+      const std::string clip_name =
+          num_stacks == 1 ? mesh_name
+                          : mesh_name + "_" + SanitizedName(stack->GetName());
+      const std::string file_name =
+          assets_dir + clip_name + "." + animdef::AnimClipExtension();
+      if (!clip.Output(file_name, tolerance, output_files)) return false;
+    }
+    return true;
+  }
+
+ private:
+  FPL_DISALLOW_COPY_AND_ASSIGN(FbxMeshParser);
+
+  void ConvertGeometry(bool recenter,
+                       VertexAttributeBitmask vertex_attributes) {
+    FbxGeometryConverter geo_converter(manager_);
+
+    // Ensure origin is in the center of geometry.
+    if (recenter) {
+      const bool recentered =
+          geo_converter.RecenterSceneToWorldCenter(scene_, 0.0);
+      if (recentered) {
+        log_.Log(kLogInfo, "Recentering\n");
+      } else {
+        log_.Log(kLogInfo, "Already centered so ignoring recenter request\n");
+      }
+    }
+
+    // Ensure each mesh has only one texture, and only triangles.
+    geo_converter.SplitMeshesPerMaterial(scene_, true);
+    geo_converter.Triangulate(scene_, true);
+
+    // Traverse all meshes in the scene, generating normals.
+    ConvertGeometryRecursive(scene_->GetRootNode(), vertex_attributes);
+  }
+
+  void ConvertGeometryRecursive(FbxNode* node,
+                                VertexAttributeBitmask vertex_attributes) {
+    if (node == nullptr) return;
+
+    // We're only interested in meshes, for the moment.
+    for (int i = 0; i < node->GetNodeAttributeCount(); ++i) {
+      FbxNodeAttribute* attr = node->GetNodeAttributeByIndex(i);
+      if (attr == nullptr ||
+          attr->GetAttributeType() != FbxNodeAttribute::eMesh)
+        continue;
+      FbxMesh* mesh = static_cast<FbxMesh*>(attr);
+
+      // Generate normals. Leaves existing normal data if it already exists.
+      if (vertex_attributes != kVertexAttributeBit_AllAttributesInSourceFile &&
+          (vertex_attributes &
+           (kVertexAttributeBit_Normal | kVertexAttributeBit_Orientation))) {
+        const bool normals_generated = mesh->GenerateNormals();
+        if (normals_generated) {
+          log_.Log(kLogInfo, "Generating normals for mesh %s\n",
+                   mesh->GetName());
+        } else {
+          log_.Log(kLogWarning, "Could not generate normals for mesh %s\n",
+                   mesh->GetName());
+        }
+      }
+
+      // Missing tangents are generated by FlatMesh::GenerateTangentFrames().
+    }
+
+    // Recursively traverse each node in the scene
+    for (int i = 0; i < node->GetChildCount(); i++) {
+      ConvertGeometryRecursive(node->GetChild(i), vertex_attributes);
+    }
+  }
+
+  // Return the total number of polygons under `node`.
+  int NumPolysRecursive(FbxNode* node) const {
+    if (node == nullptr) return 0;
+
+    // Sum the number of polygons across all meshes on this node.
+    int num_polys = 0;
+    for (int i = 0; i < node->GetNodeAttributeCount(); ++i) {
+      const FbxNodeAttribute* attr = node->GetNodeAttributeByIndex(i);
+      if (attr == nullptr ||
+          attr->GetAttributeType() != FbxNodeAttribute::eMesh)
+        continue;
+      const FbxMesh* mesh = static_cast<const FbxMesh*>(attr);
+      num_polys += mesh->GetPolygonCount();
+    }
+
+    // Recursively traverse each node in the scene
+    for (int i = 0; i < node->GetChildCount(); i++) {
+      num_polys += NumPolysRecursive(node->GetChild(i));
+    }
+    return num_polys;
+  }
+
+  // Get the UVs for a mesh.
+  const FbxGeometryElementUV* UvElements(
+      const FbxMesh* mesh, const FbxGeometryElementUV** uv_alt_element) const {
+    const int uv_count = mesh->GetElementUVCount();
+    const FbxGeometryElementUV* uv_element = nullptr;
+    *uv_alt_element = nullptr;
+
+    // Use the first UV set as the primary UV set.
+    if (uv_count > 0) {
+      uv_element = mesh->GetElementUV(0);
+      log_.Log(kLogVerbose, "Using UV map %s for mesh %s.\n",
+               uv_element->GetName(), mesh->GetName());
+    }
+
+    // Use the second UV set if it exists.
+    if (uv_count > 1) {
+      *uv_alt_element = mesh->GetElementUV(1);
+      log_.Log(kLogVerbose, "Using alternate UV map %s for mesh %s.\n",
+               (*uv_alt_element)->GetName(), mesh->GetName());
+    }
+
+    // Warn when more UV sets exist.
+    if (uv_count > 2 && log_.level() <= kLogWarning) {
+      FbxStringList uv_set_names;
+      mesh->GetUVSetNames(uv_set_names);
+      log_.Log(kLogWarning,
+               "Multiple UVs for mesh %s. Using %s and %s. Ignoring %s.\n",
+               mesh->GetName(), uv_set_names.GetStringAt(0),
+               uv_set_names.GetStringAt(1), uv_set_names.GetStringAt(2));
+    }
+
+    return uv_element;
+  }
+
+  bool SolidColor(FbxNode* node, const FbxMesh* mesh, FbxColor* color) const {
+    FbxLayerElementArrayTemplate<int>* material_indices;
+    const bool valid_indices = mesh->GetMaterialIndices(&material_indices);
+    if (!valid_indices) return false;
+
+    for (int j = 0; j < material_indices->GetCount(); ++j) {
+      // Check every material attached to this mesh.
+      const int material_index = (*material_indices)[j];
+      const FbxSurfaceMaterial* material = node->GetMaterial(material_index);
+      if (material == nullptr) continue;
+
+      // Textures are properties of the material. Check if the diffuse
+      // color has been set.
+      const FbxProperty diffuse_property =
+          material->FindProperty(FbxSurfaceMaterial::sDiffuse);
+      const FbxProperty diffuse_factor_property =
+          material->FindProperty(FbxSurfaceMaterial::sDiffuseFactor);
+      if (!diffuse_property.IsValid() || !diffuse_factor_property.IsValid())
+        continue;
+
+      // Final diffuse color is the factor times the base color.
+      const double factor = diffuse_factor_property.Get<FbxDouble>();
+      const FbxColor base = diffuse_property.Get<FbxColor>();
+      color->Set(factor * base.mRed, factor * base.mGreen, factor * base.mBlue,
+                 base.mAlpha);
+      return true;
+    }
+    return false;
+  }
+
+  // Get the texture for a mesh node.
+  const FbxFileTexture* TextureFromNode(FbxNode* node, const FbxMesh* mesh,
+                                        const char* texture_property) const {
+    FbxLayerElementArrayTemplate<int>* material_indices;
+    const bool valid_indices = mesh->GetMaterialIndices(&material_indices);
+    if (!valid_indices) return nullptr;
+
+    // Gather the unique materials attached to this mesh.
+    std::unordered_set<int> unique_material_indices;
+    for (int j = 0; j < material_indices->GetCount(); ++j) {
+      const int material_index = (*material_indices)[j];
+      unique_material_indices.insert(material_index);
+    }
+
+    for (auto it = unique_material_indices.begin();
+         it != unique_material_indices.end(); ++it) {
+      const FbxSurfaceMaterial* material = node->GetMaterial(*it);
+      if (material == nullptr) continue;
+
+      // Textures are properties of the material.
+      const FbxProperty property = material->FindProperty(texture_property);
+      const int texture_count = property.GetSrcObjectCount<FbxFileTexture>();
+      if (texture_count == 0) continue;
+
+      // Grab the first texture.
+      const FbxFileTexture* texture =
+          FbxCast<FbxFileTexture>(property.GetSrcObject<FbxFileTexture>(0));
+
+      // Warn if there are extra unused textures.
+      if (texture_count > 1 && log_.level() <= kLogWarning) {
+        const FbxFileTexture* texture1 =
+            FbxCast<FbxFileTexture>(property.GetSrcObject<FbxFileTexture>(1));
+        log_.Log(kLogWarning,
+                 "Material %s has multiple textures. Using %s. Ignoring %s.\n",
+                 material->GetName(), texture->GetFileName(),
+                 texture1->GetFileName());
+      }
+
+      // Log the texture we found and return.
+      if (texture != nullptr) return texture;
+    }
+
+    return nullptr;
+  }
+
+  std::string TextureFileName(FbxNode* node, const FbxMesh* mesh,
+                              const char* texture_property) const {
+    // Grab the texture attached to this node.
+    const FbxFileTexture* texture =
+        TextureFromNode(node, mesh, texture_property);
+    if (texture == nullptr) return "";
+
+    // Look for a texture on disk that matches the texture referenced by
+    // the FBX.
+    const std::string texture_file_name = FindSourceTextureFileName(
+        mesh_file_name_, std::string(texture->GetFileName()), log_);
+    return texture_file_name;
+  }
+
+  FlatTextures GatherTextures(FbxNode* node, const FbxMesh* mesh) const {
+    FlatTextures textures;
+
+    // FBX nodes can have many different kinds of textures.
+    // We search for each kind of texture in the order specified by
+    // kTextureProperties. When we find a texture, we assign it the next
+    // shader index.
+    for (size_t i = 0; i < FPL_ARRAYSIZE(kTextureProperties); ++i) {
+      // Find the filename for the texture type given by `texture_property`.
+      const char* texture_property = kTextureProperties[i];
+      std::string texture = TextureFileName(node, mesh, texture_property);
+      if (texture == "") continue;
+
+      // Append texture to our list of textures.
+      log_.Log(kLogVerbose, " Mapping %s texture `%s` to shader texture %d\n",
+               texture_property,
+               fplutil::RemoveDirectoryFromName(texture).c_str(),
+               textures.Count());
+      textures.Append(texture);
+    }
+
+    return textures;
+  }
+
+  // Factor node's global_transform into two transforms:
+  //   point_transform <== apply in pipeline
+  //   default_bone_transform_inverse <== apply at runtime
+  void Transforms(FbxNode* node, FbxNode* parent_node,
+                  FbxAMatrix* default_bone_transform_inverse,
+                  FbxAMatrix* point_transform) const {
+    // geometric_transform is applied to each point, but is not inherited
+    // by children.
+    const FbxVector4 geometric_translation =
+        node->GetGeometricTranslation(FbxNode::eSourcePivot);
+    const FbxVector4 geometric_rotation =
+        node->GetGeometricRotation(FbxNode::eSourcePivot);
+    const FbxVector4 geometric_scaling =
+        node->GetGeometricScaling(FbxNode::eSourcePivot);
+    const FbxAMatrix geometric_transform(geometric_translation,
+                                         geometric_rotation, geometric_scaling);
+
+    const FbxAMatrix global_transform = node->EvaluateGlobalTransform();
+    const FbxAMatrix parent_global_transform =
+        parent_node->EvaluateGlobalTransform();
+
+    // We want the root node to be the identity. Everything in object space
+    // is relative to the root.
+    *default_bone_transform_inverse = global_transform.Inverse();
+    *point_transform = global_transform * geometric_transform;
+  }
+
+  // The vertices of one mesh, copied out of the FBX SDK so that they can be
+  // gathered into a surface chunk on a worker thread.
+  struct SurfaceJob {
+    mat4 point_transform;
+    mat4 vector_transform;  // `point_transform` without the translation.
+    VertexAttributeBitmask surface_vertex_attributes;
+    vec4 color;  // Of every vertex, if the mesh has no vertex colors.
+
+    // One per control point.
+    std::vector<vec3_packed> points;
+    std::vector<SkinBinding> skin_bindings;
+
+    // One per poly-vert. Attributes the mesh doesn't have are left empty.
+    std::vector<int> control_indices;
+    std::vector<vec3_packed> normals;
+    std::vector<vec4_packed> tangents;
+    std::vector<vec4_packed> colors;
+    std::vector<vec2_packed> uvs;
+    std::vector<vec2_packed> uv_alts;
+  };
+
+  // For each mesh in the tree of nodes under `node`, add a job to `jobs` and
+  // an empty chunk for its surface to `chunks`.
+  void GatherFlatMeshRecursive(bool gather_textures,
+                               const NodeToBoneMap* node_to_bone_map,
+                               FbxNode* node, FbxNode* parent_node,
+                               const FlatMesh& out,
+                               std::vector<SurfaceJob>* jobs,
+                               std::vector<FlatMesh::SurfaceChunk>* chunks)
+      const {
+    // We're only interested in mesh nodes. If a node and all nodes under it
+    // have no meshes, we early out.
+    if (node == nullptr || !NodeHasMesh(node)) return;
+    log_.Log(kLogVerbose, "Node: %s\n", node->GetName());
+
+    // The root node cannot have a transform applied to it, so we do not
+    // export it as a bone.
+    int bone_index = -1;
+    if (node != scene_->GetRootNode()) {
+      // Get the transform to this node from its parent.
+      FbxAMatrix default_bone_transform_inverse;
+      FbxAMatrix point_transform;
+      Transforms(node, parent_node, &default_bone_transform_inverse,
+                 &point_transform);
+
+      // Find the bone for this node.  It must have one, because we checked that
+      // it contained a mesh above.
+      const auto found_it = node_to_bone_map->find(node);
+      assert(found_it != node_to_bone_map->end());
+      bone_index = found_it->second;
+
+      // Gather mesh data for this bone.
+      // Note that there may be more than one mesh attached to a node.
+      for (int i = 0; i < node->GetNodeAttributeCount(); ++i) {
+        const FbxNodeAttribute* attr = node->GetNodeAttributeByIndex(i);
+        if (attr == nullptr ||
+            attr->GetAttributeType() != FbxNodeAttribute::eMesh)
+          continue;
+        const FbxMesh* mesh = static_cast<const FbxMesh*>(attr);
+
+        // Gather the textures attached to this mesh.
+        FlatTextures textures;
+        if (gather_textures) {
+          textures = GatherTextures(node, mesh);
+        }
+
+        // If no textures for this mesh, try to get a solid color from the
+        // material.
+        FbxColor solid_color;
+        const bool has_solid_color =
+            textures.Count() == 0 && SolidColor(node, mesh, &solid_color);
+
+        // Without a base texture or color, the model will look rather plane.
+        if (textures.Count() == 0 && !has_solid_color) {
+          log_.Log(kLogWarning, "No texture or solid color found for node %s\n",
+                   node->GetName());
+        }
+
+        // Queue the vertices and indices to be gathered.
+        jobs->push_back(SurfaceJob());
+        ReadSurface(mesh, static_cast<SkinBinding::BoneIndex>(bone_index),
+                    node_to_bone_map, point_transform, has_solid_color,
+                    solid_color, &jobs->back());
+        chunks->push_back(FlatMesh::SurfaceChunk(out, textures));
+      }
+    }
+
+    // Recursively traverse each node in the scene
+    for (int i = 0; i < node->GetChildCount(); i++) {
+      GatherFlatMeshRecursive(gather_textures, node_to_bone_map,
+                              node->GetChild(i), node, out, jobs, chunks);
+    }
+  }
+
+  void GatherSkinBindings(const FbxMesh* mesh,
+                          SkinBinding::BoneIndex transform_bone_index,
+                          const NodeToBoneMap* node_to_bone_map,
+                          std::vector<SkinBinding>* out_skin_bindings) const {
+    const unsigned int point_count = mesh->GetControlPointsCount();
+    std::vector<SkinBinding> skin_bindings(point_count);
+
+    // Each cluster stores a mapping from a bone to all the vertices it
+    // influences.  This generates an inverse mapping from each point to all
+    // the bones influencing it.
+    const int skin_count = mesh->GetDeformerCount(FbxDeformer::eSkin);
+    for (int skin_index = 0; skin_index != skin_count; ++skin_index) {
+      const FbxSkin* const skin = static_cast<const FbxSkin*>(
+          mesh->GetDeformer(skin_index, FbxDeformer::eSkin));
+      const int cluster_count = skin->GetClusterCount();
+      for (int cluster_index = 0; cluster_index != cluster_count;
+           ++cluster_index) {
+        const FbxCluster* const cluster = skin->GetCluster(cluster_index);
+        const FbxNode* const link_node = cluster->GetLink();
+
+        // Get the bone index from the node pointer.
+        const NodeToBoneMap::const_iterator link_it =
+            node_to_bone_map->find(link_node);
+        assert(link_it != node_to_bone_map->end());
+        const int bone_index = link_it->second;
+
+        // We currently only support normalized weights.  Both eNormalize and
+        // eTotalOne can be treated as normalized, because we renormalize
+        // weights after extraction.
+        const FbxCluster::ELinkMode link_mode = cluster->GetLinkMode();
+        if (link_mode != FbxCluster::eNormalize &&
+            link_mode != FbxCluster::eTotalOne) {
+          log_.Log(kLogWarning,
+                   "Mesh %s skin %d(%s) cluster %d(%s) has"
+                   " unsupported LinkMode %d (only eNormalize(%d) and"
+                   " eTotalOne(%d) are supported).\n",
+                   GetMeshOrNodeName(mesh), skin_index, skin->GetName(),
+                   cluster_index, cluster->GetName(),
+                   static_cast<int>(link_mode),
+                   static_cast<int>(FbxCluster::eNormalize),
+                   static_cast<int>(FbxCluster::eTotalOne));
+        }
+
+        // Assign bone weights to all cluster influences.
+        const int influence_count = cluster->GetControlPointIndicesCount();
+        const int* const point_indices = cluster->GetControlPointIndices();
+        const double* const weights = cluster->GetControlPointWeights();
+        for (int influence_index = 0; influence_index != influence_count;
+             ++influence_index) {
+          const int point_index = point_indices[influence_index];
+          assert(static_cast<unsigned int>(point_index) < point_count);
+          const float weight = static_cast<float>(weights[influence_index]);
+          skin_bindings[point_index].AppendInfluence(
+              bone_index, weight, log_, GetMeshOrNodeName(mesh), point_index);
+        }
+      }
+    }
+
+    // Normalize weights.
+    for (unsigned int point_index = 0; point_index != point_count;
+         ++point_index) {
+      SkinBinding* const skin_binding = &skin_bindings[point_index];
+      if (!skin_binding->HasInfluences()) {
+        // Any non-skinned vertices not bound to a deformer are implicitly bound
+        // to their parent transform.
+        skin_binding->BindRigid(transform_bone_index);
+      } else {
+        skin_binding->NormalizeBoneWeights();
+      }
+    }
+
+    out_skin_bindings->swap(skin_bindings);
+  }
+
+  // Copy the vertices of `mesh` into `job`.
+  void ReadSurface(const FbxMesh* mesh,
+                   SkinBinding::BoneIndex transform_bone_index,
+                   const NodeToBoneMap* node_to_bone_map,
+                   const FbxAMatrix& point_transform, bool has_solid_color,
+                   const FbxColor& solid_color, SurfaceJob* job) const {
+    const FbxAMatrix& t = point_transform;
+    log_.Log(kLogVerbose,
+             "    transform: {%.3f %.3f %.3f %.3f}\n"
+             "               {%.3f %.3f %.3f %.3f}\n"
+             "               {%.3f %.3f %.3f %.3f}\n"
+             "               {%.3f %.3f %.3f %.3f}\n",
+             t[0][0], t[0][1], t[0][2], t[0][3], t[1][0], t[1][1], t[1][2],
+             t[1][3], t[2][0], t[2][1], t[2][2], t[2][3], t[3][0], t[3][1],
+             t[3][2], t[3][3]);
+
+    // Affine matrix only supports multiplication by a point, not a vector.
+    // That is, there is no way to ignore the translation (as is required
+    // for normals and tangents). So, we create a copy of `transform` that
+    // has no translation.
+    // http://forums.autodesk.com/t5/fbx-sdk/matrix-vector-multiplication/td-p/4245079
+    FbxAMatrix vector_transform = point_transform;
+    vector_transform.SetT(FbxVector4(0.0, 0.0, 0.0, 0.0));
+    job->point_transform = Mat4FromFbx(point_transform);
+    job->vector_transform = Mat4FromFbx(vector_transform);
+
+    GatherSkinBindings(mesh, transform_bone_index, node_to_bone_map,
+                       &job->skin_bindings);
+
+    // Get references to various vertex elements.
+    const FbxVector4* vertices = mesh->GetControlPoints();
+    const FbxGeometryElementNormal* normal_element = mesh->GetElementNormal();
+    const FbxGeometryElementTangent* tangent_element =
+        mesh->GetElementTangent();
+    const FbxGeometryElementVertexColor* color_element =
+        mesh->GetElementVertexColor();
+    const FbxGeometryElementUV* uv_alt_element = nullptr;
+    const FbxGeometryElementUV* uv_element = UvElements(mesh, &uv_alt_element);
+
+    // Record which vertex attributes exist for this surface.
+    // We reported the bone name and parents in AppendBone().
+    job->surface_vertex_attributes =
+        kVertexAttributeBit_Bone |
+        (vertices ? kVertexAttributeBit_Position : 0) |
+        (normal_element ? kVertexAttributeBit_Normal : 0) |
+        (tangent_element ? kVertexAttributeBit_Tangent : 0) |
+        (color_element != nullptr || has_solid_color ? kVertexAttributeBit_Color
+                                                     : 0) |
+        (uv_element ? kVertexAttributeBit_Uv : 0) |
+        (uv_alt_element ? kVertexAttributeBit_UvAlt : 0);
+    log_.Log(kLogVerbose, color_element != nullptr
+                              ? "Mesh has vertex colors\n"
+                              : has_solid_color
+                                    ? "Mesh material has a solid color\n"
+                                    : "Mesh does not have vertex colors\n");
+    job->color = Vec4FromFbx(has_solid_color ? solid_color : kDefaultColor);
+
+    const int num_points = mesh->GetControlPointsCount();
+    job->points.reserve(num_points);
+    for (int i = 0; i < num_points; ++i) {
+      job->points.push_back(vec3_packed(Vec3FromFbx(vertices[i])));
+    }
+
+    // Loop through every poly in the mesh.
+    const size_t max_verts = 3 * mesh->GetPolygonCount();
+    job->control_indices.reserve(max_verts);
+    if (normal_element) job->normals.reserve(max_verts);
+    if (tangent_element) job->tangents.reserve(max_verts);
+    if (color_element) job->colors.reserve(max_verts);
+    if (uv_element) job->uvs.reserve(max_verts);
+    if (uv_alt_element) job->uv_alts.reserve(max_verts);
+    int vertex_counter = 0;
+    const int num_polys = mesh->GetPolygonCount();
+    for (int poly_index = 0; poly_index < num_polys; ++poly_index) {
+      // Ensure polygon is a triangle. This should be true since we call
+      // Triangulate() when we load the scene.
+      const int num_verts = mesh->GetPolygonSize(poly_index);
+      if (num_verts != 3) {
+        log_.Log(kLogWarning, "mesh %s poly %d has %d verts instead of 3\n",
+                 mesh->GetName(), poly_index, num_verts);
+        continue;
+      }
+
+      // Loop through all three verts.
+      for (int vert_index = 0; vert_index < num_verts; ++vert_index) {
+        // Get the control index for this poly, vert combination.
+        const int control_index =
+            mesh->GetPolygonVertex(poly_index, vert_index);
+        job->control_indices.push_back(control_index);
+
+        // Depending on the FBX format, normals and UVs are indexed either
+        // by control point or by polygon-vertex.
+        // Note that the v-axis is flipped between FBX UVs and FlatBuffer UVs.
+        if (normal_element) {
+          job->normals.push_back(vec3_packed(Vec3FromFbx(ElementFromIndices(
+              normal_element, control_index, vertex_counter))));
+        }
+        if (tangent_element) {
+          job->tangents.push_back(vec4_packed(Vec4FromFbx(ElementFromIndices(
+              tangent_element, control_index, vertex_counter))));
+        }
+        if (color_element) {
+          job->colors.push_back(vec4_packed(Vec4FromFbx(ElementFromIndices(
+              color_element, control_index, vertex_counter))));
+        }
+        if (uv_element) {
+          job->uvs.push_back(vec2_packed(Vec2FromFbxUv(
+              ElementFromIndices(uv_element, control_index, vertex_counter))));
+        }
+        if (uv_alt_element) {
+          job->uv_alts.push_back(vec2_packed(Vec2FromFbxUv(ElementFromIndices(
+              uv_alt_element, control_index, vertex_counter))));
+        }
+
+        // Control points are listed in order of poly + vertex.
+        vertex_counter++;
+      }
+    }
+  }
+
+  // Transform the vertices of `job` and gather them into `out`. Safe to call
+  // from any thread, since it doesn't touch the FBX SDK or the log.
+  static void GatherFlatSurface(const SurfaceJob& job,
+                                FlatMesh::SurfaceChunk* out) {
+    out->Reserve(job.control_indices.size());
+    out->ReportSurfaceVertexAttributes(job.surface_vertex_attributes);
+    // A missing FBX UV reads as zero, which Vec2FromFbxUv() flips.
+    const vec2 kZeroUv(0.0f, 1.0f);
+    for (size_t i = 0; i < job.control_indices.size(); ++i) {
+      const int control_index = job.control_indices[i];
+      const vec3 vertex =
+          job.point_transform * vec3(job.points[control_index]);
+      const vec3 normal =
+          job.normals.empty()
+              ? kZeros3f
+              : (job.vector_transform * vec3(job.normals[i])).Normalized();
+      const vec4 tangent_in =
+          job.tangents.empty() ? kZeros4f : vec4(job.tangents[i]);
+      const vec4 tangent =
+          job.tangents.empty()
+              ? kZeros4f
+              : vec4((job.vector_transform * tangent_in.xyz()).Normalized(),
+                     tangent_in.w);
+      const vec4 color = job.colors.empty() ? job.color : vec4(job.colors[i]);
+      const vec2 uv = job.uvs.empty() ? kZeroUv : vec2(job.uvs[i]);
+      const vec2 uv_alt =
+          job.uv_alts.empty() ? kZeroUv : vec2(job.uv_alts[i]);
+      out->AppendPolyVert(vertex, normal, tangent, color, uv, uv_alt,
+                          job.skin_bindings[control_index]);
+    }
+  }
+
+  // Entry point to the FBX SDK.
+  FbxManager* manager_;
+
+  // True if `manager_` was created by this parser.
+  bool owns_manager_;
+
+  // Hold the FBX file data.
+  FbxScene* scene_;
+
+  // Name of source mesh file. Used to search for textures, when the textures
+  // are not found in their referenced location.
+  std::string mesh_file_name_;
+
+  // Information and warnings.
+  Logger& log_;
+};
+
+// Owns the FbxManager that every file is loaded into.
+struct FbxMeshLoader::Manager {
+  Manager() : fbx(FbxMeshParser::CreateManager()) {}
+  ~Manager() {
+    if (fbx != nullptr) fbx->Destroy();
+  }
+  FbxManager* fbx;
+};
+
+FbxMeshLoader::FbxMeshLoader() : manager_(nullptr) {}
+
+FbxMeshLoader::~FbxMeshLoader() { delete manager_; }
+
+bool FbxMeshLoader::Load(const MeshPipelineArgs& args, Logger& log,
+                         FlatMesh* mesh, std::vector<std::string>* input_files,
+                         std::vector<std::string>* output_files) {
+  if (manager_ == nullptr) manager_ = new Manager();
+  FbxMeshParser pipe(log, manager_->fbx);
+  if (!LoadAndGatherMesh(pipe, args, log, mesh, input_files)) return false;
+  if (!args.export_animations) return true;
+  return pipe.OutputAnimations(args.fbx_file, args.asset_base_dir,
+                               args.asset_rel_dir, args.animation_tolerance,
+                               output_files);
+}
+
+bool FbxMeshLoader::WriteGridScene(const char* file_name, int num_nodes,
+                                   int grid_size, Logger& log) {
+  if (manager_ == nullptr) manager_ = new Manager();
+  FbxManager* const fbx = manager_->fbx;
+  if (fbx == nullptr) return false;
+  FbxScene* const scene = FbxScene::Create(fbx, "Grid scene");
+
+  // Lay the grids out in a square, with gaps between them.
+  const int row = grid_size + 1;
+  int columns = 1;
+  while (columns * columns < num_nodes) columns++;
+  for (int n = 0; n < num_nodes; ++n) {
+    FbxMesh* const mesh = FbxMesh::Create(scene, "");
+    mesh->InitControlPoints(row * row);
+    FbxGeometryElementNormal* const normals = mesh->CreateElementNormal();
+    normals->SetMappingMode(FbxGeometryElement::eByControlPoint);
+    normals->SetReferenceMode(FbxGeometryElement::eDirect);
+    FbxGeometryElementUV* const uvs = mesh->CreateElementUV("uv");
+    uvs->SetMappingMode(FbxGeometryElement::eByControlPoint);
+    uvs->SetReferenceMode(FbxGeometryElement::eDirect);
+    for (int y = 0; y <= grid_size; ++y) {
+      for (int x = 0; x <= grid_size; ++x) {
+        const double fx = static_cast<double>(x) / grid_size;
+        const double fy = static_cast<double>(y) / grid_size;
+        mesh->SetControlPointAt(FbxVector4(fx, fy, 0.0), y * row + x);
+        normals->GetDirectArray().Add(FbxVector4(0.0, 0.0, 1.0));
+        uvs->GetDirectArray().Add(FbxVector2(fx, fy));
+      }
+    }
+    for (int y = 0; y < grid_size; ++y) {
+      for (int x = 0; x < grid_size; ++x) {
+        const int i = y * row + x;
+        const int quad[6] = {i, i + 1, i + row + 1, i, i + row + 1, i + row};
+        for (int t = 0; t < 6; t += 3) {
+          mesh->BeginPolygon();
+          for (int c = t; c < t + 3; ++c) mesh->AddPolygon(quad[c]);
+          mesh->EndPolygon();
+        }
+      }
+    }
+
+    std::ostringstream name;
+    name << "grid" << n;
+    FbxNode* const node = FbxNode::Create(scene, name.str().c_str());
+    node->SetNodeAttribute(mesh);
+    node->LclTranslation.Set(
+        FbxDouble3(1.5 * (n % columns), 1.5 * (n / columns), 0.0));
+    scene->GetRootNode()->AddChild(node);
+  }
+
+  FbxExporter* const exporter = FbxExporter::Create(fbx, "");
+  const bool status =
+      exporter->Initialize(file_name, -1, fbx->GetIOSettings()) &&
+      exporter->Export(scene);
+  if (!status) {
+    log.Log(kLogError, "Can't write %s: %s\n", file_name,
+            exporter->GetStatus().GetErrorString());
+  }
+  exporter->Destroy();
+  // Leave the shared manager clean for the next file.
+  scene->Destroy(true);
+  return status;
+}
+
+}  // namespace fplbase
@@ -0,0 +1,62 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef FPLBASE_MESH_PIPELINE_FBX_MESH_PARSER_H_
+#define FPLBASE_MESH_PIPELINE_FBX_MESH_PARSER_H_
+
+#include <string>
+#include <vector>
+
+#include "flat_mesh.h"
+#include "mesh_pipeline.h"
+
+namespace fplbase {
+
+/// @class FbxMeshLoader
+/// @brief Load FBX files and gather them into FlatMeshes.
+///
+/// The FbxManager is created for the first file and reused for the rest, so
+/// only use a loader from one thread at a time. When the pipeline is built
+/// without the FBX SDK, Load() logs an error and fails.
+class FbxMeshLoader {
+ public:
+  FbxMeshLoader();
+  ~FbxMeshLoader();
+
+  /// Load `args.fbx_file` and gather it into `mesh`, as LoadAndGatherMesh()
+  /// does. If `args.export_animations` is set, also output an .fplanim file
+  /// per take, and append their names to `output_files`.
+  bool Load(const MeshPipelineArgs& args, Logger& log, FlatMesh* mesh,
+            std::vector<std::string>* input_files,
+            std::vector<std::string>* output_files);
+
+  /// Write an FBX file with `num_nodes` mesh nodes side by side, each a flat
+  /// grid of `grid_size` x `grid_size` quads with normals and UVs. Used by
+  /// importer_benchmark to time gathering many meshes. Fails without the
+  /// FBX SDK.
+  bool WriteGridScene(const char* file_name, int num_nodes, int grid_size,
+                      Logger& log);
+
+ private:
+  // Defined with the FBX parser, so this header needn't include the SDK.
+  struct Manager;
+  Manager* manager_;
+
+  FPL_DISALLOW_COPY_AND_ASSIGN(FbxMeshLoader);
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_MESH_PIPELINE_FBX_MESH_PARSER_H_
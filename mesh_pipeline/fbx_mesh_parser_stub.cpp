@@ -0,0 +1,47 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// FbxMeshLoader for builds without the FBX SDK. See mesh_pipeline_fbx in
+// CMakeLists.txt.
+
+#include "fbx_mesh_parser.h"
+
+namespace fplbase {
+
+struct FbxMeshLoader::Manager {};
+
+FbxMeshLoader::FbxMeshLoader() : manager_(nullptr) {}
+
+FbxMeshLoader::~FbxMeshLoader() {}
+
+bool FbxMeshLoader::Load(const MeshPipelineArgs& args, Logger& log,
+                         FlatMesh* /*mesh*/,
+                         std::vector<std::string>* /*input_files*/,
+                         std::vector<std::string>* /*output_files*/) {
+  log.Log(kLogError,
+          "Can't load %s: mesh_pipeline was built without the FBX SDK.\n",
+          args.fbx_file.c_str());
+  return false;
+}
+
+bool FbxMeshLoader::WriteGridScene(const char* file_name, int /*num_nodes*/,
+                                   int /*grid_size*/, Logger& log) {
+  log.Log(kLogWarning,
+          "Can't write %s: mesh_pipeline was built without the FBX SDK.\n",
+          file_name);
+  return false;
+}
+
+}  // namespace fplbase
@@ -0,0 +1,455 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flat_mesh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_set>
+
+#include "fplutil/string_utils.h"
+
+namespace fplbase {
+
+static const char* const kImageExtensions[] = {"jpg", "jpeg", "png", "webp",
+                                               "tga"};
+
+// This instance is required since push_back takes its reference.
+// static
+const FlatMesh::BoneIndex FlatMesh::kInvalidBoneIdx;
+const int FlatMesh::kMinBonesPerSurface;
+
+// Texture searches are shared by every conversion in the process, so batch
+// conversions of meshes in the same directory probe each candidate file only
+// once. Both containers are guarded by `texture_search_mutex`.
+static std::mutex texture_search_mutex;
+static std::unordered_map<std::string, bool> texture_exists_cache;
+static std::unordered_set<std::string> missing_textures;
+
+static bool TextureFileExists(const std::string& file_name) {
+  {
+    std::lock_guard<std::mutex> lock(texture_search_mutex);
+    const auto found = texture_exists_cache.find(file_name);
+    if (found != texture_exists_cache.end()) return found->second;
+  }
+
+  // Check outside the lock so other threads aren't held up by the disk.
+  const bool exists = FileExists(file_name, fplutil::kCaseSensitive);
+  std::lock_guard<std::mutex> lock(texture_search_mutex);
+  texture_exists_cache[file_name] = exists;
+  return exists;
+}
+
+std::string FindSourceTextureFileName(const std::string& source_mesh_name,
+                                      const std::string& texture_name,
+                                      Logger& log) {
+  std::set<std::string> attempted_textures;
+
+  // If the texture name is relative, check for it relative to the
+  // source mesh's directory.
+  const std::string source_dir = fplutil::DirectoryName(source_mesh_name);
+  if (!fplutil::AbsoluteFileName(texture_name)) {
+    std::string texture_rel_name = source_dir + texture_name;
+    if (TextureFileExists(texture_rel_name)) return texture_rel_name;
+    attempted_textures.insert(std::move(texture_rel_name));
+  }
+
+  // If the texture exists in the same directory as the source mesh, use it.
+  const std::string texture_no_dir =
+      fplutil::RemoveDirectoryFromName(texture_name);
+  std::string texture_in_source_dir = source_dir + texture_no_dir;
+  if (TextureFileExists(texture_in_source_dir)) return texture_in_source_dir;
+  attempted_textures.insert(std::move(texture_in_source_dir));
+
+  // Check to see if there's a texture with the same base name as the mesh.
+  const std::string source_name = fplutil::BaseFileName(source_mesh_name);
+  const std::string texture_extension = fplutil::FileExtension(texture_name);
+  std::string source_texture =
+      source_dir + source_name + "." + texture_extension;
+  if (TextureFileExists(source_texture)) return source_texture;
+  attempted_textures.insert(std::move(source_texture));
+
+  // Gather potential base names for the texture (i.e. name without directory
+  // or extension).
+  const std::string base_name = fplutil::BaseFileName(texture_no_dir);
+  const std::string base_names[] = {base_name, fplutil::SnakeCase(base_name),
+                                    fplutil::CamelCase(base_name),
+                                    source_name};
+
+  // For each potential base name, loop through known image file extensions.
+  // The image may have been converted to a new format.
+  for (size_t i = 0; i < FPL_ARRAYSIZE(base_names); ++i) {
+    for (size_t j = 0; j < FPL_ARRAYSIZE(kImageExtensions); ++j) {
+      std::string potential_name =
+          source_dir + base_names[i] + "." + kImageExtensions[j];
+      if (TextureFileExists(potential_name)) return potential_name;
+      attempted_textures.insert(std::move(potential_name));
+    }
+  }
+
+  // As a last resort, use the texture name as supplied. We don't want to
+  // do this, normally, since the name can be an absolute path on the drive,
+  // or relative to the directory we're currently running from.
+  if (TextureFileExists(texture_name)) return texture_name;
+  attempted_textures.insert(texture_name.c_str());
+
+  // Texture can't be found. Only log warning once, to avoid spamming.
+  std::lock_guard<std::mutex> lock(texture_search_mutex);
+  if (missing_textures.find(texture_name) == missing_textures.end()) {
+    log.Log(kLogWarning, "Can't find texture `%s`. Tried these variants:\n",
+            texture_name.c_str());
+    for (auto it = attempted_textures.begin(); it != attempted_textures.end();
+         ++it) {
+      log.Log(kLogWarning, "  %s\n", it->c_str());
+    }
+    log.Log(kLogWarning, "\n");
+    missing_textures.insert(texture_name.c_str());
+  }
+  return "";
+}
+
+// Set by SetParallelForThreads(). 0 for one per hardware thread.
+static std::atomic<int> parallel_for_threads(0);
+
+void SetParallelForThreads(int num_threads) {
+  parallel_for_threads = std::max(0, num_threads);
+}
+
+void ParallelFor(size_t count, const std::function<void(size_t)>& fn) {
+  const int max_threads = parallel_for_threads;
+  const size_t num_threads = std::min<size_t>(
+      max_threads > 0 ? max_threads
+                      : std::max(1u, std::thread::hardware_concurrency()),
+      count);
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++) fn(i);
+  };
+
+  // The calling thread does its share of the work too.
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+}
+
+// Round `x` to a multiple of `grid`. Adding 0 turns -0 into +0, since
+// vertices are compared bytewise.
+static inline float Snap(float x, float grid) {
+  return std::round(x / grid) * grid + 0.0f;
+}
+
+// Round each component of the unit vector `v` to a signed fixed-point value
+// with `bits` bits, then renormalize.
+static inline vec3 QuantizeUnitVector(const vec3& v, int bits) {
+  const float steps = static_cast<float>((1 << (bits - 1)) - 1);
+  const vec3 q(std::round(v.x * steps) + 0.0f, std::round(v.y * steps) + 0.0f,
+               std::round(v.z * steps) + 0.0f);
+  const float length = q.Length();
+  return length > 0.0f ? q / length : v;
+}
+
+void FlatMesh::QuantizeVertex(const VertexQuantization& q, Vertex* v) {
+  if (q.position_grid > 0.0f) {
+    for (int i = 0; i < 3; ++i) {
+      v->vertex.data[i] = Snap(v->vertex.data[i], q.position_grid);
+    }
+  }
+  if (q.normal_bits > 0) {
+    const vec3 normal(v->normal);
+    if (normal.LengthSquared() > 0.0f) {
+      v->normal = QuantizeUnitVector(normal, q.normal_bits);
+    }
+    const vec4 tangent(v->tangent);
+    if (tangent.xyz().LengthSquared() > 0.0f) {
+      v->tangent = vec4(QuantizeUnitVector(tangent.xyz(), q.normal_bits),
+                        tangent.w);
+    }
+  }
+  if (q.uv_grid > 0.0f) {
+    for (int i = 0; i < 2; ++i) {
+      v->uv.data[i] = Snap(v->uv.data[i], q.uv_grid);
+      v->uv_alt.data[i] = Snap(v->uv_alt.data[i], q.uv_grid);
+    }
+  }
+}
+
+void FlatMesh::GenerateTangentFrames() {
+  if (vertex_attributes_ == kVertexAttributeBit_AllAttributesInSourceFile ||
+      (vertex_attributes_ & kTangentFrameBits) == 0 || points_.empty()) {
+    return;
+  }
+
+  // Handedness is +1 or -1, so a zero handedness marks a vertex whose source
+  // had no tangent.
+  size_t num_missing = 0;
+  for (size_t i = 0; i < points_.size(); ++i) {
+    if (points_[i].tangent.data[3] == 0.0f) num_missing++;
+  }
+  if (num_missing > 0) {
+    const VertexAttributeBitmask required =
+        kVertexAttributeBit_Normal | kVertexAttributeBit_Uv;
+    if ((mesh_vertex_attributes_ & required) != required) {
+      log_.Log(kLogWarning,
+               "Can't generate tangents for a mesh without normals and "
+               "UVs.\n");
+      return;
+    }
+
+    // Generate tangents over all surfaces at once, so that vertices shared
+    // by several surfaces are consistent.
+    IndexBuffer indices;
+    for (auto it = surfaces_.begin(); it != surfaces_.end(); ++it) {
+      indices.insert(indices.end(), it->second.begin(), it->second.end());
+    }
+    TangentSpaceMesh mesh;
+    mesh.positions = VertexAttributeView(&points_[0].vertex, sizeof(Vertex));
+    mesh.normals = VertexAttributeView(&points_[0].normal, sizeof(Vertex));
+    mesh.uvs = VertexAttributeView(&points_[0].uv, sizeof(Vertex));
+    mesh.num_vertices = points_.size();
+    mesh.indices32 = indices.data();
+    mesh.num_indices = indices.size();
+    std::vector<vec4_packed> tangents(indices.size());
+    GenerateCornerTangents(mesh, tangents.data(), ParallelFor);
+
+    // Vertices were deduplicated before they had tangents, so a vertex on a
+    // mirrored UV seam is shared by corners of both handedness. The first
+    // tangent a vertex gets is stored in place; the other goes to a copy.
+    static const VertIndex kNoCopy = static_cast<VertIndex>(-1);
+    const size_t num_points = points_.size();
+    std::vector<bool> assigned(num_points, false);
+    std::vector<VertIndex> copies(num_points, kNoCopy);
+    size_t corner = 0;
+    for (auto it = surfaces_.begin(); it != surfaces_.end(); ++it) {
+      IndexBuffer& surface_indices = it->second;
+      for (size_t i = 0; i < surface_indices.size(); ++i, ++corner) {
+        const VertIndex index = surface_indices[i];
+        if (points_[index].tangent.data[3] != 0.0f && !assigned[index]) {
+          continue;  // The source had a tangent.
+        }
+        const vec4_packed& tangent = tangents[corner];
+        if (!assigned[index]) {
+          points_[index].tangent = tangent;
+          assigned[index] = true;
+        } else if (memcmp(&points_[index].tangent, &tangent,
+                          sizeof(tangent)) != 0) {
+          if (copies[index] == kNoCopy) {
+            Vertex copy = points_[index];
+            copy.tangent = tangent;
+            copies[index] = static_cast<VertIndex>(points_.size());
+            points_.push_back(copy);
+          }
+          surface_indices[i] = copies[index];
+        }
+      }
+    }
+    log_.Log(kLogInfo,
+             "Generated tangents for %d of %d vertices, splitting %d at "
+             "mirrored UV seams\n",
+             static_cast<int>(num_missing), static_cast<int>(num_points),
+             static_cast<int>(points_.size() - num_points));
+    num_seam_copies_ += points_.size() - num_points;
+  }
+
+  // Orientations are calculated once per unique vertex.
+  if (vertex_attributes_ & kVertexAttributeBit_Orientation) {
+    for (size_t i = 0; i < points_.size(); ++i) {
+      Vertex& p = points_[i];
+      p.orientation = CalculateOrientation(vec3(p.normal), vec4(p.tangent));
+    }
+  }
+  mesh_vertex_attributes_ |= vertex_attributes_ & kTangentFrameBits;
+}
+
+void FlatMesh::AppendSurfaceChunks(std::vector<SurfaceChunk>* chunks) {
+  // Insert each chunk's unique vertices into `unique_`, in chunk order, so
+  // that vertex indices match those of a single-threaded gather. Only unique
+  // vertices are visited here, using the hashes computed by the chunks.
+  std::vector<std::vector<VertIndex>> remaps(chunks->size());
+  for (size_t c = 0; c < chunks->size(); ++c) {
+    SurfaceChunk& chunk = (*chunks)[c];
+    std::vector<VertIndex>& remap = remaps[c];
+    remap.resize(chunk.vertices_.size());
+    points_.reserve(points_.size() + chunk.vertices_.size());
+    for (size_t i = 0; i < chunk.vertices_.size(); ++i) {
+      points_.push_back(chunk.vertices_[i]);
+      const VertIndex new_index = static_cast<VertIndex>(points_.size() - 1);
+      const VertIndex index = unique_.FindOrInsertHashed(
+          points_.data(), new_index, chunk.hashes_[i]);
+      if (index != new_index) points_.pop_back();
+      remap[i] = index;
+    }
+    log_.Log(kLogVerbose, "Surface chunk: %d indices, %d unique vertices\n",
+             static_cast<int>(chunk.indices_.size()),
+             static_cast<int>(chunk.vertices_.size()));
+
+    raw_hashes_.insert(chunk.raw_hashes_.begin(), chunk.raw_hashes_.end());
+
+    // The chunk's vertices and dedup table are no longer needed.
+    std::unordered_set<uint64_t>().swap(chunk.raw_hashes_);
+    std::vector<Vertex>().swap(chunk.vertices_);
+    std::vector<uint32_t>().swap(chunk.hashes_);
+    chunk.unique_ = VertexDedupTable();
+  }
+
+  // Translate the chunks' local indices into mesh indices.
+  ParallelFor(chunks->size(), [&](size_t c) {
+    IndexBuffer& indices = (*chunks)[c].indices_;
+    const std::vector<VertIndex>& remap = remaps[c];
+    for (size_t i = 0; i < indices.size(); ++i) indices[i] = remap[indices[i]];
+  });
+
+  // Append to the surfaces in order.
+  for (size_t c = 0; c < chunks->size(); ++c) {
+    SurfaceChunk& chunk = (*chunks)[c];
+    SetSurface(chunk.textures_);
+    ReportSurfaceVertexAttributes(chunk.surface_vertex_attributes_);
+    cur_index_buf_->insert(cur_index_buf_->end(), chunk.indices_.begin(),
+                           chunk.indices_.end());
+  }
+  chunks->clear();
+}
+
+void FlatMesh::PartitionSurfaces(
+    int max_palette_size, const std::vector<BoneIndex>& mesh_to_shader_bones,
+    SubSurfaces* out) const {
+  out->surfaces.clear();
+  out->vertex_points.clear();
+  out->vertex_surfaces.clear();
+  out->partitioned = max_palette_size > 0;
+
+  // Without partitioning, output the surfaces and vertices unchanged.
+  if (!out->partitioned) {
+    out->vertex_points.resize(points_.size());
+    for (size_t i = 0; i < points_.size(); ++i) {
+      out->vertex_points[i] = static_cast<VertIndex>(i);
+    }
+    size_t surface_idx = 0;
+    for (auto it = surfaces_.begin(); it != surfaces_.end(); ++it) {
+      out->surfaces.push_back(SubSurface());
+      SubSurface& sub_surface = out->surfaces.back();
+      sub_surface.textures = &it->first;
+      sub_surface.surface_idx = surface_idx++;
+      sub_surface.indices = it->second;
+    }
+    return;
+  }
+
+  // Every triangle must fit in a palette on its own.
+  assert(max_palette_size >= kMinBonesPerSurface);
+  const size_t palette_max = static_cast<size_t>(max_palette_size);
+
+  // The output vertex of each point in the current sub-surface. Only valid
+  // when `point_surfaces` matches the current sub-surface.
+  static const uint32_t kNoSurface = 0xFFFFFFFF;
+  std::vector<VertIndex> point_vertices(points_.size());
+  std::vector<uint32_t> point_surfaces(points_.size(), kNoSurface);
+  out->vertex_points.reserve(points_.size());
+  out->vertex_surfaces.reserve(points_.size());
+
+  size_t surface_idx = 0;
+  for (auto it = surfaces_.begin(); it != surfaces_.end();
+       ++it, ++surface_idx) {
+    const IndexBuffer& index_buf = it->second;
+    uint32_t cur = kNoSurface;
+
+    // Greedily add triangles, in their original order, to the current
+    // sub-surface until one would overflow the palette. Neighboring
+    // triangles tend to share bones, so this keeps palettes small.
+    for (size_t t = 0; t < index_buf.size(); t += 3) {
+      // Gather the bones the triangle needs that aren't in the palette.
+      BoneIndex new_bones[3 * SkinBinding::kInfluenceMax];
+      size_t num_new_bones = 0;
+      for (int pass = 0; pass < 2; ++pass) {
+        num_new_bones = 0;
+        for (size_t k = 0; k < 3; ++k) {
+          const BoneIndex* bone_indices =
+              points_[index_buf[t + k]].skin_binding.GetBoneIndices();
+          for (unsigned int j = 0; j < SkinBinding::kInfluenceMax; ++j) {
+            const BoneIndex bone = bone_indices[j];
+            if (bone == SkinBinding::kNoBoneIndex) break;
+            const bool in_palette =
+                cur != kNoSurface &&
+                out->surfaces[cur].mesh_to_palette_bones[bone] !=
+                    kInvalidBoneIdx;
+            if (in_palette ||
+                std::find(new_bones, new_bones + num_new_bones, bone) !=
+                    new_bones + num_new_bones) {
+              continue;
+            }
+            new_bones[num_new_bones++] = bone;
+          }
+        }
+
+        // Start a new sub-surface if the palette would overflow.
+        const bool overflow =
+            cur != kNoSurface &&
+            out->surfaces[cur].palette.size() + num_new_bones > palette_max;
+        if (cur != kNoSurface && !overflow) break;
+        cur = static_cast<uint32_t>(out->surfaces.size());
+        out->surfaces.push_back(SubSurface());
+        SubSurface& sub_surface = out->surfaces.back();
+        sub_surface.textures = &it->first;
+        sub_surface.surface_idx = surface_idx;
+        sub_surface.mesh_to_palette_bones.assign(bones_.size(),
+                                                 kInvalidBoneIdx);
+        // The palette is empty now, so the second pass gathers every bone.
+      }
+
+      SubSurface& sub_surface = out->surfaces[cur];
+      for (size_t j = 0; j < num_new_bones; ++j) {
+        const BoneIndex bone = new_bones[j];
+        sub_surface.mesh_to_palette_bones[bone] =
+            static_cast<BoneIndex>(sub_surface.palette.size());
+        sub_surface.palette.push_back(mesh_to_shader_bones[bone]);
+      }
+
+      // Add the triangle, duplicating vertices that are already used by
+      // another sub-surface.
+      for (size_t k = 0; k < 3; ++k) {
+        const VertIndex point = index_buf[t + k];
+        if (point_surfaces[point] != cur) {
+          point_surfaces[point] = cur;
+          point_vertices[point] =
+              static_cast<VertIndex>(out->vertex_points.size());
+          out->vertex_points.push_back(point);
+          out->vertex_surfaces.push_back(cur);
+        }
+        sub_surface.indices.push_back(point_vertices[point]);
+      }
+    }
+  }
+
+  // Vertices without influences are packed with bone index 0, so make sure
+  // every palette has an entry for them.
+  for (size_t i = 0; i < out->surfaces.size(); ++i) {
+    SubSurface& sub_surface = out->surfaces[i];
+    if (sub_surface.palette.empty()) sub_surface.palette.push_back(0);
+  }
+
+  log_.Log(kLogInfo,
+           "  Partitioned %d surfaces into %d with at most %d bones each;"
+           " %d of %d vertices duplicated\n",
+           static_cast<int>(surfaces_.size()),
+           static_cast<int>(out->surfaces.size()), max_palette_size,
+           static_cast<int>(out->vertex_points.size() - points_.size()),
+           static_cast<int>(points_.size()));
+}
+
+}  // namespace fplbase
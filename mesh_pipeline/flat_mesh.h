@@ -0,0 +1,1461 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Importer-independent mesh representation. Every source format (FBX, glTF,
+// OBJ) is gathered into a FlatMesh, which then writes the .fplmesh and
+// .fplmat files.
+
+#ifndef FPLBASE_MESH_PIPELINE_FLAT_MESH_H_
+#define FPLBASE_MESH_PIPELINE_FLAT_MESH_H_
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "common_generated.h"
+#include "fplbase/fpl_common.h"
+#include "fplbase/tangent_space.h"
+#include "fplutil/file_utils.h"
+#include "materials_generated.h"
+#include "build_cache.h"
+#include "mathfu/constants.h"
+#include "mathfu/glsl_mappings.h"
+#include "mesh_generated.h"
+#include "mesh_pipeline.h"
+#include "vertex_dedup.h"
+
+namespace fplbase {
+
+using mathfu::vec2;
+using mathfu::vec3;
+using mathfu::vec4;
+using mathfu::mat3;
+using mathfu::mat4;
+using mathfu::quat;
+using mathfu::vec2_packed;
+using mathfu::vec3_packed;
+using mathfu::vec4_packed;
+using mathfu::kZeros2f;
+using mathfu::kZeros3f;
+using mathfu::kZeros4f;
+
+static inline Vec4 FlatBufferVec4(const vec4& v) {
+  return Vec4(v.x, v.y, v.z, v.w);
+}
+
+static inline Vec3 FlatBufferVec3(const vec3& v) { return Vec3(v.x, v.y, v.z); }
+
+static inline Vec2 FlatBufferVec2(const vec2& v) { return Vec2(v.x, v.y); }
+
+static inline Vec4ub FlatBufferVec4ub(const vec4& v) {
+  const vec4 scaled =
+      static_cast<float>(std::numeric_limits<uint8_t>::max()) * v;
+  return Vec4ub(static_cast<uint8_t>(scaled.x), static_cast<uint8_t>(scaled.y),
+                static_cast<uint8_t>(scaled.z), static_cast<uint8_t>(scaled.w));
+}
+
+static inline Mat3x4 FlatBufferMat3x4(const mat4& matrix) {
+  const mat4 m = matrix.Transpose();
+  return Mat3x4(Vec4(m(0), m(1), m(2), m(3)), Vec4(m(4), m(5), m(6), m(7)),
+                Vec4(m(8), m(9), m(10), m(11)));
+}
+
+static inline void LogVertexAttributes(VertexAttributeBitmask attributes,
+                                const char* header, LogLevel level,
+                                Logger* log) {
+  log->Log(level, "%s", header);
+  for (int i = 0; i < kVertexAttribute_Count; ++i) {
+    const int i_bit = 1 << i;
+    if (attributes & i_bit) {
+      const bool prev_attribute_exists = (attributes & (i_bit - 1)) != 0;
+      log->Log(level, "%s%s", prev_attribute_exists ? ", " : "",
+               kVertexAttributeShortNames[i]);
+    }
+  }
+  log->Log(level, "\n");
+}
+
+// Call `fn(i)` for every `i` in [0, `count`), spread over the hardware
+// threads. Items are claimed in increasing order, so put the most expensive
+// ones first.
+void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+// Use at most `num_threads` threads in ParallelFor(), or one per hardware
+// thread if `num_threads` is 0, which is the default.
+void SetParallelForThreads(int num_threads);
+
+// Try variations of `texture_name` until we find one on disk. Relative names
+// are resolved against the directory of `source_mesh_name`. Returns "" if no
+// variation exists.
+std::string FindSourceTextureFileName(const std::string& source_mesh_name,
+                                      const std::string& texture_name,
+                                      Logger& log);
+
+// Used for skinning, this maps a vertex to a weighted set of bones.
+class SkinBinding {
+ public:
+  typedef uint16_t BoneIndex;
+  typedef uint8_t PackedBoneIndex;
+  typedef uint8_t PackedWeight;
+  static const unsigned int kInfluenceMax = 4;
+  static const BoneIndex kNoBoneIndex = 0xffff;
+  static const BoneIndex kBoneIndexMax = 0xfffe;
+  static const PackedBoneIndex kPackedBoneIndexMax = 0xff;
+  static const PackedWeight kPackedWeightOne = 0xff;
+
+  SkinBinding() { Clear(); }
+
+  const BoneIndex* GetBoneIndices() const { return bone_indices_; }
+  const float* GetBoneWeights() const { return bone_weights_; }
+
+  void Clear() {
+    for (unsigned int influence_index = 0; influence_index != kInfluenceMax;
+         ++influence_index) {
+      bone_indices_[influence_index] = kNoBoneIndex;
+    }
+    for (unsigned int influence_index = 0; influence_index != kInfluenceMax;
+         ++influence_index) {
+      bone_weights_[influence_index] = 0.0f;
+    }
+  }
+
+  bool HasInfluences() const { return bone_indices_[0] != kNoBoneIndex; }
+
+  unsigned int CountInfluences() const {
+    for (unsigned int influence_index = 0; influence_index != kInfluenceMax;
+         ++influence_index) {
+      if (bone_indices_[influence_index] == kNoBoneIndex)
+        return influence_index;
+    }
+    return kInfluenceMax;
+  }
+
+  void AppendInfluence(unsigned int bone_index, float bone_weight, Logger& log,
+                       const char* log_mesh_name,
+                       unsigned int log_vertex_index) {
+    unsigned int influence_count = CountInfluences();
+
+    // Discard the smallest influence if we reach capacity.
+    if (influence_count == kInfluenceMax) {
+      const unsigned int smallest_influence_index =
+          FindSmallestInfluence(influence_count);
+      const float smallest_bone_weight =
+          bone_weights_[smallest_influence_index];
+      if (smallest_bone_weight < bone_weight) {
+        // Existing influence is the smallest.
+        const BoneIndex smallest_bone_index =
+            bone_indices_[smallest_influence_index];
+        EraseInfluence(influence_count, smallest_influence_index);
+        --influence_count;
+        log.Log(kLogWarning,
+                "Too many skin influences (max=%u) for mesh %s vertex %u."
+                " Discarding the smallest influence (%f) to bone %u.\n",
+                kInfluenceMax, log_mesh_name, log_vertex_index,
+                smallest_bone_weight, smallest_bone_index);
+      } else {
+        // New influence is the smallest.
+        log.Log(kLogWarning,
+                "Too many skin influences (max=%u) for mesh %s vertex %u."
+                " Discarding the smallest influence (%f) to bone %u.\n",
+                kInfluenceMax, log_mesh_name, log_vertex_index,
+                bone_weight, bone_index);
+        return;
+      }
+    }
+
+    // Append the influence.
+    assert(bone_index <= kBoneIndexMax);
+    bone_indices_[influence_count] = static_cast<BoneIndex>(bone_index);
+    bone_weights_[influence_count] = bone_weight;
+  }
+
+  // Set the vertex to single-bone rigid binding.
+  void BindRigid(BoneIndex bone_index) {
+    Clear();
+    bone_indices_[0] = bone_index;
+    bone_weights_[0] = 1.0f;
+  }
+
+  // Normalize weights to sum to 1.0.
+  void NormalizeBoneWeights() {
+    unsigned int influence_count = 0;
+    float bone_weight_sum = 0.0f;
+    for (; influence_count != kInfluenceMax; ++influence_count) {
+      if (bone_indices_[influence_count] == kNoBoneIndex) break;
+      bone_weight_sum += bone_weights_[influence_count];
+    }
+
+    if (influence_count == 0) {
+      // Vertex not weighted to any bone.  Set full weighting to the origin.
+      bone_weights_[0] = 1.0f;
+    } else if (bone_weight_sum == 0.0f) {
+      // Weights sum to 0.  Probably shouldn't happen, but if it does just
+      // evenly distribute weights.
+      const float bone_weight = 1.0f / static_cast<float>(influence_count);
+      for (unsigned int influence_index = 0; influence_index != kInfluenceMax;
+           ++influence_index) {
+        bone_weights_[influence_index] = bone_weight;
+      }
+    } else {
+      // Scale weights so they sum to 1.0.
+      const float scale = 1.0f / bone_weight_sum;
+      for (unsigned int influence_index = 0; influence_index != kInfluenceMax;
+           ++influence_index) {
+        bone_weights_[influence_index] *= scale;
+      }
+    }
+  }
+
+  // Pack indices and weights to 8-bit components, remapping indices with
+  // src_to_dst_index_map.
+  void Pack(const BoneIndex* src_to_dst_index_map, size_t src_bone_count,
+            Logger& log, const char* log_mesh_name,
+            unsigned int log_vertex_index, Vec4ub* out_packed_indices,
+            Vec4ub* out_packed_weights) const {
+    PackedBoneIndex packed_indices[4] = {0, 0, 0, 0};
+    PackedWeight packed_weights[4] = {0, 0, 0, 0};
+
+    const float src_to_dst_scale = static_cast<float>(kPackedWeightOne);
+    unsigned int dst_weight_remain = kPackedWeightOne;
+    for (unsigned int influence_index = 0; influence_index != kInfluenceMax;
+         ++influence_index) {
+      const BoneIndex src_index = bone_indices_[influence_index];
+      if (src_index == kNoBoneIndex) {
+        break;
+      }
+      assert(src_index < src_bone_count);
+
+      // This bone is referenced, so it shouldn't have been pruned.
+      const BoneIndex dst_index = src_to_dst_index_map[src_index];
+      assert(dst_index != kNoBoneIndex);
+
+      if (dst_index > kPackedBoneIndexMax) {
+        log.Log(kLogWarning,
+                "Bone index %u exceeds %u."
+                " Discarding skin weight for mesh %s vertex %u.\n",
+                dst_index, kPackedBoneIndexMax, log_mesh_name,
+                log_vertex_index);
+        break;
+      }
+
+      // Pack weight, quantizing from float to byte.  The weight is rounded, and
+      // we keep track of the total weight remaining so we can distribute
+      // quantization error between weights at the end.
+      const float src_weight = bone_weights_[influence_index];
+      const float dst_weight = src_weight * src_to_dst_scale;
+      const unsigned int dst_weight_rounded = std::min(
+          static_cast<unsigned int>(dst_weight + 0.5f), dst_weight_remain);
+      dst_weight_remain -= dst_weight_rounded;
+
+      packed_indices[influence_index] = static_cast<PackedBoneIndex>(dst_index);
+      packed_weights[influence_index] =
+          static_cast<PackedWeight>(dst_weight_rounded);
+    }
+
+    // Distribute quantization error between weights, so they sum to 255.
+    for (; dst_weight_remain; --dst_weight_remain) {
+      // Choose the weight to which adding 1 minimizes error.
+      unsigned int best_influence_index = 0;
+      float diff_min = FLT_MAX;
+      for (unsigned int influence_index = 0; influence_index != kInfluenceMax;
+           ++influence_index) {
+        if (bone_indices_[influence_index] == kNoBoneIndex) {
+          break;
+        }
+        const float src_weight = bone_weights_[influence_index];
+        const float dst_weight =
+            static_cast<float>(packed_weights[influence_index] + 1);
+        const float diff = dst_weight - src_weight * src_to_dst_scale;
+        if (diff < diff_min) {
+          best_influence_index = influence_index;
+          diff_min = diff;
+        }
+      }
+      packed_weights[best_influence_index] += 1;
+    }
+
+    *out_packed_indices = Vec4ub(packed_indices[0], packed_indices[1],
+                                 packed_indices[2], packed_indices[3]);
+    *out_packed_weights = Vec4ub(packed_weights[0], packed_weights[1],
+                                 packed_weights[2], packed_weights[3]);
+  }
+
+ private:
+  BoneIndex bone_indices_[kInfluenceMax];
+  float bone_weights_[kInfluenceMax];
+
+  // Find the smallest influence.  If there are multiple smallest influences,
+  // this returns the one nearest the end of the array (i.e. most recently
+  // added).
+  unsigned int FindSmallestInfluence(unsigned int influence_count) const {
+    assert(influence_count > 0);
+    unsigned int smallest_influence_index = 0;
+    for (unsigned int influence_index = 1; influence_index != influence_count;
+         ++influence_index) {
+      if (bone_weights_[influence_index] <=
+          bone_weights_[smallest_influence_index]) {
+        smallest_influence_index = influence_index;
+      }
+    }
+    return smallest_influence_index;
+  }
+
+  // Erase an influence, preserving the order of the remaining influences.
+  void EraseInfluence(unsigned int influence_count,
+                      unsigned int influence_index) {
+    assert(influence_index < influence_count);
+    const unsigned int last_influence_index = influence_count - 1;
+    for (; influence_index != last_influence_index; ++influence_index) {
+      bone_indices_[influence_index] = bone_indices_[influence_index + 1];
+      bone_weights_[influence_index] = bone_weights_[influence_index + 1];
+    }
+    bone_indices_[last_influence_index] = kNoBoneIndex;
+    bone_weights_[last_influence_index] = 0.0f;
+  }
+};
+
+class FlatTextures {
+ public:
+  size_t Count() const { return textures_.size(); }
+  void Append(const std::string& texture) { textures_.push_back(texture); }
+
+  // Access the ith texture.
+  const std::string& operator[](size_t i) const {
+    assert(0 <= i && i < Count());
+    return textures_[i];
+  }
+
+  // Required for std::unordered_set.
+  bool operator==(const FlatTextures& rhs) const {
+    if (Count() != rhs.Count()) return false;
+    for (size_t i = 0; i < Count(); ++i) {
+      if (textures_[0] != rhs.textures_[0]) return false;
+    }
+    return true;
+  }
+
+ private:
+  std::vector<std::string> textures_;
+};
+
+// Required for std::unordered_set. Only compare the primary texture.
+class FlatTextureHash {
+ public:
+  size_t operator()(const FlatTextures& t) const {
+    size_t hash = 0;
+    for (size_t i = 0; i < t.Count(); ++i) {
+      hash ^= std::hash<std::string>()(t[i]);
+    }
+    return hash;
+  }
+};
+
+class FlatMesh {
+ public:
+  // The smallest bone palette that can hold any triangle's bones.
+  static const int kMinBonesPerSurface = 3 * SkinBinding::kInfluenceMax;
+
+  explicit FlatMesh(int max_verts, VertexAttributeBitmask vertex_attributes,
+                    Logger& log)
+      : unique_(max_verts),
+        cur_index_buf_(nullptr),
+        mesh_vertex_attributes_(0),
+        vertex_attributes_(vertex_attributes),
+        num_seam_copies_(0),
+        log_(log) {
+    points_.reserve(max_verts);
+  }
+
+  // Round vertex attributes to `quantization` before they are deduplicated.
+  // Call before gathering.
+  void set_quantization(const VertexQuantization& quantization) {
+    quantization_ = quantization;
+  }
+
+  // Make room for `max_verts` unique vertices, once the source is loaded and
+  // the count is known.
+  void Reserve(int max_verts) {
+    unique_.Reserve(max_verts);
+    points_.reserve(max_verts);
+  }
+
+  unsigned int AppendBone(const char* bone_name,
+                          const mat4& default_bone_transform_inverse,
+                          int parent_bone_index) {
+    const unsigned int bone_index = static_cast<unsigned int>(bones_.size());
+    bones_.push_back(
+        Bone(bone_name, default_bone_transform_inverse, parent_bone_index));
+    return bone_index;
+  }
+
+  void SetSurface(const FlatTextures& textures) {
+    // Grab existing surface for `texture_file_name`, or create a new one.
+    IndexBuffer& index_buffer = surfaces_[textures];
+
+    // Update the current index buffer to which we're logging control points.
+    cur_index_buf_ = &index_buffer;
+
+    // Log the surface switch.
+    log_.Log(kLogVerbose, "Surface:");
+    for (size_t i = 0; i < textures.Count(); ++i) {
+      log_.Log(kLogVerbose, " %s", textures[i].c_str());
+    }
+    log_.Log(kLogVerbose, "\n");
+  }
+
+  void ReportSurfaceVertexAttributes(
+      VertexAttributeBitmask surface_vertex_attributes) {
+    // Warn when some surfaces have requested attributes but others do not.
+    const VertexAttributeBitmask missing_attributes =
+        vertex_attributes_ & mesh_vertex_attributes_ &
+        ~surface_vertex_attributes;
+    if (missing_attributes) {
+      LogVertexAttributes(
+          missing_attributes,
+          "Surface missing vertex attributes that are in previous surfaces: ",
+          kLogWarning, &log_);
+    }
+
+    // Remember which attributes exist so that we can output only those that
+    // we recorded, if so requested.
+    mesh_vertex_attributes_ |= surface_vertex_attributes;
+  }
+
+  // Populate a single surface with data from FBX arrays. `tangent` is zero
+  // if the source has none; see GenerateTangentFrames().
+  void AppendPolyVert(const vec3& vertex, const vec3& normal,
+                      const vec4& tangent, const vec4& color, const vec2& uv,
+                      const vec2& uv_alt, const SkinBinding& skin_binding) {
+    points_.push_back(Vertex(vertex_attributes_, vertex, normal, tangent,
+                             color, uv, uv_alt, skin_binding));
+    if (quantization_.enabled()) {
+      raw_hashes_.insert(HashPod(points_.back()));
+      QuantizeVertex(quantization_, &points_.back());
+    }
+
+    // `unique_` holds indices into `points_`, and hashes every byte of the
+    // vertex, so `points_` may grow freely.
+    const VertIndex new_index = static_cast<VertIndex>(points_.size() - 1);
+    const VertIndex index = unique_.FindOrInsert(points_.data(), new_index);
+    const bool new_control_point_created = index == new_index;
+
+    // We recycled an existing point, so we can remove the one we added with
+    // push_back().
+    if (!new_control_point_created) {
+      points_.pop_back();
+    }
+
+    // Append index of polygon point.
+    cur_index_buf_->push_back(index);
+
+    // Log the data we just added.
+    if (log_.level() <= kLogVerbose) {
+      log_.Log(kLogVerbose, "Point: index %d", index);
+      if (new_control_point_created) {
+        const VertexAttributeBitmask attributes =
+            vertex_attributes_ & mesh_vertex_attributes_;
+        if (attributes & kVertexAttributeBit_Position) {
+          log_.Log(kLogVerbose, ", vertex (%.3f, %.3f, %.3f)", vertex.x,
+                   vertex.y, vertex.z);
+        }
+        if (attributes & kVertexAttributeBit_Normal) {
+          log_.Log(kLogVerbose, ", normal (%.3f, %.3f, %.3f)", normal.x,
+                   normal.y, normal.z);
+        }
+        if (attributes & kVertexAttributeBit_Tangent) {
+          log_.Log(kLogVerbose,
+                   ", tangent (%.3f, %.3f, %.3f) binormal-handedness %.0f",
+                   tangent.x, tangent.y, tangent.z, tangent.w);
+        }
+        if (attributes & kVertexAttributeBit_Uv) {
+          log_.Log(kLogVerbose, ", uv (%.3f, %.3f)", uv.x, uv.y);
+        }
+        if (attributes & kVertexAttributeBit_UvAlt) {
+          log_.Log(kLogVerbose, ", uv-alt (%.3f, %.3f)", uv_alt.x, uv_alt.y);
+        }
+        if (attributes & kVertexAttributeBit_Color) {
+          log_.Log(kLogVerbose, ", color (%.3f, %.3f, %.3f, %.3f)", color.x,
+                   color.y, color.z, color.w);
+        }
+        if (attributes & kVertexAttributeBit_Bone) {
+          const BoneIndex* const bone_indices = skin_binding.GetBoneIndices();
+          const float* const bone_weights = skin_binding.GetBoneWeights();
+          log_.Log(kLogVerbose, ", skin (%u:%.3f, %u:%.3f, %u:%.3f, %u:%.3f)",
+                   bone_indices[0], bone_weights[0], bone_indices[1],
+                   bone_weights[1], bone_indices[2], bone_weights[2],
+                   bone_indices[3], bone_weights[3]);
+        }
+      }
+      log_.Log(kLogVerbose, "\n");
+    }
+  }
+
+  // The vertices and indices of one surface, deduplicated locally. Chunks can
+  // be gathered on separate threads and merged with AppendSurfaceChunks().
+  class SurfaceChunk;
+
+  // Complete the tangent frames of the gathered vertices. Vertices whose
+  // source had no tangents get MikkTSpace-style tangents generated from their
+  // surfaces' triangles, normals and UVs, and are split where triangles of
+  // opposite handedness meet. Orientations are then calculated
+  // from every vertex's normal and tangent. Does nothing unless tangents or
+  // orientations were requested explicitly. Call after gathering.
+  void GenerateTangentFrames();
+
+  // Merge `chunks` into the mesh, in order. The result is identical to
+  // calling SetSurface() and AppendPolyVert() for each chunk's poly verts,
+  // but each unique vertex is only hashed once, on the thread that gathered
+  // it. The chunks are consumed.
+  void AppendSurfaceChunks(std::vector<SurfaceChunk>* chunks);
+
+  // Output material and mesh flatbuffers for the gathered surfaces.
+  bool OutputFlatBuffer(
+      const std::string& mesh_name_unformated,
+      const std::string& assets_base_dir_unformated,
+      const std::string& assets_sub_dir_unformated,
+      const std::string& texture_extension,
+      const std::vector<matdef::TextureFormat>& texture_formats,
+      matdef::BlendMode blend_mode, bool interleaved, bool force32,
+      bool embed_materials, int max_bones_per_surface,
+      std::vector<std::string>* output_files) const {
+    // Ensure directory names end with a slash.
+    const std::string mesh_name = fplutil::BaseFileName(mesh_name_unformated);
+    const std::string assets_base_dir =
+        fplutil::FormatAsDirectoryName(assets_base_dir_unformated);
+    const std::string assets_sub_dir =
+        fplutil::FormatAsDirectoryName(assets_sub_dir_unformated);
+
+    // Ensure output directory exists.
+    const std::string assets_dir = assets_base_dir + assets_sub_dir;
+    if (!fplutil::CreateDirectory(assets_dir.c_str())) {
+      log_.Log(kLogError, "Could not create output directory %s\n",
+               assets_dir.c_str());
+      return false;
+    }
+
+    // Output bone hierarchy.
+    LogBones();
+
+    if (!embed_materials) {
+      // Create material files that reference the textures.
+      const bool materials_status = OutputMaterialFlatBuffers(
+          mesh_name, assets_base_dir, assets_sub_dir, texture_extension,
+          texture_formats, blend_mode, output_files);
+      if (!materials_status) return false;
+    }
+
+    // Create final mesh file that references materials relative to
+    // `assets_base_dir`.
+    const bool mesh_status = OutputMeshFlatBuffer(
+        mesh_name, assets_base_dir, assets_sub_dir, texture_extension,
+        texture_formats, blend_mode, interleaved, force32, embed_materials,
+        max_bones_per_surface, output_files);
+    if (!mesh_status) return false;
+
+    // Log summary
+    log_.Log(kLogImportant, "  %s (%d vertices, %d triangles)\n",
+             (mesh_name + '.' + meshdef::MeshExtension()).c_str(),
+             points_.size(), NumTriangles());
+    if (quantization_.enabled() && !raw_hashes_.empty()) {
+      const int merged = NumVerticesMergedByQuantization();
+      log_.Log(kLogImportant,
+               "  Quantization merged %d vertices (%d to %d, %.1f%% fewer)\n",
+               merged, static_cast<int>(raw_hashes_.size()),
+               static_cast<int>(NumGatheredVertices()),
+               100.0 * merged / raw_hashes_.size());
+    }
+    return true;
+  }
+
+  int NumVertices() const { return static_cast<int>(points_.size()); }
+
+  // The number of distinct vertices that quantization merged while
+  // gathering. Vertices split later, at mirrored UV seams, aren't counted.
+  int NumVerticesMergedByQuantization() const {
+    if (!quantization_.enabled()) return 0;
+    return static_cast<int>(raw_hashes_.size() - NumGatheredVertices());
+  }
+
+  int NumTriangles() const {
+    size_t num_indices = 0;
+    for (auto it = surfaces_.begin(); it != surfaces_.end(); ++it) {
+      const IndexBuffer& index_buf = it->second;
+      num_indices += index_buf.size();
+    }
+    return static_cast<int>(num_indices / 3);
+  }
+
+  static std::string RepeatCharacter(char c, int count) {
+    std::string s;
+    for (int i = 0; i < count; ++i) {
+      s += c;
+    }
+    return s;
+  }
+
+  void LogBones() const {
+    std::vector<BoneIndex> mesh_to_shader_bones;
+    std::vector<BoneIndex> shader_to_mesh_bones;
+    CalculateBoneIndexMaps(&mesh_to_shader_bones, &shader_to_mesh_bones);
+
+    log_.Log(kLogInfo, "Mesh hierarchy (bone indices in brackets):\n");
+    for (size_t j = 0; j < bones_.size(); ++j) {
+      const Bone& b = bones_[j];
+      std::string indent = RepeatCharacter(
+          ' ', 2 * BoneDepth(static_cast<int>(j)));
+
+      // Output bone name and index, indented to match the depth in the
+      // hierarchy.
+      const BoneIndex shader_bone = mesh_to_shader_bones[j];
+      const bool has_verts = shader_bone != kInvalidBoneIdx;
+      log_.Log(kLogInfo, "  %s[%d] %s", indent.c_str(), j, b.name.c_str());
+      if (has_verts) {
+        log_.Log(kLogInfo, " (shader bone %d)", shader_bone);
+      }
+      log_.Log(kLogInfo, "\n");
+
+      // Output global-to-local matrix transform too.
+      const mat4 t(b.default_bone_transform_inverse);
+      for (int k = 0; k < 3; ++k) {
+        log_.Log(kLogVerbose, "   %s  (%.3f, %.3f, %.3f, %.3f)\n",
+                 indent.c_str(), t(k, 0), t(k, 1), t(k, 2), t(k, 3));
+      }
+    }
+  }
+
+  void CalculateMinMaxPosition(vec3* min_position, vec3* max_position) const {
+    vec3 max(-FLT_MAX);
+    vec3 min(FLT_MAX);
+
+    // Loop through every vertex position.
+    // Note that vertex positions are always in object space.
+    for (size_t i = 0; i < points_.size(); ++i) {
+      const vec3 position = vec3(points_[i].vertex);
+      min = vec3::Min(min, position);
+      max = vec3::Max(max, position);
+    }
+
+    *min_position = min;
+    *max_position = max;
+  }
+
+ private:
+  FPL_DISALLOW_COPY_AND_ASSIGN(FlatMesh);
+  typedef SkinBinding::BoneIndex BoneIndex;
+  typedef uint8_t BoneIndexCompact;
+  typedef uint32_t VertIndex;
+  typedef uint16_t VertIndexCompact;
+  typedef std::vector<VertIndex> IndexBuffer;
+  typedef std::vector<VertIndexCompact> IndexBufferCompact;
+
+  // We use uint8_t for bone indices, and 0xFF marks invalid bones,
+  // so the limit is 254.
+  static const BoneIndex kMaxBoneIndex = SkinBinding::kPackedBoneIndexMax;
+  static const BoneIndex kInvalidBoneIdx = SkinBinding::kNoBoneIndex;
+  static const BoneIndexCompact kInvalidBoneIdxCompact = 0xFF;
+
+  // We use uint16_t for vertex indices. It's possible for a large mesh to have
+  // more vertices than that, so we output an error in that case.
+  static const VertIndex kMaxVertexIndex = 0xFFFF;
+  static const VertIndex kMaxNumPoints = kMaxVertexIndex + 1;
+
+  static const VertexAttributeBitmask kTangentFrameBits =
+      kVertexAttributeBit_Tangent | kVertexAttributeBit_Orientation;
+
+  struct Vertex {
+    vec3_packed vertex;
+    vec3_packed normal;
+    vec4_packed tangent;  // 4th element is handedness: +1 or -1
+    vec4_packed orientation;
+    vec2_packed uv;
+    vec2_packed uv_alt;
+    Vec4ub color;  // Use byte-format to ensure correct hashing.
+    SkinBinding skin_binding;
+    Vertex() : color(0, 0, 0, 0) {
+      // The Hash function operates on all the memory, so ensure everything is
+      // zero'd out.
+      memset(this, 0, sizeof(*this));
+      this->skin_binding = SkinBinding();
+    }
+    // Only record the attributes that we're asked to record. Ignore the rest.
+    // Orientations are calculated later, by GenerateTangentFrames(), from the
+    // normal, tangent and UVs, so those are kept if orientations are wanted.
+    Vertex(VertexAttributeBitmask attribs, const vec3& p, const vec3& n,
+           const vec4& t, const vec4& c, const vec2& u, const vec2& v,
+           const SkinBinding& skin_binding)
+        : vertex(attribs & kVertexAttributeBit_Position ? p : kZeros3f),
+          normal(attribs & (kVertexAttributeBit_Normal | kTangentFrameBits)
+                     ? n
+                     : kZeros3f),
+          tangent(attribs & kTangentFrameBits ? t : kZeros4f),
+          orientation(kZeros4f),
+          uv(attribs & (kVertexAttributeBit_Uv | kTangentFrameBits) ? u
+                                                                   : kZeros2f),
+          uv_alt(attribs & kVertexAttributeBit_UvAlt ? v : kZeros2f),
+          color(attribs & kVertexAttributeBit_Color ? FlatBufferVec4ub(c)
+                                                    : Vec4ub(0, 0, 0, 0)) {
+      if (attribs & kVertexAttributeBit_Bone) this->skin_binding = skin_binding;
+    }
+  };
+  static_assert(sizeof(Vertex) == 2 * sizeof(vec3_packed) +
+                                     2 * sizeof(vec4_packed) +
+                                     2 * sizeof(vec2_packed) + sizeof(Vec4ub) +
+                                     sizeof(SkinBinding),
+                "Vertex is hashed and compared bytewise, so cannot have "
+                "padding.");
+
+  struct Bone {
+    std::string name;
+    int parent_bone_index;
+    vec4_packed default_bone_transform_inverse[4];
+    Bone() : parent_bone_index(-1) {}
+    Bone(const char* name, const mat4& default_bone_transform_inverse,
+         int parent_bone_index)
+        : name(name), parent_bone_index(parent_bone_index) {
+      default_bone_transform_inverse.Pack(
+          this->default_bone_transform_inverse);
+    }
+  };
+
+  typedef std::unordered_map<FlatTextures, IndexBuffer, FlatTextureHash>
+      SurfaceMap;
+
+  // A run of one surface's triangles, as output to the mesh FlatBuffer.
+  struct SubSurface {
+    const FlatTextures* textures;
+    size_t surface_idx;  // Index of the surface in `surfaces_`.
+    IndexBuffer indices;  // Indices into SubSurfaces::vertex_points.
+    std::vector<BoneIndex> palette;  // Shader bones referenced by `indices`.
+    std::vector<BoneIndex> mesh_to_palette_bones;
+  };
+
+  // The surfaces and vertex order that are output to the mesh FlatBuffer.
+  struct SubSurfaces {
+    std::vector<SubSurface> surfaces;
+    std::vector<VertIndex> vertex_points;  // Output vertex to `points_` index.
+    std::vector<uint32_t> vertex_surfaces;  // Output vertex to `surfaces`.
+    bool partitioned;  // True if the vertices use palette bone indices.
+
+    // The map from mesh bones to the bone indices output for vertex `i`.
+    const BoneIndex* BoneMap(
+        size_t i, const std::vector<BoneIndex>& mesh_to_shader_bones) const {
+      return partitioned
+                 ? surfaces[vertex_surfaces[i]].mesh_to_palette_bones.data()
+                 : mesh_to_shader_bones.data();
+    }
+  };
+
+  // Round `v`'s attributes to `q`. Vertices that differ only by noise below
+  // the quantization become bytewise identical, so they deduplicate.
+  static void QuantizeVertex(const VertexQuantization& q, Vertex* v);
+
+  // The number of unique vertices gathered, before any were split at seams.
+  size_t NumGatheredVertices() const {
+    return points_.size() - num_seam_copies_;
+  }
+
+  // Split each surface into sub-surfaces that reference at most
+  // `max_palette_size` shader bones. Vertices used by several sub-surfaces
+  // are duplicated, since their bone indices are relative to the palette.
+  // If `max_palette_size` is 0, the surfaces and vertices are output as is.
+  void PartitionSurfaces(int max_palette_size,
+                         const std::vector<BoneIndex>& mesh_to_shader_bones,
+                         SubSurfaces* out) const;
+
+  static bool HasTexture(const FlatTextures& textures) {
+    return textures.Count() > 0;
+  }
+
+  static std::string TextureBaseFileName(const std::string& texture_file_name,
+                                         const std::string& assets_sub_dir) {
+    assert(texture_file_name != "");
+    return assets_sub_dir + fplutil::BaseFileName(texture_file_name);
+  }
+
+  static std::string TextureFileName(const std::string& texture_file_name,
+                                     const std::string& assets_sub_dir,
+                                     const std::string& texture_extension) {
+    const std::string extension =
+        texture_extension.length() == 0
+            ? fplutil::FileExtension(texture_file_name)
+            : texture_extension;
+    return TextureBaseFileName(texture_file_name, assets_sub_dir) + '.' +
+           extension;
+  }
+
+  std::string MaterialFileName(const std::string& mesh_name, size_t surface_idx,
+                               const std::string& assets_sub_dir) const {
+    std::string name = TextureBaseFileName(mesh_name, assets_sub_dir);
+    if (surfaces_.size() > 1) {
+      std::stringstream ss;
+      ss << "_" << surface_idx;
+      name += ss.str();
+    }
+    name += std::string(".") + matdef::MaterialExtension();
+    return name;
+  }
+
+  // Write the buffer to `file_name`, leaving the file untouched if it already
+  // holds the same data. Appends `file_name` to `output_files`.
+  bool OutputFlatBufferBuilder(const flatbuffers::FlatBufferBuilder& fbb,
+                               const std::string& file_name,
+                               std::vector<std::string>* output_files) const {
+    // TODO: Add option to write json file too.
+    bool changed;
+    if (!WriteFileIfChanged(file_name, fbb.GetBufferPointer(), fbb.GetSize(),
+                            log_, &changed)) {
+      return false;
+    }
+    output_files->push_back(file_name);
+    return true;
+  }
+
+  flatbuffers::Offset<matdef::Material> BuildMaterialFlatBuffer(
+      flatbuffers::FlatBufferBuilder& fbb, const std::string& assets_sub_dir,
+      const std::string& texture_extension,
+      const std::vector<matdef::TextureFormat>& texture_formats,
+      matdef::BlendMode blend_mode, const FlatTextures& textures) const {
+    // Create FlatBuffer arrays of texture names and formats.
+    std::vector<flatbuffers::Offset<flatbuffers::String>> textures_fb;
+    std::vector<uint8_t> formats_fb;
+    textures_fb.reserve(textures.Count());
+    formats_fb.reserve(textures.Count());
+    for (size_t i = 0; i < textures.Count(); ++i) {
+      // Output texture file name to array of file names.
+      const std::string texture_file_name =
+          TextureFileName(textures[i], assets_sub_dir, texture_extension);
+      textures_fb.push_back(fbb.CreateString(texture_file_name));
+
+      // Append texture format (a uint8) to array of texture formats.
+      const matdef::TextureFormat texture_format =
+          i < texture_formats.size() ? texture_formats[i]
+                                     : kDefaultTextureFormat;
+      formats_fb.push_back(static_cast<uint8_t>(texture_format));
+
+      // Log texture and format.
+      log_.Log(kLogInfo, "%s %s", i == 0 ? "" : ",",
+               fplutil::RemoveDirectoryFromName(texture_file_name).c_str());
+      if (texture_format != kDefaultTextureFormat) {
+        log_.Log(kLogInfo, "(%s)",
+                 matdef::EnumNameTextureFormat(texture_format));
+      }
+    }
+    log_.Log(kLogInfo, "\n");
+
+    // Create final material FlatBuffer.
+    auto textures_vector_fb = fbb.CreateVector(textures_fb);
+    auto formats_vector_fb = fbb.CreateVector(formats_fb);
+    auto material_fb = matdef::CreateMaterial(fbb, textures_vector_fb,
+                                              blend_mode, formats_vector_fb);
+    return material_fb;
+  }
+
+  VertIndex GetMaxIndex(const IndexBuffer& indices) const {
+    return indices.empty() ? 0
+                           : *std::max_element(indices.begin(), indices.end());
+  }
+
+  flatbuffers::Offset<meshdef::Mesh> BuildMeshFlatBuffer(
+      flatbuffers::FlatBufferBuilder& fbb, const std::string& mesh_name,
+      const std::string& assets_sub_dir, const std::string& texture_extension,
+      const std::vector<matdef::TextureFormat>& texture_formats,
+      matdef::BlendMode blend_mode, bool interleaved, bool force32,
+      bool embed_materials, int max_bones_per_surface) const {
+    const VertexAttributeBitmask attributes =
+        vertex_attributes_ == kVertexAttributeBit_AllAttributesInSourceFile
+            ? mesh_vertex_attributes_
+            : vertex_attributes_;
+    LogVertexAttributes(attributes, "  Vertex attributes: ", kLogInfo, &log_);
+
+    // Bone count is limited since we index with an 8-bit value.
+    const bool bone_overflow = bones_.size() > kMaxBoneIndex;
+    if (bone_overflow && (attributes & kVertexAttributeBit_Bone)) {
+      log_.Log(kLogError,
+               "Bone count %d exeeds maximum %d. "
+               "Verts weighted to bones beyond %d will instead be weighted"
+               " to bone 0.\n",
+               bones_.size(), kMaxBoneIndex, kMaxBoneIndex);
+    }
+
+    // Get the mapping from mesh bones (i.e. all bones in the model)
+    // to shader bones (i.e. bones that have verts weighted to them).
+    std::vector<BoneIndex> mesh_to_shader_bones;
+    std::vector<BoneIndex> shader_to_mesh_bones;
+    CalculateBoneIndexMaps(&mesh_to_shader_bones, &shader_to_mesh_bones);
+
+    // Split surfaces so that each references few enough bones to fit in the
+    // shader's bone array. The vertices are reordered (and possibly
+    // duplicated) to match.
+    SubSurfaces sub_surfaces;
+    const int max_palette_size =
+        (attributes & kVertexAttributeBit_Bone) ? max_bones_per_surface : 0;
+    PartitionSurfaces(max_palette_size, mesh_to_shader_bones, &sub_surfaces);
+
+    // Output the surfaces.
+    std::vector<flatbuffers::Offset<meshdef::Surface>> surfaces_fb;
+    surfaces_fb.reserve(sub_surfaces.surfaces.size());
+    IndexBufferCompact index_buf_compact;
+    for (size_t i = 0; i < sub_surfaces.surfaces.size(); ++i) {
+      const SubSurface& sub_surface = sub_surfaces.surfaces[i];
+      const FlatTextures& textures = *sub_surface.textures;
+      const IndexBuffer& index_buf = sub_surface.indices;
+      const size_t surface_idx = sub_surface.surface_idx;
+      const std::string material_file_name =
+          HasTexture(textures)
+              ? MaterialFileName(mesh_name, surface_idx, assets_sub_dir)
+              : std::string("");
+      auto material_fb = fbb.CreateString(material_file_name);
+      log_.Log(kLogInfo, "  Surface %d (%s) has %d triangles", surface_idx,
+               material_file_name.length() == 0 ? "unnamed"
+                                                : material_file_name.c_str(),
+               index_buf.size() / 3);
+      if (sub_surfaces.partitioned) {
+        log_.Log(kLogInfo, " and %d bones",
+                 static_cast<int>(sub_surface.palette.size()));
+      }
+      log_.Log(kLogInfo, "\n");
+      flatbuffers::Offset<flatbuffers::Vector<VertIndexCompact>> indices_fb = 0;
+      flatbuffers::Offset<flatbuffers::Vector<VertIndex>> indices32_fb = 0;
+      if (!force32 && GetMaxIndex(index_buf) <= kMaxVertexIndex) {
+        CopyIndexBuf(index_buf, &index_buf_compact);
+        indices_fb = fbb.CreateVector(index_buf_compact);
+      } else {
+        indices32_fb = fbb.CreateVector(index_buf);
+      }
+
+      flatbuffers::Offset<matdef::Material> material_data_fb = 0;
+      if (embed_materials && HasTexture(textures)) {
+        log_.Log(kLogInfo, "  %s:", material_file_name.c_str());
+        material_data_fb =
+            BuildMaterialFlatBuffer(fbb, assets_sub_dir, texture_extension,
+                                    texture_formats, blend_mode, textures);
+      }
+
+      flatbuffers::Offset<flatbuffers::Vector<BoneIndexCompact>> palette_fb =
+          0;
+      if (sub_surfaces.partitioned) {
+        std::vector<BoneIndexCompact> palette_compact;
+        palette_compact.reserve(sub_surface.palette.size());
+        for (size_t j = 0; j < sub_surface.palette.size(); ++j) {
+          palette_compact.push_back(TruncateBoneIndex(sub_surface.palette[j]));
+        }
+        palette_fb = fbb.CreateVector(palette_compact);
+      }
+
+      auto surface_fb =
+          meshdef::CreateSurface(fbb, indices_fb, material_fb, indices32_fb,
+                                 material_data_fb, palette_fb);
+      surfaces_fb.push_back(surface_fb);
+    }
+    auto surface_vector_fb = fbb.CreateVector(surfaces_fb);
+
+    // Output the mesh.
+
+    // Output the bone transforms, for skinning, and the bone names,
+    // for debugging.
+    std::vector<flatbuffers::Offset<flatbuffers::String>> bone_names;
+    std::vector<Mat3x4> bone_transforms;
+    std::vector<BoneIndexCompact> bone_parents;
+    bone_names.reserve(bones_.size());
+    bone_transforms.reserve(bones_.size());
+    bone_parents.reserve(bones_.size());
+    for (size_t i = 0; i < bones_.size(); ++i) {
+      const Bone& bone = bones_[i];
+      bone_names.push_back(fbb.CreateString(bone.name));
+      bone_transforms.push_back(
+          FlatBufferMat3x4(mat4(bone.default_bone_transform_inverse)));
+      bone_parents.push_back(
+          TruncateBoneIndex(BoneParent(static_cast<int>(i))));
+    }
+
+    // Compact the shader to mesh bone map.
+    std::vector<BoneIndexCompact> shader_to_mesh_bones_compact;
+    shader_to_mesh_bones_compact.reserve(shader_to_mesh_bones.size());
+    for (size_t i = 0; i < shader_to_mesh_bones.size(); ++i) {
+      shader_to_mesh_bones_compact.push_back(
+          TruncateBoneIndex(shader_to_mesh_bones[i]));
+    }
+
+    // Get the overal min/max values, in object space.
+    vec3 min_position;
+    vec3 max_position;
+    CalculateMinMaxPosition(&min_position, &max_position);
+
+    const size_t num_points = sub_surfaces.vertex_points.size();
+    auto max_fb = FlatBufferVec3(max_position);
+    auto min_fb = FlatBufferVec3(min_position);
+    auto bone_names_fb = fbb.CreateVector(bone_names);
+    auto bone_transforms_fb = fbb.CreateVectorOfStructs(bone_transforms);
+    auto bone_parents_fb = fbb.CreateVector(bone_parents);
+    auto shader_to_mesh_bones_fb =
+        fbb.CreateVector(shader_to_mesh_bones_compact);
+
+    if (interleaved) {
+      std::vector<uint8_t> format;
+      size_t vert_size = 0;
+      if (attributes & kVertexAttributeBit_Position) {
+        format.push_back(meshdef::Attribute_Position3f);
+        vert_size += sizeof(vec3_packed);
+      }
+      if (attributes & kVertexAttributeBit_Normal) {
+        format.push_back(meshdef::Attribute_Normal3f);
+        vert_size += sizeof(vec3_packed);
+      }
+      if (attributes & kVertexAttributeBit_Tangent) {
+        format.push_back(meshdef::Attribute_Tangent4f);
+        vert_size += sizeof(vec4_packed);
+      }
+      if (attributes & kVertexAttributeBit_Orientation) {
+        format.push_back(meshdef::Attribute_Orientation4f);
+        vert_size += sizeof(vec4_packed);
+      }
+      if (attributes & kVertexAttributeBit_Uv) {
+        format.push_back(meshdef::Attribute_TexCoord2f);
+        vert_size += sizeof(vec2_packed);
+      }
+      if (attributes & kVertexAttributeBit_UvAlt) {
+        format.push_back(meshdef::Attribute_TexCoordAlt2f);
+        vert_size += sizeof(vec2_packed);
+      }
+      if (attributes & kVertexAttributeBit_Color) {
+        format.push_back(meshdef::Attribute_Color4ub);
+        vert_size += sizeof(Vec4ub);
+      }
+      if (attributes & kVertexAttributeBit_Bone) {
+        format.push_back(meshdef::Attribute_BoneIndices4ub);
+        format.push_back(meshdef::Attribute_BoneWeights4ub);
+        vert_size += sizeof(Vec4ub) + sizeof(Vec4ub);
+      }
+      format.push_back(meshdef::Attribute_END);
+      std::vector<uint8_t> iattrs;
+      iattrs.reserve(num_points * vert_size);
+      // TODO(wvo): this is only valid on little-endian.
+      for (size_t i = 0; i < num_points; ++i) {
+        const Vertex& p = points_[sub_surfaces.vertex_points[i]];
+        if (attributes & kVertexAttributeBit_Position) {
+          auto attr = reinterpret_cast<const uint8_t *>(&p.vertex);
+          iattrs.insert(iattrs.end(), attr, attr + sizeof(vec3_packed));
+        }
+        if (attributes & kVertexAttributeBit_Normal) {
+          auto attr = reinterpret_cast<const uint8_t *>(&p.normal);
+          iattrs.insert(iattrs.end(), attr, attr + sizeof(vec3_packed));
+        }
+        if (attributes & kVertexAttributeBit_Tangent) {
+          auto attr = reinterpret_cast<const uint8_t *>(&p.tangent);
+          iattrs.insert(iattrs.end(), attr, attr + sizeof(vec4_packed));
+        }
+        if (attributes & kVertexAttributeBit_Orientation) {
+          auto attr = reinterpret_cast<const uint8_t *>(&p.orientation);
+          iattrs.insert(iattrs.end(), attr, attr + sizeof(vec4_packed));
+        }
+        if (attributes & kVertexAttributeBit_Uv) {
+          auto attr = reinterpret_cast<const uint8_t *>(&p.uv);
+          iattrs.insert(iattrs.end(), attr, attr + sizeof(vec2_packed));
+        }
+        if (attributes & kVertexAttributeBit_UvAlt) {
+          auto attr = reinterpret_cast<const uint8_t *>(&p.uv_alt);
+          iattrs.insert(iattrs.end(), attr, attr + sizeof(vec2_packed));
+        }
+        if (attributes & kVertexAttributeBit_Color) {
+          auto attr = reinterpret_cast<const uint8_t *>(&p.color);
+          iattrs.insert(iattrs.end(), attr, attr + sizeof(Vec4ub));
+        }
+        if (attributes & kVertexAttributeBit_Bone) {
+          Vec4ub bone, weights;
+          p.skin_binding.Pack(sub_surfaces.BoneMap(i, mesh_to_shader_bones),
+                              mesh_to_shader_bones.size(), log_,
+                              mesh_name.c_str(), static_cast<unsigned int>(i),
+                              &bone, &weights);
+          auto attr = reinterpret_cast<const uint8_t *>(&bone);
+          iattrs.insert(iattrs.end(), attr, attr + sizeof(Vec4ub));
+          attr = reinterpret_cast<const uint8_t *>(&weights);
+          iattrs.insert(iattrs.end(), attr, attr + sizeof(Vec4ub));
+        }
+      }
+      assert(vert_size * num_points == iattrs.size());
+      auto formatvec = fbb.CreateVector(format);
+      auto attrvec = fbb.CreateVector(iattrs);
+      return meshdef::CreateMesh(
+          fbb, surface_vector_fb, 0, 0, 0, 0,
+          0, 0, 0, &max_fb, &min_fb,
+          bone_names_fb, bone_transforms_fb, bone_parents_fb,
+          shader_to_mesh_bones_fb, 0, meshdef::MeshVersion_MostRecent,
+          formatvec, attrvec);
+    } else {
+      // First convert to structure-of-array format.
+      std::vector<Vec3> vertices;
+      std::vector<Vec3> normals;
+      std::vector<Vec4> tangents;
+      std::vector<Vec4> orientations;
+      std::vector<Vec4ub> colors;
+      std::vector<Vec2> uvs;
+      std::vector<Vec2> uvs_alt;
+      std::vector<Vec4ub> skin_indices;
+      std::vector<Vec4ub> skin_weights;
+      vertices.reserve(num_points);
+      normals.reserve(num_points);
+      tangents.reserve(num_points);
+      orientations.reserve(num_points);
+      colors.reserve(num_points);
+      uvs.reserve(num_points);
+      uvs_alt.reserve(num_points);
+      skin_indices.reserve(num_points);
+      skin_weights.reserve(num_points);
+      for (size_t i = 0; i < num_points; ++i) {
+        const Vertex& p = points_[sub_surfaces.vertex_points[i]];
+        vertices.push_back(FlatBufferVec3(vec3(p.vertex)));
+        normals.push_back(FlatBufferVec3(vec3(p.normal)));
+        tangents.push_back(FlatBufferVec4(vec4(p.tangent)));
+        orientations.push_back(FlatBufferVec4(vec4(p.orientation)));
+        colors.push_back(p.color);
+        uvs.push_back(FlatBufferVec2(vec2(p.uv)));
+        uvs_alt.push_back(FlatBufferVec2(vec2(p.uv_alt)));
+
+        Vec4ub bone, weights;
+        p.skin_binding.Pack(sub_surfaces.BoneMap(i, mesh_to_shader_bones),
+                            mesh_to_shader_bones.size(), log_,
+                            mesh_name.c_str(), static_cast<unsigned int>(i),
+                            &bone, &weights);
+        skin_indices.push_back(bone);
+        skin_weights.push_back(weights);
+      }
+      // Then create a FlatBuffer vector for each array that we want to export.
+      auto vertices_fb = (attributes & kVertexAttributeBit_Position)
+                             ? fbb.CreateVectorOfStructs(vertices)
+                             : 0;
+      auto normals_fb = (attributes & kVertexAttributeBit_Normal)
+                            ? fbb.CreateVectorOfStructs(normals)
+                            : 0;
+      auto tangents_fb = (attributes & kVertexAttributeBit_Tangent)
+                             ? fbb.CreateVectorOfStructs(tangents)
+                             : 0;
+      auto orientations_fb = (attributes & kVertexAttributeBit_Orientation)
+                                 ? fbb.CreateVectorOfStructs(orientations)
+                                 : 0;
+      auto colors_fb = (attributes & kVertexAttributeBit_Color)
+                           ? fbb.CreateVectorOfStructs(colors)
+                           : 0;
+      auto uvs_fb = (attributes & kVertexAttributeBit_Uv)
+                        ? fbb.CreateVectorOfStructs(uvs)
+                        : 0;
+      auto uvs_alt_fb = (attributes & kVertexAttributeBit_UvAlt)
+                            ? fbb.CreateVectorOfStructs(uvs_alt)
+                            : 0;
+      auto skin_indices_fb = (attributes & kVertexAttributeBit_Bone)
+                                 ? fbb.CreateVectorOfStructs(skin_indices)
+                                 : 0;
+      auto skin_weights_fb = (attributes & kVertexAttributeBit_Bone)
+                                 ? fbb.CreateVectorOfStructs(skin_weights)
+                                 : 0;
+      return meshdef::CreateMesh(
+          fbb, surface_vector_fb, vertices_fb, normals_fb, tangents_fb,
+          colors_fb, uvs_fb, skin_indices_fb, skin_weights_fb, &max_fb, &min_fb,
+          bone_names_fb, bone_transforms_fb, bone_parents_fb,
+          shader_to_mesh_bones_fb, uvs_alt_fb, meshdef::MeshVersion_MostRecent,
+          /* attributes = */ 0, /* vertices = */ 0, orientations_fb);
+    }
+  }
+
+  bool OutputMeshFlatBuffer(
+      const std::string& mesh_name, const std::string& assets_base_dir,
+      const std::string& assets_sub_dir, const std::string& texture_extension,
+      const std::vector<matdef::TextureFormat>& texture_formats,
+      matdef::BlendMode blend_mode, bool interleaved, bool force32,
+      bool embed_materials, int max_bones_per_surface,
+      std::vector<std::string>* output_files) const {
+    const std::string rel_mesh_file_name =
+        assets_sub_dir + mesh_name + "." + meshdef::MeshExtension();
+    const std::string full_mesh_file_name =
+        assets_base_dir + rel_mesh_file_name;
+
+    log_.Log(kLogInfo, "Mesh:\n");
+
+    flatbuffers::FlatBufferBuilder fbb;
+    auto mesh_fb = BuildMeshFlatBuffer(
+        fbb, mesh_name, assets_sub_dir, texture_extension, texture_formats,
+        blend_mode, interleaved, force32, embed_materials,
+        max_bones_per_surface);
+
+    meshdef::FinishMeshBuffer(fbb, mesh_fb);
+
+    // Write the buffer to a file.
+    return OutputFlatBufferBuilder(fbb, full_mesh_file_name, output_files);
+  }
+
+  bool OutputMaterialFlatBuffers(
+      const std::string& mesh_name, const std::string& assets_base_dir,
+      const std::string& assets_sub_dir, const std::string& texture_extension,
+      const std::vector<matdef::TextureFormat>& texture_formats,
+      matdef::BlendMode blend_mode,
+      std::vector<std::string>* output_files) const {
+    log_.Log(kLogInfo, "Materials:\n");
+
+    size_t surface_idx = 0;
+    for (auto it = surfaces_.begin(); it != surfaces_.end(); ++it) {
+      const FlatTextures& textures = it->first;
+      if (!HasTexture(textures)) {
+        ++surface_idx;
+        continue;
+      }
+
+      const std::string material_file_name =
+          MaterialFileName(mesh_name, surface_idx, assets_sub_dir);
+      log_.Log(kLogInfo, "  %s:", material_file_name.c_str());
+
+      flatbuffers::FlatBufferBuilder fbb;
+      auto material_fb =
+          BuildMaterialFlatBuffer(fbb, assets_sub_dir, texture_extension,
+                                  texture_formats, blend_mode, textures);
+      matdef::FinishMaterialBuffer(fbb, material_fb);
+
+      const std::string full_material_file_name =
+          assets_base_dir + material_file_name;
+      if (!OutputFlatBufferBuilder(fbb, full_material_file_name,
+                                   output_files)) {
+        return false;
+      }
+
+      surface_idx++;
+    }
+
+    // Log blend mode, if blend mode is being used.
+    if (blend_mode != matdef::BlendMode_OFF) {
+      log_.Log(kLogInfo, "  blend mode: %s\n",
+               matdef::EnumNameBlendMode(blend_mode));
+    }
+    return true;
+  }
+
+  int BoneParent(int i) const { return bones_[i].parent_bone_index; }
+
+  unsigned int BoneDepth(int i) const {
+    unsigned int depth = 0;
+    for (;;) {
+      i = bones_[i].parent_bone_index;
+      if (i < 0) break;
+      ++depth;
+    }
+    return depth;
+  }
+
+  mat4 BoneGlobalTransform(int i) const {
+    mat4 m(bones_[i].default_bone_transform_inverse);
+    for (;;) {
+      i = BoneParent(i);
+      if (i < 0) break;
+
+      // Update with parent transform.
+      m = mat4(bones_[i].default_bone_transform_inverse) * m;
+    }
+    return m;
+  }
+
+  // Inspect vertices to determine which bones are referenced.
+  void GetUsedBoneFlags(std::vector<bool>* out_used_bone_flags) const {
+    std::vector<bool> used_bone_flags(bones_.size());
+    const Vertex* vertex = points_.data();
+    const Vertex* const vertex_end = vertex + points_.size();
+    for (; vertex != vertex_end; ++vertex) {
+      const BoneIndex* bone_index_it = vertex->skin_binding.GetBoneIndices();
+      const BoneIndex* const bone_index_end =
+          bone_index_it + SkinBinding::kInfluenceMax;
+      for (; bone_index_it != bone_index_end; ++bone_index_it) {
+        const BoneIndex bone_index = *bone_index_it;
+        if (bone_index == SkinBinding::kNoBoneIndex) {
+          break;
+        }
+        used_bone_flags[bone_index] = true;
+      }
+    }
+    out_used_bone_flags->swap(used_bone_flags);
+  }
+
+  void CalculateBoneIndexMaps(
+      std::vector<BoneIndex>* mesh_to_shader_bones,
+      std::vector<BoneIndex>* shader_to_mesh_bones) const {
+    mesh_to_shader_bones->clear();
+    shader_to_mesh_bones->clear();
+
+    std::vector<bool> used_bone_flags;
+    GetUsedBoneFlags(&used_bone_flags);
+
+    // Only bones that have vertices weighted to them are uploaded to the
+    // shader.
+    BoneIndex shader_bone = 0;
+    mesh_to_shader_bones->reserve(bones_.size());
+    for (BoneIndex mesh_bone = 0; mesh_bone < bones_.size(); ++mesh_bone) {
+      if (used_bone_flags[mesh_bone]) {
+        mesh_to_shader_bones->push_back(shader_bone);
+        shader_to_mesh_bones->push_back(mesh_bone);
+        shader_bone++;
+      } else {
+        mesh_to_shader_bones->push_back(kInvalidBoneIdx);
+      }
+    }
+  }
+
+  // Copy 32bit indices into 16bit index buffer.
+  static void CopyIndexBuf(const IndexBuffer& index_buf,
+                           IndexBufferCompact* index_buf16) {
+    // Indices are output in groups of three, since we only output triangles.
+    assert(index_buf.size() % 3 == 0);
+
+    index_buf16->clear();
+    index_buf16->reserve(index_buf.size());
+
+    // Copy triangles.
+    for (size_t i = 0; i < index_buf.size(); i += 3) {
+      index_buf16->push_back(static_cast<VertIndexCompact>(index_buf[i]));
+      index_buf16->push_back(static_cast<VertIndexCompact>(index_buf[i + 1]));
+      index_buf16->push_back(static_cast<VertIndexCompact>(index_buf[i + 2]));
+    }
+  }
+
+  // Bones >8-bits are unindexable, so weight them to the root bone 0.
+  // This will look funny but it's the best we can do.
+  static BoneIndexCompact TruncateBoneIndex(int bone_idx) {
+    return bone_idx == kInvalidBoneIdx
+               ? kInvalidBoneIdxCompact
+               : bone_idx > kMaxBoneIndex
+                     ? 0
+                     : static_cast<BoneIndexCompact>(bone_idx);
+  }
+
+  SurfaceMap surfaces_;
+  VertexDedupTable unique_;
+  std::vector<Vertex> points_;
+  IndexBuffer* cur_index_buf_;
+  VertexAttributeBitmask mesh_vertex_attributes_;
+  std::vector<Bone> bones_;
+  VertexAttributeBitmask vertex_attributes_;
+  VertexQuantization quantization_;
+
+  // Hashes of the distinct vertices before quantization, to report how many
+  // vertices quantization merged. Only filled if quantization is enabled.
+  std::unordered_set<uint64_t> raw_hashes_;
+
+  // Vertices GenerateTangentFrames() appended to `points_` at mirrored UV
+  // seams, after deduplication.
+  size_t num_seam_copies_;
+
+  // Information and warnings.
+  Logger& log_;
+};
+
+class FlatMesh::SurfaceChunk {
+ public:
+  SurfaceChunk() : vertex_attributes_(0), surface_vertex_attributes_(0) {}
+
+  // Start a chunk for a surface with `textures` that will go into `mesh`.
+  SurfaceChunk(const FlatMesh& mesh, const FlatTextures& textures)
+      : textures_(textures),
+        vertex_attributes_(mesh.vertex_attributes_),
+        surface_vertex_attributes_(0),
+        quantization_(mesh.quantization_) {}
+
+  void Reserve(size_t max_verts) {
+    vertices_.reserve(max_verts);
+    hashes_.reserve(max_verts);
+    indices_.reserve(max_verts);
+    unique_.Reserve(max_verts);
+  }
+
+  void ReportSurfaceVertexAttributes(
+      VertexAttributeBitmask surface_vertex_attributes) {
+    surface_vertex_attributes_ |= surface_vertex_attributes;
+  }
+
+  // Same as FlatMesh::AppendPolyVert(), but local to this chunk.
+  void AppendPolyVert(const vec3& vertex, const vec3& normal,
+                      const vec4& tangent, const vec4& color, const vec2& uv,
+                      const vec2& uv_alt, const SkinBinding& skin_binding) {
+    vertices_.push_back(Vertex(vertex_attributes_, vertex, normal, tangent,
+                               color, uv, uv_alt, skin_binding));
+    if (quantization_.enabled()) {
+      raw_hashes_.insert(HashPod(vertices_.back()));
+      QuantizeVertex(quantization_, &vertices_.back());
+    }
+    const uint32_t hash =
+        static_cast<uint32_t>(HashPod(vertices_.back()) >> 32);
+    const VertIndex new_index = static_cast<VertIndex>(vertices_.size() - 1);
+    const VertIndex index =
+        unique_.FindOrInsertHashed(vertices_.data(), new_index, hash);
+    if (index == new_index) {
+      hashes_.push_back(hash);
+    } else {
+      vertices_.pop_back();
+    }
+    indices_.push_back(index);
+  }
+
+  size_t NumIndices() const { return indices_.size(); }
+  size_t NumUniqueVertices() const { return vertices_.size(); }
+
+ private:
+  friend class FlatMesh;
+
+  FlatTextures textures_;
+  VertexAttributeBitmask vertex_attributes_;
+  VertexAttributeBitmask surface_vertex_attributes_;
+  VertexQuantization quantization_;
+  std::unordered_set<uint64_t> raw_hashes_;  // See FlatMesh::raw_hashes_.
+  std::vector<Vertex> vertices_;
+  std::vector<uint32_t> hashes_;  // Parallel to `vertices_`.
+  VertexDedupTable unique_;
+  IndexBuffer indices_;  // Indices into `vertices_`.
+};
+
+// Load `args.fbx_file` with `pipe` and gather it into `mesh`.
+// Every file that was read is output to `input_files`.
+// `Parser` is one of the importers, such as GltfMeshParser.
+template <class Parser>
+bool LoadAndGatherMesh(Parser& pipe, const MeshPipelineArgs& args,
+                       Logger& log, FlatMesh* mesh,
+                       std::vector<std::string>* input_files) {
+  const auto start_time = std::chrono::steady_clock::now();
+  if (!pipe.Valid()) return false;
+  const bool load_status = pipe.Load(args.fbx_file.c_str(), args.axis_system,
+                                     args.distance_unit_scale, args.recenter,
+                                     args.vertex_attributes);
+  if (!load_status) return false;
+  *input_files = pipe.InputFiles();
+  const auto load_time = std::chrono::steady_clock::now();
+
+  // Gather data into a format conducive to our FlatBuffer format.
+  mesh->Reserve(pipe.NumVertsUpperBound());
+  pipe.GatherFlatMesh(args.gather_textures, mesh);
+  mesh->GenerateTangentFrames();
+  const auto gather_time = std::chrono::steady_clock::now();
+
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+  log.Log(kLogInfo, "Loaded in %.1fms, gathered in %.1fms\n",
+          Milliseconds(load_time - start_time).count(),
+          Milliseconds(gather_time - load_time).count());
+  return true;
+}
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_MESH_PIPELINE_FLAT_MESH_H_
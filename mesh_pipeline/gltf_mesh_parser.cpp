@@ -0,0 +1,1194 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gltf_mesh_parser.h"
+
+#include <float.h>
+#include <stdlib.h>
+
+#include "flatbuffers/util.h"
+
+namespace fplbase {
+
+// .glb container constants.
+static const uint32_t kGlbMagic = 0x46546C67;  // "glTF"
+static const uint32_t kGlbVersion = 2;
+static const uint32_t kGlbChunkJson = 0x4E4F534A;  // "JSON"
+static const uint32_t kGlbChunkBin = 0x004E4942;   // "BIN\0"
+static const size_t kGlbHeaderSize = 12;
+static const size_t kGlbChunkHeaderSize = 8;
+
+// Accessor component types, from the glTF spec (they match the GL enums).
+enum {
+  kComponentByte = 5120,
+  kComponentUnsignedByte = 5121,
+  kComponentShort = 5122,
+  kComponentUnsignedShort = 5123,
+  kComponentUnsignedInt = 5125,
+  kComponentFloat = 5126,
+};
+
+static const int kPrimitiveModeTriangles = 4;
+
+// glTF distances are in meters. MeshPipelineArgs are in centimeters per unit.
+static const float kCentimetersPerMeter = 100.0f;
+
+// Minimal JSON reader. Values are stored in one array, with each container
+// linking to its first child and each child to its next sibling, so the
+// whole document is two allocations plus strings.
+class JsonDocument {
+ public:
+  enum Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+  struct Value {
+    Type type;
+    double number;
+    std::string string;  // String value, or `true`/`false` for kBool.
+    std::string key;     // Member name when the parent is an object.
+    int first_child;
+    int next_sibling;
+    int num_children;
+  };
+
+  // Parse `json`. On failure returns false and sets `error`.
+  bool Parse(const char* json, size_t length, std::string* error) {
+    p_ = json;
+    end_ = json + length;
+    values_.clear();
+    error_.clear();
+    values_.reserve(length / 8 + 1);
+    if (ParseValue(0) < 0) {
+      *error = error_;
+      return false;
+    }
+    SkipWhitespace();
+    if (p_ != end_) {
+      *error = "trailing characters after JSON document";
+      return false;
+    }
+    return true;
+  }
+
+  // The root value is always index 0.
+  int root() const { return 0; }
+
+  Type type(int v) const { return v < 0 ? kNull : values_[v].type; }
+  int size(int v) const { return v < 0 ? 0 : values_[v].num_children; }
+
+  // Return the member called `key`, or -1.
+  int Member(int object, const char* key) const {
+    if (type(object) != kObject) return -1;
+    for (int c = values_[object].first_child; c >= 0;
+         c = values_[c].next_sibling) {
+      if (values_[c].key == key) return c;
+    }
+    return -1;
+  }
+
+  // Iterate children with `for (c = First(v); c >= 0; c = Next(c))`.
+  int First(int v) const {
+    return type(v) == kArray || type(v) == kObject ? values_[v].first_child
+                                                   : -1;
+  }
+  int Next(int c) const { return values_[c].next_sibling; }
+
+  // Return the `index`th element of `array`, or -1.
+  int Element(int array, int index) const {
+    if (type(array) != kArray || index < 0) return -1;
+    int c = values_[array].first_child;
+    for (; c >= 0 && index > 0; --index) c = values_[c].next_sibling;
+    return c;
+  }
+
+  double Number(int v, double default_value) const {
+    return type(v) == kNumber ? values_[v].number : default_value;
+  }
+  int Int(int v, int default_value) const {
+    return type(v) == kNumber ? static_cast<int>(values_[v].number)
+                              : default_value;
+  }
+  bool Bool(int v, bool default_value) const {
+    return type(v) == kBool ? values_[v].string == "true" : default_value;
+  }
+  const std::string& String(int v) const {
+    static const std::string kEmpty;
+    return type(v) == kString ? values_[v].string : kEmpty;
+  }
+
+  // Read up to `max_count` numbers from `array` into `out`. Returns count.
+  int Numbers(int array, float* out, int max_count) const {
+    int count = 0;
+    for (int c = First(array); c >= 0 && count < max_count; c = Next(c)) {
+      out[count++] = static_cast<float>(Number(c, 0.0));
+    }
+    return count;
+  }
+
+ private:
+  static const int kMaxDepth = 64;
+
+  int Fail(const char* message) {
+    if (error_.empty()) error_ = message;
+    return -1;
+  }
+
+  void SkipWhitespace() {
+    while (p_ < end_ &&
+           (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+      ++p_;
+    }
+  }
+
+  int NewValue(Type type) {
+    Value v;
+    v.type = type;
+    v.number = 0.0;
+    v.first_child = -1;
+    v.next_sibling = -1;
+    v.num_children = 0;
+    values_.push_back(v);
+    return static_cast<int>(values_.size()) - 1;
+  }
+
+  bool Literal(const char* text) {
+    const size_t length = strlen(text);
+    if (static_cast<size_t>(end_ - p_) < length ||
+        strncmp(p_, text, length) != 0) {
+      return false;
+    }
+    p_ += length;
+    return true;
+  }
+
+  static void AppendUtf8(unsigned int code_point, std::string* out) {
+    if (code_point < 0x80) {
+      out->push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+      out->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+      out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+      out->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+      out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else {
+      out->push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+      out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+  }
+
+  bool ParseHex4(unsigned int* out) {
+    if (end_ - p_ < 4) return false;
+    *out = 0;
+    for (int i = 0; i < 4; ++i) {
+      const char c = *p_++;
+      *out <<= 4;
+      if (c >= '0' && c <= '9') {
+        *out |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        *out |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        *out |= c - 'A' + 10;
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool ParseString(std::string* out) {
+    ++p_;  // Opening quote.
+    while (p_ < end_ && *p_ != '"') {
+      if (*p_ != '\\') {
+        out->push_back(*p_++);
+        continue;
+      }
+      if (++p_ >= end_) return false;
+      const char escape = *p_++;
+      switch (escape) {
+        case '"': case '\\': case '/': out->push_back(escape); break;
+        case 'b': out->push_back('\b'); break;
+        case 'f': out->push_back('\f'); break;
+        case 'n': out->push_back('\n'); break;
+        case 'r': out->push_back('\r'); break;
+        case 't': out->push_back('\t'); break;
+        case 'u': {
+          unsigned int code_point;
+          if (!ParseHex4(&code_point)) return false;
+          // Combine UTF-16 surrogate pairs.
+          if (code_point >= 0xD800 && code_point < 0xDC00 && end_ - p_ >= 6 &&
+              p_[0] == '\\' && p_[1] == 'u') {
+            p_ += 2;
+            unsigned int low;
+            if (!ParseHex4(&low)) return false;
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) +
+                         (low - 0xDC00);
+          }
+          AppendUtf8(code_point, out);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    if (p_ >= end_) return false;
+    ++p_;  // Closing quote.
+    return true;
+  }
+
+  // Parse the value at `p_`. Returns its index, or -1 on error.
+  int ParseValue(int depth) {
+    if (depth > kMaxDepth) return Fail("JSON nested too deeply");
+    SkipWhitespace();
+    if (p_ >= end_) return Fail("unexpected end of JSON");
+
+    switch (*p_) {
+      case '{':
+      case '[': {
+        const bool is_object = *p_ == '{';
+        const char close = is_object ? '}' : ']';
+        const int v = NewValue(is_object ? kObject : kArray);
+        ++p_;
+        SkipWhitespace();
+        if (p_ < end_ && *p_ == close) {
+          ++p_;
+          return v;
+        }
+        int last_child = -1;
+        for (;;) {
+          std::string key;
+          if (is_object) {
+            SkipWhitespace();
+            if (p_ >= end_ || *p_ != '"' || !ParseString(&key)) {
+              return Fail("expected member name");
+            }
+            SkipWhitespace();
+            if (p_ >= end_ || *p_ != ':') return Fail("expected ':'");
+            ++p_;
+          }
+          const int child = ParseValue(depth + 1);
+          if (child < 0) return -1;
+          values_[child].key.swap(key);
+          if (last_child < 0) {
+            values_[v].first_child = child;
+          } else {
+            values_[last_child].next_sibling = child;
+          }
+          last_child = child;
+          values_[v].num_children++;
+
+          SkipWhitespace();
+          if (p_ >= end_) return Fail("unterminated container");
+          if (*p_ == close) {
+            ++p_;
+            return v;
+          }
+          if (*p_ != ',') return Fail("expected ','");
+          ++p_;
+        }
+      }
+      case '"': {
+        const int v = NewValue(kString);
+        std::string s;
+        if (!ParseString(&s)) return Fail("bad string");
+        values_[v].string.swap(s);
+        return v;
+      }
+      case 't':
+      case 'f': {
+        const int v = NewValue(kBool);
+        if (Literal("true")) {
+          values_[v].string = "true";
+        } else if (!Literal("false")) {
+          return Fail("bad literal");
+        }
+        return v;
+      }
+      case 'n':
+        if (!Literal("null")) return Fail("bad literal");
+        return NewValue(kNull);
+      default: {
+        char* number_end;
+        const double number = strtod(p_, &number_end);
+        if (number_end == p_) return Fail("unexpected character");
+        p_ = number_end;
+        const int v = NewValue(kNumber);
+        values_[v].number = number;
+        return v;
+      }
+    }
+  }
+
+  const char* p_;
+  const char* end_;
+  std::vector<Value> values_;
+  std::string error_;
+};
+
+static inline uint32_t ReadUint32(const char* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Decode standard base64, ignoring anything after the first '='.
+static bool DecodeBase64(const char* s, size_t length, std::string* out) {
+  out->clear();
+  out->reserve(length / 4 * 3);
+  uint32_t bits = 0;
+  int num_bits = 0;
+  for (size_t i = 0; i < length && s[i] != '='; ++i) {
+    const char c = s[i];
+    int value;
+    if (c >= 'A' && c <= 'Z') {
+      value = c - 'A';
+    } else if (c >= 'a' && c <= 'z') {
+      value = c - 'a' + 26;
+    } else if (c >= '0' && c <= '9') {
+      value = c - '0' + 52;
+    } else if (c == '+') {
+      value = 62;
+    } else if (c == '/') {
+      value = 63;
+    } else {
+      return false;
+    }
+    bits = (bits << 6) | static_cast<uint32_t>(value);
+    num_bits += 6;
+    if (num_bits >= 8) {
+      num_bits -= 8;
+      out->push_back(static_cast<char>((bits >> num_bits) & 0xFF));
+    }
+  }
+  return true;
+}
+
+// Undo percent-encoding in a relative URI, e.g. "my%20texture.png".
+static std::string DecodeUri(const std::string& uri) {
+  std::string out;
+  out.reserve(uri.size());
+  for (size_t i = 0; i < uri.size(); ++i) {
+    if (uri[i] == '%' && i + 2 < uri.size()) {
+      const std::string hex = uri.substr(i + 1, 2);
+      char* end;
+      const long value = strtol(hex.c_str(), &end, 16);
+      if (end == hex.c_str() + 2) {
+        out.push_back(static_cast<char>(value));
+        i += 2;
+        continue;
+      }
+    }
+    out.push_back(uri[i]);
+  }
+  return out;
+}
+
+static int ComponentSize(int component_type) {
+  switch (component_type) {
+    case kComponentByte:
+    case kComponentUnsignedByte:
+      return 1;
+    case kComponentShort:
+    case kComponentUnsignedShort:
+      return 2;
+    case kComponentUnsignedInt:
+    case kComponentFloat:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+static int NumComponents(const std::string& type) {
+  if (type == "SCALAR") return 1;
+  if (type == "VEC2") return 2;
+  if (type == "VEC3") return 3;
+  if (type == "VEC4") return 4;
+  if (type == "MAT2") return 4;
+  if (type == "MAT3") return 9;
+  if (type == "MAT4") return 16;
+  return 0;
+}
+
+// Read element `index` of `accessor` as floats. Normalized integers are
+// mapped to [0,1] or [-1,1]. Missing components are left untouched.
+static void ReadFloats(const GltfMeshParser::Accessor& accessor, size_t index,
+                       float* out, int max_count) {
+  if (accessor.data == nullptr || index >= accessor.count) return;
+  const uint8_t* p = accessor.data + index * accessor.stride;
+  const int count = std::min(accessor.num_components, max_count);
+  const bool n = accessor.normalized;
+  for (int i = 0; i < count; ++i) {
+    switch (accessor.component_type) {
+      case kComponentFloat:
+        memcpy(&out[i], p + 4 * i, sizeof(float));
+        break;
+      case kComponentUnsignedByte:
+        out[i] = n ? p[i] / 255.0f : p[i];
+        break;
+      case kComponentByte: {
+        const float v = static_cast<int8_t>(p[i]);
+        out[i] = n ? std::max(v / 127.0f, -1.0f) : v;
+        break;
+      }
+      case kComponentUnsignedShort: {
+        uint16_t v;
+        memcpy(&v, p + 2 * i, sizeof(v));
+        out[i] = n ? v / 65535.0f : v;
+        break;
+      }
+      case kComponentShort: {
+        int16_t v;
+        memcpy(&v, p + 2 * i, sizeof(v));
+        out[i] = n ? std::max(v / 32767.0f, -1.0f) : v;
+        break;
+      }
+      case kComponentUnsignedInt: {
+        uint32_t v;
+        memcpy(&v, p + 4 * i, sizeof(v));
+        out[i] = static_cast<float>(v);
+        break;
+      }
+    }
+  }
+}
+
+// Read element `index` of an integer accessor (indices or joints).
+static void ReadUints(const GltfMeshParser::Accessor& accessor, size_t index,
+                      uint32_t* out, int max_count) {
+  if (accessor.data == nullptr || index >= accessor.count) return;
+  const uint8_t* p = accessor.data + index * accessor.stride;
+  const int count = std::min(accessor.num_components, max_count);
+  for (int i = 0; i < count; ++i) {
+    switch (accessor.component_type) {
+      case kComponentUnsignedByte:
+        out[i] = p[i];
+        break;
+      case kComponentUnsignedShort: {
+        uint16_t v;
+        memcpy(&v, p + 2 * i, sizeof(v));
+        out[i] = v;
+        break;
+      }
+      case kComponentUnsignedInt:
+        memcpy(&out[i], p + 4 * i, sizeof(uint32_t));
+        break;
+      default:
+        out[i] = 0;
+        break;
+    }
+  }
+}
+
+static mat4 Mat4FromPacked(const vec4_packed* columns) {
+  return mat4(vec4(columns[0]), vec4(columns[1]), vec4(columns[2]),
+              vec4(columns[3]));
+}
+
+bool GltfMeshParser::LoadFileData(const char* file_name, std::string* json) {
+  if (!flatbuffers::LoadFile(file_name, true, &file_contents_)) {
+    log_.Log(kLogError, "Could not read %s\n", file_name);
+    return false;
+  }
+
+  // Plain .gltf files are entirely JSON.
+  const char* data = file_contents_.c_str();
+  const size_t size = file_contents_.size();
+  if (size < kGlbHeaderSize || ReadUint32(data) != kGlbMagic) {
+    json->assign(file_contents_);
+    return true;
+  }
+
+  // Binary .glb: a header, a JSON chunk, then an optional BIN chunk.
+  if (ReadUint32(data + 4) != kGlbVersion) {
+    log_.Log(kLogError, "%s: unsupported glTF version %d\n", file_name,
+             ReadUint32(data + 4));
+    return false;
+  }
+  const size_t total = std::min<size_t>(ReadUint32(data + 8), size);
+  size_t offset = kGlbHeaderSize;
+  bool found_json = false;
+  while (offset + kGlbChunkHeaderSize <= total) {
+    const size_t chunk_size = ReadUint32(data + offset);
+    const uint32_t chunk_type = ReadUint32(data + offset + 4);
+    const size_t chunk_start = offset + kGlbChunkHeaderSize;
+    if (chunk_size > total - chunk_start) {
+      log_.Log(kLogError, "%s: truncated chunk\n", file_name);
+      return false;
+    }
+    if (chunk_type == kGlbChunkJson && !found_json) {
+      json->assign(data + chunk_start, chunk_size);
+      found_json = true;
+    } else if (chunk_type == kGlbChunkBin && buffers_.empty()) {
+      // Referenced in place; this is buffer 0 if it has no URI.
+      const BufferRange bin = {
+          reinterpret_cast<const uint8_t*>(data + chunk_start), chunk_size};
+      buffers_.push_back(bin);
+    }
+    offset = chunk_start + ((chunk_size + 3) & ~static_cast<size_t>(3));
+  }
+  if (!found_json) {
+    log_.Log(kLogError, "%s: no JSON chunk\n", file_name);
+    return false;
+  }
+  return true;
+}
+
+bool GltfMeshParser::ParseScene(const std::string& json,
+                                float distance_unit_scale) {
+  JsonDocument doc;
+  std::string error;
+  if (!doc.Parse(json.c_str(), json.size(), &error)) {
+    log_.Log(kLogError, "%s: %s\n", mesh_file_name_.c_str(), error.c_str());
+    return false;
+  }
+  const int root = doc.root();
+
+  const std::string& version =
+      doc.String(doc.Member(doc.Member(root, "asset"), "version"));
+  if (version.empty() || version[0] != '2') {
+    log_.Log(kLogError, "%s: unsupported glTF version '%s'\n",
+             mesh_file_name_.c_str(), version.c_str());
+    return false;
+  }
+
+  // Buffers. A .glb BIN chunk was already added as buffer 0.
+  const int buffers = doc.Member(root, "buffers");
+  const BufferRange glb_bin =
+      buffers_.empty() ? BufferRange{nullptr, 0} : buffers_[0];
+  buffers_.clear();
+  external_buffers_.reserve(doc.size(buffers));
+  const std::string directory = fplutil::DirectoryName(mesh_file_name_);
+  for (int b = doc.First(buffers); b >= 0; b = doc.Next(b)) {
+    const std::string& uri = doc.String(doc.Member(b, "uri"));
+    const size_t byte_length =
+        static_cast<size_t>(doc.Number(doc.Member(b, "byteLength"), 0.0));
+    BufferRange range = {nullptr, 0};
+    if (uri.empty()) {
+      range = glb_bin;
+    } else {
+      external_buffers_.push_back(std::string());
+      std::string& storage = external_buffers_.back();
+      const size_t comma = uri.find(',');
+      if (uri.compare(0, 5, "data:") == 0 && comma != std::string::npos) {
+        if (!DecodeBase64(uri.c_str() + comma + 1, uri.size() - comma - 1,
+                          &storage)) {
+          log_.Log(kLogError, "%s: bad base64 buffer\n",
+                   mesh_file_name_.c_str());
+          return false;
+        }
+      } else {
+        const std::string buffer_file = directory + DecodeUri(uri);
+        if (!flatbuffers::LoadFile(buffer_file.c_str(), true, &storage)) {
+          log_.Log(kLogError, "Could not read buffer %s\n",
+                   buffer_file.c_str());
+          return false;
+        }
+        input_files_.push_back(buffer_file);
+      }
+      range.data = reinterpret_cast<const uint8_t*>(storage.data());
+      range.length = storage.size();
+    }
+    if (range.length < byte_length) {
+      log_.Log(kLogError, "%s: buffer is %d bytes but should be %d\n",
+               mesh_file_name_.c_str(), static_cast<int>(range.length),
+               static_cast<int>(byte_length));
+      return false;
+    }
+    buffers_.push_back(range);
+  }
+
+  // Buffer views.
+  const int views = doc.Member(root, "bufferViews");
+  for (int v = doc.First(views); v >= 0; v = doc.Next(v)) {
+    const int buffer = doc.Int(doc.Member(v, "buffer"), -1);
+    const size_t offset =
+        static_cast<size_t>(doc.Number(doc.Member(v, "byteOffset"), 0.0));
+    const size_t length =
+        static_cast<size_t>(doc.Number(doc.Member(v, "byteLength"), 0.0));
+    if (buffer < 0 || buffer >= static_cast<int>(buffers_.size()) ||
+        offset + length > buffers_[buffer].length) {
+      log_.Log(kLogError, "%s: buffer view out of range\n",
+               mesh_file_name_.c_str());
+      return false;
+    }
+    const BufferRange range = {buffers_[buffer].data + offset, length};
+    buffer_views_.push_back(range);
+    buffer_view_strides_.push_back(
+        static_cast<size_t>(doc.Number(doc.Member(v, "byteStride"), 0.0)));
+  }
+
+  // Accessors. Out-of-range accessors are rejected here so that reads during
+  // GatherFlatMesh() need no further checks.
+  const int accessors = doc.Member(root, "accessors");
+  for (int a = doc.First(accessors); a >= 0; a = doc.Next(a)) {
+    Accessor accessor;
+    accessor.count =
+        static_cast<size_t>(doc.Number(doc.Member(a, "count"), 0.0));
+    accessor.component_type = doc.Int(doc.Member(a, "componentType"), 0);
+    accessor.num_components = NumComponents(doc.String(doc.Member(a, "type")));
+    accessor.normalized = doc.Bool(doc.Member(a, "normalized"), false);
+    const size_t element_size =
+        ComponentSize(accessor.component_type) * accessor.num_components;
+    if (element_size == 0) {
+      log_.Log(kLogError, "%s: accessor has unknown type\n",
+               mesh_file_name_.c_str());
+      return false;
+    }
+    if (doc.Member(a, "sparse") >= 0) {
+      log_.Log(kLogWarning, "%s: sparse accessors are not supported\n",
+               mesh_file_name_.c_str());
+    }
+    const int view = doc.Int(doc.Member(a, "bufferView"), -1);
+    if (view >= static_cast<int>(buffer_views_.size())) {
+      log_.Log(kLogError, "%s: accessor has invalid buffer view\n",
+               mesh_file_name_.c_str());
+      return false;
+    }
+    if (view >= 0) {
+      const size_t offset =
+          static_cast<size_t>(doc.Number(doc.Member(a, "byteOffset"), 0.0));
+      const size_t stride = buffer_view_strides_[view];
+      accessor.stride = stride != 0 ? stride : element_size;
+      accessor.data = buffer_views_[view].data + offset;
+      const size_t needed =
+          accessor.count == 0
+              ? 0
+              : offset + (accessor.count - 1) * accessor.stride + element_size;
+      if (needed > buffer_views_[view].length) {
+        log_.Log(kLogError, "%s: accessor out of range\n",
+                 mesh_file_name_.c_str());
+        return false;
+      }
+    }
+    float min[3] = {0.0f, 0.0f, 0.0f};
+    float max[3] = {0.0f, 0.0f, 0.0f};
+    accessor.has_bounds = doc.Numbers(doc.Member(a, "min"), min, 3) == 3 &&
+                          doc.Numbers(doc.Member(a, "max"), max, 3) == 3;
+    accessor.min = vec3_packed(vec3(min[0], min[1], min[2]));
+    accessor.max = vec3_packed(vec3(max[0], max[1], max[2]));
+    accessors_.push_back(accessor);
+  }
+  const int num_accessors = static_cast<int>(accessors_.size());
+  auto accessor_index = [&](int v) {
+    const int index = doc.Int(v, -1);
+    return index < num_accessors ? index : -1;
+  };
+
+  // Materials. Textures are listed in the same order as the FBX importer:
+  // diffuse, emissive, normal.
+  const int images = doc.Member(root, "images");
+  const int textures = doc.Member(root, "textures");
+  auto texture_file = [&](int texture_info) -> std::string {
+    const int texture = doc.Element(
+        textures, doc.Int(doc.Member(texture_info, "index"), -1));
+    const int image = doc.Element(
+        images, doc.Int(doc.Member(texture, "source"), -1));
+    if (image < 0) return std::string();
+    const std::string& uri = doc.String(doc.Member(image, "uri"));
+    if (uri.empty() || uri.compare(0, 5, "data:") == 0) {
+      log_.Log(kLogWarning,
+               "%s: embedded images are not supported. Reference the image"
+               " by file name instead.\n",
+               mesh_file_name_.c_str());
+      return std::string();
+    }
+    return FindSourceTextureFileName(mesh_file_name_, DecodeUri(uri), log_);
+  };
+  const int materials = doc.Member(root, "materials");
+  for (int m = doc.First(materials); m >= 0; m = doc.Next(m)) {
+    Material material;
+    material.name = doc.String(doc.Member(m, "name"));
+    const int pbr = doc.Member(m, "pbrMetallicRoughness");
+    const int slots[] = {doc.Member(pbr, "baseColorTexture"),
+                         doc.Member(m, "emissiveTexture"),
+                         doc.Member(m, "normalTexture")};
+    for (size_t i = 0; i < FPL_ARRAYSIZE(slots); ++i) {
+      if (slots[i] < 0) continue;
+      const std::string file = texture_file(slots[i]);
+      if (!file.empty()) material.textures.push_back(file);
+    }
+    float color[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    material.has_base_color =
+        doc.Numbers(doc.Member(pbr, "baseColorFactor"), color, 4) == 4;
+    material.base_color =
+        vec4_packed(vec4(color[0], color[1], color[2], color[3]));
+    materials_.push_back(material);
+  }
+  const int num_materials = static_cast<int>(materials_.size());
+
+  // Meshes.
+  const int meshes = doc.Member(root, "meshes");
+  for (int m = doc.First(meshes); m >= 0; m = doc.Next(m)) {
+    Mesh mesh;
+    mesh.name = doc.String(doc.Member(m, "name"));
+    const int primitives = doc.Member(m, "primitives");
+    for (int p = doc.First(primitives); p >= 0; p = doc.Next(p)) {
+      const int mode = doc.Int(doc.Member(p, "mode"), kPrimitiveModeTriangles);
+      if (mode != kPrimitiveModeTriangles) {
+        log_.Log(kLogWarning,
+                 "Mesh %s has a primitive with mode %d. Only triangle lists"
+                 " are supported.\n",
+                 mesh.name.c_str(), mode);
+        continue;
+      }
+      const int attributes = doc.Member(p, "attributes");
+      Primitive primitive;
+      primitive.position = accessor_index(doc.Member(attributes, "POSITION"));
+      primitive.normal = accessor_index(doc.Member(attributes, "NORMAL"));
+      primitive.tangent = accessor_index(doc.Member(attributes, "TANGENT"));
+      primitive.uv = accessor_index(doc.Member(attributes, "TEXCOORD_0"));
+      primitive.uv_alt = accessor_index(doc.Member(attributes, "TEXCOORD_1"));
+      primitive.color = accessor_index(doc.Member(attributes, "COLOR_0"));
+      primitive.joints = accessor_index(doc.Member(attributes, "JOINTS_0"));
+      primitive.weights = accessor_index(doc.Member(attributes, "WEIGHTS_0"));
+      primitive.indices = accessor_index(doc.Member(p, "indices"));
+      primitive.material = doc.Int(doc.Member(p, "material"), -1);
+      if (primitive.material >= num_materials) primitive.material = -1;
+      if (primitive.position < 0) {
+        log_.Log(kLogWarning, "Mesh %s has a primitive with no positions\n",
+                 mesh.name.c_str());
+        continue;
+      }
+      mesh.primitives.push_back(primitive);
+    }
+    meshes_.push_back(mesh);
+  }
+
+  // Skins.
+  const int skins = doc.Member(root, "skins");
+  const int num_nodes = doc.size(doc.Member(root, "nodes"));
+  for (int s = doc.First(skins); s >= 0; s = doc.Next(s)) {
+    Skin skin;
+    const int joints = doc.Member(s, "joints");
+    for (int j = doc.First(joints); j >= 0; j = doc.Next(j)) {
+      const int joint = doc.Int(j, -1);
+      skin.joints.push_back(joint < num_nodes ? joint : -1);
+    }
+    skins_.push_back(skin);
+  }
+
+  // Nodes. Distances are converted by scaling each node's translation, and
+  // later each vertex position, by `position_scale_`.
+  if (distance_unit_scale > 0.0f) {
+    position_scale_ = kCentimetersPerMeter / distance_unit_scale;
+  }
+  const int nodes = doc.Member(root, "nodes");
+  nodes_.resize(num_nodes);
+  int node_index = 0;
+  for (int n = doc.First(nodes); n >= 0; n = doc.Next(n), ++node_index) {
+    Node& node = nodes_[node_index];
+    node.name = doc.String(doc.Member(n, "name"));
+    if (node.name.empty()) {
+      std::ostringstream name;
+      name << "node" << node_index;
+      node.name = name.str();
+    }
+    node.parent = -1;
+    node.mesh = doc.Int(doc.Member(n, "mesh"), -1);
+    if (node.mesh >= static_cast<int>(meshes_.size())) node.mesh = -1;
+    node.skin = doc.Int(doc.Member(n, "skin"), -1);
+    if (node.skin >= static_cast<int>(skins_.size())) node.skin = -1;
+    const int children = doc.Member(n, "children");
+    for (int c = doc.First(children); c >= 0; c = doc.Next(c)) {
+      const int child = doc.Int(c, -1);
+      if (child >= 0 && child < num_nodes) node.children.push_back(child);
+    }
+
+    // Either a column-major matrix, or translation-rotation-scale.
+    float m[16];
+    mat4 local;
+    if (doc.Numbers(doc.Member(n, "matrix"), m, 16) == 16) {
+      local = mat4(m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8],
+                   m[9], m[10], m[11], m[12], m[13], m[14], m[15]);
+    } else {
+      float t[3] = {0.0f, 0.0f, 0.0f};
+      float r[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+      float s[3] = {1.0f, 1.0f, 1.0f};
+      doc.Numbers(doc.Member(n, "translation"), t, 3);
+      doc.Numbers(doc.Member(n, "rotation"), r, 4);
+      doc.Numbers(doc.Member(n, "scale"), s, 3);
+      const quat rotation = quat(r[3], r[0], r[1], r[2]).Normalized();
+      local = mat4::FromTranslationVector(vec3(t[0], t[1], t[2])) *
+              rotation.ToMatrix4() *
+              mat4::FromScaleVector(vec3(s[0], s[1], s[2]));
+    }
+    local(0, 3) *= position_scale_;
+    local(1, 3) *= position_scale_;
+    local(2, 3) *= position_scale_;
+    local.Pack(node.local_transform);
+  }
+  // The nodes must form trees, or the recursion over them would never end.
+  for (int i = 0; i < num_nodes; ++i) {
+    for (size_t c = 0; c < nodes_[i].children.size(); ++c) {
+      Node& child = nodes_[nodes_[i].children[c]];
+      if (child.parent >= 0) {
+        log_.Log(kLogError, "%s: node %s has more than one parent\n",
+                 mesh_file_name_.c_str(), child.name.c_str());
+        return false;
+      }
+      child.parent = i;
+    }
+  }
+  // With at most one parent each, the nodes that can't be reached from a
+  // parentless node are on, or under, a cycle.
+  std::vector<bool> reached(num_nodes, false);
+  std::vector<int> stack;
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_[i].parent < 0) stack.push_back(i);
+  }
+  while (!stack.empty()) {
+    const int node = stack.back();
+    stack.pop_back();
+    reached[node] = true;
+    const std::vector<int>& children = nodes_[node].children;
+    stack.insert(stack.end(), children.begin(), children.end());
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (!reached[i]) {
+      log_.Log(kLogError, "%s: node %s is its own ancestor\n",
+               mesh_file_name_.c_str(), nodes_[i].name.c_str());
+      return false;
+    }
+  }
+
+  // Roots come from the default scene, or are every parentless node.
+  const int scenes = doc.Member(root, "scenes");
+  const int scene = doc.Element(scenes, doc.Int(doc.Member(root, "scene"), 0));
+  const int scene_nodes = doc.Member(scene, "nodes");
+  for (int n = doc.First(scene_nodes); n >= 0; n = doc.Next(n)) {
+    const int index = doc.Int(n, -1);
+    if (index >= 0 && index < num_nodes) root_nodes_.push_back(index);
+  }
+  if (scene < 0) {
+    for (int i = 0; i < num_nodes; ++i) {
+      if (nodes_[i].parent < 0) root_nodes_.push_back(i);
+    }
+  }
+  return true;
+}
+
+void GltfMeshParser::CalculateGlobalTransforms(int node,
+                                               const mat4& parent_transform) {
+  Node& n = nodes_[node];
+  const mat4 global = parent_transform * Mat4FromPacked(n.local_transform);
+  global.Pack(n.global_transform);
+  for (size_t i = 0; i < n.children.size(); ++i) {
+    CalculateGlobalTransforms(n.children[i], global);
+  }
+}
+
+void GltfMeshParser::Recenter() {
+  // Gather the bounds of every mesh from its accessor min/max.
+  vec3 min_position(FLT_MAX);
+  vec3 max_position(-FLT_MAX);
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const Node& node = nodes_[i];
+    if (node.mesh < 0) continue;
+    const mat4 transform = node.skin >= 0
+                               ? mat4::Identity()
+                               : Mat4FromPacked(node.global_transform);
+    const Mesh& mesh = meshes_[node.mesh];
+    for (size_t p = 0; p < mesh.primitives.size(); ++p) {
+      const Accessor& positions = accessors_[mesh.primitives[p].position];
+      if (!positions.has_bounds) continue;
+      const vec3 lo = position_scale_ * vec3(positions.min);
+      const vec3 hi = position_scale_ * vec3(positions.max);
+      for (int corner = 0; corner < 8; ++corner) {
+        const vec3 c(corner & 1 ? hi.x : lo.x, corner & 2 ? hi.y : lo.y,
+                     corner & 4 ? hi.z : lo.z);
+        const vec3 world = transform * c;
+        min_position = vec3::Min(min_position, world);
+        max_position = vec3::Max(max_position, world);
+      }
+    }
+  }
+
+  // Match the FBX behavior: only translate when the origin is outside the
+  // bounding box.
+  const bool contains_origin =
+      min_position.x <= 0.0f && min_position.y <= 0.0f &&
+      min_position.z <= 0.0f && max_position.x >= 0.0f &&
+      max_position.y >= 0.0f && max_position.z >= 0.0f;
+  if (min_position.x > max_position.x || contains_origin) {
+    log_.Log(kLogInfo, "Already centered so ignoring recenter request\n");
+    return;
+  }
+  log_.Log(kLogInfo, "Recentering\n");
+  const vec3 offset = -0.5f * (min_position + max_position);
+  const mat4 translation = mat4::FromTranslationVector(offset);
+  for (size_t i = 0; i < root_nodes_.size(); ++i) {
+    Node& node = nodes_[root_nodes_[i]];
+    (translation * Mat4FromPacked(node.local_transform))
+        .Pack(node.local_transform);
+  }
+  recenter_offset_ = vec3_packed(offset);
+}
+
+bool GltfMeshParser::Load(const char* file_name,
+                          AxisSystem axis_system,
+                          float distance_unit_scale, bool recenter,
+                          VertexAttributeBitmask vertex_attributes) {
+  log_.Log(
+      kLogInfo,
+      "---- mesh_pipeline: %s ------------------------------------------\n",
+      fplutil::BaseFileName(file_name).c_str());
+  mesh_file_name_ = std::string(file_name);
+  input_files_.push_back(mesh_file_name_);
+
+  std::string json;
+  if (!LoadFileData(file_name, &json)) return false;
+  if (!ParseScene(json, distance_unit_scale)) return false;
+
+  // glTF is always y-up, right-handed, with +z forward.
+  if (axis_system != kUnspecifiedAxisSystem) {
+    log_.Log(kLogWarning,
+             "Axis conversion is not supported for glTF. Ignoring --axes.\n");
+  }
+
+  generate_normals_ =
+      vertex_attributes != kVertexAttributeBit_AllAttributesInSourceFile &&
+      (vertex_attributes &
+       (kVertexAttributeBit_Normal | kVertexAttributeBit_Orientation)) != 0;
+
+  for (size_t i = 0; i < root_nodes_.size(); ++i) {
+    CalculateGlobalTransforms(root_nodes_[i], mat4::Identity());
+  }
+  if (recenter) {
+    Recenter();
+    for (size_t i = 0; i < root_nodes_.size(); ++i) {
+      CalculateGlobalTransforms(root_nodes_[i], mat4::Identity());
+    }
+  }
+
+  log_.Log(kLogVerbose, "Parsed %d nodes, %d meshes, %d accessors\n",
+           static_cast<int>(nodes_.size()), static_cast<int>(meshes_.size()),
+           static_cast<int>(accessors_.size()));
+  return true;
+}
+
+int GltfMeshParser::NumVertsUpperBound() const {
+  int num_verts = 0;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    if (nodes_[i].mesh < 0) continue;
+    const Mesh& mesh = meshes_[nodes_[i].mesh];
+    for (size_t p = 0; p < mesh.primitives.size(); ++p) {
+      const Primitive& primitive = mesh.primitives[p];
+      const int source =
+          primitive.indices >= 0 ? primitive.indices : primitive.position;
+      num_verts += static_cast<int>(accessors_[source].count);
+    }
+  }
+  return num_verts;
+}
+
+void GltfMeshParser::GatherPrimitive(const Primitive& primitive, int node,
+                                     int bone_index,
+                                     const std::vector<int>& node_to_bone,
+                                     bool gather_textures,
+                                     FlatMesh* out) const {
+  const Node& n = nodes_[node];
+  const Material* material =
+      primitive.material >= 0 ? &materials_[primitive.material] : nullptr;
+
+  FlatTextures textures;
+  if (gather_textures && material != nullptr) {
+    for (size_t i = 0; i < material->textures.size(); ++i) {
+      textures.Append(material->textures[i]);
+    }
+  }
+  out->SetSurface(textures);
+
+  // If no textures for this primitive, use the material's base color.
+  const bool has_solid_color =
+      textures.Count() == 0 && material != nullptr && material->has_base_color;
+  const vec4 solid_color =
+      has_solid_color ? vec4(material->base_color) : vec4(mathfu::kOnes4f);
+  if (textures.Count() == 0 && !has_solid_color) {
+    log_.Log(kLogWarning, "No texture or solid color found for node %s\n",
+             n.name.c_str());
+  }
+
+  // Skinned vertices are already in bind space. glTF ignores the transform
+  // of the node that the skinned mesh is attached to.
+  const bool skinned =
+      n.skin >= 0 && primitive.joints >= 0 && primitive.weights >= 0;
+  const mat4 point_transform =
+      skinned ? mat4::FromTranslationVector(vec3(recenter_offset_)) *
+                    mat4::FromScaleVector(vec3(position_scale_))
+              : Mat4FromPacked(n.global_transform) *
+                    mat4::FromScaleVector(vec3(position_scale_));
+  const mat3 vector_transform =
+      skinned ? mat3::Identity()
+              : mat4::ToRotationMatrix(Mat4FromPacked(n.global_transform));
+
+  const bool has_normals = primitive.normal >= 0;
+  const bool has_tangents = primitive.tangent >= 0 && has_normals;
+  out->ReportSurfaceVertexAttributes(
+      kVertexAttributeBit_Bone | kVertexAttributeBit_Position |
+      (has_normals || generate_normals_ ? kVertexAttributeBit_Normal : 0) |
+      (has_tangents ? kVertexAttributeBit_Tangent |
+                          kVertexAttributeBit_Orientation
+                    : 0) |
+      (primitive.color >= 0 || has_solid_color ? kVertexAttributeBit_Color
+                                               : 0) |
+      (primitive.uv >= 0 ? kVertexAttributeBit_Uv : 0) |
+      (primitive.uv_alt >= 0 ? kVertexAttributeBit_UvAlt : 0));
+
+  const Accessor kNone;
+  auto accessor = [&](int index) -> const Accessor& {
+    return index >= 0 ? accessors_[index] : kNone;
+  };
+  const Accessor& positions = accessors_[primitive.position];
+  const Accessor& normals = accessor(primitive.normal);
+  const Accessor& tangents = accessor(primitive.tangent);
+  const Accessor& uvs = accessor(primitive.uv);
+  const Accessor& uvs_alt = accessor(primitive.uv_alt);
+  const Accessor& colors = accessor(primitive.color);
+  const Accessor& joints = accessor(primitive.joints);
+  const Accessor& weights = accessor(primitive.weights);
+  const Accessor& indices = accessor(primitive.indices);
+  const std::vector<int>* skin_joints =
+      skinned ? &skins_[n.skin].joints : nullptr;
+
+  const size_t num_corners =
+      primitive.indices >= 0 ? indices.count : positions.count;
+  for (size_t tri = 0; tri + 3 <= num_corners; tri += 3) {
+    uint32_t v[3] = {static_cast<uint32_t>(tri),
+                     static_cast<uint32_t>(tri + 1),
+                     static_cast<uint32_t>(tri + 2)};
+    if (primitive.indices >= 0) {
+      for (int k = 0; k < 3; ++k) ReadUints(indices, tri + k, &v[k], 1);
+    }
+
+    vec3 p[3];
+    for (int k = 0; k < 3; ++k) {
+      float f[3] = {0.0f, 0.0f, 0.0f};
+      ReadFloats(positions, v[k], f, 3);
+      p[k] = point_transform * vec3(f[0], f[1], f[2]);
+    }
+    const vec3 face_normal =
+        vec3::CrossProduct(p[1] - p[0], p[2] - p[0]).Normalized();
+
+    for (int k = 0; k < 3; ++k) {
+      const uint32_t i = v[k];
+      float f[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+      vec3 normal = face_normal;
+      if (has_normals) {
+        ReadFloats(normals, i, f, 3);
+        normal = (vector_transform * vec3(f[0], f[1], f[2])).Normalized();
+      }
+      vec4 tangent = kZeros4f;
+      if (has_tangents) {
+        float t[4] = {1.0f, 0.0f, 0.0f, 1.0f};
+        ReadFloats(tangents, i, t, 4);
+        tangent = vec4(
+            (vector_transform * vec3(t[0], t[1], t[2])).Normalized(), t[3]);
+      }
+      float c[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+      ReadFloats(colors, i, c, 4);
+      const vec4 color =
+          primitive.color >= 0 ? vec4(c[0], c[1], c[2], c[3]) : solid_color;
+      float uv[2] = {0.0f, 0.0f};
+      float uv_alt[2] = {0.0f, 0.0f};
+      ReadFloats(uvs, i, uv, 2);
+      ReadFloats(uvs_alt, i, uv_alt, 2);
+
+      // glTF UVs already have their origin at the top-left, as we do.
+      SkinBinding skin_binding;
+      if (skinned) {
+        uint32_t joint[4] = {0, 0, 0, 0};
+        float weight[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        ReadUints(joints, i, joint, 4);
+        ReadFloats(weights, i, weight, 4);
+        for (int j = 0; j < 4; ++j) {
+          if (weight[j] <= 0.0f || joint[j] >= skin_joints->size()) continue;
+          const int joint_node = (*skin_joints)[joint[j]];
+          if (joint_node < 0 || node_to_bone[joint_node] < 0) continue;
+          skin_binding.AppendInfluence(node_to_bone[joint_node], weight[j],
+                                       log_, n.name.c_str(), i);
+        }
+      }
+      if (!skin_binding.HasInfluences()) {
+        skin_binding.BindRigid(static_cast<SkinBinding::BoneIndex>(bone_index));
+      } else {
+        skin_binding.NormalizeBoneWeights();
+      }
+
+      out->AppendPolyVert(p[k], normal, tangent, color, vec2(uv[0], uv[1]),
+                          vec2(uv_alt[0], uv_alt[1]), skin_binding);
+    }
+  }
+}
+
+void GltfMeshParser::GatherFlatMesh(bool gather_textures, FlatMesh* out) const {
+  const int num_nodes = static_cast<int>(nodes_.size());
+
+  // First pass: nodes with meshes or that are skin joints are bones, as are
+  // all of their ancestors.
+  std::vector<bool> is_bone(num_nodes, false);
+  for (int i = 0; i < num_nodes; ++i) {
+    if (nodes_[i].mesh >= 0) is_bone[i] = true;
+  }
+  for (size_t s = 0; s < skins_.size(); ++s) {
+    for (size_t j = 0; j < skins_[s].joints.size(); ++j) {
+      if (skins_[s].joints[j] >= 0) is_bone[skins_[s].joints[j]] = true;
+    }
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    if (!is_bone[i]) continue;
+    for (int p = nodes_[i].parent; p >= 0 && !is_bone[p];
+         p = nodes_[p].parent) {
+      is_bone[p] = true;
+    }
+  }
+
+  // Second pass: add bones depth-first, so parents precede children.
+  std::vector<int> node_to_bone(num_nodes, -1);
+  std::vector<int> order;
+  std::vector<std::pair<int, int>> stack;  // (node, parent bone)
+  for (size_t r = root_nodes_.size(); r-- > 0;) {
+    stack.push_back(std::make_pair(root_nodes_[r], -1));
+  }
+  while (!stack.empty()) {
+    const int node = stack.back().first;
+    const int parent_bone = stack.back().second;
+    stack.pop_back();
+    if (!is_bone[node] || node_to_bone[node] >= 0) continue;
+    const Node& n = nodes_[node];
+    const mat4 default_bone_transform_inverse =
+        Mat4FromPacked(n.global_transform).Inverse();
+    node_to_bone[node] = static_cast<int>(out->AppendBone(
+        n.name.c_str(), default_bone_transform_inverse, parent_bone));
+    order.push_back(node);
+    for (size_t c = n.children.size(); c-- > 0;) {
+      stack.push_back(std::make_pair(n.children[c], node_to_bone[node]));
+    }
+  }
+
+  // Final pass: one surface per primitive, in bone order.
+  for (size_t o = 0; o < order.size(); ++o) {
+    const int node = order[o];
+    if (nodes_[node].mesh < 0) continue;
+    log_.Log(kLogVerbose, "Node: %s\n", nodes_[node].name.c_str());
+    const Mesh& mesh = meshes_[nodes_[node].mesh];
+    for (size_t p = 0; p < mesh.primitives.size(); ++p) {
+      GatherPrimitive(mesh.primitives[p], node, node_to_bone[node],
+                      node_to_bone, gather_textures, out);
+    }
+  }
+}
+
+}  // namespace fplbase
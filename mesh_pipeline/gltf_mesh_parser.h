@@ -0,0 +1,178 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_MESH_PIPELINE_GLTF_MESH_PARSER_H_
+#define FPLBASE_MESH_PIPELINE_GLTF_MESH_PARSER_H_
+
+#include <string>
+#include <vector>
+
+#include "flat_mesh.h"
+
+namespace fplbase {
+
+/// @class GltfMeshParser
+/// @brief Load glTF 2.0 files (.gltf or binary .glb) and gather them into a
+///        FlatMesh.
+///
+/// Vertex data is read straight out of the binary buffers through accessors.
+/// For .glb files the BIN chunk is referenced in place, so no geometry is
+/// copied until it is appended to the FlatMesh.
+///
+/// As with FBX, every node that has a mesh or is a skin joint, along with its
+/// ancestors, becomes a bone.
+class GltfMeshParser {
+ public:
+  explicit GltfMeshParser(Logger& log)
+      : position_scale_(1.0f),
+        recenter_offset_(kZeros3f),
+        generate_normals_(false),
+        log_(log) {}
+
+  bool Valid() const { return true; }
+
+  bool Load(const char* file_name, AxisSystem axis_system,
+            float distance_unit_scale, bool recenter,
+            VertexAttributeBitmask vertex_attributes);
+
+  // Return an upper bound on the number of vertices in the scene.
+  int NumVertsUpperBound() const;
+
+  // Files read by Load(). Used by the build cache.
+  const std::vector<std::string>& InputFiles() const { return input_files_; }
+
+  // Gather the loaded scene into `out`.
+  void GatherFlatMesh(bool gather_textures, FlatMesh* out) const;
+
+  // A typed, strided view into a buffer. `data` is null when the accessor
+  // has no buffer view, in which case every element is zero.
+  struct Accessor {
+    const uint8_t* data;
+    size_t count;
+    size_t stride;
+    int component_type;
+    int num_components;
+    bool normalized;
+    vec3_packed min;
+    vec3_packed max;
+    bool has_bounds;
+    Accessor()
+        : data(nullptr),
+          count(0),
+          stride(0),
+          component_type(0),
+          num_components(0),
+          normalized(false),
+          min(kZeros3f),
+          max(kZeros3f),
+          has_bounds(false) {}
+  };
+
+  // Indices into `accessors_`, or -1 when not present.
+  struct Primitive {
+    int position;
+    int normal;
+    int tangent;
+    int uv;
+    int uv_alt;
+    int color;
+    int joints;
+    int weights;
+    int indices;
+    int material;  // Index into `materials_`, or -1.
+  };
+
+  struct Mesh {
+    std::string name;
+    std::vector<Primitive> primitives;
+  };
+
+  struct Node {
+    std::string name;
+    vec4_packed local_transform[4];
+    vec4_packed global_transform[4];
+    int parent;
+    int mesh;
+    int skin;
+    std::vector<int> children;
+  };
+
+  struct Skin {
+    std::vector<int> joints;  // Indices into `nodes_`.
+  };
+
+  struct Material {
+    std::string name;
+    std::vector<std::string> textures;  // Base color, emissive, normal.
+    bool has_base_color;
+    vec4_packed base_color;
+    Material() : has_base_color(false), base_color(mathfu::kOnes4f) {}
+  };
+
+ private:
+  FPL_DISALLOW_COPY_AND_ASSIGN(GltfMeshParser);
+
+  bool LoadFileData(const char* file_name, std::string* json);
+  bool ParseScene(const std::string& json, float distance_unit_scale);
+  void CalculateGlobalTransforms(int node, const mat4& parent_transform);
+  void Recenter();
+  void GatherPrimitive(const Primitive& primitive, int node, int bone_index,
+                       const std::vector<int>& node_to_bone,
+                       bool gather_textures, FlatMesh* out) const;
+
+  // The whole .gltf or .glb file. For .glb files, `buffers_[0]` usually
+  // points into the BIN chunk here.
+  std::string file_contents_;
+
+  // Data for buffers that are loaded from other files or data URIs.
+  std::vector<std::string> external_buffers_;
+
+  struct BufferRange {
+    const uint8_t* data;
+    size_t length;
+  };
+  std::vector<BufferRange> buffers_;
+  std::vector<BufferRange> buffer_views_;
+  std::vector<size_t> buffer_view_strides_;
+
+  std::vector<Accessor> accessors_;
+  std::vector<Mesh> meshes_;
+  std::vector<Node> nodes_;
+  std::vector<int> root_nodes_;
+  std::vector<Skin> skins_;
+  std::vector<Material> materials_;
+
+  // Multiplier from meters to the requested distance unit.
+  float position_scale_;
+
+  // Translation applied to skinned vertices when recentering. Rigid vertices
+  // pick it up from their node transforms.
+  vec3_packed recenter_offset_;
+
+  // Generate flat normals for primitives without them.
+  bool generate_normals_;
+
+  // Name of source mesh file. Used to search for textures.
+  std::string mesh_file_name_;
+
+  // The source mesh file and any files it references.
+  std::vector<std::string> input_files_;
+
+  // Information and warnings.
+  Logger& log_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_MESH_PIPELINE_GLTF_MESH_PARSER_H_
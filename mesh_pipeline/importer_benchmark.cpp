@@ -0,0 +1,315 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Times the importers: loading a file, and gathering it into a FlatMesh, as
+// mesh_pipeline does before it writes the .fplmesh file. Each file is
+// imported with ParallelFor() on one thread, then on every core.
+//
+// Usage: importer_benchmark [grid size | mesh file]...
+// Each grid size generates an OBJ and a glTF grid of that many quads square,
+// in the current directory. Mesh files, such as FBX files, are imported as
+// they are. Without arguments, a few grid sizes are timed, and, if the FBX
+// SDK is available, an FBX scene of many small meshes, which the FBX
+// importer gathers on several threads.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "fbx_mesh_parser.h"
+#include "flat_mesh.h"
+#include "flatbuffers/util.h"
+#include "fplutil/file_utils.h"
+#include "gltf_mesh_parser.h"
+#include "obj_mesh_parser.h"
+
+namespace {
+
+const char kObjFile[] = "importer_benchmark.obj";
+const char kGltfFile[] = "importer_benchmark.gltf";
+const char kGltfBufferFile[] = "importer_benchmark.bin";
+const char kFbxFile[] = "importer_benchmark.fbx";
+// The FBX scene: many meshes of a few thousand triangles each.
+const int kFbxNodes = 256;
+const int kFbxNodeGridSize = 40;
+const int kRepeats = 3;
+// Ripples on the grid.
+const float kFrequency = 20.0f;
+const float kHeight = 0.02f;
+
+// A `size` x `size` grid of quads, rippled so that normals vary.
+struct Grid {
+  explicit Grid(int size);
+  int size;
+  std::vector<float> positions;  // xyz per vertex.
+  std::vector<float> normals;    // xyz per vertex.
+  std::vector<float> uvs;        // uv per vertex.
+  std::vector<uint32_t> indices;  // Two triangles per quad.
+};
+
+Grid::Grid(int size) : size(size) {
+  const int row = size + 1;
+  for (int y = 0; y <= size; ++y) {
+    for (int x = 0; x <= size; ++x) {
+      const float fx = static_cast<float>(x) / size;
+      const float fy = static_cast<float>(y) / size;
+      const float height =
+          kHeight * sinf(kFrequency * fx) * cosf(kFrequency * fy);
+      positions.push_back(fx);
+      positions.push_back(fy);
+      positions.push_back(height);
+      const float dx = kHeight * kFrequency * cosf(kFrequency * fx) *
+                       cosf(kFrequency * fy);
+      const float dy = -kHeight * kFrequency * sinf(kFrequency * fx) *
+                       sinf(kFrequency * fy);
+      const float length = sqrtf(dx * dx + dy * dy + 1.0f);
+      normals.push_back(-dx / length);
+      normals.push_back(-dy / length);
+      normals.push_back(1.0f / length);
+      uvs.push_back(fx);
+      uvs.push_back(fy);
+    }
+  }
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      const uint32_t i = static_cast<uint32_t>(y * row + x);
+      const uint32_t quad[6] = {i, i + 1, i + row + 1, i, i + row + 1, i + row};
+      indices.insert(indices.end(), quad, quad + 6);
+    }
+  }
+}
+
+bool WriteObj(const Grid& grid) {
+  std::ostringstream obj;
+  const size_t num_vertices = grid.positions.size() / 3;
+  for (size_t i = 0; i < num_vertices; ++i) {
+    obj << "v " << grid.positions[3 * i] << " " << grid.positions[3 * i + 1]
+        << " " << grid.positions[3 * i + 2] << "\n";
+  }
+  for (size_t i = 0; i < num_vertices; ++i) {
+    obj << "vt " << grid.uvs[2 * i] << " " << grid.uvs[2 * i + 1] << "\n";
+  }
+  for (size_t i = 0; i < num_vertices; ++i) {
+    obj << "vn " << grid.normals[3 * i] << " " << grid.normals[3 * i + 1]
+        << " " << grid.normals[3 * i + 2] << "\n";
+  }
+  for (size_t i = 0; i < grid.indices.size(); i += 3) {
+    obj << "f";
+    for (size_t j = i; j < i + 3; ++j) {
+      const uint32_t v = grid.indices[j] + 1;
+      obj << " " << v << "/" << v << "/" << v;
+    }
+    obj << "\n";
+  }
+  return flatbuffers::SaveFile(kObjFile, obj.str(), false);
+}
+
+// Append the bytes of `values` to `buffer`.
+template <class T>
+size_t AppendBytes(const std::vector<T>& values, std::string* buffer) {
+  const size_t offset = buffer->size();
+  buffer->append(reinterpret_cast<const char*>(values.data()),
+                 values.size() * sizeof(T));
+  return offset;
+}
+
+bool WriteGltf(const Grid& grid) {
+  std::string buffer;
+  const size_t positions = AppendBytes(grid.positions, &buffer);
+  const size_t normals = AppendBytes(grid.normals, &buffer);
+  const size_t uvs = AppendBytes(grid.uvs, &buffer);
+  const size_t indices = AppendBytes(grid.indices, &buffer);
+  const size_t num_vertices = grid.positions.size() / 3;
+
+  std::ostringstream gltf;
+  gltf << "{\"asset\": {\"version\": \"2.0\"},\n"
+       << "\"buffers\": [{\"uri\": \"" << kGltfBufferFile
+       << "\", \"byteLength\": " << buffer.size() << "}],\n"
+       << "\"bufferViews\": [\n"
+       << " {\"buffer\": 0, \"byteOffset\": " << positions
+       << ", \"byteLength\": " << normals - positions << "},\n"
+       << " {\"buffer\": 0, \"byteOffset\": " << normals
+       << ", \"byteLength\": " << uvs - normals << "},\n"
+       << " {\"buffer\": 0, \"byteOffset\": " << uvs
+       << ", \"byteLength\": " << indices - uvs << "},\n"
+       << " {\"buffer\": 0, \"byteOffset\": " << indices
+       << ", \"byteLength\": " << buffer.size() - indices << "}],\n"
+       << "\"accessors\": [\n"
+       << " {\"bufferView\": 0, \"componentType\": 5126, \"count\": "
+       << num_vertices << ", \"type\": \"VEC3\", "
+       << "\"min\": [0, 0, -1], \"max\": [1, 1, 1]},\n"
+       << " {\"bufferView\": 1, \"componentType\": 5126, \"count\": "
+       << num_vertices << ", \"type\": \"VEC3\"},\n"
+       << " {\"bufferView\": 2, \"componentType\": 5126, \"count\": "
+       << num_vertices << ", \"type\": \"VEC2\"},\n"
+       << " {\"bufferView\": 3, \"componentType\": 5125, \"count\": "
+       << grid.indices.size() << ", \"type\": \"SCALAR\"}],\n"
+       << "\"meshes\": [{\"primitives\": [{\"attributes\": {\"POSITION\": 0, "
+       << "\"NORMAL\": 1, \"TEXCOORD_0\": 2}, \"indices\": 3}]}],\n"
+       << "\"nodes\": [{\"mesh\": 0}],\n"
+       << "\"scenes\": [{\"nodes\": [0]}],\n"
+       << "\"scene\": 0}\n";
+  return flatbuffers::SaveFile(kGltfBufferFile, buffer, true) &&
+         flatbuffers::SaveFile(kGltfFile, gltf.str(), false);
+}
+
+typedef std::chrono::steady_clock Clock;
+
+bool HasExtension(const char* file_name, const char* extension) {
+  const std::string actual = fplutil::FileExtension(file_name);
+  if (actual.size() != strlen(extension)) return false;
+  for (size_t i = 0; i < actual.size(); ++i) {
+    if (tolower(actual[i]) != extension[i]) return false;
+  }
+  return true;
+}
+
+// Load `file_name` with the importer for its extension, and gather it into a
+// FlatMesh. Outputs the size of the mesh.
+bool Import(const char* file_name, fplbase::FbxMeshLoader* fbx_loader,
+            fplbase::Logger& log, int* num_vertices, int* num_triangles) {
+  fplbase::MeshPipelineArgs args;
+  args.fbx_file = file_name;
+  args.gather_textures = false;
+  fplbase::FlatMesh mesh(0, args.vertex_attributes, log);
+  std::vector<std::string> input_files;
+  std::vector<std::string> output_files;
+  bool status;
+  if (HasExtension(file_name, "obj")) {
+    fplbase::ObjMeshParser pipe(log);
+    status = fplbase::LoadAndGatherMesh(pipe, args, log, &mesh, &input_files);
+  } else if (HasExtension(file_name, "gltf") ||
+             HasExtension(file_name, "glb")) {
+    fplbase::GltfMeshParser pipe(log);
+    status = fplbase::LoadAndGatherMesh(pipe, args, log, &mesh, &input_files);
+  } else {
+    status = fbx_loader->Load(args, log, &mesh, &input_files, &output_files);
+  }
+  *num_vertices = mesh.NumVertices();
+  *num_triangles = mesh.NumTriangles();
+  return status;
+}
+
+// Import `file_name` kRepeats times with ParallelFor() limited to
+// `num_threads` threads, or one per core if 0. Outputs the fastest time.
+bool TimeImport(const char* file_name, int num_threads,
+                fplbase::FbxMeshLoader* fbx_loader, fplbase::Logger& log,
+                double* milliseconds, int* num_vertices, int* num_triangles) {
+  fplbase::SetParallelForThreads(num_threads);
+  *milliseconds = 0.0;
+  for (int i = 0; i < kRepeats; ++i) {
+    const auto start = Clock::now();
+    if (!Import(file_name, fbx_loader, log, num_vertices, num_triangles)) {
+      return false;
+    }
+    const double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    *milliseconds = i == 0 ? ms : std::min(*milliseconds, ms);
+  }
+  return true;
+}
+
+// Time importing `file_name` on one thread and on every core, and print the
+// results as one row, named `label`.
+bool BenchmarkFile(const char* file_name, const std::string& label,
+                   fplbase::FbxMeshLoader* fbx_loader, fplbase::Logger& log) {
+  double serial_ms = 0.0;
+  double parallel_ms = 0.0;
+  int num_vertices = 0;
+  int num_triangles = 0;
+  if (!TimeImport(file_name, 1, fbx_loader, log, &serial_ms, &num_vertices,
+                  &num_triangles) ||
+      !TimeImport(file_name, 0, fbx_loader, log, &parallel_ms, &num_vertices,
+                  &num_triangles)) {
+    log.Log(fplbase::kLogError, "Can't import %s.\n", file_name);
+    return false;
+  }
+  printf("%10d %10d %12.2f %12.2f %8.2fx  %s\n", num_triangles, num_vertices,
+         serial_ms, parallel_ms,
+         parallel_ms > 0.0 ? serial_ms / parallel_ms : 0.0, label.c_str());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<int> sizes;
+  std::vector<const char*> files;
+  for (int i = 1; i < argc; ++i) {
+    const int size = atoi(argv[i]);
+    if (size > 0) {
+      sizes.push_back(size);
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+  const bool defaults = sizes.empty() && files.empty();
+  if (defaults) {
+    sizes.push_back(64);
+    sizes.push_back(256);
+    sizes.push_back(1024);
+  }
+
+  fplbase::Logger log;
+  log.set_level(fplbase::kLogWarning);
+  fplbase::FbxMeshLoader fbx_loader;
+  printf("%10s %10s %12s %12s %9s  %s\n", "triangles", "vertices",
+         "1 thread ms", "all cores ms", "speedup", "file");
+  bool ok = true;
+  for (size_t i = 0; i < sizes.size() && ok; ++i) {
+    const Grid grid(sizes[i]);
+    if (!WriteObj(grid) || !WriteGltf(grid)) {
+      log.Log(fplbase::kLogError, "Can't write the benchmark files.\n");
+      ok = false;
+      break;
+    }
+    std::ostringstream grid_name;
+    grid_name << " (" << sizes[i] << "x" << sizes[i] << " grid)";
+    ok = BenchmarkFile(kObjFile, kObjFile + grid_name.str(), &fbx_loader,
+                       log) &&
+         BenchmarkFile(kGltfFile, kGltfFile + grid_name.str(), &fbx_loader,
+                       log);
+  }
+  remove(kObjFile);
+  remove(kGltfFile);
+  remove(kGltfBufferFile);
+
+  if (defaults && ok) {
+    if (fbx_loader.WriteGridScene(kFbxFile, kFbxNodes, kFbxNodeGridSize,
+                                  log)) {
+      std::ostringstream scene_name;
+      scene_name << kFbxFile << " (" << kFbxNodes << " meshes, "
+                 << kFbxNodeGridSize << "x" << kFbxNodeGridSize << " grids)";
+      ok = BenchmarkFile(kFbxFile, scene_name.str(), &fbx_loader, log);
+      remove(kFbxFile);
+    }
+  }
+
+  // Files named on the command line, such as FBX files, which can't be
+  // generated.
+  for (size_t i = 0; i < files.size() && ok; ++i) {
+    ok = BenchmarkFile(files[i], files[i], &fbx_loader, log);
+  }
+  return ok ? 0 : 1;
+}
@@ -16,7 +16,8 @@
 #define FPLBASE_MESH_PIPELINE_H_
 
 #include <string>
-#include "fbx_common/fbx_common.h"
+#include <vector>
+#include "pipeline_utils.h"
 #include "flatbuffers/flatbuffers.h"
 #include "fplbase/fpl_common.h"
 #include "materials_generated.h"
@@ -70,27 +71,80 @@ static_assert(
 static const matdef::TextureFormat kDefaultTextureFormat =
     matdef::TextureFormat_AUTO;
 
+// Part of the build cache key. Change this whenever the output for a given
+// input and arguments changes, so that cached conversions are redone.
+static const char kMeshPipelineVersion[] = "mesh_pipeline 1.2";
+
+/// Precision to which vertex attributes are rounded before duplicate vertices
+/// are merged, so that float noise in the source doesn't keep vertices apart.
+/// A value of 0 leaves that attribute unrounded.
+struct VertexQuantization {
+  VertexQuantization() : position_grid(0.0f), normal_bits(0), uv_grid(0.0f) {}
+  bool enabled() const {
+    return position_grid > 0.0f || normal_bits > 0 || uv_grid > 0.0f;
+  }
+
+  float position_grid;  /// Snap positions to multiples of this distance.
+  int normal_bits;      /// Bits per component of normals and tangents.
+  float uv_grid;        /// Snap UVs to multiples of this.
+};
+
 struct MeshPipelineArgs {
   MeshPipelineArgs();
 
-  std::string fbx_file;        /// FBX input file to convert.
+  std::string fbx_file;        /// FBX, glTF or OBJ input file to convert.
   std::string asset_base_dir;  /// Directory from which all assets are loaded.
   std::string asset_rel_dir;   /// Directory (relative to base) to output files.
   std::string texture_extension;  /// Extension of textures in material file.
   std::vector<matdef::TextureFormat> texture_formats;
   matdef::BlendMode blend_mode;
-  fplutil::AxisSystem axis_system;
+  AxisSystem axis_system;
   float distance_unit_scale;
   bool recenter;         /// Translate geometry to origin.
   bool interleaved;      /// Write vertex attributes interleaved.
   bool force32;          /// Force 32bit indices.
   bool embed_materials;  /// Embed material definitions in fplmesh file.
   VertexAttributeBitmask vertex_attributes;  /// Vertex attributes to output.
-  fplutil::LogLevel log_level;  /// Amount of logging to dump during conversion.
+  LogLevel log_level;  /// Amount of logging to dump during conversion.
   bool gather_textures;         /// Gather textures and generate .fplmat files.
+  int max_bones_per_surface;  /// Split surfaces to fit. 0 to never split.
+  VertexQuantization quantization;  /// Rounding applied before dedup.
+  bool export_animations;     /// Output an .fplanim file per FBX take.
+  float animation_tolerance;  /// Max error of keys dropped from animations.
+  bool write_report;  /// Output a .report.json of statistics per .fplmesh.
+  std::string cache_dir;  /// Skip unchanged conversions. Empty to disable.
+  bool force_rebuild;     /// Convert even if the cache is up to date.
 };
 
-int RunMeshPipeline(const MeshPipelineArgs& args, fplutil::Logger& log);
+/// Outcome of converting one file in RunMeshPipelineBatch.
+struct MeshPipelineResult {
+  std::string file_name;
+  bool success;
+  bool up_to_date;      /// Skipped because the build cache was up to date.
+  double milliseconds;  /// Wall time spent converting the file.
+  int num_vertices;
+  int num_triangles;
+};
+
+int RunMeshPipeline(const MeshPipelineArgs& args, Logger& log);
+
+/// Convert each of `files` with `args`, in parallel on `num_threads` threads
+/// (or one per core if `num_threads` is 0), then log a summary of every
+/// conversion. `args.fbx_file` is ignored.
+/// Returns 0 if every file converted successfully.
+int RunMeshPipelineBatch(const MeshPipelineArgs& args,
+                         const std::vector<std::string>& files,
+                         int num_threads, Logger& log);
+
+/// Append the files named by `manifest_or_pattern` to `files`. It can be
+/// - a directory, in which case every .fbx, .obj, .gltf and .glb file in it
+///   is included, or every file with `extension` if that is set,
+/// - a path whose file name has `*` or `?` wildcards, such as `props/*.fbx`,
+/// - or a manifest file listing one input file per line. Relative paths are
+///   relative to the manifest, and lines beginning with `#` are ignored.
+bool GatherBatchFiles(const std::string& manifest_or_pattern,
+                      Logger& log, std::vector<std::string>* files,
+                      const char* extension = nullptr);
 
 }  // namespace fplbase
 
@@ -14,11 +14,15 @@
 
 #include "mesh_pipeline.h"
 
-using fplutil::kLogError;
-using fplutil::kLogImportant;
-using fplutil::kLogInfo;
-using fplutil::kLogVerbose;
-using fplutil::kLogWarning;
+#include <stdlib.h>
+
+#include "mesh_report.h"
+
+using fplbase::kLogError;
+using fplbase::kLogImportant;
+using fplbase::kLogInfo;
+using fplbase::kLogVerbose;
+using fplbase::kLogWarning;
 
 static fplbase::VertexAttributeBitmask ParseVertexAttribute(char c) {
   for (int i = 0; i < fplbase::kVertexAttribute_Count; ++i) {
@@ -39,16 +43,16 @@ static fplbase::VertexAttributeBitmask ParseVertexAttributes(const char* s) {
 
 static matdef::TextureFormat ParseTextureFormat(const char* s) {
   return static_cast<matdef::TextureFormat>(
-      fplutil::IndexOfName(s, matdef::EnumNamesTextureFormat()));
+      fplbase::IndexOfName(s, matdef::EnumNamesTextureFormat()));
 }
 
 static matdef::BlendMode ParseBlendMode(const char* s) {
   return static_cast<matdef::BlendMode>(
-      fplutil::IndexOfName(s, matdef::EnumNamesBlendMode()));
+      fplbase::IndexOfName(s, matdef::EnumNamesBlendMode()));
 }
 
 static bool ParseTextureFormats(
-    const std::string& arg, fplutil::Logger& log,
+    const std::string& arg, fplbase::Logger& log,
     std::vector<matdef::TextureFormat>* texture_formats) {
   // No texture formats specified is valid. Always use `AUTO`.
   if (arg.size() == 0) return true;
@@ -85,8 +89,10 @@ static matdef::BlendMode DefaultBlendMode(
              : matdef::BlendMode_OFF;
 }
 
-static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
-                                  fplbase::MeshPipelineArgs* args) {
+static bool ParseMeshPipelineArgs(int argc, char** argv, fplbase::Logger& log,
+                                  fplbase::MeshPipelineArgs* args, bool* batch,
+                                  int* num_threads,
+                                  std::string* aggregate_report) {
   bool valid_args = true;
 
   // Last parameter is used as file name.
@@ -164,6 +170,91 @@ static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
     } else if (arg == "--embed-materials") {
       args->embed_materials = true;
 
+    } else if (arg == "--cache-dir") {
+      if (i + 1 < argc - 1) {
+        args->cache_dir = std::string(argv[i + 1]);
+        i++;
+      } else {
+        valid_args = false;
+      }
+
+    } else if (arg == "--force") {
+      args->force_rebuild = true;
+
+    } else if (arg == "--max-bones") {
+      if (i + 1 < argc - 1) {
+        args->max_bones_per_surface = atoi(argv[i + 1]);
+        valid_args = args->max_bones_per_surface > 0;
+        i++;
+      } else {
+        valid_args = false;
+      }
+
+    } else if (arg == "--quantize-positions") {
+      if (i + 1 < argc - 1) {
+        args->quantization.position_grid =
+            static_cast<float>(atof(argv[i + 1]));
+        valid_args = args->quantization.position_grid > 0.0f;
+        i++;
+      } else {
+        valid_args = false;
+      }
+
+    } else if (arg == "--quantize-normals") {
+      if (i + 1 < argc - 1) {
+        args->quantization.normal_bits = atoi(argv[i + 1]);
+        valid_args = args->quantization.normal_bits >= 2 &&
+                     args->quantization.normal_bits <= 23;
+        i++;
+      } else {
+        valid_args = false;
+      }
+
+    } else if (arg == "--quantize-uvs") {
+      if (i + 1 < argc - 1) {
+        args->quantization.uv_grid = static_cast<float>(atof(argv[i + 1]));
+        valid_args = args->quantization.uv_grid > 0.0f;
+        i++;
+      } else {
+        valid_args = false;
+      }
+
+    } else if (arg == "--anims") {
+      args->export_animations = true;
+
+    } else if (arg == "--anim-tolerance") {
+      if (i + 1 < argc - 1) {
+        args->animation_tolerance = static_cast<float>(atof(argv[i + 1]));
+        valid_args = args->animation_tolerance >= 0.0f;
+        i++;
+      } else {
+        valid_args = false;
+      }
+
+    } else if (arg == "--report") {
+      args->write_report = true;
+
+    } else if (arg == "--aggregate-report") {
+      if (i + 1 < argc - 1) {
+        *aggregate_report = std::string(argv[i + 1]);
+        i++;
+      } else {
+        valid_args = false;
+      }
+
+    } else if (arg == "--batch") {
+      *batch = true;
+
+      // -j switch
+    } else if (arg == "-j" || arg == "--jobs") {
+      if (i + 1 < argc - 1) {
+        *num_threads = atoi(argv[i + 1]);
+        valid_args = *num_threads > 0;
+        i++;
+      } else {
+        valid_args = false;
+      }
+
       // -f switch
     } else if (arg == "-f" || arg == "--texture-formats") {
       if (i + 1 < argc - 1) {
@@ -192,7 +283,7 @@ static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
 
     } else if (arg == "-a" || arg == "--axes") {
       if (i + 1 < argc - 1) {
-        args->axis_system = fplutil::AxisSystemFromName(argv[i + 1]);
+        args->axis_system = fplbase::AxisSystemFromName(argv[i + 1]);
         valid_args = args->axis_system >= 0;
         if (!valid_args) {
           log.Log(kLogError, "Unknown coordinate system: %s\n\n", argv[i + 1]);
@@ -204,7 +295,7 @@ static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
 
     } else if (arg == "-u" || arg == "--unit") {
       if (i + 1 < argc - 1) {
-        args->distance_unit_scale = fplutil::DistanceUnitFromName(argv[i + 1]);
+        args->distance_unit_scale = fplbase::DistanceUnitFromName(argv[i + 1]);
         valid_args = args->distance_unit_scale > 0.0f;
         if (!valid_args) {
           log.Log(kLogError, "Unknown distance unit: %s\n\n", argv[i + 1]);
@@ -253,10 +344,19 @@ static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
         "                     [-m BLEND_MODE] [-a AXES] [-u (unit)|(scale)]\n"
         "                     [--attrib p|n|t|q|u|v|c|b]\n"
         "                     [--force-32-bit-indices] [--no-textures]\n"
-        "                     [--embed-materials] [-h] [-c] [-l] [-v|-d|-i]\n"
+        "                     [--embed-materials] [--cache-dir CACHE_DIR]\n"
+        "                     [--force] [--batch [-j JOBS]]\n"
+        "                     [--max-bones MAX_BONES]\n"
+        "                     [--anims [--anim-tolerance TOLERANCE]]\n"
+        "                     [--quantize-positions GRID]\n"
+        "                     [--quantize-normals BITS] [--quantize-uvs GRID]\n"
+        "                     [--report] [--aggregate-report OUTPUT_JSON]\n"
+        "                     [-h] [-c] [-l] [-v|-d|-i]\n"
         "                     FBX_FILE\n"
         "\n"
         "Pipeline to convert FBX mesh data into FlatBuffer mesh data.\n"
+        "FBX_FILE may also be a glTF 2.0 (.gltf or .glb) or Wavefront\n"
+        "(.obj) file. The format is chosen by file extension.\n"
         "We output a .fplmesh file and (potentially several) .fplmat files,\n"
         "one for each material. The files have the same base name as\n"
         "FBX_FILE, with a number appended to the .fplmat files if required.\n"
@@ -326,7 +426,7 @@ static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
         "                is in meters, no matter the distance unit of the\n"
         "                FBX file.\n"
         "                (unit) can be one of the following:\n");
-    LogOptions(kOptionIndent, fplutil::DistanceUnitNames(), &log);
+    LogOptions(kOptionIndent, fplbase::DistanceUnitNames(), &log);
 
     log.Log(
         kLogImportant,
@@ -358,6 +458,51 @@ static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
         "  --embed-materials\n"
         "                Embeds the material data directly into the .fplmesh\n"
         "                file instead of generating separate .fplmat files.\n"
+        "  --cache-dir CACHE_DIR\n"
+        "                Record the inputs and outputs of each conversion in\n"
+        "                CACHE_DIR. If the input files, arguments, and\n"
+        "                outputs are unchanged since the last conversion,\n"
+        "                skip the conversion.\n"
+        "  --force       Convert even if the cache is up to date.\n"
+        "  --max-bones MAX_BONES\n"
+        "                Split surfaces so that each is skinned by at most\n"
+        "                MAX_BONES bones (12 to 255), for shaders whose bone\n"
+        "                array is smaller than the skeleton. Each surface\n"
+        "                stores the palette of shader bones it uses, and\n"
+        "                only that palette is uploaded to draw it.\n"
+        "  --quantize-positions GRID\n"
+        "                Snap vertex positions to multiples of GRID, in\n"
+        "                output units, before merging duplicate vertices.\n"
+        "  --quantize-normals BITS\n"
+        "                Round normal and tangent components to BITS bits\n"
+        "                (2 to 23) before merging duplicate vertices.\n"
+        "  --quantize-uvs GRID\n"
+        "                Snap UVs to multiples of GRID, e.g. 0.0002, before\n"
+        "                merging duplicate vertices.\n"
+        "  --anims       Also output an .fplanim file for each animation take\n"
+        "                in an FBX file. With one take, the file has the\n"
+        "                mesh's base name; otherwise the take's name is\n"
+        "                appended. Clips animate the bones of the mesh.\n"
+        "  --anim-tolerance TOLERANCE\n"
+        "                Drop animation keys that interpolation reproduces\n"
+        "                to within TOLERANCE. Defaults to 0.001.\n"
+        "  --report      Also output a .report.json file beside each .fplmesh\n"
+        "                file, with its vertex format and size, index width,\n"
+        "                vertex cache misses per triangle (ACMR), estimated\n"
+        "                memory, bone and material counts, and any\n"
+        "                degenerate triangles or unused vertices.\n"
+        "  --aggregate-report OUTPUT_JSON\n"
+        "                Convert nothing. Instead, report on every .fplmesh\n"
+        "                file named by FBX_FILE, which is a directory, pattern\n"
+        "                or manifest as for --batch, and write the reports and\n"
+        "                their totals to OUTPUT_JSON.\n"
+        "  --batch       Convert many files in one process. FBX_FILE is a\n"
+        "                directory, a pattern such as 'props/*.fbx' (quote\n"
+        "                it so the shell doesn't expand it), or a manifest\n"
+        "                listing one file per line. A summary is printed.\n"
+        "  -j, --jobs JOBS\n"
+        "                Number of files to convert at once in batch mode.\n"
+        "                Defaults to the number of cores.\n"
         "  -v, --verbose output all informative messages\n"
         "  -d, --details output important informative messages\n"
         "  -i, --info    output more than details, less than verbose\n");
@@ -367,11 +512,28 @@ static bool ParseMeshPipelineArgs(int argc, char** argv, fplutil::Logger& log,
 }
 
 int main(int argc, char** argv) {
-  fplutil::Logger log;
+  fplbase::Logger log;
 
   // Parse the command line arguments.
   fplbase::MeshPipelineArgs args;
-  if (!ParseMeshPipelineArgs(argc, argv, log, &args)) return 1;
+  bool batch = false;
+  int num_threads = 0;
+  std::string aggregate_report;
+  if (!ParseMeshPipelineArgs(argc, argv, log, &args, &batch, &num_threads,
+                             &aggregate_report)) {
+    return 1;
+  }
+  if (!aggregate_report.empty()) {
+    log.set_level(args.log_level);
+    std::vector<std::string> meshes;
+    if (!fplbase::GatherBatchFiles(args.fbx_file, log, &meshes, "fplmesh")) {
+      return 1;
+    }
+    return fplbase::RunMeshReport(meshes, aggregate_report, log);
+  }
+  if (!batch) return fplbase::RunMeshPipeline(args, log);
 
-  return fplbase::RunMeshPipeline(args, log);
+  std::vector<std::string> files;
+  if (!fplbase::GatherBatchFiles(args.fbx_file, log, &files)) return 1;
+  return fplbase::RunMeshPipelineBatch(args, files, num_threads, log);
 }
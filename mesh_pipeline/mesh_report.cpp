@@ -0,0 +1,383 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mesh_report.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+#include "build_cache.h"
+#include "flatbuffers/util.h"
+#include "mathfu/glsl_mappings.h"
+#include "mesh_generated.h"
+
+namespace fplbase {
+
+using mathfu::vec3;
+
+namespace {
+
+int AttributeSize(meshdef::Attribute attribute) {
+  switch (attribute) {
+    case meshdef::Attribute_Position3f:
+    case meshdef::Attribute_Normal3f:
+      return 12;
+    case meshdef::Attribute_Tangent4f:
+    case meshdef::Attribute_Orientation4f:
+      return 16;
+    case meshdef::Attribute_TexCoord2f:
+    case meshdef::Attribute_TexCoordAlt2f:
+    case meshdef::Attribute_Position2f:
+      return 8;
+    case meshdef::Attribute_Color4ub:
+    case meshdef::Attribute_BoneIndices4ub:
+    case meshdef::Attribute_BoneWeights4ub:
+    case meshdef::Attribute_TexCoord2us:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+// The vertex format of `mesh`, in the order the runtime lays it out.
+void VertexFormat(const meshdef::Mesh& mesh,
+                  std::vector<meshdef::Attribute>* format) {
+  format->clear();
+  if (mesh.attributes() != nullptr) {
+    for (flatbuffers::uoffset_t i = 0; i < mesh.attributes()->size(); ++i) {
+      const meshdef::Attribute a =
+          static_cast<meshdef::Attribute>(mesh.attributes()->Get(i));
+      if (a == meshdef::Attribute_END) break;
+      format->push_back(a);
+    }
+    return;
+  }
+  // See Mesh::InitFromMeshDef().
+  format->push_back(meshdef::Attribute_Position3f);
+  if (mesh.normals()) format->push_back(meshdef::Attribute_Normal3f);
+  if (mesh.tangents()) format->push_back(meshdef::Attribute_Tangent4f);
+  if (mesh.orientations()) format->push_back(meshdef::Attribute_Orientation4f);
+  if (mesh.colors()) format->push_back(meshdef::Attribute_Color4ub);
+  if (mesh.texcoords()) format->push_back(meshdef::Attribute_TexCoord2f);
+  if (mesh.texcoords_alt()) {
+    format->push_back(meshdef::Attribute_TexCoordAlt2f);
+  }
+  if (mesh.skin_indices() && mesh.skin_weights()) {
+    format->push_back(meshdef::Attribute_BoneIndices4ub);
+    format->push_back(meshdef::Attribute_BoneWeights4ub);
+  }
+}
+
+// Random access to vertex positions, interleaved or not.
+class PositionReader {
+ public:
+  PositionReader(const meshdef::Mesh& mesh,
+                 const std::vector<meshdef::Attribute>& format, int stride)
+      : mesh_(mesh), data_(nullptr), stride_(stride), offset_(0),
+        components_(0) {
+    if (mesh.vertices() == nullptr) return;
+    data_ = mesh.vertices()->data();
+    for (size_t i = 0; i < format.size(); ++i) {
+      if (format[i] == meshdef::Attribute_Position3f ||
+          format[i] == meshdef::Attribute_Position2f) {
+        components_ = format[i] == meshdef::Attribute_Position3f ? 3 : 2;
+        break;
+      }
+      offset_ += AttributeSize(format[i]);
+    }
+  }
+
+  vec3 operator[](size_t i) const {
+    if (data_ == nullptr) {
+      const Vec3* p =
+          mesh_.positions()->Get(static_cast<flatbuffers::uoffset_t>(i));
+      return vec3(p->x(), p->y(), p->z());
+    }
+    float f[3] = {0.0f, 0.0f, 0.0f};
+    memcpy(f, data_ + i * stride_ + offset_, components_ * sizeof(float));
+    return vec3(f[0], f[1], f[2]);
+  }
+
+ private:
+  const meshdef::Mesh& mesh_;
+  const uint8_t* data_;
+  int stride_;
+  int offset_;
+  int components_;
+};
+
+// A triangle is degenerate if it repeats a vertex, or if its edges are
+// parallel to within float precision.
+bool IsDegenerate(const PositionReader& positions, uint32_t a, uint32_t b,
+                  uint32_t c) {
+  if (a == b || b == c || c == a) return true;
+  const vec3 e1 = positions[b] - positions[a];
+  const vec3 e2 = positions[c] - positions[a];
+  const float cross = vec3::CrossProduct(e1, e2).LengthSquared();
+  return cross <= 1e-12f * e1.LengthSquared() * e2.LengthSquared();
+}
+
+std::string JsonString(const std::string& s) {
+  std::string out = "\"";
+  for (size_t i = 0; i < s.size(); ++i) {
+    const char c = s[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+std::string JsonNumber(double value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.3f", value);
+  return buffer;
+}
+
+void WriteMeshReport(const MeshReport& r, const std::string& indent,
+                     std::ostringstream& out) {
+  const std::string in = indent + "  ";
+  out << "{\n";
+  out << in << "\"file\": " << JsonString(r.file_name) << ",\n";
+  out << in << "\"interleaved\": " << (r.interleaved ? "true" : "false")
+      << ",\n";
+  out << in << "\"vertex_format\": [";
+  for (size_t i = 0; i < r.vertex_format.size(); ++i) {
+    out << (i == 0 ? "" : ", ") << JsonString(r.vertex_format[i]);
+  }
+  out << "],\n";
+  out << in << "\"vertex_size\": " << r.vertex_size << ",\n";
+  out << in << "\"vertices\": " << r.num_vertices << ",\n";
+  out << in << "\"unused_vertices\": " << r.num_unused_vertices << ",\n";
+  out << in << "\"triangles\": " << r.num_triangles << ",\n";
+  out << in << "\"degenerate_triangles\": " << r.num_degenerate_triangles
+      << ",\n";
+  out << in << "\"materials\": " << r.num_materials << ",\n";
+  out << in << "\"bones\": " << r.num_bones << ",\n";
+  out << in << "\"shader_bones\": " << r.num_shader_bones << ",\n";
+  out << in << "\"acmr\": " << JsonNumber(r.acmr) << ",\n";
+  out << in << "\"vertex_bytes\": " << r.vertex_bytes << ",\n";
+  out << in << "\"index_bytes\": " << r.index_bytes << ",\n";
+  out << in << "\"estimated_bytes\": " << r.vertex_bytes + r.index_bytes
+      << ",\n";
+  out << in << "\"surfaces\": [";
+  for (size_t i = 0; i < r.surfaces.size(); ++i) {
+    const SurfaceReport& s = r.surfaces[i];
+    out << (i == 0 ? "\n" : ",\n") << in << "  {"
+        << "\"material\": " << JsonString(s.material)
+        << ", \"triangles\": " << s.num_triangles
+        << ", \"degenerate_triangles\": " << s.num_degenerate_triangles
+        << ", \"vertices\": " << s.num_vertices
+        << ", \"index_size\": " << s.index_size
+        << ", \"palette_size\": " << s.palette_size
+        << ", \"acmr\": " << JsonNumber(s.acmr) << "}";
+  }
+  out << (r.surfaces.empty() ? "]\n" : "\n" + in + "]\n");
+  out << indent << "}";
+}
+
+}  // namespace
+
+bool AnalyzeMesh(const void* data, size_t size, const std::string& file_name,
+                 MeshReport* report) {
+  flatbuffers::Verifier verifier(static_cast<const uint8_t*>(data), size);
+  if (!meshdef::VerifyMeshBuffer(verifier)) return false;
+  const meshdef::Mesh& mesh = *meshdef::GetMesh(data);
+
+  MeshReport& r = *report;
+  r = MeshReport();
+  r.file_name = file_name;
+  r.interleaved = mesh.vertices() != nullptr;
+
+  std::vector<meshdef::Attribute> format;
+  VertexFormat(mesh, &format);
+  for (size_t i = 0; i < format.size(); ++i) {
+    r.vertex_format.push_back(meshdef::EnumNameAttribute(format[i]));
+    r.vertex_size += AttributeSize(format[i]);
+  }
+  if (r.interleaved) {
+    if (r.vertex_size == 0) return false;
+    r.num_vertices = static_cast<int>(mesh.vertices()->size() / r.vertex_size);
+  } else {
+    if (mesh.positions() == nullptr) return false;
+    r.num_vertices = static_cast<int>(mesh.positions()->size());
+  }
+  r.num_bones = mesh.bone_parents() ? mesh.bone_parents()->size() : 0;
+  r.num_shader_bones =
+      mesh.shader_to_mesh_bones() ? mesh.shader_to_mesh_bones()->size() : 0;
+  r.vertex_bytes = static_cast<size_t>(r.num_vertices) * r.vertex_size;
+
+  // Simulate a FIFO vertex cache over each surface in turn. A vertex is in
+  // the cache if it was inserted fewer than kReportVertexCacheSize misses ago.
+  const PositionReader positions(mesh, format, r.vertex_size);
+  std::vector<int64_t> inserted(r.num_vertices, -1);
+  std::vector<int> last_surface(r.num_vertices, -1);
+  std::set<std::string> materials;
+  int64_t misses = 0;
+  int total_misses = 0;
+  for (flatbuffers::uoffset_t s = 0; s < mesh.surfaces()->size(); ++s) {
+    const meshdef::Surface& surface = *mesh.surfaces()->Get(s);
+    SurfaceReport sr;
+    sr.material = surface.material()->str();
+    materials.insert(sr.material);
+    sr.palette_size =
+        surface.bone_palette() ? surface.bone_palette()->size() : 0;
+
+    const bool wide = surface.indices32() != nullptr;
+    const size_t num_indices =
+        wide ? surface.indices32()->size()
+             : surface.indices() ? surface.indices()->size() : 0;
+    sr.index_size = wide ? 4 : 2;
+    sr.num_triangles = static_cast<int>(num_indices / 3);
+    r.index_bytes += num_indices * sr.index_size;
+
+    const int64_t surface_start = misses;
+    uint32_t tri[3];
+    for (size_t i = 0; i < num_indices; ++i) {
+      const uint32_t v = wide ? surface.indices32()->Get(i)
+                              : surface.indices()->Get(i);
+      if (v >= static_cast<uint32_t>(r.num_vertices)) return false;
+      if (inserted[v] < surface_start ||
+          misses - inserted[v] >= kReportVertexCacheSize) {
+        inserted[v] = misses++;
+      }
+      if (last_surface[v] != static_cast<int>(s)) {
+        last_surface[v] = static_cast<int>(s);
+        sr.num_vertices++;
+      }
+      tri[i % 3] = v;
+      if (i % 3 == 2 && IsDegenerate(positions, tri[0], tri[1], tri[2])) {
+        sr.num_degenerate_triangles++;
+      }
+    }
+    const int surface_misses = static_cast<int>(misses - surface_start);
+    sr.acmr = sr.num_triangles > 0
+                  ? static_cast<double>(surface_misses) / sr.num_triangles
+                  : 0.0;
+    total_misses += surface_misses;
+    r.num_triangles += sr.num_triangles;
+    r.num_degenerate_triangles += sr.num_degenerate_triangles;
+    r.surfaces.push_back(sr);
+  }
+  r.num_materials = static_cast<int>(materials.size());
+  r.acmr = r.num_triangles > 0
+               ? static_cast<double>(total_misses) / r.num_triangles
+               : 0.0;
+  for (int v = 0; v < r.num_vertices; ++v) {
+    if (last_surface[v] < 0) r.num_unused_vertices++;
+  }
+  return true;
+}
+
+bool AnalyzeMeshFile(const std::string& file_name, Logger& log,
+                     MeshReport* report) {
+  std::string data;
+  if (!flatbuffers::LoadFile(file_name.c_str(), true, &data)) {
+    log.Log(kLogError, "Could not read %s\n", file_name.c_str());
+    return false;
+  }
+  if (!AnalyzeMesh(data.data(), data.size(), file_name, report)) {
+    log.Log(kLogError, "%s is not a valid mesh\n", file_name.c_str());
+    return false;
+  }
+  return true;
+}
+
+std::string MeshReportJson(const MeshReport& report) {
+  std::ostringstream out;
+  WriteMeshReport(report, "", out);
+  out << "\n";
+  return out.str();
+}
+
+std::string AggregateMeshReportJson(const std::vector<MeshReport>& reports) {
+  MeshReport total;
+  for (size_t i = 0; i < reports.size(); ++i) {
+    const MeshReport& r = reports[i];
+    total.num_vertices += r.num_vertices;
+    total.num_unused_vertices += r.num_unused_vertices;
+    total.num_triangles += r.num_triangles;
+    total.num_degenerate_triangles += r.num_degenerate_triangles;
+    total.num_materials += r.num_materials;
+    total.num_bones = std::max(total.num_bones, r.num_bones);
+    total.num_shader_bones = std::max(total.num_shader_bones,
+                                      r.num_shader_bones);
+    total.acmr += r.acmr * r.num_triangles;
+    total.vertex_bytes += r.vertex_bytes;
+    total.index_bytes += r.index_bytes;
+  }
+  if (total.num_triangles > 0) total.acmr /= total.num_triangles;
+
+  std::ostringstream out;
+  out << "{\n  \"meshes\": [";
+  for (size_t i = 0; i < reports.size(); ++i) {
+    out << (i == 0 ? "\n    " : ",\n    ");
+    WriteMeshReport(reports[i], "    ", out);
+  }
+  out << (reports.empty() ? "],\n" : "\n  ],\n");
+  out << "  \"totals\": {\n"
+      << "    \"meshes\": " << reports.size() << ",\n"
+      << "    \"vertices\": " << total.num_vertices << ",\n"
+      << "    \"unused_vertices\": " << total.num_unused_vertices << ",\n"
+      << "    \"triangles\": " << total.num_triangles << ",\n"
+      << "    \"degenerate_triangles\": " << total.num_degenerate_triangles
+      << ",\n"
+      << "    \"materials\": " << total.num_materials << ",\n"
+      << "    \"max_bones\": " << total.num_bones << ",\n"
+      << "    \"max_shader_bones\": " << total.num_shader_bones << ",\n"
+      << "    \"acmr\": " << JsonNumber(total.acmr) << ",\n"
+      << "    \"vertex_bytes\": " << total.vertex_bytes << ",\n"
+      << "    \"index_bytes\": " << total.index_bytes << ",\n"
+      << "    \"estimated_bytes\": "
+      << total.vertex_bytes + total.index_bytes << "\n"
+      << "  }\n}\n";
+  return out.str();
+}
+
+int RunMeshReport(const std::vector<std::string>& files,
+                  const std::string& output_file, Logger& log) {
+  std::vector<MeshReport> reports;
+  bool all_valid = true;
+  for (size_t i = 0; i < files.size(); ++i) {
+    MeshReport report;
+    if (AnalyzeMeshFile(files[i], log, &report)) {
+      reports.push_back(report);
+    } else {
+      all_valid = false;
+    }
+  }
+
+  const std::string json = AggregateMeshReportJson(reports);
+  bool changed;
+  if (!WriteFileIfChanged(output_file, json.data(), json.size(), log,
+                          &changed)) {
+    return 1;
+  }
+  log.Log(kLogImportant, "Reported on %d meshes in %s\n",
+          static_cast<int>(reports.size()), output_file.c_str());
+  return all_valid ? 0 : 1;
+}
+
+}  // namespace fplbase
@@ -0,0 +1,105 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runtime cost statistics and validation of .fplmesh files, output as JSON.
+
+#ifndef FPLBASE_MESH_PIPELINE_MESH_REPORT_H_
+#define FPLBASE_MESH_PIPELINE_MESH_REPORT_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "fplutil/file_utils.h"
+#include "pipeline_utils.h"
+
+namespace fplbase {
+
+// Size of the FIFO post-transform vertex cache that ACMR is measured against.
+static const int kReportVertexCacheSize = 32;
+
+struct SurfaceReport {
+  SurfaceReport()
+      : num_triangles(0),
+        num_degenerate_triangles(0),
+        num_vertices(0),
+        index_size(0),
+        palette_size(0),
+        acmr(0.0) {}
+
+  std::string material;
+  int num_triangles;
+  int num_degenerate_triangles;  // Repeated indices, or zero area.
+  int num_vertices;              // Distinct vertices referenced.
+  int index_size;                // Bytes per index: 2 or 4.
+  int palette_size;              // Bones in the surface's palette, or 0.
+  double acmr;                   // Vertex cache misses per triangle.
+};
+
+struct MeshReport {
+  MeshReport()
+      : interleaved(false),
+        vertex_size(0),
+        num_vertices(0),
+        num_unused_vertices(0),
+        num_triangles(0),
+        num_degenerate_triangles(0),
+        num_materials(0),
+        num_bones(0),
+        num_shader_bones(0),
+        acmr(0.0),
+        vertex_bytes(0),
+        index_bytes(0) {}
+
+  std::string file_name;
+  bool interleaved;
+  std::vector<std::string> vertex_format;  // Attribute names, in order.
+  int vertex_size;                         // Bytes per vertex.
+  int num_vertices;
+  int num_unused_vertices;  // Not referenced by any surface.
+  int num_triangles;
+  int num_degenerate_triangles;
+  int num_materials;  // Distinct materials across surfaces.
+  int num_bones;
+  int num_shader_bones;
+  double acmr;  // Over all surfaces, each starting with an empty cache.
+  size_t vertex_bytes;  // Estimated vertex buffer memory.
+  size_t index_bytes;   // Estimated index buffer memory.
+  std::vector<SurfaceReport> surfaces;
+};
+
+// Analyze the .fplmesh FlatBuffer in `data`. Returns false if it isn't a
+// valid mesh.
+bool AnalyzeMesh(const void* data, size_t size, const std::string& file_name,
+                 MeshReport* report);
+
+// Load and analyze the .fplmesh file `file_name`.
+bool AnalyzeMeshFile(const std::string& file_name, Logger& log,
+                     MeshReport* report);
+
+// Format `report` as a JSON object.
+std::string MeshReportJson(const MeshReport& report);
+
+// Format `reports` as a JSON object with an array of the individual reports
+// and their totals.
+std::string AggregateMeshReportJson(const std::vector<MeshReport>& reports);
+
+// Analyze every file in `files` and write their aggregate report to
+// `output_file`. Returns 0 if every file was analyzed.
+int RunMeshReport(const std::vector<std::string>& files,
+                  const std::string& output_file, Logger& log);
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_MESH_PIPELINE_MESH_REPORT_H_
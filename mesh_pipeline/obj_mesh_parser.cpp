@@ -0,0 +1,602 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "obj_mesh_parser.h"
+
+#include <float.h>
+#include <stdlib.h>
+#include <climits>
+#include <thread>
+
+#include "flatbuffers/util.h"
+
+namespace fplbase {
+
+// Don't bother splitting files smaller than this across threads.
+static const size_t kMinChunkSize = 256 * 1024;
+
+// Marks a corner attribute that was not specified, e.g. `f 1//2`.
+static const int kMissingIndex = INT_MIN;
+
+// OBJ UVs have the v-coordinate inverted from OpenGL, as with FBX.
+static inline vec2 Vec2FromObjUv(float u, float v) { return vec2(u, 1.0f - v); }
+
+static inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+static inline bool IsEndOfLine(char c) {
+  return c == '\n' || c == '\r' || c == '\0';
+}
+
+static inline const char* SkipSpaces(const char* p) {
+  while (IsSpace(*p)) ++p;
+  return p;
+}
+
+static inline const char* SkipLine(const char* p, const char* end) {
+  while (p < end && *p != '\n') ++p;
+  return p < end ? p + 1 : end;
+}
+
+// Return the rest of the line, with trailing whitespace stripped.
+static std::string RestOfLine(const char* p) {
+  p = SkipSpaces(p);
+  const char* e = p;
+  while (!IsEndOfLine(*e)) ++e;
+  while (e > p && IsSpace(e[-1])) --e;
+  return std::string(p, e);
+}
+
+// Return true if `p` starts with `keyword` followed by whitespace.
+static inline bool IsKeyword(const char* p, const char* keyword) {
+  while (*keyword) {
+    if (*p++ != *keyword++) return false;
+  }
+  return IsSpace(*p);
+}
+
+// Parse up to `max_count` floats from the line at `p`. Returns number parsed.
+static int ParseFloats(const char* p, float* out, int max_count) {
+  int count = 0;
+  while (count < max_count) {
+    p = SkipSpaces(p);
+    if (IsEndOfLine(*p)) break;
+    char* next;
+    out[count] = strtof(p, &next);
+    if (next == p) break;
+    ++count;
+    p = next;
+  }
+  return count;
+}
+
+// The results of tokenizing a contiguous run of lines.
+// Indices are kept in their raw form until every chunk has been counted.
+struct ObjChunk {
+  struct RawCorner {
+    // 1-based absolute index, or, if the matching `relative` bit is set, the
+    // 0-based index relative to the first element of this chunk (which may
+    // be negative, referencing a previous chunk).
+    int index[3];
+    uint8_t relative;
+  };
+  struct RawFace {
+    int first_corner;
+    int num_corners;
+    int material;  // Index into `material_names`, or -1 to inherit.
+  };
+
+  std::vector<vec3_packed> positions;
+  std::vector<vec4_packed> colors;
+  std::vector<vec2_packed> uvs;
+  std::vector<vec3_packed> normals;
+  std::vector<RawCorner> corners;
+  std::vector<RawFace> faces;
+  std::vector<std::string> material_names;
+  std::vector<std::string> material_libraries;
+  bool has_colors;
+  int bad_lines;
+
+  ObjChunk() : has_colors(false), bad_lines(0) {}
+
+  void Parse(const char* p, const char* end) {
+    int current_material = -1;
+    while (p < end) {
+      p = SkipSpaces(p);
+      switch (*p) {
+        case 'v':
+          if (IsSpace(p[1])) {
+            ParsePosition(p + 1);
+          } else if (p[1] == 't' && IsSpace(p[2])) {
+            float uv[2] = {0.0f, 0.0f};
+            ParseFloats(p + 2, uv, 2);
+            uvs.push_back(vec2_packed(Vec2FromObjUv(uv[0], uv[1])));
+          } else if (p[1] == 'n' && IsSpace(p[2])) {
+            float n[3] = {0.0f, 0.0f, 0.0f};
+            if (ParseFloats(p + 2, n, 3) != 3) ++bad_lines;
+            normals.push_back(vec3_packed(vec3(n[0], n[1], n[2])));
+          }
+          break;
+        case 'f':
+          if (IsSpace(p[1])) ParseFace(p + 1, current_material);
+          break;
+        case 'u':
+          if (IsKeyword(p, "usemtl")) {
+            current_material = static_cast<int>(material_names.size());
+            material_names.push_back(RestOfLine(p + 6));
+          }
+          break;
+        case 'm':
+          if (IsKeyword(p, "mtllib")) {
+            material_libraries.push_back(RestOfLine(p + 6));
+          }
+          break;
+        default:
+          // Comments, groups, smoothing groups, lines and points are ignored.
+          break;
+      }
+      p = SkipLine(p, end);
+    }
+  }
+
+ private:
+  void ParsePosition(const char* p) {
+    float v[6] = {0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+    const int count = ParseFloats(p, v, 6);
+    if (count < 3) ++bad_lines;
+    positions.push_back(vec3_packed(vec3(v[0], v[1], v[2])));
+
+    // Vertex colors are a common extension: `v x y z r g b`.
+    if (count == 6 && !has_colors) {
+      has_colors = true;
+      colors.resize(positions.size() - 1, vec4_packed(mathfu::kOnes4f));
+    }
+    if (has_colors) {
+      colors.push_back(vec4_packed(vec4(v[3], v[4], v[5], 1.0f)));
+    }
+  }
+
+  void ParseFace(const char* p, int material) {
+    RawFace face;
+    face.first_corner = static_cast<int>(corners.size());
+    face.material = material;
+    const int counts[3] = {static_cast<int>(positions.size()),
+                           static_cast<int>(uvs.size()),
+                           static_cast<int>(normals.size())};
+    for (;;) {
+      p = SkipSpaces(p);
+      if (IsEndOfLine(*p)) break;
+
+      // Parse `v`, `v/vt`, `v//vn` or `v/vt/vn`.
+      RawCorner corner;
+      corner.relative = 0;
+      for (int i = 0; i < 3; ++i) {
+        corner.index[i] = kMissingIndex;
+        if (i > 0) {
+          if (*p != '/') continue;
+          ++p;
+        }
+        char* next;
+        const long value = strtol(p, &next, 10);
+        if (next == p) continue;
+        p = next;
+        if (value < 0) {
+          corner.index[i] = counts[i] + static_cast<int>(value);
+          corner.relative |= 1 << i;
+        } else {
+          corner.index[i] = static_cast<int>(value);
+        }
+      }
+      if (corner.index[0] == kMissingIndex) {
+        ++bad_lines;
+        return;
+      }
+      corners.push_back(corner);
+      while (!IsSpace(*p) && !IsEndOfLine(*p)) ++p;
+    }
+
+    face.num_corners = static_cast<int>(corners.size()) - face.first_corner;
+    if (face.num_corners < 3) {
+      corners.resize(face.first_corner);
+      ++bad_lines;
+      return;
+    }
+    faces.push_back(face);
+  }
+};
+
+bool ObjMeshParser::Load(const char* file_name,
+                         AxisSystem axis_system,
+                         float distance_unit_scale, bool recenter,
+                         VertexAttributeBitmask vertex_attributes) {
+  log_.Log(
+      kLogInfo,
+      "---- mesh_pipeline: %s ------------------------------------------\n",
+      fplutil::BaseFileName(file_name).c_str());
+
+  std::string contents;
+  if (!flatbuffers::LoadFile(file_name, true, &contents)) {
+    log_.Log(kLogError, "Could not read %s\n", file_name);
+    return false;
+  }
+  mesh_file_name_ = std::string(file_name);
+  input_files_.push_back(mesh_file_name_);
+
+  // OBJ files carry no unit or axis information.
+  if (axis_system != kUnspecifiedAxisSystem) {
+    log_.Log(kLogWarning,
+             "OBJ files have no coordinate system. Ignoring --axes.\n");
+  }
+  if (distance_unit_scale > 0.0f) {
+    log_.Log(kLogWarning,
+             "OBJ files have no distance unit. Ignoring --unit.\n");
+  }
+
+  // Split the file into line-aligned chunks, one per thread.
+  const char* const begin = contents.c_str();
+  const char* const end = begin + contents.size();
+  const size_t max_chunks = contents.size() / kMinChunkSize + 1;
+  const size_t num_chunks = std::max<size_t>(
+      1, std::min<size_t>(std::thread::hardware_concurrency(), max_chunks));
+  std::vector<const char*> boundaries(num_chunks + 1, end);
+  boundaries[0] = begin;
+  for (size_t i = 1; i < num_chunks; ++i) {
+    const char* split = begin + contents.size() * i / num_chunks;
+    boundaries[i] = std::max(SkipLine(split, end), boundaries[i - 1]);
+  }
+
+  // Tokenize every chunk in parallel.
+  std::vector<ObjChunk> chunks(num_chunks);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_chunks; ++i) {
+    threads.push_back(std::thread(&ObjChunk::Parse, &chunks[i], boundaries[i],
+                                  boundaries[i + 1]));
+  }
+  chunks[0].Parse(boundaries[0], boundaries[1]);
+  for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+
+  // Concatenate the chunks, converting raw indices into absolute 0-based
+  // indices. Any chunk with vertex colors forces colors for the whole file.
+  bool has_colors = false;
+  size_t totals[4] = {0, 0, 0, 0};
+  int bad_lines = 0;
+  for (size_t i = 0; i < num_chunks; ++i) {
+    has_colors |= chunks[i].has_colors;
+    totals[0] += chunks[i].positions.size();
+    totals[1] += chunks[i].uvs.size();
+    totals[2] += chunks[i].normals.size();
+    totals[3] += chunks[i].corners.size();
+    bad_lines += chunks[i].bad_lines;
+  }
+  positions_.reserve(totals[0]);
+  uvs_.reserve(totals[1]);
+  normals_.reserve(totals[2]);
+  corners_.reserve(totals[3]);
+  if (has_colors) colors_.reserve(totals[0]);
+
+  int current_material = -1;
+  for (size_t c = 0; c < num_chunks; ++c) {
+    ObjChunk& chunk = chunks[c];
+    const int base[3] = {static_cast<int>(positions_.size()),
+                         static_cast<int>(uvs_.size()),
+                         static_cast<int>(normals_.size())};
+    const int limit[3] = {static_cast<int>(totals[0]),
+                          static_cast<int>(totals[1]),
+                          static_cast<int>(totals[2])};
+    const int corner_base = static_cast<int>(corners_.size());
+
+    for (size_t i = 0; i < chunk.corners.size(); ++i) {
+      const ObjChunk::RawCorner& raw = chunk.corners[i];
+      int index[3];
+      for (int k = 0; k < 3; ++k) {
+        if (raw.index[k] == kMissingIndex) {
+          index[k] = -1;
+          continue;
+        }
+        index[k] = raw.relative & (1 << k) ? base[k] + raw.index[k]
+                                           : raw.index[k] - 1;
+        if (index[k] < 0 || index[k] >= limit[k]) {
+          ++bad_lines;
+          index[k] = k == 0 ? 0 : -1;
+        }
+      }
+      const Corner corner = {index[0], index[1], index[2]};
+      corners_.push_back(corner);
+    }
+
+    // Map chunk-local material names to global material indices.
+    std::vector<int> chunk_materials(chunk.material_names.size());
+    for (size_t i = 0; i < chunk.material_names.size(); ++i) {
+      const std::string& name = chunk.material_names[i];
+      auto found = material_indices_.find(name);
+      if (found == material_indices_.end()) {
+        const int index = static_cast<int>(materials_.size());
+        found = material_indices_.insert(std::make_pair(name, index)).first;
+        materials_.push_back(Material());
+        materials_.back().name = name;
+      }
+      chunk_materials[i] = found->second;
+    }
+    for (size_t i = 0; i < chunk.faces.size(); ++i) {
+      const ObjChunk::RawFace& raw = chunk.faces[i];
+      if (raw.material >= 0) current_material = chunk_materials[raw.material];
+      const Face face = {corner_base + raw.first_corner, raw.num_corners,
+                         current_material};
+      faces_.push_back(face);
+    }
+
+    positions_.insert(positions_.end(), chunk.positions.begin(),
+                      chunk.positions.end());
+    uvs_.insert(uvs_.end(), chunk.uvs.begin(), chunk.uvs.end());
+    normals_.insert(normals_.end(), chunk.normals.begin(), chunk.normals.end());
+    if (has_colors) {
+      if (chunk.has_colors) {
+        colors_.insert(colors_.end(), chunk.colors.begin(), chunk.colors.end());
+      } else {
+        colors_.resize(positions_.size(), vec4_packed(mathfu::kOnes4f));
+      }
+    }
+
+    for (size_t i = 0; i < chunk.material_libraries.size(); ++i) {
+      LoadMaterialLibrary(chunk.material_libraries[i]);
+    }
+
+    // Release the chunk's memory as we go.
+    chunk = ObjChunk();
+  }
+
+  if (bad_lines > 0) {
+    log_.Log(kLogWarning, "%s: %d malformed lines or out of range indices\n",
+             file_name, bad_lines);
+  }
+  log_.Log(kLogVerbose,
+           "Parsed %d positions, %d uvs, %d normals, %d faces on %d threads\n",
+           static_cast<int>(positions_.size()), static_cast<int>(uvs_.size()),
+           static_cast<int>(normals_.size()), static_cast<int>(faces_.size()),
+           static_cast<int>(num_chunks));
+
+  // Generate normals. Leaves existing normal data if it already exists.
+  if (vertex_attributes != kVertexAttributeBit_AllAttributesInSourceFile &&
+      (vertex_attributes &
+       (kVertexAttributeBit_Normal | kVertexAttributeBit_Orientation))) {
+    GenerateNormals();
+  }
+
+  if (recenter) Recenter();
+  return true;
+}
+
+void ObjMeshParser::LoadMaterialLibrary(const std::string& mtl_file_name) {
+  const std::string full_name =
+      fplutil::DirectoryName(mesh_file_name_) + mtl_file_name;
+  std::string contents;
+  if (!flatbuffers::LoadFile(full_name.c_str(), false, &contents)) {
+    log_.Log(kLogWarning, "Could not read material library %s\n",
+             full_name.c_str());
+    return;
+  }
+  input_files_.push_back(full_name);
+
+  // Texture slots, in the same order as the FBX kTextureProperties.
+  enum { kDiffuse, kEmissive, kNormalMap, kBump, kTextureSlotCount };
+  std::string slots[kTextureSlotCount];
+  Material* material = nullptr;
+  auto finish_material = [&]() {
+    if (material == nullptr) return;
+    material->textures.clear();
+    for (int i = 0; i < kTextureSlotCount; ++i) {
+      if (!slots[i].empty()) material->textures.push_back(slots[i]);
+      slots[i].clear();
+    }
+  };
+
+  const char* p = contents.c_str();
+  const char* const end = p + contents.size();
+  for (; p < end; p = SkipLine(p, end)) {
+    p = SkipSpaces(p);
+    if (IsKeyword(p, "newmtl")) {
+      finish_material();
+      const std::string name = RestOfLine(p + 6);
+      auto found = material_indices_.find(name);
+      material = found == material_indices_.end() ? nullptr
+                                                  : &materials_[found->second];
+      continue;
+    }
+    if (material == nullptr) continue;
+
+    // Texture maps may be preceded by options (e.g. `-bm 0.5`), so we take
+    // the last token as the file name.
+    int slot = -1;
+    const char* args = nullptr;
+    if (IsKeyword(p, "Kd")) {
+      float kd[3] = {1.0f, 1.0f, 1.0f};
+      if (ParseFloats(p + 2, kd, 3) == 3) {
+        material->has_diffuse_color = true;
+        material->diffuse_color = vec4_packed(vec4(kd[0], kd[1], kd[2], 1.0f));
+      }
+    } else if (IsKeyword(p, "map_Kd")) {
+      slot = kDiffuse;
+      args = p + 6;
+    } else if (IsKeyword(p, "map_Ke")) {
+      slot = kEmissive;
+      args = p + 6;
+    } else if (IsKeyword(p, "norm")) {
+      slot = kNormalMap;
+      args = p + 4;
+    } else if (IsKeyword(p, "map_Bump") || IsKeyword(p, "map_bump")) {
+      slot = kBump;
+      args = p + 8;
+    } else if (IsKeyword(p, "bump")) {
+      slot = kBump;
+      args = p + 4;
+    }
+    if (slot < 0) continue;
+
+    const std::string line = RestOfLine(args);
+    const size_t last_space = line.find_last_of(" \t");
+    const std::string texture = last_space == std::string::npos
+                                    ? line
+                                    : line.substr(last_space + 1);
+    slots[slot] = FindSourceTextureFileName(mesh_file_name_, texture, log_);
+  }
+  finish_material();
+}
+
+void ObjMeshParser::GenerateNormals() {
+  // Only corners without an explicit normal need one generated.
+  bool missing = false;
+  for (size_t i = 0; i < corners_.size() && !missing; ++i) {
+    missing = corners_[i].normal < 0;
+  }
+  if (!missing) return;
+  log_.Log(kLogInfo, "Generating normals for mesh %s\n",
+           fplutil::BaseFileName(mesh_file_name_).c_str());
+
+  // Smooth normals are accumulated per position, weighted by face area, and
+  // appended after any normals from the file.
+  std::vector<vec3> accumulated(positions_.size(), kZeros3f);
+  for (size_t f = 0; f < faces_.size(); ++f) {
+    const Face& face = faces_[f];
+    const Corner* c = &corners_[face.first_corner];
+    const vec3 p0(positions_[c[0].position]);
+    for (int i = 1; i + 1 < face.num_corners; ++i) {
+      const vec3 p1(positions_[c[i].position]);
+      const vec3 p2(positions_[c[i + 1].position]);
+      const vec3 n = vec3::CrossProduct(p1 - p0, p2 - p0);
+      accumulated[c[0].position] += n;
+      accumulated[c[i].position] += n;
+      accumulated[c[i + 1].position] += n;
+    }
+  }
+
+  const int generated_base = static_cast<int>(normals_.size());
+  normals_.reserve(normals_.size() + positions_.size());
+  for (size_t i = 0; i < accumulated.size(); ++i) {
+    const float length = accumulated[i].Length();
+    normals_.push_back(vec3_packed(
+        length > 0.0f ? accumulated[i] / length : mathfu::kAxisZ3f));
+  }
+  for (size_t i = 0; i < corners_.size(); ++i) {
+    Corner& corner = corners_[i];
+    if (corner.normal < 0) corner.normal = generated_base + corner.position;
+  }
+}
+
+void ObjMeshParser::Recenter() {
+  vec3 min_position(FLT_MAX);
+  vec3 max_position(-FLT_MAX);
+  for (size_t i = 0; i < positions_.size(); ++i) {
+    const vec3 p(positions_[i]);
+    min_position = vec3::Min(min_position, p);
+    max_position = vec3::Max(max_position, p);
+  }
+
+  // Match the FBX behavior: only translate when the origin is outside the
+  // bounding box.
+  const bool contains_origin =
+      min_position.x <= 0.0f && min_position.y <= 0.0f &&
+      min_position.z <= 0.0f && max_position.x >= 0.0f &&
+      max_position.y >= 0.0f && max_position.z >= 0.0f;
+  if (positions_.empty() || contains_origin) {
+    log_.Log(kLogInfo, "Already centered so ignoring recenter request\n");
+    return;
+  }
+  log_.Log(kLogInfo, "Recentering\n");
+  const vec3 offset = -0.5f * (min_position + max_position);
+  for (size_t i = 0; i < positions_.size(); ++i) {
+    positions_[i] = vec3_packed(vec3(positions_[i]) + offset);
+  }
+}
+
+int ObjMeshParser::NumVertsUpperBound() const {
+  int num_verts = 0;
+  for (size_t i = 0; i < faces_.size(); ++i) {
+    num_verts += 3 * (faces_[i].num_corners - 2);
+  }
+  return num_verts;
+}
+
+void ObjMeshParser::GatherFlatMesh(bool gather_textures, FlatMesh* out) const {
+  // The whole file is one rigid node.
+  const std::string mesh_name = fplutil::BaseFileName(mesh_file_name_);
+  const unsigned int bone_index =
+      out->AppendBone(mesh_name.c_str(), mathfu::mat4::Identity(), -1);
+  SkinBinding skin_binding;
+  skin_binding.BindRigid(static_cast<SkinBinding::BoneIndex>(bone_index));
+
+  bool has_uvs = false;
+  bool has_normals = false;
+  for (size_t i = 0; i < corners_.size(); ++i) {
+    has_uvs |= corners_[i].uv >= 0;
+    has_normals |= corners_[i].normal >= 0;
+  }
+
+  const vec4 kDefaultColor(mathfu::kOnes4f);
+  int current_material = -2;
+  vec4 solid_color = kDefaultColor;
+  bool has_solid_color = false;
+  for (size_t f = 0; f < faces_.size(); ++f) {
+    const Face& face = faces_[f];
+
+    // Switch surfaces whenever the material changes.
+    if (face.material != current_material) {
+      current_material = face.material;
+      FlatTextures textures;
+      has_solid_color = false;
+      if (current_material >= 0) {
+        const Material& material = materials_[current_material];
+        if (gather_textures) {
+          for (size_t i = 0; i < material.textures.size(); ++i) {
+            textures.Append(material.textures[i]);
+          }
+        }
+        has_solid_color =
+            textures.Count() == 0 && material.has_diffuse_color;
+        solid_color = vec4(material.diffuse_color);
+      }
+      if (textures.Count() == 0 && !has_solid_color) {
+        log_.Log(kLogWarning, "No texture or solid color found for %s\n",
+                 current_material >= 0
+                     ? materials_[current_material].name.c_str()
+                     : mesh_name.c_str());
+      }
+      out->SetSurface(textures);
+      out->ReportSurfaceVertexAttributes(
+          kVertexAttributeBit_Bone | kVertexAttributeBit_Position |
+          (has_normals ? kVertexAttributeBit_Normal : 0) |
+          (has_uvs ? kVertexAttributeBit_Uv : 0) |
+          (!colors_.empty() || has_solid_color ? kVertexAttributeBit_Color
+                                               : 0));
+    }
+
+    // Triangulate the polygon as a fan.
+    const Corner* c = &corners_[face.first_corner];
+    for (int i = 1; i + 1 < face.num_corners; ++i) {
+      const Corner* tri[3] = {&c[0], &c[i], &c[i + 1]};
+      for (int k = 0; k < 3; ++k) {
+        const Corner& corner = *tri[k];
+        const vec3 position(positions_[corner.position]);
+        const vec3 normal =
+            corner.normal >= 0 ? vec3(normals_[corner.normal]) : kZeros3f;
+        const vec2 uv = corner.uv >= 0 ? vec2(uvs_[corner.uv]) : kZeros2f;
+        const vec4 color = !colors_.empty() ? vec4(colors_[corner.position])
+                           : has_solid_color ? solid_color
+                                             : kDefaultColor;
+        out->AppendPolyVert(position, normal, kZeros4f, color, uv, kZeros2f,
+                            skin_binding);
+      }
+    }
+  }
+}
+
+}  // namespace fplbase
@@ -0,0 +1,106 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_MESH_PIPELINE_OBJ_MESH_PARSER_H_
+#define FPLBASE_MESH_PIPELINE_OBJ_MESH_PARSER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "flat_mesh.h"
+
+namespace fplbase {
+
+/// @class ObjMeshParser
+/// @brief Load Wavefront OBJ files (and their .mtl libraries) and gather them
+///        into a FlatMesh.
+///
+/// The file is split into line-aligned chunks that are tokenized on separate
+/// threads. Relative (negative) indices are resolved once all chunks have
+/// been counted, and faces are then appended to the FlatMesh in file order,
+/// so the output is independent of the number of threads.
+///
+/// OBJ has no hierarchy, so the whole file becomes a single bone.
+class ObjMeshParser {
+ public:
+  explicit ObjMeshParser(Logger& log) : log_(log) {}
+
+  bool Valid() const { return true; }
+
+  bool Load(const char* file_name, AxisSystem axis_system,
+            float distance_unit_scale, bool recenter,
+            VertexAttributeBitmask vertex_attributes);
+
+  // Return an upper bound on the number of vertices in the scene.
+  int NumVertsUpperBound() const;
+
+  // Files read by Load(). Used by the build cache.
+  const std::vector<std::string>& InputFiles() const { return input_files_; }
+
+  // Gather the loaded geometry into `out`.
+  void GatherFlatMesh(bool gather_textures, FlatMesh* out) const;
+
+  // Index into one of the position, uv or normal arrays.
+  // -1 means the attribute is not present for this corner.
+  struct Corner {
+    int position;
+    int uv;
+    int normal;
+  };
+
+  // A polygon with `num_corners` corners starting at `first_corner`.
+  struct Face {
+    int first_corner;
+    int num_corners;
+    int material;  // Index into `materials_`, or -1.
+  };
+
+  struct Material {
+    std::string name;
+    std::vector<std::string> textures;  // Diffuse, emissive, normal, bump.
+    bool has_diffuse_color;
+    vec4_packed diffuse_color;
+    Material() : has_diffuse_color(false), diffuse_color(mathfu::kOnes4f) {}
+  };
+
+ private:
+  FPL_DISALLOW_COPY_AND_ASSIGN(ObjMeshParser);
+
+  void LoadMaterialLibrary(const std::string& mtl_file_name);
+  void GenerateNormals();
+  void Recenter();
+
+  std::vector<vec3_packed> positions_;
+  std::vector<vec4_packed> colors_;  // Optional, parallel to `positions_`.
+  std::vector<vec2_packed> uvs_;
+  std::vector<vec3_packed> normals_;
+  std::vector<Corner> corners_;
+  std::vector<Face> faces_;
+  std::vector<Material> materials_;
+  std::map<std::string, int> material_indices_;
+
+  // Name of source mesh file. Used to search for textures.
+  std::string mesh_file_name_;
+
+  // The source mesh file and any files it references.
+  std::vector<std::string> input_files_;
+
+  // Information and warnings.
+  Logger& log_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_MESH_PIPELINE_OBJ_MESH_PARSER_H_
@@ -0,0 +1,127 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "pipeline_utils.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace fplbase {
+
+static FILE* LogStream(LogLevel level) {
+  return level >= kLogWarning ? stderr : stdout;
+}
+
+void Logger::Log(LogLevel level, const char* format, ...) {
+  if (level < level_) return;
+  va_list args;
+  va_start(args, format);
+  if (!buffered_) {
+    vfprintf(LogStream(level), format, args);
+    va_end(args);
+    return;
+  }
+
+  // Measure the message, then format it into the buffer.
+  va_list measure_args;
+  va_copy(measure_args, args);
+  const int length = vsnprintf(nullptr, 0, format, measure_args);
+  va_end(measure_args);
+  if (length > 0) {
+    std::vector<char> text(length + 1);
+    vsnprintf(text.data(), text.size(), format, args);
+    const Message message = {level, std::string(text.data(), length)};
+    messages_.push_back(message);
+  }
+  va_end(args);
+}
+
+void Logger::Flush() {
+  for (size_t i = 0; i < messages_.size(); ++i) {
+    fputs(messages_[i].text.c_str(), LogStream(messages_[i].level));
+  }
+  messages_.clear();
+}
+
+// Every up axis, followed by every signed front axis perpendicular to it,
+// followed by both signs of the remaining axis.
+static const char* const kAxisSystemNames[] = {
+    "x+y+z", "x+y-z", "x-y+z", "x-y-z", "x+z+y", "x+z-y", "x-z+y", "x-z-y",
+    "y+x+z", "y+x-z", "y-x+z", "y-x-z", "y+z+x", "y+z-x", "y-z+x", "y-z-x",
+    "z+x+y", "z+x-y", "z-x+y", "z-x-y", "z+y+x", "z+y-x", "z-y+x", "z-y-x",
+    nullptr,
+};
+
+const char* const* AxisSystemNames() { return kAxisSystemNames; }
+
+AxisSystem AxisSystemFromName(const char* name) {
+  const int index = IndexOfName(name, kAxisSystemNames);
+  return index >= 0 ? index : kInvalidAxisSystem;
+}
+
+// Return the signed axis starting at `name`, such as "+y" or "z".
+static int SignedAxis(const char* name) {
+  const int sign = name[0] == '-' ? -1 : 1;
+  const char axis = name[0] == '-' || name[0] == '+' ? name[1] : name[0];
+  return sign * (axis - 'x' + 1);
+}
+
+void AxisSystemAxes(AxisSystem axis_system, int* up, int* front, int* left) {
+  const char* name = kAxisSystemNames[axis_system];
+  *up = SignedAxis(name);
+  *front = SignedAxis(name + 1);
+  *left = SignedAxis(name + 3);
+}
+
+static const char* const kDistanceUnitNames[] = {
+    "cm", "m", "km", "mm", "dm", "inches", "feet", "yards", "miles", nullptr,
+};
+static const float kCentimetersPerDistanceUnit[] = {
+    1.0f, 100.0f, 100000.0f, 0.1f, 10.0f, 2.54f, 30.48f, 91.44f, 160934.4f,
+};
+static_assert(sizeof(kDistanceUnitNames) / sizeof(kDistanceUnitNames[0]) - 1 ==
+                  sizeof(kCentimetersPerDistanceUnit) /
+                      sizeof(kCentimetersPerDistanceUnit[0]),
+              "kDistanceUnitNames is not in sync with "
+              "kCentimetersPerDistanceUnit.");
+
+const char* const* DistanceUnitNames() { return kDistanceUnitNames; }
+
+float DistanceUnitFromName(const char* name) {
+  const int index = IndexOfName(name, kDistanceUnitNames);
+  if (index >= 0) return kCentimetersPerDistanceUnit[index];
+
+  // Otherwise, the number of centimeters in the unit.
+  char* end = nullptr;
+  const float scale = strtof(name, &end);
+  return end != name && *end == '\0' && scale > 0.0f ? scale : -1.0f;
+}
+
+int IndexOfName(const char* name, const char* const* names) {
+  for (int i = 0; names[i] != nullptr; ++i) {
+    if (strcmp(name, names[i]) == 0) return i;
+  }
+  return -1;
+}
+
+void LogOptions(const char* indent, const char* const* names, Logger* log) {
+  for (int i = 0; names[i] != nullptr; ++i) {
+    log->Log(kLogImportant, "%s%s\n", indent, names[i]);
+  }
+}
+
+}  // namespace fplbase
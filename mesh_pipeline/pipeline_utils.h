@@ -0,0 +1,115 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Logging and command line helpers shared by every importer of the mesh
+// pipeline. Nothing here depends on the FBX SDK, so that the glTF and OBJ
+// importers build without it.
+
+#ifndef FPLBASE_MESH_PIPELINE_PIPELINE_UTILS_H_
+#define FPLBASE_MESH_PIPELINE_PIPELINE_UTILS_H_
+
+#include <string>
+#include <vector>
+
+namespace fplbase {
+
+/// Importance of a log message, from least to most important.
+enum LogLevel {
+  kLogVerbose,
+  kLogInfo,
+  kLogImportant,
+  kLogWarning,
+  kLogError,
+  kNumLogLevels
+};
+
+/// @class Logger
+/// @brief Print messages at or above a given importance.
+///
+/// Errors and warnings go to stderr, everything else to stdout.
+///
+/// A buffered logger holds its messages until Flush(), so that several
+/// threads can each log to their own without their lines interleaving.
+class Logger {
+ public:
+  Logger() : level_(kLogImportant), buffered_(false) {}
+  ~Logger() { Flush(); }
+
+  /// Only log messages of `level` or higher.
+  void set_level(LogLevel level) { level_ = level; }
+  LogLevel level() const { return level_; }
+
+  /// Hold messages until Flush(), rather than printing them straight away.
+  void set_buffered(bool buffered) { buffered_ = buffered; }
+
+  /// Print the held messages, in the order they were logged.
+  void Flush();
+
+  /// Log a printf-style message, if `level` is at least level().
+  void Log(LogLevel level, const char* format, ...)
+#ifdef __GNUC__
+      __attribute__((format(printf, 3, 4)))
+#endif
+      ;
+
+ private:
+  struct Message {
+    LogLevel level;
+    std::string text;
+  };
+
+  LogLevel level_;
+  bool buffered_;
+  std::vector<Message> messages_;  // Held until Flush().
+};
+
+/// Coordinate system of a mesh, named "<up><front><left>" where the up axis
+/// is one of x, y or z, and the front and left axes are signed axes such as
+/// "+y" or "-x". For example, "z+y+x" is z up, with +y out of a character's
+/// belly button and +x out of its left side.
+/// Non-negative values index AxisSystemNames().
+typedef int AxisSystem;
+static const AxisSystem kInvalidAxisSystem = -2;
+static const AxisSystem kUnspecifiedAxisSystem = -1;
+
+/// Null-terminated list of the names of every valid AxisSystem.
+const char* const* AxisSystemNames();
+
+/// Return the AxisSystem called `name`, or kInvalidAxisSystem.
+AxisSystem AxisSystemFromName(const char* name);
+
+/// Output the up, front and left axes of `axis_system`, which must be valid,
+/// as 1 for x, 2 for y and 3 for z, negated if the axis points the negative
+/// way.
+void AxisSystemAxes(AxisSystem axis_system, int* up, int* front, int* left);
+
+/// Null-terminated list of the named distance units, such as "m".
+const char* const* DistanceUnitNames();
+
+/// Return the number of centimeters in the unit called `name`, which is
+/// either one of DistanceUnitNames() or a positive number of centimeters.
+/// Returns -1 if `name` is neither.
+float DistanceUnitFromName(const char* name);
+
+/// Return the index of `name` in the null-terminated list `names`, or -1.
+int IndexOfName(const char* name, const char* const* names);
+
+/// Log each of the null-terminated list `names` on its own line, after
+/// `indent`.
+void LogOptions(const char* indent, const char* const* names, Logger* log);
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_MESH_PIPELINE_PIPELINE_UTILS_H_
@@ -0,0 +1,224 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FPLBASE_MESH_PIPELINE_VERTEX_DEDUP_H_
+#define FPLBASE_MESH_PIPELINE_VERTEX_DEDUP_H_
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace fplbase {
+
+namespace internal {
+
+static const uint64_t kHashPrime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t kHashPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t kHashPrime3 = 0x165667B19E3779F9ULL;
+static const uint64_t kHashPrime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t kHashPrime5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t HashRotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// Unaligned little-endian loads. memcpy compiles to a single mov.
+inline uint64_t HashRead64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t HashRead32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t HashRound(uint64_t acc, uint64_t input) {
+  acc += input * kHashPrime2;
+  acc = HashRotl(acc, 31);
+  return acc * kHashPrime1;
+}
+
+inline uint64_t HashMergeRound(uint64_t acc, uint64_t val) {
+  acc ^= HashRound(0, val);
+  return acc * kHashPrime1 + kHashPrime4;
+}
+
+}  // namespace internal
+
+/// Hash `size` bytes at `data` into 64 bits.
+///
+/// This is xxHash64. Unlike flatbuffers::HashFnv1a(const char*), every byte
+/// is consumed, including zeros, so it is suitable for hashing binary structs
+/// such as vertices. Throughput is several bytes per cycle, since the main
+/// loop runs four independent 64-bit lanes.
+inline uint64_t HashBytes64(const void* data, size_t size, uint64_t seed = 0) {
+  using namespace internal;
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  const uint8_t* const end = p + size;
+  uint64_t h;
+
+  if (size >= 32) {
+    const uint8_t* const limit = end - 32;
+    uint64_t v1 = seed + kHashPrime1 + kHashPrime2;
+    uint64_t v2 = seed + kHashPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kHashPrime1;
+    do {
+      v1 = HashRound(v1, HashRead64(p));
+      v2 = HashRound(v2, HashRead64(p + 8));
+      v3 = HashRound(v3, HashRead64(p + 16));
+      v4 = HashRound(v4, HashRead64(p + 24));
+      p += 32;
+    } while (p <= limit);
+    h = HashRotl(v1, 1) + HashRotl(v2, 7) + HashRotl(v3, 12) +
+        HashRotl(v4, 18);
+    h = HashMergeRound(h, v1);
+    h = HashMergeRound(h, v2);
+    h = HashMergeRound(h, v3);
+    h = HashMergeRound(h, v4);
+  } else {
+    h = seed + kHashPrime5;
+  }
+  h += static_cast<uint64_t>(size);
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= HashRound(0, HashRead64(p));
+    h = HashRotl(h, 27) * kHashPrime1 + kHashPrime4;
+  }
+  if (p + 4 <= end) {
+    h ^= static_cast<uint64_t>(HashRead32(p)) * kHashPrime1;
+    h = HashRotl(h, 23) * kHashPrime2 + kHashPrime3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    h ^= static_cast<uint64_t>(*p) * kHashPrime5;
+    h = HashRotl(h, 11) * kHashPrime1;
+  }
+
+  h ^= h >> 33;
+  h *= kHashPrime2;
+  h ^= h >> 29;
+  h *= kHashPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+/// Hash a plain-old-data value over all `sizeof(T)` bytes.
+/// The caller must ensure that any padding in `T` is zeroed.
+template <class T>
+inline uint64_t HashPod(const T& value) {
+  return HashBytes64(&value, sizeof(value));
+}
+
+/// @class VertexDedupTable
+/// @brief Open-addressing set of indices into an external vertex array.
+///
+/// Vertices are compared bitwise, so `Vertex` must be plain-old-data with
+/// zeroed padding. The table stores only a 32-bit hash and a 32-bit index per
+/// slot, so probing stays within a cache line and only full hash matches fall
+/// through to a memcmp of the vertex data. The vertex array can be freely
+/// reallocated between calls, since the table never holds pointers into it.
+class VertexDedupTable {
+ public:
+  typedef uint32_t Index;
+  static const Index kEmpty = 0xFFFFFFFF;
+
+  explicit VertexDedupTable(size_t expected_count = 0) : count_(0), mask_(0) {
+    Reserve(expected_count);
+  }
+
+  /// Ensure `count` unique vertices can be inserted without rehashing.
+  void Reserve(size_t count) {
+    size_t capacity = 16;
+    while (capacity < 2 * count) capacity *= 2;
+    if (capacity > slots_.size()) Rehash(capacity);
+  }
+
+  /// Number of unique vertices inserted so far.
+  size_t size() const { return count_; }
+
+  /// Remove all entries, keeping the allocated slots.
+  void Clear() {
+    for (size_t i = 0; i < slots_.size(); ++i) slots_[i] = Slot();
+    count_ = 0;
+  }
+
+  /// Look up `vertices[index]`. If an equal vertex with a different index is
+  /// already present, returns that vertex's index. Otherwise inserts `index`
+  /// and returns it.
+  template <class Vertex>
+  Index FindOrInsert(const Vertex* vertices, Index index) {
+    const uint32_t hash =
+        static_cast<uint32_t>(HashPod(vertices[index]) >> 32);
+    return FindOrInsertHashed(vertices, index, hash);
+  }
+
+  /// As above, with a caller-supplied hash (the top 32 bits of HashPod).
+  /// Useful when hashes are computed in bulk or on another thread.
+  template <class Vertex>
+  Index FindOrInsertHashed(const Vertex* vertices, Index index,
+                           uint32_t hash) {
+    assert(index != kEmpty);
+    if (2 * (count_ + 1) > slots_.size()) Rehash(2 * slots_.size());
+
+    const Vertex& v = vertices[index];
+    for (size_t i = hash & mask_;; i = (i + 1) & mask_) {
+      Slot& slot = slots_[i];
+      if (slot.index == kEmpty) {
+        slot.hash = hash;
+        slot.index = index;
+        ++count_;
+        return index;
+      }
+      if (slot.hash == hash &&
+          memcmp(&vertices[slot.index], &v, sizeof(Vertex)) == 0) {
+        return slot.index;
+      }
+    }
+  }
+
+ private:
+  struct Slot {
+    uint32_t hash;
+    Index index;
+    Slot() : hash(0), index(kEmpty) {}
+  };
+
+  void Rehash(size_t capacity) {
+    assert((capacity & (capacity - 1)) == 0);
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.resize(capacity);
+    mask_ = capacity - 1;
+    for (size_t j = 0; j < old.size(); ++j) {
+      const Slot& s = old[j];
+      if (s.index == kEmpty) continue;
+      size_t i = s.hash & mask_;
+      while (slots_[i].index != kEmpty) i = (i + 1) & mask_;
+      slots_[i] = s;
+    }
+  }
+
+  std::vector<Slot> slots_;
+  size_t count_;
+  size_t mask_;
+};
+
+}  // namespace fplbase
+
+#endif  // FPLBASE_MESH_PIPELINE_VERTEX_DEDUP_H_
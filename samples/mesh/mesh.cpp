@@ -16,6 +16,7 @@
 #include "fplbase/renderer.h"
 #include "fplbase/input.h"
 #include "fplbase/asset_manager.h"
+#include "fplbase/frame_pipeline.h"
 #include "fplbase/utilities.h"
 #include "mathfu/matrix.h"
 #include "mathfu/matrix_4x4.h"
@@ -27,6 +28,7 @@
 // - asset_manager to load mesh as asset.
 // - Renderer to setup rendering and transform models.
 // - InputSystem to query for exit events and elapsed time.
+// - FramePipeline to render on a separate thread.
 
 extern "C" int FPL_main(int /*argc*/, char* argv[]) {
   fplbase::Renderer renderer;
@@ -40,6 +42,8 @@ extern "C" int FPL_main(int /*argc*/, char* argv[]) {
   assert(result);
 
   fplbase::AssetManager asset_manager(renderer);
+  // Upload the textures on the loader thread, where the GL context allows.
+  asset_manager.EnableBackgroundUploads();
   fplbase::Shader *shader = asset_manager.LoadShader("mesh");
   assert(shader);
 
@@ -60,25 +64,38 @@ extern "C" int FPL_main(int /*argc*/, char* argv[]) {
   assert(cubetex->IsValid());
   mesh->GetMaterial(0)->textures().push_back(cubetex);
 
+  // The pipeline advances the renderer after each frame it executes, so
+  // advance it once here to set up the viewport for the first one.
+  renderer.AdvanceFrame(input.minimized(), input.Time());
+  mathfu::vec2i window_size = renderer.window_size();
+
+  // Render on a thread of its own, so each frame is simulated while the last
+  // one is submitted. Falls back to rendering here if the GL context can't
+  // be handed over. Either way, the renderer belongs to the pipeline until
+  // it's stopped, so the window size comes back from SubmitFrame().
+  fplbase::FramePipeline pipeline(renderer);
+  pipeline.Start();
+
   while (!(input.exit_requested() ||
            input.GetButton(fplbase::FPLK_AC_BACK).went_down())) {
-    renderer.AdvanceFrame(input.minimized(), input.Time());
-    input.AdvanceFrame(&renderer.window_size());
-    renderer.ClearFrameBuffer(mathfu::vec4(0.0, 0.0f, 0.0, 1.0f));
+    input.AdvanceFrame(&window_size);
+    fplbase::FramePacket &frame = pipeline.BeginFrame();
+    frame.ClearFrameBuffer(mathfu::vec4(0.0, 0.0f, 0.0, 1.0f));
 
     // generate animation matrix
     auto time = static_cast<float>(input.Time());
     auto roty = mathfu::mat3::RotationY(std::sin(time) * 3);
     auto zoom = mathfu::kOnes3f * 0.15f;
-    auto aspect =
-        static_cast<float>(renderer.window_size().y) / renderer.window_size().x;
+    auto aspect = static_cast<float>(window_size.y) / window_size.x;
     auto mvp = mathfu::mat4::Ortho(-1.0, 1.0, -aspect, aspect, -1.0, 1.0) *
                mathfu::mat4::FromRotationMatrix(roty) *
                mathfu::mat4::FromScaleVector(zoom);
-    renderer.set_model_view_projection(mvp);
-    renderer.SetShader(shader);
-    renderer.Render(mesh);
+    frame.SetModelViewProjection(mvp);
+    frame.SetShader(shader);
+    frame.Render(mesh);
+    window_size = pipeline.SubmitFrame(input.minimized(), input.Time());
   }
+  pipeline.Stop();
   asset_manager.ClearAllAssets();
   renderer.ShutDown();
   return 0;
@@ -0,0 +1,117 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "fplbase/input.h"
+#include "fplbase/renderer.h"
+#include "fplbase/shader.h"
+#include "fplbase/utilities.h"
+
+// Measures how long it takes to compile a library of programs that share
+// vertex and fragment shaders, with the renderer reusing compiled stages and
+// with every stage made unique so that none can be reused.
+//
+// It demonstrates usage of:
+// - Renderer::CompileAndLinkShader() to build many programs at startup.
+// - RendererBase::shader_stages_compiled() and shader_stage_cache_hits() to
+//   count the stages compiled and reused.
+
+// Each program pairs one of kNumVertexShaders vertex shaders with one of
+// kNumFragmentShaders fragment shaders, so every pair is used once.
+static const int kNumVertexShaders = 10;
+static const int kNumFragmentShaders = 30;
+static const int kNumPrograms = kNumVertexShaders * kNumFragmentShaders;
+
+static std::string VertexShader(int i) {
+  char source[256];
+  snprintf(source, sizeof(source),
+           "attribute vec4 aPosition;\n"
+           "uniform mat4 model_view_projection;\n"
+           "void main() {\n"
+           "  gl_Position = model_view_projection * aPosition * %d.0;\n"
+           "}\n",
+           i + 1);
+  return source;
+}
+
+static std::string FragmentShader(int i) {
+  char source[256];
+  snprintf(source, sizeof(source),
+           "uniform vec4 color;\n"
+           "void main() {\n"
+           "  gl_FragColor = color * %.3f;\n"
+           "}\n",
+           static_cast<float>(i) / kNumFragmentShaders);
+  return source;
+}
+
+// Compile kNumPrograms programs. If `unique` is set, a comment naming the
+// program is appended to each of its shaders, so that no stage is shared.
+static void RunBenchmark(const char *name, bool unique,
+                         fplbase::Renderer *renderer) {
+  typedef std::chrono::steady_clock Clock;
+  fplbase::RendererBase *base = fplbase::RendererBase::Get();
+  const int compiled = base->shader_stages_compiled();
+  const int cache_hits = base->shader_stage_cache_hits();
+
+  std::vector<fplbase::Shader *> shaders;
+  const auto start = Clock::now();
+  for (int i = 0; i < kNumPrograms; ++i) {
+    std::string vs = VertexShader(i % kNumVertexShaders);
+    std::string ps = FragmentShader(i / kNumVertexShaders);
+    if (unique) {
+      char comment[32];
+      snprintf(comment, sizeof(comment), "// Program %d.\n", i);
+      vs += comment;
+      ps += comment;
+    }
+    fplbase::Shader *shader =
+        renderer->CompileAndLinkShader(vs.c_str(), ps.c_str());
+    if (shader == nullptr) {
+      fplbase::LogError("Program %d: %s", i, renderer->last_error().c_str());
+      continue;
+    }
+    shaders.push_back(shader);
+  }
+  const double ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  fplbase::LogInfo(
+      "%s: %d of %d programs in %.1fms, %d stages compiled, %d reused.", name,
+      static_cast<int>(shaders.size()), kNumPrograms, ms,
+      base->shader_stages_compiled() - compiled,
+      base->shader_stage_cache_hits() - cache_hits);
+
+  for (auto it = shaders.begin(); it != shaders.end(); ++it) delete *it;
+}
+
+extern "C" int FPL_main(int /*argc*/, char * /*argv*/[]) {
+  fplbase::InputSystem input;
+  input.Initialize();
+
+  fplbase::Renderer renderer;
+  renderer.Initialize(mathfu::vec2i(800, 600), "Shader compile benchmark");
+  renderer.AdvanceFrame(input.minimized(), input.Time());
+
+  RunBenchmark("Unique stages", true, &renderer);
+  RunBenchmark("Shared stages", false, &renderer);
+
+  renderer.ShutDown();
+  return 0;
+}
@@ -0,0 +1,150 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "fplbase/async_loader.h"
+#include "fplbase/input.h"
+#include "fplbase/renderer.h"
+#include "fplbase/texture.h"
+#include "fplbase/texture_staging.h"
+#include "fplbase/utilities.h"
+
+// Measures how long the main thread stalls finalizing 4096x4096 RGBA
+// textures, uploaded from client memory and then from a TextureStagingPool.
+//
+// It demonstrates usage of:
+// - AsyncLoader to load textures on a loader thread.
+// - TextureStagingPool to upload them from mapped pixel unpack buffers.
+
+static const char kTextureFile[] = "upload_benchmark.tga";
+static const int kTextureSize = 4096;
+static const int kNumTextures = 4;
+// One buffer per texture, so that every texture is staged however far the
+// loader thread gets ahead of finalization.
+static const int kNumStagingBuffers = kNumTextures;
+static const size_t kStagingBufferSize =
+    static_cast<size_t>(kTextureSize) * kTextureSize * 4;
+
+// Write an uncompressed, top-down, 32 bit TGA of a gradient.
+static bool WriteTestImage() {
+  std::string tga(18 + kStagingBufferSize, '\0');
+  tga[2] = 2;  // Uncompressed true color.
+  tga[12] = tga[14] = static_cast<char>(kTextureSize & 0xff);
+  tga[13] = tga[15] = static_cast<char>(kTextureSize >> 8);
+  tga[16] = 32;    // Bits per pixel.
+  tga[17] = 0x28;  // 8 alpha bits, top-down.
+  char *pixel = &tga[18];
+  for (int y = 0; y < kTextureSize; ++y) {
+    for (int x = 0; x < kTextureSize; ++x, pixel += 4) {
+      pixel[0] = static_cast<char>(x);
+      pixel[1] = static_cast<char>(y);
+      pixel[2] = static_cast<char>(x ^ y);
+      pixel[3] = static_cast<char>(0xff);
+    }
+  }
+  return fplbase::SaveFile(kTextureFile, tga);
+}
+
+// Load kNumTextures textures through `loader`, staging them in `pool` if set,
+// and log how long each TryFinalize() that finalized textures took.
+static void RunBenchmark(const char *name, fplbase::AsyncLoader *loader,
+                         fplbase::TextureStagingPool *pool,
+                         fplbase::Renderer *renderer,
+                         fplbase::InputSystem *input) {
+  typedef std::chrono::steady_clock Clock;
+  std::vector<fplbase::Texture *> textures;
+  for (int i = 0; i < kNumTextures; ++i) {
+    auto tex = new fplbase::Texture(
+        kTextureFile, fplbase::kFormat8888,
+        static_cast<fplbase::TextureFlags>(fplbase::kTextureFlagsClampToEdge |
+                                           fplbase::kTextureFlagsLoadAsync));
+    tex->set_staging_pool(pool);
+    loader->QueueJob(tex);
+    textures.push_back(tex);
+  }
+  loader->StartLoading();
+
+  int finalized = 0;
+  double total_ms = 0.0;
+  double max_ms = 0.0;
+  bool done = false;
+  while (!done) {
+    renderer->AdvanceFrame(input->minimized(), input->Time());
+    input->AdvanceFrame(&renderer->window_size());
+    if (pool) pool->Update();
+
+    const auto start = Clock::now();
+    done = loader->TryFinalize();
+    // Submit the upload commands, as the end of the frame would.
+    GL_CALL(glFlush());
+    const double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+
+    const int count = static_cast<int>(std::count_if(
+        textures.begin(), textures.end(),
+        [](fplbase::Texture *tex) { return tex->IsValid(); }));
+    if (count > finalized) {
+      const double per_texture = ms / (count - finalized);
+      total_ms += ms;
+      max_ms = std::max(max_ms, per_texture);
+      finalized = count;
+    }
+  }
+  fplbase::LogInfo("%s: %d of %d textures, %.2fms average, %.2fms max stall.",
+                   name, finalized, kNumTextures,
+                   finalized ? total_ms / finalized : 0.0, max_ms);
+
+  for (auto it = textures.begin(); it != textures.end(); ++it) delete *it;
+  // Let the pool reuse the buffers the last textures were uploaded from.
+  GL_CALL(glFinish());
+  if (pool) pool->Update();
+}
+
+extern "C" int FPL_main(int /*argc*/, char * /*argv*/[]) {
+  fplbase::InputSystem input;
+  input.Initialize();
+
+  fplbase::Renderer renderer;
+  renderer.Initialize(mathfu::vec2i(800, 600), "Texture upload benchmark");
+
+  if (!WriteTestImage()) {
+    fplbase::LogError("Can't write %s.", kTextureFile);
+    return 1;
+  }
+
+  fplbase::AsyncLoader loader;
+  RunBenchmark("Unstaged", &loader, nullptr, &renderer, &input);
+
+  {
+    // Deleted before the renderer shuts down.
+    fplbase::TextureStagingPool pool;
+    if (pool.Initialize(kStagingBufferSize, kNumStagingBuffers)) {
+      RunBenchmark(pool.persistent() ? "Staged, persistent" : "Staged",
+                   &loader, &pool, &renderer, &input);
+    } else {
+      fplbase::LogInfo("Staged uploads aren't supported.");
+    }
+  }
+
+  loader.Stop();
+  remove(kTextureFile);
+  renderer.ShutDown();
+  return 0;
+}
@@ -0,0 +1,257 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/animation.h"
+#include "fplbase/flatbuffer_utils.h"
+#include "fplbase/mesh.h"
+#include "fplbase/utilities.h"
+#include "anim_generated.h"
+
+using mathfu::mat4;
+using mathfu::quat;
+using mathfu::vec3;
+using mathfu::vec4;
+
+namespace fplbase {
+
+static const uint8_t kNoParent = 0xFF;
+static const vec4 kIdentityRotation(0.0f, 0.0f, 0.0f, 1.0f);
+
+bool AnimClip::Load(const char *filename) {
+  std::string flatbuf;
+  if (!LoadFile(filename, &flatbuf)) {
+    LogError(kError, "Couldn\'t load: %s", filename);
+    return false;
+  }
+  if (!LoadFromMemory(flatbuf.data(), flatbuf.size())) {
+    LogError(kError, "Invalid animation file: %s", filename);
+    return false;
+  }
+  return true;
+}
+
+// Return true if `channel` is missing, or its keys are in strictly ascending
+// frame order and have `num_components` values each.
+static bool ValidChannel(const animdef::Channel *channel, int num_components) {
+  if (channel == nullptr) return true;
+  const flatbuffers::Vector<uint16_t> *frames = channel->frames();
+  if (channel->values()->size() < frames->size() * num_components) {
+    return false;
+  }
+  for (flatbuffers::uoffset_t i = 1; i < frames->size(); ++i) {
+    if (frames->Get(i) <= frames->Get(i - 1)) return false;
+  }
+  return true;
+}
+
+bool AnimClip::LoadFromMemory(const void *buffer, size_t size) {
+  def_ = nullptr;
+  data_.assign(static_cast<const char *>(buffer), size);
+
+  flatbuffers::Verifier verifier(
+      reinterpret_cast<const uint8_t *>(data_.data()), data_.size());
+  if (!animdef::VerifyAnimClipBuffer(verifier)) return false;
+
+  // See Mesh::InitFromMeshDef() for the version policy.
+  const animdef::AnimClip *def = animdef::GetAnimClip(data_.data());
+  if (def->version() != animdef::AnimVersion_Unspecified &&
+      def->version() != animdef::AnimVersion_MostRecent) {
+    return false;
+  }
+  if (def->bone_parents() == nullptr ||
+      def->bone_parents()->size() != def->bones()->size()) {
+    return false;
+  }
+
+  // Sampling relies on these, so check them here rather than trust the file.
+  for (flatbuffers::uoffset_t i = 0; i < def->bones()->size(); ++i) {
+    const uint8_t parent = def->bone_parents()->Get(i);
+    if (parent != kNoParent && parent >= i) return false;
+    const animdef::BoneAnim *bone = def->bones()->Get(i);
+    if (!ValidChannel(bone->translation(), 3) ||
+        !ValidChannel(bone->rotation(), 4) ||
+        !ValidChannel(bone->scale(), 3)) {
+      return false;
+    }
+  }
+  def_ = def;
+  return true;
+}
+
+float AnimClip::duration() const {
+  // Frames are samples, so the clip ends on its last frame.
+  return def_ == nullptr || def_->frames_per_second() <= 0.0f ||
+                 def_->num_frames() == 0
+             ? 0.0f
+             : (def_->num_frames() - 1) / def_->frames_per_second();
+}
+
+size_t AnimClip::num_bones() const {
+  return def_ == nullptr ? 0 : def_->bones()->size();
+}
+
+const uint8_t *AnimClip::bone_parents() const {
+  return def_ == nullptr ? nullptr : def_->bone_parents()->data();
+}
+
+// Load `num_components` quantized values into a vector. Unused components
+// are zero.
+static inline vec4 LoadQuantized(const uint16_t *values, int num_components) {
+  return vec4(values[0], values[1], values[2],
+              num_components > 3 ? values[3] : 0.0f);
+}
+
+// Sample `channel` at `frame`. Returns `identity` if there is no channel.
+static vec4 SampleChannel(const animdef::Channel *channel, int num_components,
+                          float frame, const vec4 &identity) {
+  if (channel == nullptr || channel->frames()->size() == 0) return identity;
+
+  // Find the keys on either side of `frame`.
+  const uint16_t *frames = channel->frames()->data();
+  const size_t num_keys = channel->frames()->size();
+  const size_t next =
+      std::upper_bound(frames, frames + num_keys, frame) - frames;
+  const size_t k0 = next == 0 ? 0 : next - 1;
+  const size_t k1 = next == num_keys ? k0 : next;
+  const float t = k0 == k1 ? 0.0f
+                           : (frame - frames[k0]) /
+                                 static_cast<float>(frames[k1] - frames[k0]);
+
+  // Interpolate in quantized space, then dequantize. Both are linear, so
+  // this is equivalent to dequantizing first, but saves a multiply-add.
+  // AnimClip::LoadFromMemory() checked that there are enough values.
+  assert(channel->values()->size() >= num_keys * num_components);
+  const uint16_t *values = channel->values()->data();
+  const vec4 q = vec4::Lerp(LoadQuantized(values + k0 * num_components,
+                                          num_components),
+                            LoadQuantized(values + k1 * num_components,
+                                          num_components),
+                            t);
+  const vec4 offset =
+      channel->min() ? LoadVec4(channel->min()) : mathfu::kZeros4f;
+  const vec4 scale =
+      channel->scale() ? LoadVec4(channel->scale()) : mathfu::kOnes4f;
+  return offset + q * scale;
+}
+
+// Normalize a quaternion stored as a vec4, falling back to identity if it
+// has degenerated.
+static inline vec4 NormalizeRotation(const vec4 &q) {
+  const float length_squared = q.LengthSquared();
+  return length_squared > 0.0f ? q * (1.0f / sqrtf(length_squared))
+                               : kIdentityRotation;
+}
+
+void AnimPose::Reset(size_t num_bones) {
+  translations_.assign(num_bones, mathfu::vec3_packed(mathfu::kZeros3f));
+  rotations_.assign(num_bones, mathfu::vec4_packed(kIdentityRotation));
+  scales_.assign(num_bones, mathfu::vec3_packed(mathfu::kOnes3f));
+}
+
+void AnimPose::Sample(const AnimClip &clip, float time, bool loop) {
+  assert(clip.IsValid());
+  const animdef::AnimClip *def = clip.def();
+  const size_t num_bones = clip.num_bones();
+  translations_.resize(num_bones);
+  rotations_.resize(num_bones);
+  scales_.resize(num_bones);
+
+  // Convert time to a frame within the clip.
+  const float duration = clip.duration();
+  if (loop && duration > 0.0f) {
+    time = fmodf(time, duration);
+    if (time < 0.0f) time += duration;
+  }
+  time = mathfu::Clamp(time, 0.0f, duration);
+  const float frame = time * def->frames_per_second();
+
+  const vec4 zeros(mathfu::kZeros4f);
+  const vec4 ones(mathfu::kOnes4f);
+  for (size_t i = 0; i < num_bones; ++i) {
+    const animdef::BoneAnim *bone =
+        def->bones()->Get(static_cast<flatbuffers::uoffset_t>(i));
+    translations_[i] =
+        SampleChannel(bone->translation(), 3, frame, zeros).xyz();
+    rotations_[i] = NormalizeRotation(
+        SampleChannel(bone->rotation(), 4, frame, kIdentityRotation));
+    scales_[i] = SampleChannel(bone->scale(), 3, frame, ones).xyz();
+  }
+}
+
+void AnimPose::Blend(const AnimPose &other, float weight) {
+  assert(other.num_bones() == num_bones());
+  for (size_t i = 0; i < num_bones(); ++i) {
+    translations_[i] = vec3::Lerp(vec3(translations_[i]),
+                                  vec3(other.translations_[i]), weight);
+    scales_[i] = vec3::Lerp(vec3(scales_[i]), vec3(other.scales_[i]), weight);
+
+    // Normalized lerp, taking the shorter path around the sphere.
+    const vec4 a(rotations_[i]);
+    const vec4 b(other.rotations_[i]);
+    const vec4 b_near = vec4::DotProduct(a, b) < 0.0f ? -b : b;
+    rotations_[i] = NormalizeRotation(vec4::Lerp(a, b_near, weight));
+  }
+}
+
+void AnimPose::GlobalTransforms(const uint8_t *bone_parents,
+                                mathfu::AffineTransform *transforms) const {
+  for (size_t i = 0; i < num_bones(); ++i) {
+    const vec4 r(rotations_[i]);
+    const mat4 local =
+        mat4::FromTranslationVector(vec3(translations_[i])) *
+        mat4::FromRotationMatrix(quat(r.w, r.x, r.y, r.z).ToMatrix()) *
+        mat4::FromScaleVector(vec3(scales_[i]));
+
+    const uint8_t parent = bone_parents[i];
+    if (parent == kNoParent) {
+      transforms[i] = mat4::ToAffineTransform(local);
+    } else {
+      assert(parent < i);
+      transforms[i] = mat4::ToAffineTransform(
+          mat4::FromAffineTransform(transforms[parent]) * local);
+    }
+  }
+}
+
+void AnimSampler::SampleInstances(const Mesh &mesh,
+                                  const AnimInstance *instances, size_t count,
+                                  mathfu::AffineTransform *shader_transforms) {
+  const size_t num_bones = mesh.num_bones();
+  const size_t num_shader_bones = mesh.num_shader_bones();
+  if (num_global_transforms_ < num_bones) {
+    global_transforms_.reset(new mathfu::AffineTransform[num_bones]);
+    num_global_transforms_ = num_bones;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    const AnimInstance &instance = instances[i];
+    assert(instance.clip != nullptr &&
+           instance.clip->num_bones() == num_bones);
+    pose_.Sample(*instance.clip, instance.time, instance.loop);
+
+    if (instance.blend_clip != nullptr && instance.blend_weight > 0.0f) {
+      assert(instance.blend_clip->num_bones() == num_bones);
+      blend_pose_.Sample(*instance.blend_clip, instance.blend_time,
+                         instance.loop);
+      pose_.Blend(blend_pose_, instance.blend_weight);
+    }
+
+    pose_.GlobalTransforms(mesh.bone_parents(), global_transforms_.get());
+    mesh.GatherShaderTransforms(global_transforms_.get(),
+                                shader_transforms + i * num_shader_bones);
+  }
+}
+
+}  // namespace fplbase
@@ -13,6 +13,9 @@
 // limitations under the License.
 
 #include "precompiled.h"
+#include <chrono>
+#include <thread>
+
 #include "common_generated.h"
 #include "fplbase/asset_manager.h"
 #include "fplbase/texture.h"
@@ -29,10 +32,18 @@ using mathfu::vec4i;
 
 namespace fplbase {
 
+ObjectPool<FileAsset> &FileAsset::pool() {
+  // Leaked, so that it outlives file assets destroyed during static
+  // destruction.
+  static ObjectPool<FileAsset> *pool = new ObjectPool<FileAsset>();
+  return *pool;
+}
+
 void FileAsset::Load() {
   if (LoadFile(filename_.c_str(), &contents)) {
     // This is just to signal the load succeeded. data_ doesn't own the memory.
     data_ = reinterpret_cast<const uint8_t *>(contents.c_str());
+    data_size_ = contents.size();
   }
 }
 
@@ -62,7 +73,7 @@ void DestructAssetsInMap(std::map<std::string, T> &map) {
 AssetManager::AssetManager(Renderer &renderer)
     : renderer_(renderer), texture_scale_(mathfu::kOnes2f) {
   // Empty material for default case.
-  material_map_[""] = new Material();
+  material_map_[""] = Register(new Material());
 }
 
 void AssetManager::ClearAllAssets() {
@@ -72,6 +83,13 @@ void AssetManager::ClearAllAssets() {
   DestructAssetsInMap(shader_map_);
   DestructAssetsInMap(texture_map_);
   DestructAssetsInMap(file_map_);
+  texture_arrays_.Clear();
+}
+
+TextureLayer AssetManager::LoadTextureLayer(const char *filename,
+                                            TextureFlags flags) {
+  if (renderer_.feature_level() < kFeatureLevel30) return TextureLayer();
+  return texture_arrays_.LoadTexture(filename, texture_scale_, flags);
 }
 
 Shader *AssetManager::FindShader(const char *basename) {
@@ -87,7 +105,8 @@ Shader *AssetManager::LoadShaderHelper(
     shader = new Shader(basename, local_defines, &renderer_);
   }
   shader->UpdateGlobalDefines(defines_to_add_, defines_to_omit_);
-  return found ? shader : LoadOrQueue(shader, shader_map_, async, alias);
+  return found ? AddToLoadGroup(shader)
+               : LoadOrQueue(shader, shader_map_, async, alias);
 }
 
 Shader *AssetManager::LoadShader(const char *basename,
@@ -131,16 +150,17 @@ Shader *AssetManager::LoadShaderDef(const char *filename) {
   if (shader) return shader;
   shader = Shader::LoadFromShaderDef(filename);
   if (!shader) return nullptr;
-  shader_map_[filename] = shader;
+  shader_map_[filename] = Register(shader);
   return shader;
 }
 
 void AssetManager::UnloadShader(const char *filename) {
   auto shader = FindShader(filename);
   if (!shader || shader->DecreaseRefCount()) return;
-  loader_.AbortJob(shader);
   shader_map_.erase(filename);
-  delete shader;
+  Unregister(shader);
+  // If it's mid-load, the loader deletes it once the load stops.
+  if (!loader_.AbortJob(shader)) delete shader;
 }
 
 Texture *AssetManager::FindTexture(const char *filename) {
@@ -150,24 +170,65 @@ Texture *AssetManager::FindTexture(const char *filename) {
 Texture *AssetManager::LoadTexture(const char *filename, TextureFormat format,
                                    TextureFlags flags) {
   auto tex = FindTexture(filename);
-  if (tex) return tex;
+  if (tex) return AddToLoadGroup(tex);
   tex = new Texture(filename, format, flags);
-  return LoadOrQueue(tex, texture_map_, (flags & kTextureFlagsLoadAsync) != 0,
-                     nullptr /* alias */);
+  const bool async = (flags & kTextureFlagsLoadAsync) != 0;
+  if (async) tex->set_staging_pool(texture_staging_.get());
+  return LoadOrQueue(tex, texture_map_, async, nullptr /* alias */);
 }
 
 void AssetManager::StartLoadingTextures() { loader_.StartLoading(); }
 
 void AssetManager::StopLoadingTextures() { loader_.PauseLoading(); }
 
-bool AssetManager::TryFinalize() { return loader_.TryFinalize(); }
+bool AssetManager::EnableBackgroundUploads() {
+  return loader_.EnableBackgroundUploads(&renderer_.environment());
+}
+
+bool AssetManager::EnableStagedTextureUploads(size_t buffer_size,
+                                              int num_buffers) {
+  if (texture_staging_) return true;
+  std::unique_ptr<TextureStagingPool> pool(new TextureStagingPool());
+  if (!pool->Initialize(buffer_size, num_buffers)) return false;
+  texture_staging_ = std::move(pool);
+  return true;
+}
+
+bool AssetManager::TryFinalize() {
+  // Free the buffers of textures finalized in earlier frames, for the loader
+  // to stage into.
+  if (texture_staging_) texture_staging_->Update();
+  return loader_.TryFinalize();
+}
+
+void AssetManager::SetLoadGroup(FinalizeGroup *group) {
+  load_group_ = group ? group->GetFuture() : FinalizeGroup::Future();
+}
+
+bool AssetManager::FinishLoadGroup(const FinalizeGroup::Future &group) {
+  loader_.StartLoading();
+  for (;;) {
+    const bool idle = TryFinalize();
+    if (group.IsReady()) return group.progress().num_failed == 0;
+    // Nothing left to finalize can complete the group, so don't wait forever
+    // for an asset that will never be finalized.
+    if (idle) {
+      LogError(kApplication,
+               "FinishLoadGroup: %d of %d assets will never be finalized.",
+               group.progress().num_assets - group.progress().num_finalized,
+               group.progress().num_assets);
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
 
 void AssetManager::UnloadTexture(const char *filename) {
   auto tex = FindTexture(filename);
   if (!tex || tex->DecreaseRefCount()) return;
-  loader_.AbortJob(tex);
   texture_map_.erase(filename);
-  delete tex;
+  Unregister(tex);
+  if (!loader_.AbortJob(tex)) delete tex;
 }
 
 Material *AssetManager::FindMaterial(const char *filename) {
@@ -185,9 +246,12 @@ Material *AssetManager::LoadMaterial(const char *filename,
         (async_resources ? kTextureFlagsLoadAsync : kTextureFlagsNone));
       tex->set_scale(texture_scale_);
       return tex;
+    },
+    [&](const char *filename, TextureFormat /*format*/, TextureFlags flags) {
+      return LoadTextureLayer(filename, flags);
     });
   if (!mat) return nullptr;
-  material_map_[filename] = mat;
+  material_map_[filename] = Register(mat);
   return mat;
 }
 
@@ -196,8 +260,17 @@ void AssetManager::UnloadMaterial(const char *filename) {
   if (!mat || mat->DecreaseRefCount()) return;
   mat->DeleteTextures();
   material_map_.erase(filename);
-  for (auto it = mat->textures().begin(); it != mat->textures().end(); ++it) {
-    texture_map_.erase((*it)->filename());
+  Unregister(mat);
+  const std::vector<int> &layers = mat->texture_layers();
+  for (size_t i = 0; i < mat->textures().size(); ++i) {
+    const int layer = i < layers.size() ? layers[i] : -1;
+    if (layer >= 0) {
+      texture_arrays_.UnloadTexture(TextureLayer(
+          static_cast<TextureArray *>(mat->textures()[i]), layer));
+    } else {
+      texture_map_.erase(mat->textures()[i]->filename());
+      Unregister(mat->textures()[i]);
+    }
   }
 }
 
@@ -207,7 +280,7 @@ Mesh *AssetManager::FindMesh(const char *filename) {
 
 Mesh *AssetManager::LoadMesh(const char *filename, bool async) {
   auto mesh = FindMesh(filename);
-  if (mesh) return mesh;
+  if (mesh) return AddToLoadGroup(mesh);
 
   auto async_flags = (async ? kTextureFlagsLoadAsync : kTextureFlagsNone);
   auto load_texture_fn = [this, async_flags](const char *filename,
@@ -217,25 +290,34 @@ Mesh *AssetManager::LoadMesh(const char *filename, bool async) {
     tex->set_scale(texture_scale_);
     return tex;
   };
+  auto load_layer_fn = [this](const char *filename, TextureFormat /*format*/,
+                              TextureFlags flags) {
+    return LoadTextureLayer(filename, flags);
+  };
 
-  mesh =
-      new Mesh(filename, [this, async, load_texture_fn](const char *filename,
-                                                 const matdef::Material *def) {
-        if (def) {
-          return Material::LoadFromMaterialDef(def, load_texture_fn);
-        } else {
-          return LoadMaterial(filename, async);
-        }
-      });
+  // Materials are loaded when the mesh is finalized, so put their textures
+  // in the group that's current now.
+  const FinalizeGroup::Future group = load_group_;
+  mesh = new Mesh(filename, [this, async, load_texture_fn, load_layer_fn,
+                             group](const char *filename,
+                                    const matdef::Material *def) {
+    const FinalizeGroup::Future previous_group = load_group_;
+    load_group_ = group;
+    Material *mat =
+        def ? Material::LoadFromMaterialDef(def, load_texture_fn, load_layer_fn)
+            : LoadMaterial(filename, async);
+    load_group_ = previous_group;
+    return mat;
+  });
   return LoadOrQueue(mesh, mesh_map_, async, nullptr /* alias */);
 }
 
 void AssetManager::UnloadMesh(const char *filename) {
   auto mesh = FindMesh(filename);
   if (!mesh || mesh->DecreaseRefCount()) return;
-  loader_.AbortJob(mesh);
   mesh_map_.erase(filename);
-  delete mesh;
+  Unregister(mesh);
+  if (!loader_.AbortJob(mesh)) delete mesh;
 }
 
 TextureAtlas *AssetManager::FindTextureAtlas(const char *filename) {
@@ -252,7 +334,7 @@ TextureAtlas *AssetManager::LoadTextureAtlas(const char *filename,
       return LoadTexture(filename, format, flags);
     });
   if (!atlas) return nullptr;
-  texture_atlas_map_[filename] = atlas;
+  texture_atlas_map_[filename] = Register(atlas);
   return atlas;
 }
 
@@ -260,6 +342,7 @@ void AssetManager::UnloadTextureAtlas(const char *filename) {
   auto atlas = FindTextureAtlas(filename);
   if (!atlas || atlas->DecreaseRefCount()) return;
   texture_atlas_map_.erase(filename);
+  Unregister(atlas);
   delete atlas;
 }
 
@@ -272,7 +355,7 @@ FileAsset *AssetManager::LoadFileAsset(const char *filename) {
   if (file) return file;
   file = new FileAsset();
   if (LoadFile(filename, &file->contents)) {
-    file_map_[filename] = file;
+    file_map_[filename] = Register(file);
     return file;
   }
   delete file;
@@ -283,6 +366,7 @@ void AssetManager::UnloadFileAsset(const char *filename) {
   auto file = FindFileAsset(filename);
   if (!file || file->DecreaseRefCount()) return;
   file_map_.erase(filename);
+  Unregister(file);
   delete file;
 }
 
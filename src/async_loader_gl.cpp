@@ -0,0 +1,105 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The parts of AsyncLoader that upload assets on the loader thread, common
+// to every backend.
+
+#include "precompiled.h"
+#include "fplbase/async_loader.h"
+#include "fplbase/environment.h"
+#include "fplbase/utilities.h"
+
+// Whether glFenceSync() and friends are looked up at runtime, in which case
+// they may be missing.
+#if !defined(__APPLE__) && !defined(__ANDROID__) && \
+    !defined(GL_GLEXT_PROTOTYPES)
+#define FPLBASE_GL_SYNC_OPTIONAL
+#endif
+
+namespace fplbase {
+
+bool AsyncLoader::EnableBackgroundUploads(Environment *environment) {
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+  if (upload_environment_) return true;
+  if (environment->feature_level() < kFeatureLevel30) return false;
+#ifdef FPLBASE_GL_SYNC_OPTIONAL
+  if (!glFenceSync || !glClientWaitSync || !glDeleteSync) return false;
+#endif
+  if (!environment->CreateUploadContext()) {
+    LogInfo("AsyncLoader: no shared context, uploading on the main thread.");
+    return false;
+  }
+  upload_environment_ = environment;
+  return true;
+#else
+  (void)environment;
+  return false;
+#endif  // GL_SYNC_GPU_COMMANDS_COMPLETE
+}
+
+bool AsyncLoader::BindUploadContext() {
+  if (!upload_environment_) return false;
+  if (upload_environment_->MakeUploadContextCurrent()) return true;
+  LogError(kError, "AsyncLoader: can't bind the upload context.");
+  return false;
+}
+
+void AsyncLoader::UnbindUploadContext() {
+  upload_environment_->ReleaseUploadContext();
+}
+
+// static
+void AsyncLoader::LoadAndUpload(AsyncAsset *res, bool uploading) {
+  res->Load();
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+  if (!uploading || res->cancellation_token_.IsCancelled() || !res->Upload()) {
+    return;
+  }
+  res->upload_fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  if (res->upload_fence_) {
+    // Submit the upload and the fence, so the main thread can wait on it.
+    GL_CALL(glFlush());
+  } else {
+    GL_CALL(glFinish());
+  }
+#else
+  (void)uploading;
+#endif  // GL_SYNC_GPU_COMMANDS_COMPLETE
+}
+
+// static
+bool AsyncLoader::UploadFinished(AsyncAsset *res) {
+  if (!res->upload_fence_) return true;
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+  GLsync fence = static_cast<GLsync>(res->upload_fence_);
+  // Poll, rather than wait, so as not to stall the frame.
+  if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) return false;
+  glDeleteSync(fence);
+#endif  // GL_SYNC_GPU_COMMANDS_COMPLETE
+  res->upload_fence_ = nullptr;
+  return true;
+}
+
+// static
+void AsyncLoader::DiscardAsset(AsyncAsset *res) {
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+  if (res->upload_fence_) {
+    glDeleteSync(static_cast<GLsync>(res->upload_fence_));
+    res->upload_fence_ = nullptr;
+  }
+#endif  // GL_SYNC_GPU_COMMANDS_COMPLETE
+  res->DiscardData();
+}
+
+}  // namespace fplbase
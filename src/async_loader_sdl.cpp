@@ -37,7 +37,10 @@ class BookendAsyncResource : public AsyncAsset {
 const char *BookendAsyncResource::kBookendFileName = "bookend";
 
 AsyncLoader::AsyncLoader()
-    : loading_(nullptr), num_pending_requests_(0), worker_thread_(nullptr) {
+    : loading_(nullptr),
+      num_pending_requests_(0),
+      upload_environment_(nullptr),
+      worker_thread_(nullptr) {
   mutex_ = SDL_CreateMutex();
   job_semaphore_ = SDL_CreateSemaphore(0);
   assert(mutex_ && job_semaphore_);
@@ -45,6 +48,7 @@ AsyncLoader::AsyncLoader()
 
 AsyncLoader::~AsyncLoader() {
   Stop();
+  DeleteReclaimed();
 }
 
 void AsyncLoader::Stop() {
@@ -72,15 +76,20 @@ void AsyncLoader::QueueJob(AsyncAsset *res) {
   SDL_SemPost(static_cast<SDL_semaphore *>(job_semaphore_));
 }
 
-void AsyncLoader::AbortJob(AsyncAsset *res) {
-  const bool was_loading =
-      LockReturn<bool>([this, res]() { return loading_ == res; });
-
-  if (was_loading) {
-    PauseLoading();
-  }
+bool AsyncLoader::AbortJob(AsyncAsset *res) {
+  bool was_loading = false;
+  bool was_done = false;
+  Lock([this, res, &was_loading, &was_done]() {
+    if (res && loading_ == res) {
+      // Don't wait for Load(); the worker hands the asset to reclaim_ when it
+      // sees the cancellation, and TryFinalize() deletes it. The asset stays
+      // at the front of queue_ until then.
+      res->cancellation_token_.Cancel();
+      --num_pending_requests_;
+      was_loading = true;
+      return;
+    }
 
-  Lock([this, res]() {
     auto iter = std::find(queue_.begin(), queue_.end(), res);
     if (iter != queue_.end()) {
       queue_.erase(iter);
@@ -91,15 +100,16 @@ void AsyncLoader::AbortJob(AsyncAsset *res) {
     if (iter != done_.end()) {
       done_.erase(iter);
       --num_pending_requests_;
+      was_done = true;
     }
   });
 
-  if (was_loading) {
-    StartLoading();
-  }
+  if (was_done) DiscardAsset(res);
+  return was_loading;
 }
 
 void AsyncLoader::LoaderWorker() {
+  const bool uploading = BindUploadContext();
   for (;;) {
     Lock([this]() { loading_ = queue_.empty() ? nullptr : queue_.front(); });
     if (!loading_) {
@@ -110,13 +120,18 @@ void AsyncLoader::LoaderWorker() {
     // StopLoadingWhenComplete(). To start loading again, call StartLoading().
     if (BookendAsyncResource::IsBookend(*loading_)) break;
     LogInfo(kApplication, "async load: %s", loading_->filename_.c_str());
-    loading_->Load();
+    LoadAndUpload(loading_, uploading);
     Lock([this]() {
       queue_.pop_front();
-      done_.push_back(loading_);
+      if (loading_->cancellation_token_.IsCancelled()) {
+        reclaim_.push_back(loading_);
+      } else {
+        done_.push_back(loading_);
+      }
       loading_ = nullptr;
     });
   }
+  if (uploading) UnbindUploadContext();
 }
 
 int AsyncLoader::LoaderThread(void *user_data) {
@@ -138,11 +153,27 @@ void AsyncLoader::StopLoadingWhenComplete() {
   QueueJob(&bookend);
 }
 
+void AsyncLoader::DeleteReclaimed() {
+  std::vector<AsyncAsset *> reclaim;
+  if (mutex_) {
+    Lock([this, &reclaim]() { reclaim.swap(reclaim_); });
+  } else {
+    // Stop() has joined the worker and destroyed the mutex.
+    reclaim.swap(reclaim_);
+  }
+  for (auto it = reclaim.begin(); it != reclaim.end(); ++it) {
+    DiscardAsset(*it);
+    delete *it;
+  }
+}
+
 bool AsyncLoader::TryFinalize() {
+  DeleteReclaimed();
   for (;;) {
     auto res = LockReturn<AsyncAsset *>(
         [this]() { return done_.empty() ? nullptr : done_.front(); });
-    if (!res) break;
+    // Wait for the GPU to finish uploading it, without stalling.
+    if (!res || !UploadFinished(res)) break;
     bool ok = res->Finalize();
     if (!ok) {
       // Can't do much here, since res is already constructed. Caller has to
@@ -18,8 +18,10 @@
 
 namespace fplbase {
 
-AsyncLoader::AsyncLoader() : loading_(nullptr), num_pending_requests_(0) {
-}
+AsyncLoader::AsyncLoader()
+    : loading_(nullptr),
+      num_pending_requests_(0),
+      upload_environment_(nullptr) {}
 
 AsyncLoader::~AsyncLoader() {
   {
@@ -27,6 +29,7 @@ AsyncLoader::~AsyncLoader() {
     queue_.clear();
   }
   Stop();
+  DeleteReclaimed();
 }
 
 void AsyncLoader::Stop() {
@@ -45,19 +48,18 @@ void AsyncLoader::QueueJob(AsyncAsset *res) {
   job_cv_.notify_one();
 }
 
-void AsyncLoader::AbortJob(AsyncAsset *res) {
-  bool was_loading = false;
+bool AsyncLoader::AbortJob(AsyncAsset *res) {
+  bool was_done = false;
   {
     std::lock_guard<std::mutex> lock(mutex_);
-    was_loading = loading_ == res;
-  }
-
-  if (was_loading) {
-    PauseLoading();
-  }
+    if (res && loading_ == res) {
+      // Don't wait for Load(); the worker hands the asset to reclaim_ when it
+      // sees the cancellation, and TryFinalize() deletes it.
+      res->cancellation_token_.Cancel();
+      --num_pending_requests_;
+      return true;
+    }
 
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
     auto iter = std::find(queue_.begin(), queue_.end(), res);
     if (iter != queue_.end()) {
       queue_.erase(iter);
@@ -68,12 +70,12 @@ void AsyncLoader::AbortJob(AsyncAsset *res) {
     if (iter != done_.end()) {
       done_.erase(iter);
       --num_pending_requests_;
+      was_done = true;
     }
   }
 
-  if (was_loading) {
-    StartLoading();
-  }
+  if (was_done) DiscardAsset(res);
+  return false;
 }
 
 void AsyncLoader::StartLoading() {
@@ -93,7 +95,20 @@ void AsyncLoader::PauseLoading() {
 
 void AsyncLoader::StopLoadingWhenComplete() { QueueJob(nullptr); }
 
+void AsyncLoader::DeleteReclaimed() {
+  std::vector<AsyncAsset *> reclaim;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reclaim.swap(reclaim_);
+  }
+  for (auto it = reclaim.begin(); it != reclaim.end(); ++it) {
+    DiscardAsset(*it);
+    delete *it;
+  }
+}
+
 bool AsyncLoader::TryFinalize() {
+  DeleteReclaimed();
   for (;;) {
     AsyncAsset *resource = nullptr;
     {
@@ -101,7 +116,8 @@ bool AsyncLoader::TryFinalize() {
       if (done_.size() > 0) resource = done_[0];
     }
 
-    if (!resource) break;
+    // Wait for the GPU to finish uploading it, without stalling.
+    if (!resource || !UploadFinished(resource)) break;
     bool ok = resource->Finalize();
     if (!ok) {
       // Can't do much here, since res is already constructed. Caller has to
@@ -127,6 +143,7 @@ bool AsyncLoader::TryFinalize() {
 }
 
 void AsyncLoader::LoaderWorker() {
+  const bool uploading = BindUploadContext();
   for (;;) {
     {
       std::unique_lock<std::mutex> lock(mutex_);
@@ -139,11 +156,16 @@ void AsyncLoader::LoaderWorker() {
       break;
     }
 
-    loading_->Load();
+    LoadAndUpload(loading_, uploading);
     std::lock_guard<std::mutex> lock(mutex_);
-    done_.push_back(loading_);
+    if (loading_->cancellation_token_.IsCancelled()) {
+      reclaim_.push_back(loading_);
+    } else {
+      done_.push_back(loading_);
+    }
     loading_ = nullptr;
   }
+  if (uploading) UnbindUploadContext();
 }
 
 // static
@@ -32,11 +32,13 @@ namespace fplbase {
 
 struct SDLHandles : EnvironmentHandles {
   SDLHandles(SDL_Window *window, SDL_GLContext context)
-    : window_(window), context_(context) {}
+    : window_(window), context_(context), upload_context_(nullptr) {}
   ~SDLHandles() {}
 
   SDL_Window *window_;
   SDL_GLContext context_;
+  // Shares objects with context_. See CreateUploadContext().
+  SDL_GLContext upload_context_;
 };
 
 static WindowMode AdjustWindowModeForPlatform(WindowMode window_mode) {
@@ -156,7 +158,7 @@ bool Environment::Initialize(const vec2i &window_size, const char *window_title,
 
 // Enable Vsync on desktop
 #ifndef PLATFORM_MOBILE
-  SDL_GL_SetSwapInterval(1);
+  if (SDL_GL_SetSwapInterval(1) != 0) frame_pacer_.set_vsync(false);
 #endif
 
 #if !defined(FPLBASE_GLES) && !defined(__APPLE__)
@@ -179,6 +181,9 @@ bool Environment::Initialize(const vec2i &window_size, const char *window_title,
 void Environment::ShutDown() {
   auto handles = static_cast<SDLHandles *>(handles_.get());
   if (handles) {
+    if (handles->upload_context_) {
+      SDL_GL_DeleteContext(handles->upload_context_);
+    }
     SDL_GL_DeleteContext(handles->context_);
     SDL_DestroyWindow(handles->window_);
     handles = nullptr;
@@ -194,10 +199,55 @@ void Environment::AdvanceFrame(bool minimized) {
     // Save some cpu / battery:
     SDL_Delay(10);
   } else {
+    frame_pacer_.FramePresenting();
     SDL_GL_SwapWindow(handles->window_);
+    frame_pacer_.FramePresented();
   }
   // Get window size again, just in case it has changed.
   SDL_GetWindowSize(handles->window_, &window_size_.x, &window_size_.y);
+  // Start the next frame, and so read its input, as late as it can start.
+  if (!minimized) frame_pacer_.WaitForFrameStart();
+}
+
+bool Environment::MakeContextCurrent() {
+  auto handles = static_cast<SDLHandles *>(handles_.get());
+  if (!handles) return false;
+  return SDL_GL_MakeCurrent(handles->window_, handles->context_) == 0;
+}
+
+bool Environment::ReleaseContext() {
+  auto handles = static_cast<SDLHandles *>(handles_.get());
+  if (!handles) return false;
+  return SDL_GL_MakeCurrent(handles->window_, nullptr) == 0;
+}
+
+bool Environment::CreateUploadContext() {
+  auto handles = static_cast<SDLHandles *>(handles_.get());
+  if (!handles) return false;
+  if (handles->upload_context_) return true;
+  // The version attributes set by Initialize() still apply.
+  SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+  auto context = SDL_GL_CreateContext(handles->window_);
+  SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+  // Creating a context makes it current, so switch back to the main one.
+  SDL_GL_MakeCurrent(handles->window_, handles->context_);
+  if (!context) {
+    last_error_ = std::string("SDL_GL_CreateContext fail: ") + SDL_GetError();
+    return false;
+  }
+  handles->upload_context_ = context;
+  return true;
+}
+
+bool Environment::MakeUploadContextCurrent() {
+  auto handles = static_cast<SDLHandles *>(handles_.get());
+  if (!handles || !handles->upload_context_) return false;
+  return SDL_GL_MakeCurrent(handles->window_, handles->upload_context_) == 0;
+}
+
+void Environment::ReleaseUploadContext() {
+  auto handles = static_cast<SDLHandles *>(handles_.get());
+  if (handles) SDL_GL_MakeCurrent(handles->window_, nullptr);
 }
 
 vec2i Environment::GetViewportSize() const {
@@ -32,6 +32,23 @@ using mathfu::vec4;
 
 namespace fplbase {
 
+#ifdef __ANDROID__
+// The app owns the window and main context, so only the upload context, and
+// the surface it needs to be made current with, are ours.
+struct EGLUploadHandles : EnvironmentHandles {
+  EGLUploadHandles(EGLDisplay display, EGLContext context, EGLSurface surface)
+      : display_(display), context_(context), surface_(surface) {}
+  ~EGLUploadHandles() {
+    eglDestroySurface(display_, surface_);
+    eglDestroyContext(display_, context_);
+  }
+
+  EGLDisplay display_;
+  EGLContext context_;
+  EGLSurface surface_;
+};
+#endif  // defined(__ANDROID__)
+
 // When building without SDL we assume the window and rendering context have
 // already been created prior to calling initialize.
 bool Environment::Initialize(const vec2i& /*window_size*/,
@@ -81,11 +98,77 @@ bool Environment::Initialize(const vec2i& /*window_size*/,
   return true;
 }
 
-void Environment::ShutDown() {
-}
+void Environment::ShutDown() { handles_.reset(); }
 
 void Environment::AdvanceFrame(bool minimized) {
-  (void)minimized;
+  // The platform presents, at its own pace, once the frame returns, so just
+  // count frames.
+  if (!minimized) frame_pacer_.FramePresented();
+}
+
+// The platform owns the context, and keeps it current on its render thread.
+bool Environment::MakeContextCurrent() { return false; }
+
+bool Environment::ReleaseContext() { return false; }
+
+bool Environment::CreateUploadContext() {
+#ifdef __ANDROID__
+  if (handles_) return true;
+  const EGLDisplay display = eglGetCurrentDisplay();
+  const EGLContext main_context = eglGetCurrentContext();
+  if (display == EGL_NO_DISPLAY || main_context == EGL_NO_CONTEXT) {
+    return false;
+  }
+  // Use the main context's config, so the contexts are compatible.
+  EGLint config_id = 0;
+  eglQueryContext(display, main_context, EGL_CONFIG_ID, &config_id);
+  const EGLint config_attribs[] = {EGL_CONFIG_ID, config_id, EGL_NONE};
+  EGLConfig config = nullptr;
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(display, config_attribs, &config, 1, &num_configs) ||
+      num_configs < 1) {
+    return false;
+  }
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION,
+                                    AndroidGetContextClientVersion(),
+                                    EGL_NONE};
+  const EGLContext context =
+      eglCreateContext(display, config, main_context, context_attribs);
+  if (context == EGL_NO_CONTEXT) return false;
+  // The context never draws, but not every driver supports surfaceless
+  // contexts, so give it a tiny pbuffer.
+  const EGLint surface_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+  const EGLSurface surface =
+      eglCreatePbufferSurface(display, config, surface_attribs);
+  if (surface == EGL_NO_SURFACE) {
+    eglDestroyContext(display, context);
+    return false;
+  }
+  handles_.reset(new EGLUploadHandles(display, context, surface));
+  return true;
+#else
+  return false;
+#endif  // defined(__ANDROID__)
+}
+
+bool Environment::MakeUploadContextCurrent() {
+#ifdef __ANDROID__
+  auto handles = static_cast<EGLUploadHandles *>(handles_.get());
+  return handles && eglMakeCurrent(handles->display_, handles->surface_,
+                                   handles->surface_, handles->context_);
+#else
+  return false;
+#endif  // defined(__ANDROID__)
+}
+
+void Environment::ReleaseUploadContext() {
+#ifdef __ANDROID__
+  auto handles = static_cast<EGLUploadHandles *>(handles_.get());
+  if (handles) {
+    eglMakeCurrent(handles->display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+  }
+#endif  // defined(__ANDROID__)
 }
 
 vec2i Environment::GetViewportSize() const {
@@ -0,0 +1,250 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/async_loader.h"
+#include "fplbase/finalize_callback.h"
+#include "fplutil/mutex.h"
+
+namespace fplbase {
+
+struct FinalizeCallbackList::Node {
+  FinalizeCallback callback;
+  Node *next;
+};
+
+// Hands out list nodes from blocks that are never freed, so the cost of
+// allocating them is paid once for the most callbacks ever pending at once.
+class FinalizeCallbackArena {
+ public:
+  typedef FinalizeCallbackList::Node Node;
+
+  static FinalizeCallbackArena &Get() {
+    // Leaked, so that it outlives assets destroyed during static destruction.
+    static FinalizeCallbackArena *arena = new FinalizeCallbackArena();
+    return *arena;
+  }
+
+  Node *New(FinalizeCallback callback) {
+    Slot *slot;
+    {
+      fplutil::MutexLock lock(mutex_);
+      if (free_ == nullptr) Grow();
+      slot = free_;
+      free_ = slot->next_free;
+    }
+    Node *node = new (slot) Node();
+    node->callback = std::move(callback);
+    node->next = nullptr;
+    return node;
+  }
+
+  void Delete(Node *node) {
+    node->~Node();
+    Slot *slot = reinterpret_cast<Slot *>(node);
+    fplutil::MutexLock lock(mutex_);
+    slot->next_free = free_;
+    free_ = slot;
+  }
+
+ private:
+  static const size_t kSlotsPerBlock = 256;
+
+  union Slot {
+    Slot *next_free;
+    std::aligned_storage<sizeof(Node), alignof(Node)>::type node;
+  };
+
+  FinalizeCallbackArena() : free_(nullptr) {}
+
+  void Grow() {
+    Slot *block = new Slot[kSlotsPerBlock];
+    for (size_t i = 0; i < kSlotsPerBlock; ++i) {
+      block[i].next_free = i + 1 < kSlotsPerBlock ? &block[i + 1] : free_;
+    }
+    free_ = block;
+  }
+
+  fplutil::Mutex mutex_;
+  Slot *free_;
+};
+
+void FinalizeCallbackList::Add(FinalizeCallback callback) {
+  Node *node = FinalizeCallbackArena::Get().New(std::move(callback));
+  if (tail_) {
+    tail_->next = node;
+  } else {
+    head_ = node;
+  }
+  tail_ = node;
+}
+
+void FinalizeCallbackList::CallAll() {
+  FinalizeCallbackArena &arena = FinalizeCallbackArena::Get();
+  while (head_) {
+    // Unlink the node first, in case the callback adds another.
+    Node *node = head_;
+    head_ = node->next;
+    if (head_ == nullptr) tail_ = nullptr;
+    node->callback();
+    arena.Delete(node);
+  }
+}
+
+void FinalizeCallbackList::Clear() {
+  FinalizeCallbackArena &arena = FinalizeCallbackArena::Get();
+  while (head_) {
+    Node *node = head_;
+    head_ = node->next;
+    arena.Delete(node);
+  }
+  tail_ = nullptr;
+}
+
+// Shared by a FinalizeGroup, its Futures and the callbacks it adds to its
+// assets, so that any of them can outlive the others.
+struct FinalizeGroup::State {
+  State() : ref_count(1) {}
+
+  void AddRef() { ref_count++; }
+  void Release() {
+    if (--ref_count == 0) delete this;
+  }
+
+  void Add(AsyncAsset *asset);
+
+  // `asset` is null if it was destroyed before being finalized.
+  void OnAssetFinalized(AsyncAsset *asset) {
+    progress.num_finalized++;
+    if (asset == nullptr || !asset->IsValid()) progress.num_failed++;
+    if (asset) progress.bytes_loaded += asset->data_size();
+    if (progress.num_finalized == progress.num_assets && on_complete) {
+      // Reset before calling, so the callback can set a new one.
+      FinalizeCallback callback(std::move(on_complete));
+      callback();
+    }
+  }
+
+  int ref_count;
+  LoadProgress progress;
+  FinalizeCallback on_complete;
+};
+
+// The callback a FinalizeGroup adds to each of its assets. Fits in a
+// FinalizeCallback without allocating. If the asset is destroyed before it's
+// finalized, the asset counts as finalized, so the group still completes.
+class FinalizeGroup::MemberCallback {
+ public:
+  MemberCallback(State *state, AsyncAsset *asset)
+      : state_(state), asset_(asset) {
+    state_->AddRef();
+  }
+  MemberCallback(MemberCallback &&other) noexcept
+      : state_(other.state_), asset_(other.asset_) {
+    other.state_ = nullptr;
+  }
+  ~MemberCallback() {
+    if (state_) Finish(nullptr);
+  }
+
+  void operator()() { Finish(asset_); }
+
+ private:
+  void Finish(AsyncAsset *asset) {
+    State *state = state_;
+    state_ = nullptr;
+    state->OnAssetFinalized(asset);
+    state->Release();
+  }
+
+  State *state_;
+  AsyncAsset *asset_;
+
+  MemberCallback(const MemberCallback &);
+  void operator=(const MemberCallback &);
+};
+
+void FinalizeGroup::State::Add(AsyncAsset *asset) {
+  progress.num_assets++;
+  if (asset->IsFinalized()) {
+    OnAssetFinalized(asset);
+  } else {
+    asset->AddFinalizeCallback(MemberCallback(this, asset));
+  }
+}
+
+FinalizeGroup::FinalizeGroup() : state_(new State()) {}
+
+FinalizeGroup::~FinalizeGroup() {
+  state_->on_complete.Reset();
+  state_->Release();
+}
+
+void FinalizeGroup::Add(AsyncAsset *asset) { state_->Add(asset); }
+
+void FinalizeGroup::OnComplete(FinalizeCallback callback) {
+  state_->on_complete = std::move(callback);
+  if (IsComplete()) {
+    FinalizeCallback complete(std::move(state_->on_complete));
+    complete();
+  }
+}
+
+int FinalizeGroup::size() const { return state_->progress.num_assets; }
+
+int FinalizeGroup::num_finalized() const {
+  return state_->progress.num_finalized;
+}
+
+bool FinalizeGroup::IsComplete() const {
+  return state_->progress.num_finalized == state_->progress.num_assets;
+}
+
+LoadProgress FinalizeGroup::progress() const { return state_->progress; }
+
+FinalizeGroup::Future::Future(State *state) : state_(state) {
+  state_->AddRef();
+}
+
+FinalizeGroup::Future::Future(const Future &other) : state_(other.state_) {
+  if (state_) state_->AddRef();
+}
+
+FinalizeGroup::Future &FinalizeGroup::Future::operator=(const Future &other) {
+  if (other.state_) other.state_->AddRef();
+  if (state_) state_->Release();
+  state_ = other.state_;
+  return *this;
+}
+
+FinalizeGroup::Future::~Future() {
+  if (state_) state_->Release();
+}
+
+bool FinalizeGroup::Future::IsReady() const {
+  assert(state_);
+  return state_->progress.num_finalized == state_->progress.num_assets;
+}
+
+LoadProgress FinalizeGroup::Future::progress() const {
+  assert(state_);
+  return state_->progress;
+}
+
+void FinalizeGroup::Future::Add(AsyncAsset *asset) const {
+  assert(state_);
+  state_->Add(asset);
+}
+
+}  // namespace fplbase
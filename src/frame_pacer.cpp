@@ -0,0 +1,149 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "precompiled.h"
+#include <thread>
+
+#include "fplbase/frame_pacer.h"
+#include "fplbase/renderer.h"
+#include "fplbase/utilities.h"
+
+namespace fplbase {
+
+// Assumed until presents have been measured, and without vsync.
+static const double kDefaultRefreshRate = 60.0;
+// Weight of each new measurement in the running estimates.
+static const double kEstimateWeight = 0.1;
+// Weight of measurements that say an estimate is too low, since
+// underestimating makes frames miss their deadline.
+static const double kIncreaseWeight = 0.5;
+// Present intervals further than this many refreshes from a whole number of
+// refreshes are too noisy to refine the refresh interval with.
+static const double kRefreshTolerance = 0.15;
+// Time before a deadline that is spun rather than slept.
+static const double kSpinTime = 0.0005;
+// Slack kept between when a frame is expected to be ready and its deadline.
+static const double kPresentMargin = 0.001;
+
+static std::chrono::steady_clock::duration ToClock(
+    std::chrono::duration<double> seconds) {
+  return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      seconds);
+}
+
+FramePacer::FramePacer()
+    : target_frame_rate_(0.0),
+      pacing_enabled_(false),
+      vsync_(true),
+      presented_(false),
+      frame_start_(Clock::now()),
+      refresh_interval_(1.0 / kDefaultRefreshRate),
+      work_time_(0.0),
+      oversleep_(0.0),
+      vsync_frame_id_(0) {}
+
+FramePacer::Seconds FramePacer::TargetInterval() const {
+  if (target_frame_rate_ > 0.0) return Seconds(1.0 / target_frame_rate_);
+  return vsync_ ? refresh_interval_ : Seconds(1.0 / kDefaultRefreshRate);
+}
+
+void FramePacer::WaitForFrameStart() {
+  if (pacing_enabled_ && presented_) SleepUntil(FrameStartTime());
+  FrameStarted();
+}
+
+FramePacer::Clock::time_point FramePacer::FrameStartTime() const {
+  Clock::time_point deadline = next_present_;
+  if (vsync_) {
+    // Present on the refresh nearest the ideal time, but after the one the
+    // last frame was presented on.
+    const double ideal = (next_present_ - last_present_) / refresh_interval_;
+    const double refreshes = std::max(1.0, floor(ideal + 0.5));
+    deadline = last_present_ + ToClock(refresh_interval_ * refreshes);
+  }
+  return deadline - ToClock(work_time_ + Seconds(kPresentMargin));
+}
+
+void FramePacer::FrameStarted(Clock::time_point time) { frame_start_ = time; }
+
+void FramePacer::FramePresenting(Clock::time_point time) {
+  const Seconds work = time - frame_start_;
+  work_time_ += (work - work_time_) *
+                (work > work_time_ ? kIncreaseWeight : kEstimateWeight);
+}
+
+void FramePacer::FramePresented(Clock::time_point now) {
+  if (!presented_) {
+    presented_ = true;
+    last_present_ = now;
+    next_present_ = now + ToClock(TargetInterval());
+    vsync_frame_id_++;
+    return;
+  }
+
+  const Seconds interval = now - last_present_;
+  const double ratio = interval / refresh_interval_;
+  const double whole = floor(ratio + 0.5);
+  if (vsync_ && ratio < 1.0 - kRefreshTolerance) {
+    // Presents are coming faster than the estimate allows, so the display
+    // is faster than assumed, or has changed mode.
+    refresh_interval_ += (interval - refresh_interval_) * kIncreaseWeight;
+  } else if (vsync_ && fabs(ratio - whole) < kRefreshTolerance) {
+    refresh_interval_ += (interval / whole - refresh_interval_) *
+                         kEstimateWeight;
+  }
+  vsync_frame_id_ += static_cast<int>(std::max(1.0, whole));
+
+  last_present_ = now;
+  next_present_ += ToClock(TargetInterval());
+  // After a missed deadline, pace from now rather than rushing to catch up.
+  if (next_present_ < now) next_present_ = now + ToClock(TargetInterval());
+}
+
+void FramePacer::WaitForVsync() {
+  const Clock::time_point now = Clock::now();
+  if (!presented_) {
+    SleepUntil(now + ToClock(refresh_interval_));
+    return;
+  }
+  const double refreshes = floor((now - last_present_) / refresh_interval_);
+  SleepUntil(last_present_ + ToClock(refresh_interval_ * (refreshes + 1.0)));
+}
+
+void FramePacer::SleepUntil(Clock::time_point time) {
+  for (;;) {
+    const Clock::time_point now = Clock::now();
+    const Seconds request = time - now - oversleep_ - Seconds(kSpinTime);
+    if (request <= Seconds::zero()) break;
+    std::this_thread::sleep_for(request);
+    const Seconds overslept = Clock::now() - now - request;
+    oversleep_ += (overslept - oversleep_) *
+                  (overslept > oversleep_ ? kIncreaseWeight : kEstimateWeight);
+  }
+  while (Clock::now() < time) std::this_thread::yield();
+}
+
+#if !defined(__ANDROID__)
+// On Android, these are driven by the Choreographer instead.
+void WaitForVsync() {
+  RendererBase::Get()->environment().frame_pacer().WaitForVsync();
+}
+
+int GetVsyncFrameId() {
+  return RendererBase::Get()->environment().frame_pacer().vsync_frame_id();
+}
+#endif  // !defined(__ANDROID__)
+
+}  // namespace fplbase
@@ -0,0 +1,244 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "fplbase/frame_pipeline.h"
+#include "fplbase/renderer.h"
+#include "fplbase/utilities.h"
+
+using mathfu::AffineTransform;
+using mathfu::mat4;
+using mathfu::vec3;
+using mathfu::vec4;
+
+namespace fplbase {
+
+// Vectors and matrices are captured as plain floats, as closures that
+// std::function stores on the heap aren't guaranteed their SIMD alignment.
+
+FramePacket::FramePacket() : num_bones_(0), bones_capacity_(0) {}
+
+FramePacket::~FramePacket() {}
+
+void FramePacket::ClearFrameBuffer(const vec4 &color) {
+  const float c[4] = {color.x, color.y, color.z, color.w};
+  Add([c](Renderer &renderer) { renderer.ClearFrameBuffer(vec4(c)); });
+}
+
+void FramePacket::SetModelViewProjection(const mat4 &mvp) {
+  float m[16];
+  memcpy(m, &mvp[0], sizeof(m));
+  Add([m](Renderer &renderer) { renderer.set_model_view_projection(mat4(m)); });
+}
+
+void FramePacket::SetModel(const mat4 &model) {
+  float m[16];
+  memcpy(m, &model[0], sizeof(m));
+  Add([m](Renderer &renderer) { renderer.set_model(mat4(m)); });
+}
+
+void FramePacket::SetColor(const vec4 &color) {
+  const float c[4] = {color.x, color.y, color.z, color.w};
+  Add([c](Renderer &renderer) { renderer.set_color(vec4(c)); });
+}
+
+void FramePacket::SetLightPos(const vec3 &light_pos) {
+  const float p[3] = {light_pos.x, light_pos.y, light_pos.z};
+  Add([p](Renderer &renderer) { renderer.set_light_pos(vec3(p)); });
+}
+
+void FramePacket::SetCameraPos(const vec3 &camera_pos) {
+  const float p[3] = {camera_pos.x, camera_pos.y, camera_pos.z};
+  Add([p](Renderer &renderer) { renderer.set_camera_pos(vec3(p)); });
+}
+
+void FramePacket::SetBoneTransforms(const AffineTransform *bone_transforms,
+                                    int num_bones) {
+  const size_t count = static_cast<size_t>(num_bones);
+  if (num_bones_ + count > bones_capacity_) {
+    const size_t capacity = std::max(num_bones_ + count, 2 * bones_capacity_);
+    AffineTransform *bones = new AffineTransform[capacity];
+    for (size_t i = 0; i < num_bones_; ++i) bones[i] = bones_[i];
+    bones_.reset(bones);
+    bones_capacity_ = capacity;
+  }
+  const size_t offset = num_bones_;
+  for (size_t i = 0; i < count; ++i) {
+    bones_[offset + i] = bone_transforms[i];
+  }
+  num_bones_ += count;
+  Add([this, offset, num_bones](Renderer &renderer) {
+    renderer.SetBoneTransforms(num_bones ? &bones_[offset] : nullptr,
+                               num_bones);
+  });
+}
+
+void FramePacket::SetShader(const Shader *shader) {
+  Add([shader](Renderer &renderer) { renderer.SetShader(shader); });
+}
+
+void FramePacket::Render(Mesh *mesh, bool ignore_material, size_t instances) {
+  Add([mesh, ignore_material, instances](Renderer &renderer) {
+    renderer.Render(mesh, ignore_material, instances);
+  });
+}
+
+void FramePacket::Execute(Renderer &renderer) {
+  for (auto it = commands_.begin(); it != commands_.end(); ++it) {
+    (*it)(renderer);
+  }
+  // The renderer refers to the bone palette until it's set again, and the
+  // palette won't outlive the packet.
+  if (num_bones_) renderer.SetBoneTransforms(nullptr, 0);
+}
+
+void FramePacket::Clear() {
+  commands_.clear();
+  num_bones_ = 0;
+}
+
+FramePipeline::FramePipeline(Renderer &renderer,
+                             const PresentFunction &present)
+    : renderer_(renderer),
+      present_(present),
+      recording_(0),
+      running_(false),
+      context_handed_off_(false),
+      context_acquired_(false),
+      stopping_(false),
+      window_size_(renderer.window_size()) {}
+
+FramePipeline::~FramePipeline() { Stop(); }
+
+bool FramePipeline::Start() {
+  if (running_) return true;
+  Environment &environment = renderer_.environment();
+  window_size_ = renderer_.window_size();
+  if (!environment.ReleaseContext()) return false;
+
+  context_handed_off_ = false;
+  context_acquired_ = false;
+  stopping_ = false;
+  render_thread_ = std::thread(&FramePipeline::RenderThread, this);
+  bool acquired;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return context_handed_off_; });
+    acquired = context_acquired_;
+  }
+  if (!acquired) {
+    render_thread_.join();
+    environment.MakeContextCurrent();
+    LogInfo("FramePipeline: rendering on the main thread.");
+    return false;
+  }
+  running_ = true;
+  return true;
+}
+
+void FramePipeline::Stop() {
+  if (!running_) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  render_thread_.join();
+  running_ = false;
+  renderer_.environment().MakeContextCurrent();
+}
+
+FramePacket &FramePipeline::BeginFrame() {
+  Frame &frame = frames_[recording_];
+  if (running_) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&frame]() { return !frame.in_flight; });
+  }
+  frame.packet.Clear();
+  return frame.packet;
+}
+
+mathfu::vec2i FramePipeline::SubmitFrame(bool minimized, double time) {
+  Frame &frame = frames_[recording_];
+  frame.minimized = minimized;
+  frame.time = time;
+  if (!running_) {
+    ExecuteFrame(frame);
+    return window_size_;
+  }
+  mathfu::vec2i window_size;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frame.in_flight = true;
+    submitted_.push_back(recording_);
+    window_size = window_size_;
+  }
+  cv_.notify_all();
+  recording_ = (recording_ + 1) % kNumPackets;
+  return window_size;
+}
+
+void FramePipeline::Flush() {
+  if (!running_) return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this]() { return submitted_.empty(); });
+}
+
+void FramePipeline::ExecuteFrame(Frame &frame) {
+  frame.packet.Execute(renderer_);
+  if (present_) {
+    present_(renderer_, frame.minimized, frame.time);
+  } else {
+    renderer_.AdvanceFrame(frame.minimized, frame.time);
+  }
+  // Presenting reads the window size back. Publish it for the recording
+  // thread, which mustn't use the renderer while the pipeline runs.
+  std::lock_guard<std::mutex> lock(mutex_);
+  window_size_ = renderer_.window_size();
+}
+
+void FramePipeline::RenderThread() {
+  Environment &environment = renderer_.environment();
+  const bool acquired = environment.MakeContextCurrent();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    context_handed_off_ = true;
+    context_acquired_ = acquired;
+  }
+  cv_.notify_all();
+  if (!acquired) return;
+
+  for (;;) {
+    int index;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return stopping_ || !submitted_.empty(); });
+      // Frames submitted before Stop() are still presented.
+      if (submitted_.empty()) break;
+      index = submitted_.front();
+    }
+    Frame &frame = frames_[index];
+    ExecuteFrame(frame);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      submitted_.pop_front();
+      frame.in_flight = false;
+    }
+    cv_.notify_all();
+  }
+  environment.ReleaseContext();
+}
+
+}  // namespace fplbase
@@ -14,8 +14,10 @@
 
 #include "fplbase/gpu_debug.h"
 
+#include "fplbase/fpl_common.h"
 #include "fplbase/glplatform.h"
 #include "fplbase/internal/type_conversions_gl.h"
+#include "fplbase/utilities.h"
 
 namespace fplbase {
 
@@ -27,31 +29,26 @@ bool ValidateGlBlendState(const BlendState& state) {
 
   GL_CALL(glGetBooleanv(GL_BLEND, &bool_value));
   if (GlToBool(bool_value) != state.enabled) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_BLEND_SRC_RGB, &int_value));
   if (static_cast<GLint>(BlendStateFactorToGl(state.src_color)) != int_value) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_BLEND_SRC_ALPHA, &int_value));
   if (static_cast<GLint>(BlendStateFactorToGl(state.src_alpha)) != int_value) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_BLEND_DST_RGB, &int_value));
   if (static_cast<GLint>(BlendStateFactorToGl(state.dst_color)) != int_value) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_BLEND_DST_ALPHA, &int_value));
   if (static_cast<GLint>(BlendStateFactorToGl(state.dst_alpha)) != int_value) {
-    assert(false);
     return false;
   }
 
@@ -64,13 +61,11 @@ bool ValidateGlCullState(const CullState& state) {
 
   GL_CALL(glGetBooleanv(GL_CULL_FACE, &bool_value));
   if (GlToBool(bool_value) != state.enabled) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_CULL_FACE_MODE, &int_value));
   if (static_cast<GLint>(CullFaceToGl(state.face)) != int_value) {
-    assert(false);
     return false;
   }
 
@@ -83,20 +78,17 @@ bool ValidateGlDepthState(const DepthState& state) {
 
   GL_CALL(glGetBooleanv(GL_DEPTH_TEST, &bool_value));
   if (GlToBool(bool_value) != state.test_enabled) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetBooleanv(GL_DEPTH_WRITEMASK, &bool_value));
   if (GlToBool(bool_value) != state.write_enabled) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_DEPTH_FUNC, &int_value));
   if (static_cast<GLint>(RenderFunctionToGlFunction(state.function)) !=
       int_value) {
-    assert(false);
     return false;
   }
 
@@ -110,7 +102,6 @@ bool ValidateGlPointState(const PointState& state) {
 #ifdef GL_POINT_SPRITE
   GL_CALL(glGetBooleanv(GL_POINT_SPRITE, &bool_value));
   if (GlToBool(bool_value) != state.point_sprite_enabled) {
-    assert(false);
     return false;
   }
 #endif  // GL_POINT_SPRITE
@@ -118,13 +109,11 @@ bool ValidateGlPointState(const PointState& state) {
 #ifdef GL_PROGRAM_POINT_SIZE
   GL_CALL(glGetBooleanv(GL_PROGRAM_POINT_SIZE, &bool_value));
   if (GlToBool(bool_value) != state.point_sprite_enabled) {
-    assert(false);
     return false;
   }
 #elif defined(GL_VERTEX_PROGRAM_POINT_SIZE)
   GL_CALL(glGetBooleanv(GL_VERTEX_PROGRAM_POINT_SIZE, &bool_value));
   if (GlToBool(bool_value) != state.point_sprite_enabled) {
-    assert(false);
     return false;
   }
 #endif  // GL_PROGRAM_POINT_SIZE
@@ -132,7 +121,6 @@ bool ValidateGlPointState(const PointState& state) {
   float float_value;
   GL_CALL(glGetFloatv(GL_POINT_SIZE, &float_value));
   if (float_value != state.point_size) {
-    assert(false);
     return false;
   }
 #endif  // FPLBASE_GLES
@@ -150,7 +138,6 @@ bool ValidateGlStencilState(const StencilState& state) {
 
   GL_CALL(glGetBooleanv(GL_STENCIL_TEST, &bool_value));
   if (GlToBool(bool_value) != state.enabled) {
-    assert(false);
     return false;
   }
 
@@ -158,19 +145,16 @@ bool ValidateGlStencilState(const StencilState& state) {
   GL_CALL(glGetIntegerv(GL_STENCIL_BACK_FUNC, &int_value));
   if (static_cast<GLint>(RenderFunctionToGlFunction(
           state.back_function.function)) != int_value) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_STENCIL_BACK_REF, &int_value));
   if (static_cast<GLint>(state.back_function.ref) != int_value) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_STENCIL_BACK_VALUE_MASK, &int_value));
   if (static_cast<GLint>(state.back_function.mask) != int_value) {
-    assert(false);
     return false;
   }
 
@@ -178,19 +162,16 @@ bool ValidateGlStencilState(const StencilState& state) {
   GL_CALL(glGetIntegerv(GL_STENCIL_FUNC, &int_value));
   if (static_cast<GLint>(RenderFunctionToGlFunction(
           state.front_function.function)) != int_value) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_STENCIL_REF, &int_value));
   if (static_cast<GLint>(state.front_function.ref) != int_value) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_STENCIL_VALUE_MASK, &int_value));
   if (static_cast<GLint>(state.front_function.mask) != int_value) {
-    assert(false);
     return false;
   }
 
@@ -198,20 +179,17 @@ bool ValidateGlStencilState(const StencilState& state) {
   GL_CALL(glGetIntegerv(GL_STENCIL_BACK_FAIL, &int_value));
   if (static_cast<GLint>(StencilOpToGlOp(state.back_op.stencil_fail)) !=
       int_value) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_STENCIL_BACK_PASS_DEPTH_FAIL, &int_value));
   if (static_cast<GLint>(StencilOpToGlOp(state.back_op.depth_fail)) !=
       int_value) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_STENCIL_BACK_PASS_DEPTH_PASS, &int_value));
   if (static_cast<GLint>(StencilOpToGlOp(state.back_op.pass)) != int_value) {
-    assert(false);
     return false;
   }
 
@@ -219,20 +197,17 @@ bool ValidateGlStencilState(const StencilState& state) {
   GL_CALL(glGetIntegerv(GL_STENCIL_FAIL, &int_value));
   if (static_cast<GLint>(StencilOpToGlOp(state.front_op.stencil_fail)) !=
       int_value) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_STENCIL_PASS_DEPTH_FAIL, &int_value));
   if (static_cast<GLint>(StencilOpToGlOp(state.front_op.depth_fail)) !=
       int_value) {
-    assert(false);
     return false;
   }
 
   GL_CALL(glGetIntegerv(GL_STENCIL_PASS_DEPTH_PASS, &int_value));
   if (static_cast<GLint>(StencilOpToGlOp(state.front_op.pass)) != int_value) {
-    assert(false);
     return false;
   }
 
@@ -244,7 +219,6 @@ bool ValidateGlScissorState(const ScissorState& state) {
 
   GL_CALL(glGetBooleanv(GL_SCISSOR_TEST, &bool_value));
   if (GlToBool(bool_value) != state.enabled) {
-    assert(false);
     return false;
   }
 
@@ -257,43 +231,113 @@ bool ValidateGlViewport(const Viewport& viewport) {
   GL_CALL(glGetIntegerv(GL_VIEWPORT, int_values));
   if (int_values[0] != viewport.pos.x || int_values[1] != viewport.pos.y ||
       int_values[2] != viewport.size.x || int_values[3] != viewport.size.y) {
-    assert(false);
     return false;
   }
 
   return true;
 }
 
-bool ValidateRenderState(const RenderState& render_state) {
-  if (!ValidateGlBlendState(render_state.blend_state)) {
-    return false;
+bool ValidateRenderStateGroup(const RenderState& render_state,
+                              RenderStateGroup group) {
+  switch (group) {
+    case kRenderStateGroupBlend:
+      return ValidateGlBlendState(render_state.blend_state);
+    case kRenderStateGroupCull:
+      return ValidateGlCullState(render_state.cull_state);
+    case kRenderStateGroupScissor:
+      return ValidateGlScissorState(render_state.scissor_state);
+    case kRenderStateGroupDepth:
+      return ValidateGlDepthState(render_state.depth_state);
+    case kRenderStateGroupPoint:
+      return ValidateGlPointState(render_state.point_state);
+    case kRenderStateGroupStencil:
+      return ValidateGlStencilState(render_state.stencil_state);
+    case kRenderStateGroupViewport:
+      return ValidateGlViewport(render_state.viewport);
+    default:
+      assert(false);
+      return false;
   }
+}
 
-  if (!ValidateGlCullState(render_state.cull_state)) {
-    return false;
+bool ValidateRenderState(const RenderState& render_state) {
+  for (int i = 0; i < kRenderStateGroupCount; ++i) {
+    if (!ValidateRenderStateGroup(render_state,
+                                  static_cast<RenderStateGroup>(i))) {
+      assert(false);
+      return false;
+    }
   }
+  return true;
+}
 
-  if (!ValidateGlScissorState(render_state.scissor_state)) {
-    return false;
-  }
+static const char* const kRenderStateGroupNames[] = {
+    "blend", "cull", "scissor", "depth", "point", "stencil", "viewport",
+};
+static_assert(FPL_ARRAYSIZE(kRenderStateGroupNames) == kRenderStateGroupCount,
+              "kRenderStateGroupNames is not in sync with RenderStateGroup.");
 
-  if (!ValidateGlDepthState(render_state.depth_state)) {
-    return false;
-  }
+RenderStateValidator::RenderStateValidator()
+    : mode_(kRenderStateValidationAll),
+      next_group_(0),
+      touched_(0),
+      call_depth_(0) {}
 
-  if (!ValidateGlPointState(render_state.point_state)) {
-    return false;
-  }
+void RenderStateValidator::BeginCall(const RenderStateCallSite& call_site) {
+  if (call_depth_++ == 0) current_call_ = call_site;
+}
 
-  if (!ValidateGlStencilState(render_state.stencil_state)) {
-    return false;
-  }
+void RenderStateValidator::EndCall() {
+  assert(call_depth_ > 0);
+  if (--call_depth_ == 0) current_call_ = RenderStateCallSite();
+}
 
-  if (!ValidateGlViewport(render_state.viewport)) {
-    return false;
-  }
+void RenderStateValidator::Touch(RenderStateGroup group) {
+  touched_ |= 1u << group;
+  last_set_[group] = current_call_;
+}
 
-  return true;
+bool RenderStateValidator::Validate(const RenderState& render_state) {
+  const uint32_t all_groups = (1u << kRenderStateGroupCount) - 1;
+  const uint32_t round_robin = 1u << next_group_;
+  uint32_t groups = all_groups;
+  switch (mode_) {
+    case kRenderStateValidationAll:
+      break;
+    case kRenderStateValidationRoundRobin:
+      groups = round_robin;
+      break;
+    case kRenderStateValidationTouched:
+      groups = touched_ | round_robin;
+      break;
+  }
+  if (groups & round_robin) {
+    next_group_ = (next_group_ + 1) % kRenderStateGroupCount;
+  }
+  touched_ = 0;
+
+  bool valid = true;
+  for (int i = 0; i < kRenderStateGroupCount; ++i) {
+    if (!(groups & (1u << i))) continue;
+    const RenderStateGroup group = static_cast<RenderStateGroup>(i);
+    if (ValidateRenderStateGroup(render_state, group)) continue;
+    const RenderStateCallSite& site = last_set_[group];
+    if (site.function) {
+      LogError(kError,
+               "GPU %s state doesn't match the Renderer's. It was last set by "
+               "Renderer::%s, called from %p.",
+               kRenderStateGroupNames[group], site.function,
+               site.return_address);
+    } else {
+      LogError(kError,
+               "GPU %s state doesn't match the Renderer's. It hasn't been set "
+               "through the Renderer.",
+               kRenderStateGroupNames[group]);
+    }
+    valid = false;
+  }
+  assert(valid);
+  return valid;
 }
 
 }  // namespace fplbase
@@ -39,6 +39,7 @@ InputSystem::InputSystem()
       frames_(0),
       minimized_frame_(0),
       mousewheel_delta_(mathfu::kZeros2i),
+      current_snapshot_(0),
       record_text_input_(false),
       touch_device_(true) {
   pointers_.assign(kMaxSimultanuousPointers, InputPointer());
@@ -146,6 +147,7 @@ void InputSystem::AdvanceFrame(vec2i *window_size) {
   }
 
   UpdateEvents(window_size);
+  UpdateControllerSnapshot();
 
   // Update the head mounted display input. Note this is after the mouse
   // input, as that can be treated as a trigger.
@@ -193,6 +195,40 @@ size_t InputSystem::FindPointer(FingerId id) {
   return 0;
 }
 
+void InputSystem::UpdateControllerSnapshot() {
+  const ControllerSnapshot &previous = controller_snapshots_[current_snapshot_];
+  current_snapshot_ ^= 1;
+  ControllerSnapshot &snapshot = controller_snapshots_[current_snapshot_];
+  snapshot.Clear();
+  snapshot.frame = frames_;
+
+  // Fill the slots in map order, which keeps a device in the same slot for as
+  // long as the set of connected devices doesn't change.
+  int device = 0;
+  for (auto it = joystick_map_.begin();
+       it != joystick_map_.end() && device < ControllerSnapshot::kMaxDevices;
+       ++it, ++device) {
+    snapshot.device_ids[device] = it->first;
+    it->second.CaptureState(device, &snapshot);
+  }
+#if ANDROID_GAMEPAD
+  for (auto it = gamepad_map_.begin();
+       it != gamepad_map_.end() && device < ControllerSnapshot::kMaxDevices;
+       ++it, ++device) {
+    snapshot.device_ids[device] = static_cast<uint64_t>(it->first);
+    it->second.CaptureState(device, &snapshot);
+  }
+#endif  // ANDROID_GAMEPAD
+  snapshot.num_devices = device;
+
+  // Carry the previous masks over by device id rather than by slot, so a
+  // device that moved slot doesn't report spurious edges.
+  for (int i = 0; i < snapshot.num_devices; ++i) {
+    const int prev = previous.FindDevice(snapshot.device_ids[i]);
+    snapshot.previous_buttons[i] = prev >= 0 ? previous.buttons[prev] : 0;
+  }
+}
+
 void InputSystem::UpdateConnectedJoystickList() {
   CloseOpenJoysticks();
   OpenConnectedJoysticks();
@@ -249,6 +285,54 @@ void Joystick::AdvanceFrame() {
   }
 }
 
+void Joystick::CaptureState(int device, ControllerSnapshot *snapshot) const {
+  ControllerSnapshot::ButtonMask buttons = 0;
+  const size_t num_buttons =
+      std::min(button_list_.size(),
+               static_cast<size_t>(ControllerSnapshot::kMaxButtons));
+  for (size_t i = 0; i < num_buttons; i++) {
+    if (button_list_[i].is_down()) {
+      buttons |= static_cast<ControllerSnapshot::ButtonMask>(1) << i;
+    }
+  }
+  snapshot->buttons[device] = buttons;
+
+  const size_t num_axes = std::min(
+      axis_list_.size(), static_cast<size_t>(ControllerSnapshot::kMaxAxes));
+  for (size_t i = 0; i < num_axes; i++) {
+    snapshot->axes[device][i] = axis_list_[i];
+  }
+
+  const size_t num_hats = std::min(
+      hat_list_.size(), static_cast<size_t>(ControllerSnapshot::kMaxHats));
+  for (size_t i = 0; i < num_hats; i++) {
+    snapshot->hats[device][i] = mathfu::vec2_packed(hat_list_[i]);
+  }
+}
+
+void ControllerSnapshot::Clear() {
+  num_devices = 0;
+  frame = 0;
+  for (int i = 0; i < kMaxDevices; i++) {
+    device_ids[i] = 0;
+    buttons[i] = 0;
+    previous_buttons[i] = 0;
+    for (int j = 0; j < kMaxAxes; j++) {
+      axes[i][j] = 0.0f;
+    }
+    for (int j = 0; j < kMaxHats; j++) {
+      hats[i][j] = mathfu::vec2_packed(mathfu::kZeros2f);
+    }
+  }
+}
+
+int ControllerSnapshot::FindDevice(uint64_t device_id) const {
+  for (int i = 0; i < num_devices; i++) {
+    if (device_ids[i] == device_id) return i;
+  }
+  return -1;
+}
+
 // Constructors and destroctor of TextInputEvent union.
 TextInputEvent::TextInputEvent(TextInputEventType t) {
   type = t;
@@ -465,6 +465,18 @@ void Gamepad::AdvanceFrame() {
   }
 }
 
+void Gamepad::CaptureState(int device, ControllerSnapshot *snapshot) const {
+  static_assert(Gamepad::kControlCount <= ControllerSnapshot::kMaxButtons,
+                "Gamepad buttons must fit in a ControllerSnapshot mask");
+  ControllerSnapshot::ButtonMask buttons = 0;
+  for (size_t i = 0; i < button_list_.size(); i++) {
+    if (button_list_[i].is_down()) {
+      buttons |= static_cast<ControllerSnapshot::ButtonMask>(1) << i;
+    }
+  }
+  snapshot->buttons[device] = buttons;
+}
+
 Button &Gamepad::GetButton(GamepadInputButton index) {
   assert(index >= 0 && index < Gamepad::kControlCount &&
          "Gamepad Button Index out of range");
@@ -13,6 +13,8 @@
 // limitations under the License.
 
 #include "precompiled.h"
+#include <atomic>
+
 #include "fplbase/flatbuffer_utils.h"
 #include "fplbase/material.h"
 #include "fplbase/renderer.h"
@@ -54,50 +56,139 @@ static_assert(kFormatCount == kFormatLuminanceAlpha + 1,
 void Material::Set(Renderer &renderer) {
   renderer.SetBlendMode(blend_mode_);
   for (size_t i = 0; i < textures_.size(); i++) textures_[i]->Set(i);
+  if (!texture_layers_.empty()) renderer.SetTextureLayers(texture_layers_);
+  if (!params_.empty()) renderer.SetMaterialParams(this);
+}
+
+ObjectPool<Material> &Material::pool() {
+  // Leaked, so that it outlives materials destroyed during static destruction.
+  static ObjectPool<Material> *pool = new ObjectPool<Material>();
+  return *pool;
+}
+
+uint32_t Material::NextParamsVersion() {
+  static std::atomic<uint32_t> next_version(1);
+  return next_version++;
+}
+
+bool Material::SetParam(const char *name, const float *value,
+                        size_t num_components) {
+  if (num_components < 1 || (num_components > 4 && num_components != 16)) {
+    LogError(kApplication, "Material parameter %s has %d components", name,
+             static_cast<int>(num_components));
+    return false;
+  }
+  auto param = params_.begin();
+  while (param != params_.end() && param->name != name) ++param;
+  if (param == params_.end()) {
+    params_.push_back(MaterialParam());
+    param = params_.end() - 1;
+    param->name = name;
+    // Resolve the new parameter's handles next time the material is bound.
+    params_handles_.clear();
+  }
+  param->value.assign(value, value + num_components);
+  params_version_ = NextParamsVersion();
+  return true;
+}
+
+void Material::UpdateSortKey() {
+  // Hash what identifies each texture across runs, rather than its GL handle.
+  // Layers of the same array are identified by the array alone.
+  std::string key;
+  for (size_t i = 0; i < textures_.size(); i++) {
+    const Texture *tex = textures_[i];
+    if (i < texture_layers_.size() && texture_layers_[i] >= 0) {
+      char array_key[64];
+      snprintf(array_key, sizeof(array_key), "array:%dx%d:%d:%d",
+               tex->size().x, tex->size().y, tex->format(), tex->flags());
+      key += array_key;
+    } else {
+      key += tex->filename();
+    }
+    key += '\n';
+  }
+  textures_sort_key_ =
+      textures_.empty()
+          ? 0
+          : flatbuffers::HashFnv1a<uint32_t>(key.c_str()) & 0x0FFFFFFF;
 }
 
 void Material::DeleteTextures() {
-  for (size_t i = 0; i < textures_.size(); i++) textures_[i]->Delete();
+  for (size_t i = 0; i < textures_.size(); i++) {
+    if (i < texture_layers_.size() && texture_layers_[i] >= 0) continue;
+    textures_[i]->Delete();
+  }
 }
 
 Material *Material::LoadFromMaterialDef(const matdef::Material *matdef,
-                                        const TextureLoaderFn &tlf) {
+                                        const TextureLoaderFn &tlf,
+                                        const TextureLayerLoaderFn &llf) {
   if (matdef) {
     auto mat = new Material();
     mat->set_blend_mode(static_cast<BlendMode>(matdef->blendmode()));
+    mat->textures().reserve(matdef->texture_filenames()->size());
+    mat->texture_layers().reserve(matdef->texture_filenames()->size());
     for (size_t i = 0; i < matdef->texture_filenames()->size(); i++) {
       flatbuffers::uoffset_t index = static_cast<flatbuffers::uoffset_t>(i);
       auto format =
           matdef->desired_format() && i < matdef->desired_format()->size()
               ? static_cast<TextureFormat>(matdef->desired_format()->Get(index))
               : kFormatAuto;
-      auto tex = tlf(
-          matdef->texture_filenames()->Get(index)->c_str(), format,
+      const bool is_cubemap =
+          matdef->is_cubemap() && matdef->is_cubemap()->Get(index);
+      const auto flags =
           (matdef->mipmaps() ? kTextureFlagsUseMipMaps : kTextureFlagsNone) |
-              (matdef->is_cubemap() && matdef->is_cubemap()->Get(index)
-                   ? kTextureFlagsIsCubeMap
-                   : kTextureFlagsNone) |
-              (matdef->wrapmode() == matdef::TextureWrap_CLAMP
-                   ? kTextureFlagsClampToEdge
-                   : kTextureFlagsNone));
+          (is_cubemap ? kTextureFlagsIsCubeMap : kTextureFlagsNone) |
+          (matdef->wrapmode() == matdef::TextureWrap_CLAMP
+               ? kTextureFlagsClampToEdge
+               : kTextureFlagsNone);
+      const char *filename = matdef->texture_filenames()->Get(index)->c_str();
+
+      // Texture arrays don't hold cubemaps.
+      TextureLayer layer;
+      if (llf && matdef->texture_array() && !is_cubemap) {
+        layer = llf(filename, format, flags);
+      }
+      if (layer.array) {
+        mat->textures().push_back(layer.array);
+        mat->texture_layers().push_back(layer.layer);
+        continue;
+      }
+
+      auto tex = tlf(filename, format, flags);
       if (!tex) {
         delete mat;
         return nullptr;
       }
       mat->textures().push_back(tex);
+      mat->texture_layers().push_back(-1);
       auto original_size =
           matdef->original_size() && index < matdef->original_size()->size()
               ? LoadVec2i(matdef->original_size()->Get(index))
               : tex->size();
       tex->set_original_size(original_size);
     }
+    if (matdef->params()) {
+      for (auto it = matdef->params()->begin(); it != matdef->params()->end();
+           ++it) {
+        if (!it->name() || !it->value() ||
+            !mat->SetParam(it->name()->c_str(), it->value()->data(),
+                           it->value()->size())) {
+          delete mat;
+          return nullptr;
+        }
+      }
+    }
+    mat->UpdateSortKey();
     return mat;
   }
   return nullptr;
 }
 
 Material *Material::LoadFromMaterialDef(const char *filename,
-                                        const TextureLoaderFn &tlf) {
+                                        const TextureLoaderFn &tlf,
+                                        const TextureLayerLoaderFn &llf) {
   const matdef::Material *def = nullptr;
   std::string flatbuf;
   if (LoadFile(filename, &flatbuf)) {
@@ -106,7 +197,7 @@ Material *Material::LoadFromMaterialDef(const char *filename,
     assert(matdef::VerifyMaterialBuffer(verifier));
     def = matdef::GetMaterial(flatbuf.c_str());
   }
-  Material *mat = LoadFromMaterialDef(def, tlf);
+  Material *mat = LoadFromMaterialDef(def, tlf, llf);
   if (!mat) {
     RendererBase::Get()->set_last_error(std::string("Couldn\'t load: ")
                                       + filename);
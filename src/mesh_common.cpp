@@ -63,6 +63,12 @@ void CopyAttribute(const T *attr, uint8_t *&buf) {
 
 }  // namespace
 
+ObjectPool<Mesh> &Mesh::pool() {
+  // Leaked, so that it outlives meshes destroyed during static destruction.
+  static ObjectPool<Mesh> *pool = new ObjectPool<Mesh>();
+  return *pool;
+}
+
 Mesh::Mesh(const char *filename, MaterialCreateFn material_create_fn,
            Primitive primitive)
     : AsyncAsset(filename ? filename : ""),
@@ -163,6 +169,7 @@ void Mesh::Load() {
         reinterpret_cast<const uint8_t *>(flatbuf->c_str()), flatbuf->length());
     assert(meshdef::VerifyMeshBuffer(verifier));
     data_ = reinterpret_cast<const uint8_t *>(flatbuf);
+    data_size_ = flatbuf->size();
   } else {
     LogError(kError, "Couldn\'t load: %s", filename_.c_str());
     data_ = nullptr;
@@ -292,6 +299,10 @@ bool Mesh::InitFromMeshDef(const void *meshdef_buffer) {
                surface->indices() ? surface->indices()->Length()
                                   : surface->indices32()->Length(),
                mat, !surface->indices());
+    if (surface->bone_palette()) {
+      SetBonePalette(indices_.size() - 1, surface->bone_palette()->Data(),
+                     surface->bone_palette()->Length());
+    }
   }
 
   InterleavedVertexData ivd;
@@ -358,6 +369,13 @@ void Mesh::SetBones(const mathfu::AffineTransform *bone_transforms,
   }
 }
 
+void Mesh::SetBonePalette(size_t i, const uint8_t *shader_bone_indices,
+                          size_t num_palette_bones) {
+  assert(i < indices_.size());
+  indices_[i].bone_palette.assign(shader_bone_indices,
+                                  shader_bone_indices + num_palette_bones);
+}
+
 void Mesh::GatherShaderTransforms(
     const mathfu::AffineTransform *bone_transforms,
     mathfu::AffineTransform *shader_transforms) const {
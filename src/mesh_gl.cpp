@@ -39,12 +39,75 @@ namespace fplbase {
 // Even though these functions are identical in each implementation, the
 // definition of MeshImpl is different, so these functions cannot be in
 // mesh_common.cpp.
-MeshImpl *Mesh::CreateMeshImpl() { return new MeshImpl; }
-void Mesh::DestroyMeshImpl(MeshImpl *impl) { delete impl; }
+static ObjectPool<MeshImpl> &MeshImplPool() {
+  // Leaked, so that it outlives meshes destroyed during static destruction.
+  static ObjectPool<MeshImpl> *pool = new ObjectPool<MeshImpl>();
+  return *pool;
+}
+MeshImpl *Mesh::CreateMeshImpl() { return MeshImplPool().New(); }
+void Mesh::DestroyMeshImpl(MeshImpl *impl) { MeshImplPool().Delete(impl); }
 
 bool Mesh::IsValid() { return ValidBufferHandle(impl_->vbo); }
 
+// Create a buffer on `target` holding `size` bytes of `data`.
+static BufferHandle CreateBuffer(GLenum target, const void *data, size_t size) {
+  GLuint buffer = 0;
+  GL_CALL(glGenBuffers(1, &buffer));
+  GL_CALL(glBindBuffer(target, buffer));
+  GL_CALL(glBufferData(target, size, data, GL_STATIC_DRAW));
+  GL_CALL(glBindBuffer(target, 0));
+  return BufferHandleFromGl(buffer);
+}
+
+// Take the buffer `*uploaded`, if Mesh::Upload() created it.
+static BufferHandle TakeUploaded(BufferHandle *uploaded) {
+  const BufferHandle buffer = *uploaded;
+  *uploaded = InvalidBufferHandle();
+  return buffer;
+}
+
+static void DeleteUploaded(MeshImpl *impl) {
+  if (ValidBufferHandle(impl->uploaded_vbo)) {
+    auto vbo = GlBufferHandle(TakeUploaded(&impl->uploaded_vbo));
+    GL_CALL(glDeleteBuffers(1, &vbo));
+  }
+  for (auto it = impl->uploaded_ibos.begin(); it != impl->uploaded_ibos.end();
+       ++it) {
+    if (ValidBufferHandle(*it)) {
+      auto ibo = GlBufferHandle(*it);
+      GL_CALL(glDeleteBuffers(1, &ibo));
+    }
+  }
+  impl->uploaded_ibos.clear();
+}
+
+bool Mesh::Upload() {
+  if (!data_) return false;
+  const char *meshdef_buffer =
+      reinterpret_cast<const std::string *>(data_)->c_str();
+  InterleavedVertexData ivd;
+  ParseInterleavedVertexData(meshdef_buffer, &ivd);
+  if (!ivd.count) return false;
+  impl_->uploaded_vbo = CreateBuffer(GL_ARRAY_BUFFER, ivd.vertex_data,
+                                     ivd.count * ivd.vertex_size);
+
+  // In the order InitFromMeshDef() adds them.
+  auto surfaces = meshdef::GetMesh(meshdef_buffer)->surfaces();
+  for (flatbuffers::uoffset_t i = 0; i < surfaces->size(); ++i) {
+    auto surface = surfaces->Get(i);
+    impl_->uploaded_ibos.push_back(
+        surface->indices()
+            ? CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, surface->indices()->Data(),
+                           surface->indices()->Length() * sizeof(uint16_t))
+            : CreateBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                           surface->indices32()->Data(),
+                           surface->indices32()->Length() * sizeof(uint32_t)));
+  }
+  return true;
+}
+
 void Mesh::ClearPlatformDependent() {
+  DeleteUploaded(impl_);
   if (ValidBufferHandle(impl_->vbo)) {
     auto vbo = GlBufferHandle(impl_->vbo);
     GL_CALL(glDeleteBuffers(1, &vbo));
@@ -70,12 +133,17 @@ void Mesh::LoadFromMemory(const void *vertex_data, size_t count,
   default_bone_transform_inverses_ = nullptr;
 
   set_format(format);
-  GLuint vbo = 0;
-  GL_CALL(glGenBuffers(1, &vbo));
-  impl_->vbo = BufferHandleFromGl(vbo);
+  if (ValidBufferHandle(impl_->uploaded_vbo)) {
+    // Filled by Upload() from this data. Its index buffers have been adopted
+    // by AddIndices() already.
+    impl_->vbo = TakeUploaded(&impl_->uploaded_vbo);
+    DeleteUploaded(impl_);
+  } else {
+    impl_->vbo =
+        CreateBuffer(GL_ARRAY_BUFFER, vertex_data, count * vertex_size);
+  }
+  const GLuint vbo = GlBufferHandle(impl_->vbo);
   GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
-  GL_CALL(glBufferData(GL_ARRAY_BUFFER, count * vertex_size, vertex_data,
-                       GL_STATIC_DRAW));
 
   if (RendererBase::Get()->feature_level() >= kFeatureLevel30) {
     GLuint vao = 0;
@@ -112,17 +180,18 @@ void Mesh::AddIndices(const void *index_data, int count, Material *mat,
   indices_.push_back(Indices());
   auto &idxs = indices_.back();
   idxs.count = count;
-  GLuint ibo = 0;
-  GL_CALL(glGenBuffers(1, &ibo));
-  idxs.ibo = BufferHandleFromGl(ibo);
-  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo));
-  GL_CALL(
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                   count * (is_32_bit ? sizeof(uint32_t) : sizeof(uint16_t)),
-                   index_data, GL_STATIC_DRAW));
+  const size_t surface = indices_.size() - 1;
+  if (surface < impl_->uploaded_ibos.size() &&
+      ValidBufferHandle(impl_->uploaded_ibos[surface])) {
+    // Filled by Upload() from this data.
+    idxs.ibo = TakeUploaded(&impl_->uploaded_ibos[surface]);
+  } else {
+    idxs.ibo = CreateBuffer(
+        GL_ELEMENT_ARRAY_BUFFER, index_data,
+        count * (is_32_bit ? sizeof(uint32_t) : sizeof(uint16_t)));
+  }
   idxs.index_type = (is_32_bit ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT);
   idxs.mat = mat;
-  GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
 }
 
 }  // namespace fplbase
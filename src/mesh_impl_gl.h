@@ -15,15 +15,25 @@
 #ifndef FPLBASE_MESH_IMPL_GL_H
 #define FPLBASE_MESH_IMPL_GL_H
 
+#include <vector>
+
 #include "fplbase/handles.h"
 
 namespace fplbase {
 
 struct MeshImpl {
-  MeshImpl() : vbo(InvalidBufferHandle()), vao(InvalidBufferHandle()) {}
+  MeshImpl()
+      : vbo(InvalidBufferHandle()),
+        vao(InvalidBufferHandle()),
+        uploaded_vbo(InvalidBufferHandle()) {}
 
   BufferHandle vbo;
   BufferHandle vao;
+
+  // Filled by Mesh::Upload() on the loader thread, for Finalize() to adopt.
+  // VAOs can't be shared between contexts, so Finalize() still makes vao.
+  BufferHandle uploaded_vbo;
+  std::vector<BufferHandle> uploaded_ibos;  // One per surface.
 };
 
 }  // namespace fplbase
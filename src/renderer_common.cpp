@@ -14,6 +14,7 @@
 
 #include "precompiled.h"  // NOLINT
 
+#include "fplbase/fpl_common.h"
 #include "fplbase/gpu_debug.h"
 #include "fplbase/preprocessor.h"
 #include "fplbase/render_target.h"
@@ -44,6 +45,8 @@ RendererBase::RendererBase()
       force_shader_(nullptr),
       force_blend_mode_(kBlendModeCount),
       max_vertex_uniform_components_(0),
+      shader_stages_compiled_(0),
+      shader_stage_cache_hits_(0),
       version_(&Version()) {
   assert(the_base_raw_ == nullptr);
 }
@@ -65,6 +68,10 @@ Renderer::Renderer()
       camera_pos_(mathfu::kZeros3f),
       bone_transforms_(nullptr),
       num_bones_(0),
+      shader_(nullptr),
+      material_params_version_(0),
+      material_params_shader_(nullptr),
+      material_params_program_version_(0),
       blend_mode_(kBlendModeUnknown),
       blend_amount_(0.0f),
       cull_mode_(kCullingModeUnknown),
@@ -117,13 +124,13 @@ bool RendererBase::Initialize(const vec2i &window_size,
 
 void Renderer::BeginRendering() {
 #ifdef FPLBASE_VERIFY_GPU_STATE
-  ValidateRenderState(render_state_);
+  state_validator_.Validate(render_state_);
 #endif  // FPLBASE_VERIFY_GPU_STATE
 }
 
 void Renderer::EndRendering() {
 #ifdef FPLBASE_VERIFY_GPU_STATE
-  ValidateRenderState(render_state_);
+  state_validator_.Validate(render_state_);
 #endif  // FPLBASE_VERIFY_GPU_STATE
 }
 
@@ -166,6 +173,13 @@ void Renderer::AdvanceFrame(bool minimized, double time) {
 }
 
 void Renderer::UpdateCachedRenderState(const RenderState &render_state) {
+#ifdef FPLBASE_VERIFY_GPU_STATE
+  state_validator_.BeginCall(
+      RenderStateCallSite(__func__, FPL_RETURN_ADDRESS()));
+  for (int i = 0; i < kRenderStateGroupCount; ++i) {
+    state_validator_.Touch(static_cast<RenderStateGroup>(i));
+  }
+#endif  // FPLBASE_VERIFY_GPU_STATE
   render_state_ = render_state;
 
   const BlendMode prev_blend_mode = blend_mode_;
@@ -182,6 +196,9 @@ void Renderer::UpdateCachedRenderState(const RenderState &render_state) {
   SetCulling(prev_cull_mode);
   SetDepthFunction(prev_depth_function);
   SetStencilMode(prev_stencil_mode, stencil_ref_, stencil_mask_);
+#ifdef FPLBASE_VERIFY_GPU_STATE
+  state_validator_.EndCall();
+#endif  // FPLBASE_VERIFY_GPU_STATE
 }
 
 }  // namespace fplbase
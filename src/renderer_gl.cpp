@@ -14,6 +14,8 @@
 
 #include "precompiled.h"  // NOLINT
 
+#include "flatbuffers/hash.h"
+#include "fplbase/fpl_common.h"
 #include "fplbase/internal/type_conversions_gl.h"
 #include "fplbase/preprocessor.h"
 #include "fplbase/render_target.h"
@@ -34,6 +36,31 @@ namespace fplbase {
 // Local helper functions to help rendering.
 namespace {
 
+#ifdef FPLBASE_VERIFY_GPU_STATE
+// Makes the enclosing Renderer function the call site of any render state set
+// until it returns, so the RenderStateValidator can report it.
+class RenderStateCallScope {
+ public:
+  RenderStateCallScope(RenderStateValidator *validator, const char *function,
+                       const void *return_address)
+      : validator_(validator) {
+    validator_->BeginCall(RenderStateCallSite(function, return_address));
+  }
+  ~RenderStateCallScope() { validator_->EndCall(); }
+
+ private:
+  RenderStateValidator *validator_;
+};
+
+#define FPLBASE_RENDER_STATE_CALL()                                         \
+  RenderStateCallScope render_state_call_scope(&state_validator_, __func__, \
+                                               FPL_RETURN_ADDRESS())
+#define FPLBASE_TOUCH_RENDER_STATE(group) state_validator_.Touch(group)
+#else
+#define FPLBASE_RENDER_STATE_CALL()
+#define FPLBASE_TOUCH_RENDER_STATE(group)
+#endif  // FPLBASE_VERIFY_GPU_STATE
+
 void DrawElement(int32_t count, int32_t instances, uint32_t index_type,
                  GLenum gl_primitive, bool support_instancing) {
   static const void *kNullIndices = nullptr;
@@ -228,15 +255,42 @@ ShaderHandle RendererBase::CompileShader(bool is_vertex_shader,
   PlatformSanitizeShaderSource(source, defines, &platform_source);
   const char *platform_source_ptr = platform_source.c_str();
 
+  // Many programs share a vertex or fragment shader, so reuse the stage if an
+  // identical one has already been compiled.
+  const uint64_t key =
+      (flatbuffers::HashFnv1a<uint64_t>(platform_source_ptr) << 1) |
+      (is_vertex_shader ? 1 : 0);
+  auto cached = shader_stages_.find(key);
+  const bool collides = cached != shader_stages_.end() &&
+                        cached->second.source != platform_source;
+  if (cached != shader_stages_.end() && !collides) {
+    cached->second.ref_count++;
+    shader_stage_cache_hits_++;
+    GL_CALL(glAttachShader(GlShaderHandle(program),
+                           GlShaderHandle(cached->second.handle)));
+    return cached->second.handle;
+  }
+
   const GLenum stage = is_vertex_shader ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER;
   const GLuint shader_obj = glCreateShader(stage);
   GL_CALL(glShaderSource(shader_obj, 1, &platform_source_ptr, nullptr));
   GL_CALL(glCompileShader(shader_obj));
+  shader_stages_compiled_++;
   GLint success;
   GL_CALL(glGetShaderiv(shader_obj, GL_COMPILE_STATUS, &success));
   if (success) {
     GL_CALL(glAttachShader(GlShaderHandle(program), shader_obj));
-    return ShaderHandleFromGl(shader_obj);
+    const ShaderHandle handle = ShaderHandleFromGl(shader_obj);
+    // An uncached stage isn't in `shader_stage_keys_`, so
+    // ReleaseShaderStage() deletes it with its program.
+    if (!collides) {
+      ShaderStage &entry = shader_stages_[key];
+      entry.handle = handle;
+      entry.ref_count = 1;
+      entry.source.swap(platform_source);
+      shader_stage_keys_[handle.handle] = key;
+    }
+    return handle;
   } else {
     GLint length = 0;
     GL_CALL(glGetShaderiv(shader_obj, GL_INFO_LOG_LENGTH, &length));
@@ -248,6 +302,23 @@ ShaderHandle RendererBase::CompileShader(bool is_vertex_shader,
   }
 }
 
+// static
+void RendererBase::ReleaseShaderStage(ShaderHandle stage) {
+  // Stages outlive the RendererBase only at shutdown; just delete them.
+  RendererBase *base = the_base_raw_;
+  if (base != nullptr) {
+    auto key = base->shader_stage_keys_.find(stage.handle);
+    if (key != base->shader_stage_keys_.end()) {
+      auto cached = base->shader_stages_.find(key->second);
+      assert(cached != base->shader_stages_.end());
+      if (--cached->second.ref_count > 0) return;
+      base->shader_stages_.erase(cached);
+      base->shader_stage_keys_.erase(key);
+    }
+  }
+  GL_CALL(glDeleteShader(GlShaderHandle(stage)));
+}
+
 Shader *RendererBase::CompileAndLinkShaderHelper(const char *vs_source,
                                                  const char *ps_source,
                                                  Shader *shader) {
@@ -295,15 +366,16 @@ Shader *RendererBase::CompileAndLinkShaderHelper(const char *vs_source,
       last_error_.assign(length, '\0');
       GL_CALL(
           glGetProgramInfoLog(program_gl, length, &length, &last_error_[0]));
-      GL_CALL(glDeleteShader(GlShaderHandle(ps)));
+      ReleaseShaderStage(ps);
     }
-    GL_CALL(glDeleteShader(GlShaderHandle(vs)));
+    ReleaseShaderStage(vs);
   }
   GL_CALL(glDeleteProgram(program_gl));
   return nullptr;
 }
 
 void Renderer::SetDepthFunction(DepthFunction func) {
+  FPLBASE_RENDER_STATE_CALL();
   if (func == depth_function_) {
     return;
   }
@@ -370,6 +442,8 @@ void Renderer::SetDepthFunction(DepthFunction func) {
 }
 
 void Renderer::SetDepthWrite(bool enabled) {
+  FPLBASE_RENDER_STATE_CALL();
+  FPLBASE_TOUCH_RENDER_STATE(kRenderStateGroupDepth);
   if (render_state_.depth_state.write_enabled == enabled) {
     return;
   }
@@ -380,6 +454,7 @@ void Renderer::SetDepthWrite(bool enabled) {
 }
 
 void Renderer::SetBlendMode(BlendMode blend_mode, float amount) {
+  FPLBASE_RENDER_STATE_CALL();
   (void)amount;
 
   if (blend_mode == blend_mode_ &&
@@ -489,6 +564,7 @@ static void SetStencilFunction(GLenum face, const StencilFunction &set_func,
 }
 
 void Renderer::SetStencilMode(StencilMode mode, int ref, uint32_t mask) {
+  FPLBASE_RENDER_STATE_CALL();
   if (mode == stencil_mode_ && ref == stencil_ref_ && mask == stencil_mask_) {
     return;
   }
@@ -541,6 +617,7 @@ void Renderer::SetStencilMode(StencilMode mode, int ref, uint32_t mask) {
 }
 
 void Renderer::SetCulling(CullingMode mode) {
+  FPLBASE_RENDER_STATE_CALL();
   if (mode == cull_mode_) {
     return;
   }
@@ -576,6 +653,8 @@ void Renderer::SetCulling(CullingMode mode) {
 }
 
 void Renderer::SetViewport(const Viewport &viewport) {
+  FPLBASE_RENDER_STATE_CALL();
+  FPLBASE_TOUCH_RENDER_STATE(kRenderStateGroupViewport);
   if (viewport == render_state_.viewport) {
     return;
   }
@@ -590,6 +669,7 @@ void Renderer::SetShader(const Shader *shader) {
   assert(!shader->IsDirty());
   const int kNumVec4InBoneTransform = 3;
   GL_CALL(glUseProgram(GlShaderHandle(shader->program_)));
+  shader_ = shader;
 
   if (ValidUniformHandle(shader->uniform_model_view_projection_)) {
     GL_CALL(glUniformMatrix4fv(
@@ -626,6 +706,8 @@ void Renderer::SetShader(const Shader *shader) {
 }
 
 void Renderer::ScissorOn(const vec2i &pos, const vec2i &size) {
+  FPLBASE_RENDER_STATE_CALL();
+  FPLBASE_TOUCH_RENDER_STATE(kRenderStateGroupScissor);
   if (!render_state_.scissor_state.enabled) {
     GL_CALL(glEnable(GL_SCISSOR_TEST));
     render_state_.scissor_state.enabled = true;
@@ -644,6 +726,8 @@ void Renderer::ScissorOn(const vec2i &pos, const vec2i &size) {
 }
 
 void Renderer::ScissorOff() {
+  FPLBASE_RENDER_STATE_CALL();
+  FPLBASE_TOUCH_RENDER_STATE(kRenderStateGroupScissor);
   if (!render_state_.scissor_state.enabled) {
     return;
   }
@@ -661,6 +745,7 @@ void Renderer::RenderSubMeshHelper(Mesh *mesh, size_t index,
   if (!ignore_material) {
     submesh->mat->Set(*this);
   }
+  SetBonePalette(submesh->bone_palette);
 
   GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GlBufferHandle(submesh->ibo)));
   DrawElement(submesh->count, static_cast<int32_t>(instances), submesh->index_type,
@@ -668,6 +753,88 @@ void Renderer::RenderSubMeshHelper(Mesh *mesh, size_t index,
   GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
 }
 
+void Renderer::SetBonePalette(const std::vector<uint8_t> &palette) {
+  if (palette.empty() || shader_ == nullptr || bone_transforms_ == nullptr ||
+      !ValidUniformHandle(shader_->uniform_bone_transforms_)) {
+    return;
+  }
+
+  // Gather the palette's transforms from the full set of shader transforms.
+  const size_t kFloatsInBoneTransform = 12;
+  static_assert(sizeof(mathfu::AffineTransform) ==
+                    kFloatsInBoneTransform * sizeof(float),
+                "AffineTransform must be tightly packed.");
+  bone_palette_data_.resize(palette.size() * kFloatsInBoneTransform);
+  for (size_t i = 0; i < palette.size(); ++i) {
+    assert(palette[i] < num_bones_);
+    memcpy(&bone_palette_data_[i * kFloatsInBoneTransform],
+           &bone_transforms_[palette[i]][0],
+           kFloatsInBoneTransform * sizeof(float));
+  }
+  GL_CALL(glUniform4fv(GlUniformHandle(shader_->uniform_bone_transforms_),
+                       static_cast<GLsizei>(palette.size() * 3),
+                       bone_palette_data_.data()));
+}
+
+void Renderer::SetTextureLayers(const std::vector<int> &layers) {
+  if (shader_ == nullptr ||
+      !ValidUniformHandle(shader_->uniform_texture_layers_)) {
+    return;
+  }
+  float values[kMaxTexturesPerShader];
+  const size_t count =
+      std::min(layers.size(), static_cast<size_t>(kMaxTexturesPerShader));
+  if (count == 0) return;
+  for (size_t i = 0; i < count; ++i) {
+    values[i] = static_cast<float>(std::max(layers[i], 0));
+  }
+  GL_CALL(glUniform1fv(GlUniformHandle(shader_->uniform_texture_layers_),
+                       static_cast<GLsizei>(count), values));
+}
+
+void Renderer::SetMaterialParams(Material *material) {
+  if (shader_ == nullptr) return;
+  const uint32_t program_version = shader_->program_version_;
+  if (material->params_version_ == material_params_version_ &&
+      shader_ == material_params_shader_ &&
+      program_version == material_params_program_version_) {
+    return;
+  }
+
+  // Look up the uniforms only the first time the material is used with each
+  // shader, and again whenever that shader is relinked. GL reuses program
+  // names, so the cache is keyed on the Shader and its program version.
+  const std::vector<MaterialParam> &params = material->params_;
+  std::vector<Material::ParamHandles> &cache = material->params_handles_;
+  auto cached = cache.begin();
+  while (cached != cache.end() && cached->shader != shader_) ++cached;
+  if (cached == cache.end()) {
+    cache.push_back(Material::ParamHandles());
+    cached = cache.end() - 1;
+    cached->shader = shader_;
+    cached->program_version = 0;
+  }
+  if (cached->program_version != program_version) {
+    cached->program_version = program_version;
+    cached->handles.resize(params.size());
+    const GLuint program = GlShaderHandle(shader_->program_);
+    for (size_t i = 0; i < params.size(); ++i) {
+      cached->handles[i] = UniformHandleFromGl(
+          glGetUniformLocation(program, params[i].name.c_str()));
+    }
+  }
+
+  for (size_t i = 0; i < params.size(); ++i) {
+    const UniformHandle handle = cached->handles[i];
+    if (!ValidUniformHandle(handle)) continue;
+    shader_->SetUniform(handle, params[i].value.data(),
+                        params[i].value.size());
+  }
+  material_params_version_ = material->params_version_;
+  material_params_shader_ = shader_;
+  material_params_program_version_ = program_version;
+}
+
 void Renderer::Render(Mesh *mesh, bool ignore_material, size_t instances) {
   BindAttributes(mesh->impl_->vao, mesh->impl_->vbo, mesh->format_,
                  mesh->vertex_size_);
@@ -701,6 +868,7 @@ void Renderer::RenderStereo(Mesh *mesh, const Shader *shader,
       GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GlBufferHandle(it->ibo)));
       for (size_t i = 0; i < 2; ++i) {
         prep_stereo(i);
+        SetBonePalette(it->bone_palette);
         DrawElement(it->count, static_cast<int32_t>(instances), it->index_type,
                     mesh->primitive_, base_->supports_instancing_);
       }
@@ -731,6 +899,7 @@ void Renderer::RenderSubMesh(Mesh *mesh, size_t submesh, bool ignore_material,
 }
 
 void Renderer::SetRenderState(const RenderState &render_state) {
+  FPLBASE_RENDER_STATE_CALL();
   SetAlphaTestState(render_state.alpha_test_state);
   SetBlendState(render_state.blend_state);
   SetCullState(render_state.cull_state);
@@ -766,6 +935,7 @@ void Renderer::SetAlphaTestState(const AlphaTestState &alpha_test_state) {
 }
 
 void Renderer::SetBlendState(const BlendState &blend_state) {
+  FPLBASE_TOUCH_RENDER_STATE(kRenderStateGroupBlend);
   if (blend_state.enabled != render_state_.blend_state.enabled) {
     if (blend_state.enabled) {
       GL_CALL(glEnable(GL_BLEND));
@@ -790,6 +960,7 @@ void Renderer::SetBlendState(const BlendState &blend_state) {
 }
 
 void Renderer::SetCullState(const CullState &cull_state) {
+  FPLBASE_TOUCH_RENDER_STATE(kRenderStateGroupCull);
   if (cull_state.enabled != render_state_.cull_state.enabled) {
     if (cull_state.enabled) {
       GL_CALL(glEnable(GL_CULL_FACE));
@@ -813,6 +984,7 @@ void Renderer::SetCullState(const CullState &cull_state) {
 }
 
 void Renderer::SetDepthState(const DepthState &depth_state) {
+  FPLBASE_TOUCH_RENDER_STATE(kRenderStateGroupDepth);
   if (depth_state.test_enabled != render_state_.depth_state.test_enabled) {
     if (depth_state.test_enabled) {
       GL_CALL(glEnable(GL_DEPTH_TEST));
@@ -832,6 +1004,7 @@ void Renderer::SetDepthState(const DepthState &depth_state) {
 }
 
 void Renderer::SetPointState(const PointState &point_state) {
+  FPLBASE_TOUCH_RENDER_STATE(kRenderStateGroupPoint);
 #ifndef FPLBASE_GLES
 #ifdef GL_POINT_SPRITE
   if (render_state_.point_state.point_sprite_enabled !=
@@ -873,6 +1046,7 @@ void Renderer::SetPointState(const PointState &point_state) {
 }
 
 void Renderer::SetScissorState(const ScissorState &scissor_state) {
+  FPLBASE_TOUCH_RENDER_STATE(kRenderStateGroupScissor);
   if (render_state_.scissor_state == scissor_state) {
     return;
   }
@@ -887,6 +1061,7 @@ void Renderer::SetScissorState(const ScissorState &scissor_state) {
 }
 
 void Renderer::SetStencilState(const StencilState &stencil_state) {
+  FPLBASE_TOUCH_RENDER_STATE(kRenderStateGroupStencil);
   if (stencil_state.enabled != render_state_.stencil_state.enabled) {
     if (stencil_state.enabled) {
       GL_CALL(glEnable(GL_STENCIL_TEST));
@@ -913,6 +1088,8 @@ void Renderer::SetStencilState(const StencilState &stencil_state) {
 }
 
 void Renderer::SetFrontFace(CullState::FrontFace front_face) {
+  FPLBASE_RENDER_STATE_CALL();
+  FPLBASE_TOUCH_RENDER_STATE(kRenderStateGroupCull);
   if (front_face != render_state_.cull_state.front) {
     GL_CALL(glFrontFace(FrontFaceToGl(front_face)));
   }
@@ -14,6 +14,7 @@
 
 #include "precompiled.h"
 
+#include <atomic>
 #include <iterator>
 
 #include "fplbase/preprocessor.h"
@@ -23,6 +24,12 @@
 
 namespace fplbase {
 
+ObjectPool<Shader> &Shader::pool() {
+  // Leaked, so that it outlives shaders destroyed during static destruction.
+  static ObjectPool<Shader> *pool = new ObjectPool<Shader>();
+  return *pool;
+}
+
 Shader::~Shader() {
   Clear();
   DestroyShaderImpl(impl_);
@@ -32,6 +39,7 @@ void Shader::Init(ShaderHandle program, ShaderHandle vs, ShaderHandle ps,
                   const std::vector<std::string> &local_defines,
                   Renderer *renderer) {
   program_ = program;
+  program_version_ = NextProgramVersion();
   vs_ = vs;
   ps_ = ps;
   const UniformHandle invalid = InvalidUniformHandle();
@@ -42,6 +50,7 @@ void Shader::Init(ShaderHandle program, ShaderHandle vs, ShaderHandle ps,
   uniform_camera_pos_ = invalid;
   uniform_time_ = invalid;
   uniform_bone_transforms_ = invalid;
+  uniform_texture_layers_ = invalid;
   renderer_ = renderer;
 
   // All local defines are enabled by default.
@@ -103,9 +112,15 @@ bool Shader::ReloadInternal() {
   return sh != nullptr;
 }
 
+uint32_t Shader::NextProgramVersion() {
+  static std::atomic<uint32_t> next_version(1);
+  return next_version++;
+}
+
 void Shader::Reset(ShaderHandle program, ShaderHandle vs, ShaderHandle ps) {
   Clear();
   program_ = program;
+  program_version_ = NextProgramVersion();
   vs_ = vs;
   ps_ = ps;
 }
@@ -114,27 +129,34 @@ void Shader::Load() {
   ShaderSourcePair *source_pair = LoadSourceFile();
   if (source_pair != nullptr) {
     data_ = reinterpret_cast<uint8_t *>(source_pair);
+    data_size_ = source_pair->vertex_shader.size() +
+                 source_pair->fragment_shader.size();
   }
 }
 
-bool Shader::Finalize() {
-  if (data_ == nullptr) {
-    return false;
-  }
-  const ShaderSourcePair *source_pair =
-      reinterpret_cast<const ShaderSourcePair *>(data_);
-  auto sh =
-      renderer_->RecompileShader(source_pair->vertex_shader.c_str(),
-                                 source_pair->fragment_shader.c_str(), this);
+void Shader::DiscardData() {
+  delete reinterpret_cast<const ShaderSourcePair *>(data_);
+  data_ = nullptr;
+}
 
-  if (sh == nullptr) {
-    LogError(kError, "Shader compilation error:\n%s",
-             renderer_->last_error().c_str());
+bool Shader::Finalize() {
+  // If the source failed to load, finalize anyway, so that callbacks and
+  // load groups waiting for the shader learn that it failed.
+  Shader *sh = nullptr;
+  if (data_ != nullptr) {
+    const ShaderSourcePair *source_pair =
+        reinterpret_cast<const ShaderSourcePair *>(data_);
+    sh = renderer_->RecompileShader(source_pair->vertex_shader.c_str(),
+                                    source_pair->fragment_shader.c_str(),
+                                    this);
+    if (sh == nullptr) {
+      LogError(kError, "Shader compilation error:\n%s",
+               renderer_->last_error().c_str());
+    }
+    dirty_ = false;
   }
 
   CallFinalizeCallback();
-
-  dirty_ = false;
   return sh != nullptr;
 }
 
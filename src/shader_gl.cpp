@@ -34,18 +34,20 @@ ShaderImpl *Shader::CreateShaderImpl() { return nullptr; }
 void Shader::DestroyShaderImpl(ShaderImpl *impl) { (void)impl; }
 
 void Shader::Clear() {
+  // Delete the program first, which detaches its stages. They may be shared
+  // with other programs, so release rather than delete them.
+  if (ValidShaderHandle(program_)) {
+    GL_CALL(glDeleteProgram(GlShaderHandle(program_)));
+    program_ = InvalidShaderHandle();
+  }
   if (ValidShaderHandle(vs_)) {
-    GL_CALL(glDeleteShader(GlShaderHandle(vs_)));
+    RendererBase::ReleaseShaderStage(vs_);
     vs_ = InvalidShaderHandle();
   }
   if (ValidShaderHandle(ps_)) {
-    GL_CALL(glDeleteShader(GlShaderHandle(ps_)));
+    RendererBase::ReleaseShaderStage(ps_);
     ps_ = InvalidShaderHandle();
   }
-  if (ValidShaderHandle(program_)) {
-    GL_CALL(glDeleteProgram(GlShaderHandle(program_)));
-    program_ = InvalidShaderHandle();
-  }
   if (data_ != nullptr) {
     delete reinterpret_cast<const ShaderSourcePair *>(data_);
     data_ = nullptr;
@@ -59,7 +61,7 @@ UniformHandle Shader::FindUniform(const char *uniform_name) {
 }
 
 void Shader::SetUniform(UniformHandle uniform_loc, const float *value,
-                        size_t num_components) {
+                        size_t num_components) const {
   // clang-format off
   auto uniform_loc_gl = GlUniformHandle(uniform_loc);
   switch (num_components) {
@@ -97,6 +99,11 @@ void Shader::InitializeUniforms() {
   uniform_bone_transforms_ =
       UniformHandleFromGl(glGetUniformLocation(program, "bone_transforms"));
 
+  // An array of floats: the layer to sample from each texture unit bound to
+  // a TextureArray.
+  uniform_texture_layers_ =
+      UniformHandleFromGl(glGetUniformLocation(program, "texture_layers"));
+
   // Set up the uniforms the shader uses for texture access.
   char texture_unit_name[] = "texture_unit_#####";
   for (int i = 0; i < kMaxTexturesPerShader; i++) {
@@ -0,0 +1,253 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This file has no graphics dependencies, so that the mesh_pipeline can build
+// it too.
+#include "fplbase/tangent_space.h"
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "mathfu/constants.h"
+#include "mathfu/quaternion.h"
+#include "mathfu/utilities.h"
+
+using mathfu::mat3;
+using mathfu::quat;
+using mathfu::vec2;
+using mathfu::vec3;
+using mathfu::vec4;
+
+namespace fplbase {
+
+// Work is split into jobs of this many triangles or vertices, so that the
+// cost of dispatching a job is small next to the job itself.
+static const size_t kItemsPerJob = 4096;
+
+// Squared lengths below this are treated as zero.
+static const float kMinLengthSquared = 1e-20f;
+
+static inline vec3 LoadVec3(const VertexAttributeView &view, size_t i) {
+  const float *f = view[i];
+  return vec3(f[0], f[1], f[2]);
+}
+
+static inline vec2 LoadVec2(const VertexAttributeView &view, size_t i) {
+  const float *f = view[i];
+  return vec2(f[0], f[1]);
+}
+
+static inline size_t Index(const TangentSpaceMesh &mesh, size_t i) {
+  return mesh.indices32 != nullptr ? mesh.indices32[i] : mesh.indices16[i];
+}
+
+static inline vec3 NormalizedOrZero(const vec3 &v) {
+  const float length_squared = v.LengthSquared();
+  return length_squared > kMinLengthSquared
+             ? v * (1.0f / sqrtf(length_squared))
+             : mathfu::kZeros3f;
+}
+
+// Remove the component of `v` along the unit vector `n`, then normalize.
+static inline vec3 ProjectOntoPlane(const vec3 &v, const vec3 &n) {
+  return NormalizedOrZero(v - n * vec3::DotProduct(n, v));
+}
+
+// Return a unit vector perpendicular to `n`.
+static inline vec3 Perpendicular(const vec3 &n) {
+  const vec3 axis =
+      fabsf(n.x) < 0.9f ? mathfu::kAxisX3f : mathfu::kAxisY3f;
+  const vec3 p = NormalizedOrZero(vec3::CrossProduct(n, axis));
+  return p.LengthSquared() > 0.0f ? p : mathfu::kAxisX3f;
+}
+
+// Call `fn(begin, end)` for consecutive ranges that cover [0, count).
+static void ForEachRange(size_t count, const ParallelForFunction &parallel_for,
+                         const std::function<void(size_t, size_t)> &fn) {
+  const size_t num_jobs = (count + kItemsPerJob - 1) / kItemsPerJob;
+  const auto job = [&](size_t j) {
+    const size_t begin = j * kItemsPerJob;
+    fn(begin, std::min(begin + kItemsPerJob, count));
+  };
+  if (parallel_for && num_jobs > 1) {
+    parallel_for(num_jobs, job);
+  } else {
+    for (size_t j = 0; j < num_jobs; ++j) job(j);
+  }
+}
+
+// The tangent that each triangle corner contributes to its vertex, and the
+// corners of each vertex.
+struct CornerSums {
+  // Per corner, the weighted tangent. The w component holds the weighted
+  // handedness, or 0 if the triangle has no UV area.
+  std::vector<mathfu::vec4_packed> corners;
+  // The corners of vertex `v` are vertex_corners[offsets[v], offsets[v + 1]).
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> vertex_corners;
+};
+
+static void SumCorners(const TangentSpaceMesh &mesh,
+                       const ParallelForFunction &parallel_for,
+                       CornerSums *sums) {
+  assert(mesh.positions.data && mesh.normals.data && mesh.uvs.data);
+  assert((mesh.indices16 == nullptr) != (mesh.indices32 == nullptr));
+  assert(mesh.num_indices % 3 == 0);
+  const size_t num_corners = mesh.num_indices;
+  const size_t num_triangles = num_corners / 3;
+
+  // Each triangle contributes a tangent to each of its corners, in the plane
+  // of the corner's normal and weighted by the corner's angle.
+  std::vector<mathfu::vec4_packed> &corners = sums->corners;
+  corners.resize(num_corners);
+  ForEachRange(num_triangles, parallel_for, [&](size_t begin, size_t end) {
+    for (size_t tri = begin; tri < end; ++tri) {
+      const size_t i[3] = {Index(mesh, 3 * tri), Index(mesh, 3 * tri + 1),
+                           Index(mesh, 3 * tri + 2)};
+      const vec3 p[3] = {LoadVec3(mesh.positions, i[0]),
+                         LoadVec3(mesh.positions, i[1]),
+                         LoadVec3(mesh.positions, i[2])};
+      const vec2 uv[3] = {LoadVec2(mesh.uvs, i[0]), LoadVec2(mesh.uvs, i[1]),
+                          LoadVec2(mesh.uvs, i[2])};
+
+      // The direction of increasing u. As in MikkTSpace, its magnitude is
+      // discarded, and its sign flips when the UVs are mirrored.
+      const vec3 e1 = p[1] - p[0];
+      const vec3 e2 = p[2] - p[0];
+      const vec2 d1 = uv[1] - uv[0];
+      const vec2 d2 = uv[2] - uv[0];
+      const float signed_uv_area = d1.x * d2.y - d2.x * d1.y;
+      const float handedness = signed_uv_area < 0.0f ? -1.0f : 1.0f;
+      const vec3 s = (e1 * d2.y - e2 * d1.y) * handedness;
+
+      // Triangles without UV area have no tangent to contribute.
+      if (fabsf(signed_uv_area) <= kMinLengthSquared) {
+        for (int k = 0; k < 3; ++k) corners[3 * tri + k] = mathfu::kZeros4f;
+        continue;
+      }
+
+      for (int k = 0; k < 3; ++k) {
+        const vec3 n = LoadVec3(mesh.normals, i[k]);
+        const vec3 to_next = ProjectOntoPlane(p[(k + 1) % 3] - p[k], n);
+        const vec3 to_prev = ProjectOntoPlane(p[(k + 2) % 3] - p[k], n);
+        const float angle = acosf(mathfu::Clamp(
+            vec3::DotProduct(to_next, to_prev), -1.0f, 1.0f));
+        corners[3 * tri + k] =
+            vec4(ProjectOntoPlane(s, n) * angle, angle * handedness);
+      }
+    }
+  });
+
+  // List the corners of each vertex, in triangle order, so that sums over
+  // them don't depend on how the work was split.
+  std::vector<uint32_t> &offsets = sums->offsets;
+  offsets.assign(mesh.num_vertices + 1, 0);
+  for (size_t c = 0; c < num_corners; ++c) {
+    assert(Index(mesh, c) < mesh.num_vertices);
+    ++offsets[Index(mesh, c) + 1];
+  }
+  for (size_t v = 0; v < mesh.num_vertices; ++v) offsets[v + 1] += offsets[v];
+  sums->vertex_corners.resize(num_corners);
+  std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+  for (size_t c = 0; c < num_corners; ++c) {
+    sums->vertex_corners[next[Index(mesh, c)]++] = static_cast<uint32_t>(c);
+  }
+}
+
+// The tangent frames of one vertex: one from the corners of each handedness.
+struct VertexFrames {
+  vec4 right;
+  vec4 left;
+  // The frame of the handedness with the greater weight.
+  vec4 dominant;
+};
+
+// Orthonormalize the summed tangent `sum` against the normal `n`.
+static inline vec4 FinishTangent(const vec3 &sum, const vec3 &n,
+                                 float handedness) {
+  vec3 t = ProjectOntoPlane(sum, n);
+  if (t.LengthSquared() == 0.0f) t = Perpendicular(n);
+  return vec4(t, handedness);
+}
+
+static VertexFrames SumVertex(const TangentSpaceMesh &mesh,
+                              const CornerSums &sums, size_t v) {
+  // Like MikkTSpace, keep the corners of mirrored triangles apart, so that
+  // a vertex on a mirrored UV seam doesn't get the average of both sides.
+  vec4 right_sum = mathfu::kZeros4f;
+  vec4 left_sum = mathfu::kZeros4f;
+  for (uint32_t k = sums.offsets[v]; k < sums.offsets[v + 1]; ++k) {
+    const vec4 corner(sums.corners[sums.vertex_corners[k]]);
+    if (corner.w > 0.0f) {
+      right_sum += corner;
+    } else if (corner.w < 0.0f) {
+      left_sum += corner;
+    }
+  }
+  const vec3 n = LoadVec3(mesh.normals, v);
+  VertexFrames frames;
+  frames.right = FinishTangent(right_sum.xyz(), n, 1.0f);
+  frames.left = FinishTangent(left_sum.xyz(), n, -1.0f);
+  frames.dominant = right_sum.w >= -left_sum.w ? frames.right : frames.left;
+  return frames;
+}
+
+void GenerateTangents(const TangentSpaceMesh &mesh,
+                      mathfu::vec4_packed *tangents,
+                      const ParallelForFunction &parallel_for) {
+  CornerSums sums;
+  SumCorners(mesh, parallel_for, &sums);
+  ForEachRange(mesh.num_vertices, parallel_for, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      tangents[v] = SumVertex(mesh, sums, v).dominant;
+    }
+  });
+}
+
+void GenerateCornerTangents(const TangentSpaceMesh &mesh,
+                            mathfu::vec4_packed *corner_tangents,
+                            const ParallelForFunction &parallel_for) {
+  CornerSums sums;
+  SumCorners(mesh, parallel_for, &sums);
+  ForEachRange(mesh.num_vertices, parallel_for, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+      const VertexFrames frames = SumVertex(mesh, sums, v);
+      for (uint32_t k = sums.offsets[v]; k < sums.offsets[v + 1]; ++k) {
+        const uint32_t c = sums.vertex_corners[k];
+        const float w = sums.corners[c].data[3];
+        // Corners without a tangent of their own take the vertex's.
+        corner_tangents[c] =
+            w > 0.0f ? frames.right : w < 0.0f ? frames.left : frames.dominant;
+      }
+    }
+  });
+}
+
+vec4 CalculateOrientation(const vec3 &normal, const vec4 &tangent) {
+  const vec3 n = normal.Normalized();
+  const vec3 t = tangent.xyz().Normalized();
+  const vec3 b = vec3::CrossProduct(n, t).Normalized();
+  const mat3 m(t.x, t.y, t.z, b.x, b.y, b.z, n.x, n.y, n.z);
+  quat q = quat::FromMatrix(m).Normalized();
+  // Align the sign bit of the orientation scalar to our handedness.
+  if (std::signbit(tangent.w) != std::signbit(q.scalar())) {
+    q = quat(-q.scalar(), -q.vector());
+  }
+  return vec4(q.vector(), q.scalar());
+}
+
+}  // namespace fplbase
@@ -0,0 +1,129 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "fplbase/texture_array.h"
+#include "fplbase/utilities.h"
+
+using mathfu::vec2;
+using mathfu::vec2i;
+
+namespace fplbase {
+
+TextureArray::TextureArray(const vec2i &size, TextureFormat format,
+                           int num_layers, TextureFlags flags)
+    : Texture(nullptr, format, flags), num_layers_(num_layers) {
+  size_ = size;
+  SetOriginalSizeIfNotYetSet(size);
+  texture_format_ = format;
+  // Hand out low layers first.
+  for (int layer = num_layers - 1; layer >= 0; --layer) {
+    free_layers_.push_back(layer);
+  }
+}
+
+int TextureArray::AllocateLayer() {
+  if (free_layers_.empty()) return -1;
+  const int layer = free_layers_.back();
+  free_layers_.pop_back();
+  return layer;
+}
+
+void TextureArray::FreeLayer(int layer) {
+  assert(0 <= layer && layer < num_layers_);
+  assert(std::find(free_layers_.begin(), free_layers_.end(), layer) ==
+         free_layers_.end());
+  free_layers_.push_back(layer);
+}
+
+TextureArrayPool::TextureArrayPool(int layers_per_array)
+    : layers_per_array_(layers_per_array) {
+  assert(layers_per_array > 0);
+}
+
+TextureArrayPool::~TextureArrayPool() { Clear(); }
+
+TextureLayer TextureArrayPool::LoadTexture(const char *filename,
+                                           const vec2 &scale,
+                                           TextureFlags flags) {
+  auto existing = layers_.find(filename);
+  if (existing != layers_.end()) {
+    existing->second.ref_count++;
+    return existing->second.layer;
+  }
+
+  // Loading is synchronous, so the flag doesn't distinguish arrays.
+  flags = static_cast<TextureFlags>(flags & ~kTextureFlagsLoadAsync);
+  vec2i size;
+  TextureFormat format;
+  uint8_t *data =
+      Texture::LoadAndUnpackTexture(filename, scale, flags, &size, &format);
+  if (data == nullptr) return TextureLayer();
+
+  // Find an array with room for the texture, or create one.
+  TextureLayer result;
+  for (auto it = arrays_.begin(); it != arrays_.end(); ++it) {
+    TextureArray *array = *it;
+    if (array->size() == size && array->format() == format &&
+        array->flags() == flags && array->num_free_layers() > 0) {
+      result.array = array;
+      break;
+    }
+  }
+  if (result.array == nullptr) {
+    TextureArray *array =
+        new TextureArray(size, format, layers_per_array_, flags);
+    if (array->Create()) {
+      arrays_.push_back(array);
+      result.array = array;
+    } else {
+      LogError(kApplication, "Can't create a texture array for %s", filename);
+      delete array;
+    }
+  }
+  if (result.array != nullptr) {
+    result.layer = result.array->AllocateLayer();
+    result.array->SetLayer(result.layer, data);
+    const LoadedLayer loaded = {result, 1};
+    layers_[filename] = loaded;
+  }
+  free(data);
+  return result;
+}
+
+void TextureArrayPool::UnloadTexture(const char *filename) {
+  auto it = layers_.find(filename);
+  if (it == layers_.end() || --it->second.ref_count > 0) return;
+  it->second.layer.array->FreeLayer(it->second.layer.layer);
+  layers_.erase(it);
+}
+
+void TextureArrayPool::UnloadTexture(const TextureLayer &layer) {
+  for (auto it = layers_.begin(); it != layers_.end(); ++it) {
+    if (it->second.layer.array == layer.array &&
+        it->second.layer.layer == layer.layer) {
+      UnloadTexture(it->first.c_str());
+      return;
+    }
+  }
+}
+
+void TextureArrayPool::Clear() {
+  for (auto it = arrays_.begin(); it != arrays_.end(); ++it) delete *it;
+  arrays_.clear();
+  layers_.clear();
+}
+
+}  // namespace fplbase
@@ -0,0 +1,90 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+
+#include "fplbase/internal/type_conversions_gl.h"
+#include "fplbase/renderer.h"
+#include "fplbase/texture_array.h"
+#include "fplbase/utilities.h"
+
+using mathfu::vec2i;
+
+namespace fplbase {
+
+// Returns false if texture arrays can't hold `format`.
+static bool GlFormat(TextureFormat format, GLenum *gl_format) {
+  // clang-format off
+  switch (format) {
+    case kFormat8888: *gl_format = GL_RGBA; return true;
+    case kFormat888: *gl_format = GL_RGB; return true;
+    case kFormatLuminance: *gl_format = GL_LUMINANCE; return true;
+    case kFormatLuminanceAlpha: *gl_format = GL_LUMINANCE_ALPHA; return true;
+    default: return false;
+  }
+  // clang-format on
+}
+
+bool TextureArray::Create() {
+  assert(!(flags_ & kTextureFlagsIsCubeMap));
+  GLenum format;
+  if (RendererBase::Get()->feature_level() < kFeatureLevel30 ||
+      !GlFormat(texture_format_, &format)) {
+    return false;
+  }
+
+  GLuint texture_id;
+  GL_CALL(glGenTextures(1, &texture_id));
+  GL_CALL(glActiveTexture(GL_TEXTURE0));
+  GL_CALL(glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id));
+  const GLint wrap_mode =
+      flags_ & kTextureFlagsClampToEdge ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+  const bool mips = (flags_ & kTextureFlagsUseMipMaps) != 0;
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap_mode));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap_mode));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER,
+                          GL_LINEAR));
+  GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                          mips ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+
+  // Allocate every mip level up front; layers are filled in by SetLayer().
+  vec2i mip_size = size_;
+  for (int level = 0;; ++level) {
+    GL_CALL(glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, mip_size.x,
+                         mip_size.y, num_layers_, 0, format, GL_UNSIGNED_BYTE,
+                         nullptr));
+    if (!mips || (mip_size.x == 1 && mip_size.y == 1)) break;
+    mip_size = vec2i::Max(mathfu::kOnes2i, mip_size / 2);
+  }
+
+  id_ = TextureHandleFromGl(texture_id);
+  target_ = TextureTargetFromGl(GL_TEXTURE_2D_ARRAY);
+  is_external_ = false;
+  return true;
+}
+
+void TextureArray::SetLayer(int layer, const uint8_t *data) {
+  assert(0 <= layer && layer < num_layers_ && ValidTextureHandle(id_));
+  GLenum format = GL_RGBA;
+  GlFormat(texture_format_, &format);
+  GL_CALL(glActiveTexture(GL_TEXTURE0));
+  GL_CALL(glBindTexture(GL_TEXTURE_2D_ARRAY, GlTextureHandle(id_)));
+  GL_CALL(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, size_.x,
+                          size_.y, 1, format, GL_UNSIGNED_BYTE, data));
+  if (flags_ & kTextureFlagsUseMipMaps) {
+    GL_CALL(glGenerateMipmap(GL_TEXTURE_2D_ARRAY));
+  }
+}
+
+}  // namespace fplbase
@@ -18,6 +18,7 @@
 #include "fplbase/renderer.h"
 #include "fplbase/texture.h"
 #include "fplbase/texture_atlas.h"
+#include "fplbase/texture_staging.h"
 #include "fplbase/utilities.h"
 #include "mathfu/glsl_mappings.h"
 #include "texture_atlas_generated.h"
@@ -56,6 +57,16 @@ using mathfu::vec2i;
 
 namespace fplbase {
 
+// Bytes of a WebP file fed to the decoder between cancellation checks.
+static const size_t kWebPDecodeChunkSize = 32 * 1024;
+
+// Output rows resized between cancellation checks.
+static const int kResizeStripeHeight = 64;
+
+static bool IsCancelled(const CancellationToken *cancel) {
+  return cancel != nullptr && cancel->IsCancelled();
+}
+
 // Returns true if the file has a Resource Interchange File Format (RIFF) header
 // whose first chunk has a WEBP FOURCC. This will not check chunks other than
 // the first one. https://developers.google.com/speed/webp/docs/riff_container
@@ -81,6 +92,10 @@ Texture::Texture(const char *filename, TextureFormat format, TextureFlags flags)
     : AsyncAsset(filename ? filename : ""),
       impl_(CreateTextureImpl()),
       id_(InvalidTextureHandle()),
+      uploaded_id_(InvalidTextureHandle()),
+      staging_pool_(nullptr),
+      staging_buffer_(nullptr),
+      staged_format_(kFormat888),
       size_(mathfu::kZeros2i),
       original_size_(mathfu::kZeros2i),
       scale_(mathfu::kOnes2f),
@@ -88,17 +103,96 @@ Texture::Texture(const char *filename, TextureFormat format, TextureFlags flags)
       target_(TextureTargetFromFlags(flags)),
       desired_(format),
       flags_(flags),
+      resample_filter_(kTextureResampleFilterDefault),
       is_external_(false) {}
 
+ObjectPool<Texture> &Texture::pool() {
+  // Leaked, so that it outlives textures destroyed during static destruction.
+  static ObjectPool<Texture> *pool = new ObjectPool<Texture>();
+  return *pool;
+}
+
 Texture::~Texture() {
+  ReleaseStagingBuffer();
   Delete();
   DestroyTextureImpl(impl_);
 }
 
+// The size of a texture's unpacked data. Compressed formats are assumed to be
+// 4 bits per pixel, as ETC and most ASTC block sizes in use are about that.
+static size_t UnpackedDataSize(const vec2i &size, TextureFormat format) {
+  const size_t pixels = static_cast<size_t>(size.x) * size.y;
+  // clang-format off
+  switch (format) {
+    case kFormat8888: return pixels * 4;
+    case kFormat888: return pixels * 3;
+    case kFormat5551:
+    case kFormat565:
+    case kFormatLuminanceAlpha: return pixels * 2;
+    case kFormatLuminance: return pixels;
+    default: return pixels / 2;
+  }
+  // clang-format on
+}
+
 void Texture::Load() {
   data_ = LoadAndUnpackTexture(filename_.c_str(), scale_, flags_, &size_,
-                               &texture_format_);
+                               &texture_format_, &cancellation_token_);
   SetOriginalSizeIfNotYetSet(size_);
+  if (data_ && !cancellation_token_.IsCancelled()) {
+    uint8_t *resampled = ResampleIfNpotUnsupported(data_);
+    if (resampled) {
+      free(const_cast<uint8_t *>(data_));
+      data_ = resampled;
+    }
+    data_size_ = UnpackedDataSize(size_, texture_format_);
+    StageData();
+  }
+}
+
+bool Texture::StageData() {
+  if (!staging_pool_ || !data_ || staging_buffer_ ||
+      IsCompressed(texture_format_) || (flags_ & kTextureFlagsIsCubeMap)) {
+    return false;
+  }
+  // Resolve the format to upload in, as CreateTexture() does.
+  TextureFormat desired = desired_;
+  if (desired == kFormatAuto) {
+    desired = HasAlpha(texture_format_) ? kFormat5551 : kFormat565;
+  } else if (desired == kFormatNative) {
+    desired = texture_format_;
+  }
+  const bool to_16bpp =
+      (texture_format_ == kFormat8888 && desired == kFormat5551) ||
+      (texture_format_ == kFormat888 && desired == kFormat565);
+  if (!to_16bpp && desired != texture_format_) return false;
+  const TextureFormat staged_format =
+      to_16bpp && staging_pool_->use_16bpp() ? desired : texture_format_;
+
+  const size_t staged_size = UnpackedDataSize(size_, staged_format);
+  TextureStagingBuffer *buffer = staging_pool_->Acquire(staged_size);
+  if (!buffer) return false;
+  uint16_t *out = reinterpret_cast<uint16_t *>(buffer->data);
+  if (staged_format == kFormat5551) {
+    Convert8888To5551(data_, size_, out);
+  } else if (staged_format == kFormat565) {
+    Convert888To565(data_, size_, out);
+  } else {
+    memcpy(buffer->data, data_, staged_size);
+  }
+  free(const_cast<uint8_t *>(data_));
+  data_ = buffer->data;
+  data_size_ = staged_size;
+  staging_buffer_ = buffer;
+  staged_format_ = staged_format;
+  return true;
+}
+
+void Texture::ReleaseStagingBuffer() {
+  if (!staging_buffer_) return;
+  staging_pool_->Release(staging_buffer_);
+  staging_buffer_ = nullptr;
+  data_ = nullptr;
 }
 
 void Texture::LoadFromMemory(const uint8_t *data, const vec2i &size,
@@ -106,12 +200,49 @@ void Texture::LoadFromMemory(const uint8_t *data, const vec2i &size,
   size_ = size;
   SetOriginalSizeIfNotYetSet(size_);
   texture_format_ = texture_format;
-  id_ = CreateTexture(data, size_, texture_format_, desired_, flags_, impl_);
+  uint8_t *resampled = ResampleIfNpotUnsupported(data);
+  id_ = CreateTexture(resampled ? resampled : data, size_, texture_format_,
+                      desired_, flags_, impl_);
+  free(resampled);
   is_external_ = false;
 }
 
+void Texture::DiscardData() {
+  if (staging_buffer_) {
+    ReleaseStagingBuffer();
+  } else {
+    free(const_cast<uint8_t *>(data_));
+    data_ = nullptr;
+  }
+  DeleteUploaded();
+}
+
+bool Texture::Upload() {
+  // Staged data is uploaded from its buffer by Finalize() instead.
+  if (!data_ || staging_buffer_) return false;
+  uploaded_id_ =
+      CreateTexture(data_, size_, texture_format_, desired_, flags_, impl_);
+  free(const_cast<uint8_t *>(data_));
+  data_ = nullptr;
+  return ValidTextureHandle(uploaded_id_);
+}
+
 bool Texture::Finalize() {
-  if (data_) {
+  if (ValidTextureHandle(uploaded_id_)) {
+    id_ = uploaded_id_;
+    uploaded_id_ = InvalidTextureHandle();
+    is_external_ = false;
+  } else if (staging_buffer_) {
+    // The buffer holds the data in the format to upload, and while it's
+    // bound, a null buffer is its start.
+    staging_pool_->BeginUpload(staging_buffer_);
+    id_ = CreateTexture(nullptr, size_, staged_format_, staged_format_, flags_,
+                        impl_);
+    staging_pool_->EndUpload(staging_buffer_);
+    staging_buffer_ = nullptr;
+    data_ = nullptr;
+    is_external_ = false;
+  } else if (data_) {
     id_ = CreateTexture(data_, size_, texture_format_, desired_, flags_, impl_);
     is_external_ = false;
     free(const_cast<uint8_t *>(data_));
@@ -131,21 +262,130 @@ void Texture::Set(size_t unit) const { const_cast<Texture *>(this)->Set(unit); }
 
 uint16_t *Texture::Convert8888To5551(const uint8_t *buffer, const vec2i &size) {
   auto buffer16 = new uint16_t[size.x * size.y];
+  Convert8888To5551(buffer, size, buffer16);
+  return buffer16;
+}
+
+void Texture::Convert8888To5551(const uint8_t *buffer, const vec2i &size,
+                                uint16_t *out) {
   for (int i = 0; i < size.x * size.y; i++) {
     auto c = &buffer[i * 4];
-    buffer16[i] = ((c[0] >> 3) << 11) | ((c[1] >> 3) << 6) |
-                  ((c[2] >> 3) << 1) | ((c[3] >> 7) << 0);
+    out[i] = ((c[0] >> 3) << 11) | ((c[1] >> 3) << 6) | ((c[2] >> 3) << 1) |
+             ((c[3] >> 7) << 0);
   }
-  return buffer16;
 }
 
 uint16_t *Texture::Convert888To565(const uint8_t *buffer, const vec2i &size) {
   auto buffer16 = new uint16_t[size.x * size.y];
+  Convert888To565(buffer, size, buffer16);
+  return buffer16;
+}
+
+void Texture::Convert888To565(const uint8_t *buffer, const vec2i &size,
+                              uint16_t *out) {
   for (int i = 0; i < size.x * size.y; i++) {
     auto c = &buffer[i * 3];
-    buffer16[i] = ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | ((c[2] >> 3) << 0);
+    out[i] = ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | ((c[2] >> 3) << 0);
   }
-  return buffer16;
+}
+
+// Ties round up, as documented on Texture::NearestPowerOfTwoSize().
+static int NearestPowerOfTwo(int n) {
+  int lower = 1;
+  while (lower <= n / 2) lower *= 2;
+  return n - lower < 2 * lower - n ? lower : 2 * lower;
+}
+
+static bool IsPowerOfTwo(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+vec2i Texture::NearestPowerOfTwoSize(const vec2i &size) {
+  return vec2i(NearestPowerOfTwo(size.x), NearestPowerOfTwo(size.y));
+}
+
+bool Texture::RequiresNpotSupport(const vec2i &size, TextureFlags flags) {
+  const vec2i face_size =
+      flags & kTextureFlagsIsCubeMap ? size / vec2i(1, 6) : size;
+  const bool pot = IsPowerOfTwo(face_size.x) && IsPowerOfTwo(face_size.y);
+  return !pot && ((flags & kTextureFlagsUseMipMaps) ||
+                  !(flags & kTextureFlagsClampToEdge));
+}
+
+uint8_t *Texture::ResampleToPowerOfTwo(const uint8_t *buffer,
+                                       const vec2i &size,
+                                       TextureFormat texture_format,
+                                       TextureFlags flags,
+                                       TextureResampleFilter filter,
+                                       vec2i *new_size) {
+  int channels;
+  int alpha_channel;
+  // clang-format off
+  switch (texture_format) {
+    case kFormat8888: channels = 4; alpha_channel = 3; break;
+    case kFormat888: channels = 3; alpha_channel = -1; break;
+    case kFormatLuminance: channels = 1; alpha_channel = -1; break;
+    case kFormatLuminanceAlpha: channels = 2; alpha_channel = 1; break;
+    default: return nullptr;
+  }
+  stbir_filter stbir_filter_type;
+  switch (filter) {
+    case kTextureResampleFilterBox: stbir_filter_type = STBIR_FILTER_BOX; break;
+    case kTextureResampleFilterTriangle:
+      stbir_filter_type = STBIR_FILTER_TRIANGLE; break;
+    case kTextureResampleFilterCatmullRom:
+      stbir_filter_type = STBIR_FILTER_CATMULLROM; break;
+    case kTextureResampleFilterMitchell:
+      stbir_filter_type = STBIR_FILTER_MITCHELL; break;
+    default: stbir_filter_type = STBIR_FILTER_DEFAULT; break;
+  }
+  // clang-format on
+
+  // Cubemaps are a column of six square faces, which must stay square and
+  // must not bleed into each other.
+  const bool cube_map = (flags & kTextureFlagsIsCubeMap) != 0;
+  const int num_faces = cube_map ? 6 : 1;
+  const vec2i face_size = size / vec2i(1, num_faces);
+  vec2i new_face_size = NearestPowerOfTwoSize(face_size);
+  if (cube_map) new_face_size.y = new_face_size.x;
+  *new_size = new_face_size * vec2i(1, num_faces);
+
+  const stbir_edge edge = cube_map || (flags & kTextureFlagsClampToEdge)
+                              ? STBIR_EDGE_CLAMP
+                              : STBIR_EDGE_WRAP;
+  const int stbir_flags = flags & kTextureFlagsPremultiplyAlpha
+                              ? STBIR_FLAG_ALPHA_PREMULTIPLIED
+                              : 0;
+  const size_t face_bytes = static_cast<size_t>(face_size.x) * face_size.y *
+                            channels;
+  const size_t new_face_bytes =
+      static_cast<size_t>(new_face_size.x) * new_face_size.y * channels;
+  uint8_t *resampled =
+      static_cast<uint8_t *>(malloc(new_face_bytes * num_faces));
+  for (int face = 0; face < num_faces; ++face) {
+    stbir_resize_uint8_generic(buffer + face * face_bytes, face_size.x,
+                               face_size.y, 0, resampled + face * new_face_bytes,
+                               new_face_size.x, new_face_size.y, 0, channels,
+                               alpha_channel, stbir_flags, edge,
+                               stbir_filter_type, STBIR_COLORSPACE_LINEAR,
+                               nullptr);
+  }
+  return resampled;
+}
+
+uint8_t *Texture::ResampleIfNpotUnsupported(const uint8_t *buffer) {
+  if (RendererBase::Get()->SupportsTextureNpot() ||
+      !RequiresNpotSupport(size_, flags_)) {
+    return nullptr;
+  }
+  vec2i new_size;
+  uint8_t *resampled = ResampleToPowerOfTwo(buffer, size_, texture_format_,
+                                            flags_, resample_filter_,
+                                            &new_size);
+  if (resampled) {
+    LogInfo(kApplication, "Resampled %s from (%d,%d) to (%d,%d)",
+            filename_.c_str(), size_.x, size_.y, new_size.x, new_size.y);
+    size_ = new_size;
+  }
+  return resampled;
 }
 
 void Texture::SetTextureId(TextureTarget target, TextureHandle id) {
@@ -171,7 +411,8 @@ uint8_t *Texture::UnpackTGA(const void *tga_buf, TextureFlags flags,
 
 uint8_t *Texture::UnpackWebP(const void *webp_buf, size_t size,
                              const vec2 &scale, TextureFlags flags,
-                             vec2i *dimensions, TextureFormat *texture_format) {
+                             vec2i *dimensions, TextureFormat *texture_format,
+                             const CancellationToken *cancel) {
   WebPDecoderConfig config;
   memset(&config, 0, sizeof(WebPDecoderConfig));
   auto status = WebPGetFeatures(static_cast<const uint8_t *>(webp_buf), size,
@@ -194,8 +435,24 @@ uint8_t *Texture::UnpackWebP(const void *webp_buf, size_t size,
       config.output.colorspace = MODE_RGBA;
     }
   }
-  status = WebPDecode(static_cast<const uint8_t *>(webp_buf), size, &config);
-  if (status != VP8_STATUS_OK) return nullptr;
+
+  // Decode incrementally, so that a cancelled load stops after the rows in
+  // the current chunk rather than after the whole image. The decoder reads
+  // the buffer in place, so feeding it in chunks copies nothing.
+  WebPIDecoder *idec = WebPIDecode(nullptr, 0, &config);
+  if (!idec) return nullptr;
+  const uint8_t *data = static_cast<const uint8_t *>(webp_buf);
+  status = VP8_STATUS_SUSPENDED;
+  for (size_t fed = 0; status == VP8_STATUS_SUSPENDED && fed < size;) {
+    if (IsCancelled(cancel)) break;
+    fed = std::min(size, fed + kWebPDecodeChunkSize);
+    status = WebPIUpdate(idec, data, fed);
+  }
+  WebPIDelete(idec);
+  if (status != VP8_STATUS_OK) {
+    WebPFreeDecBuffer(&config.output);
+    return nullptr;
+  }
 
   *dimensions = vec2i(config.output.width, config.output.height);
   *texture_format = config.input.has_alpha != 0 ? kFormat8888 : kFormat888;
@@ -292,8 +549,8 @@ uint8_t *Texture::UnpackKTX(const void *file_buf, size_t size,
 
 uint8_t *Texture::UnpackImage(const void *img_buf, size_t size,
                               const vec2 &scale, TextureFlags flags,
-                              vec2i *dimensions,
-                              TextureFormat *texture_format) {
+                              vec2i *dimensions, TextureFormat *texture_format,
+                              const CancellationToken *cancel) {
   uint8_t *image = nullptr;
   int width = 0;
   int height = 0;
@@ -303,6 +560,10 @@ uint8_t *Texture::UnpackImage(const void *img_buf, size_t size,
   image = stbi_load_from_memory(static_cast<stbi_uc const *>(img_buf),
                                 static_cast<int>(size), &width, &height,
                                 &channels, 0);
+  if (image && IsCancelled(cancel)) {
+    stbi_image_free(image);
+    return nullptr;
+  }
 
   if (image && (scale.x != 1.0f || scale.y != 1.0f)) {
     // Scale the image.
@@ -310,9 +571,29 @@ uint8_t *Texture::UnpackImage(const void *img_buf, size_t size,
     int32_t new_height = static_cast<int32_t>(height * scale.y);
     uint8_t *new_image =
         static_cast<uint8_t *>(malloc(new_width * new_height * channels));
-    stbir_resize_uint8(image, width, height, 0, new_image, new_width,
-                       new_height, 0, channels);
+    // Resize in stripes of output rows, so a cancelled load stops early.
+    // Each stripe is a region of the whole source, so stripes sample across
+    // their edges just as a single resize would.
+    const int row_bytes = new_width * channels;
+    for (int row = 0; row < new_height && new_image;
+         row += kResizeStripeHeight) {
+      if (IsCancelled(cancel)) {
+        free(new_image);
+        new_image = nullptr;
+        break;
+      }
+      const int rows = std::min(kResizeStripeHeight, new_height - row);
+      const float t0 = static_cast<float>(row) / new_height;
+      const float t1 = static_cast<float>(row + rows) / new_height;
+      stbir_resize_region(image, width, height, 0, new_image + row * row_bytes,
+                          new_width, rows, row_bytes, STBIR_TYPE_UINT8,
+                          channels, STBIR_ALPHA_CHANNEL_NONE, 0,
+                          STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP,
+                          STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT,
+                          STBIR_COLORSPACE_LINEAR, nullptr, 0.0f, t0, 1.0f, t1);
+    }
     stbi_image_free(image);
+    if (!new_image) return nullptr;
     image = new_image;
     width = new_width;
     height = new_height;
@@ -337,7 +618,8 @@ uint8_t *Texture::UnpackImage(const void *img_buf, size_t size,
 
 uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
                                        TextureFlags flags, vec2i *dimensions,
-                                       TextureFormat *texture_format) {
+                                       TextureFormat *texture_format,
+                                       const CancellationToken *cancel) {
   std::string ext;
   std::string basename = filename;
   size_t ext_pos = basename.find_last_of(".");
@@ -394,16 +676,21 @@ uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
     LogError(kApplication, "Couldn\'t load: %s", filename);
     return nullptr;
   }
+  if (IsCancelled(cancel)) return nullptr;
 
   if (ext == "tga" || ext == "png" || ext == "jpg") {
     auto buf = UnpackImage(file.c_str(), file.length(), scale, flags,
-                           dimensions, texture_format);
-    if (!buf) LogError(kApplication, "Image format problem: %s", filename);
+                           dimensions, texture_format, cancel);
+    if (!buf && !IsCancelled(cancel)) {
+      LogError(kApplication, "Image format problem: %s", filename);
+    }
     return buf;
   } else if (ext == "webp" || HasWebpHeader(file)) {
     auto buf = UnpackWebP(file.c_str(), file.length(), scale, flags, dimensions,
-                          texture_format);
-    if (!buf) LogError(kApplication, "WebP format problem: %s", filename);
+                          texture_format, cancel);
+    if (!buf && !IsCancelled(cancel)) {
+      LogError(kApplication, "WebP format problem: %s", filename);
+    }
     return buf;
   } else {
     LogError(kApplication, "Can\'t figure out file type from extension: %s",
@@ -412,6 +699,12 @@ uint8_t *Texture::LoadAndUnpackTexture(const char *filename, const vec2 &scale,
   }
 }
 
+ObjectPool<TextureAtlas> &TextureAtlas::pool() {
+  // Leaked, so that it outlives atlases destroyed during static destruction.
+  static ObjectPool<TextureAtlas> *pool = new ObjectPool<TextureAtlas>();
+  return *pool;
+}
+
 TextureAtlas *TextureAtlas::LoadTextureAtlas(const char *filename,
                                              TextureFormat format,
                                              TextureFlags flags,
@@ -48,6 +48,15 @@ void Texture::Delete() {
     }
     id_ = InvalidTextureHandle();
   }
+  DeleteUploaded();
+}
+
+void Texture::DeleteUploaded() {
+  if (ValidTextureHandle(uploaded_id_)) {
+    auto id = GlTextureHandle(uploaded_id_);
+    GL_CALL(glDeleteTextures(1, &id));
+    uploaded_id_ = InvalidTextureHandle();
+  }
 }
 
 // Returns the block size for compressed texture formats, else 1x1.
@@ -104,6 +113,21 @@ static vec2i GetBlockSize(int internal_format) {
   }
 }
 
+// Whether a texture created from `buffer` has pixels. With a pixel unpack
+// buffer bound, as when uploading from a TextureStagingPool, a null `buffer`
+// is the start of it.
+static bool HasPixelData(const uint8_t *buffer) {
+  if (buffer) return true;
+#ifdef GL_PIXEL_UNPACK_BUFFER_BINDING
+  if (RendererBase::Get()->feature_level() >= kFeatureLevel30) {
+    GLint unpack_buffer = 0;
+    GL_CALL(glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack_buffer));
+    return unpack_buffer != 0;
+  }
+#endif  // GL_PIXEL_UNPACK_BUFFER_BINDING
+  return false;
+}
+
 // static
 TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
                                      TextureFormat texture_format,
@@ -126,19 +150,16 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
     }
   }
 
-  if (!RendererBase::Get()->SupportsTextureNpot()) {
-    // Npot textures are supported in ES 2.0 if you use GL_CLAMP_TO_EDGE and no
-    // mipmaps. See Section 3.8.2 of ES2.0 spec:
-    // https://www.khronos.org/registry/gles/specs/2.0/es_full_spec_2.0.25.pdf
-    if (flags & kTextureFlagsUseMipMaps ||
-        !(flags & kTextureFlagsClampToEdge)) {
-      int area = tex_size.x * tex_size.y;
-      if (area & (area - 1)) {
-        LogError(kError, "CreateTexture: not power of two in size: (%d,%d)",
-                 tex_size.x, tex_size.y);
-        return InvalidTextureHandle();
-      }
-    }
+  // Npot textures are supported in ES 2.0 if you use GL_CLAMP_TO_EDGE and no
+  // mipmaps. See Section 3.8.2 of ES2.0 spec:
+  // https://www.khronos.org/registry/gles/specs/2.0/es_full_spec_2.0.25.pdf
+  // Uncompressed textures are resampled when loaded, so only compressed ones
+  // should get here.
+  if (!RendererBase::Get()->SupportsTextureNpot() &&
+      RequiresNpotSupport(size, flags)) {
+    LogError(kError, "CreateTexture: not power of two in size: (%d,%d)",
+             tex_size.x, tex_size.y);
+    return InvalidTextureHandle();
   }
 
   bool generate_mips = (flags & kTextureFlagsUseMipMaps) != 0;
@@ -223,6 +244,7 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
           break;
         case kFormat5551:
           // Nothing coversion.
+          type = GL_UNSIGNED_SHORT_5_5_5_1;
           gl_tex_image(buffer, tex_size, 0, num_pixels * 2, false);
           break;
         default:
@@ -400,7 +422,7 @@ TextureHandle Texture::CreateTexture(const uint8_t *buffer, const vec2i &size,
       assert(false);
   }
 
-  if (generate_mips && buffer != nullptr) {
+  if (generate_mips && HasPixelData(buffer)) {
     // Work around for some Android devices to correctly generate miplevels.
     // NOTE:  If client creates a texture with buffer == nullptr (i.e. to
     // render into later), and wants mipmapping, and is on a phone requiring
@@ -0,0 +1,224 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "precompiled.h"
+#include "fplbase/renderer.h"
+#include "fplbase/texture_staging.h"
+#include "fplbase/utilities.h"
+
+// OS X only has a GL 2.1 compatibility profile, without glMapBufferRange().
+#if defined(GL_PIXEL_UNPACK_BUFFER) && defined(GL_MAP_WRITE_BIT) && \
+    defined(GL_SYNC_GPU_COMMANDS_COMPLETE) && !defined(PLATFORM_OSX)
+#define FPLBASE_TEXTURE_STAGING
+#endif
+
+// Whether buffers can be mapped persistently, given GL support at runtime.
+#if defined(FPLBASE_TEXTURE_STAGING) && defined(GL_MAP_PERSISTENT_BIT) && \
+    !defined(FPLBASE_GLES)
+#define FPLBASE_TEXTURE_STAGING_PERSISTENT
+#endif
+
+// Whether the GL functions used are looked up at runtime, in which case they
+// may be missing.
+#if !defined(__APPLE__) && !defined(__ANDROID__) && \
+    !defined(GL_GLEXT_PROTOTYPES)
+#define FPLBASE_TEXTURE_STAGING_OPTIONAL
+#endif
+
+namespace fplbase {
+
+#ifdef FPLBASE_TEXTURE_STAGING_PERSISTENT
+// Whether the context has glBufferStorage(), from GL 4.4 or
+// ARB_buffer_storage.
+static bool SupportsBufferStorage() {
+#ifdef FPLBASE_TEXTURE_STAGING_OPTIONAL
+  if (!glBufferStorage) return false;
+#endif
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (major > 4 || (major == 4 && minor >= 4)) return true;
+  GLint num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+  for (GLint i = 0; i < num_extensions; ++i) {
+    auto ext = glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i));
+    if (ext && strcmp(reinterpret_cast<const char *>(ext),
+                      "GL_ARB_buffer_storage") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+#endif  // FPLBASE_TEXTURE_STAGING_PERSISTENT
+
+TextureStagingPool::TextureStagingPool()
+    : buffer_size_(0), persistent_(false), use_16bpp_(false) {}
+
+TextureStagingPool::~TextureStagingPool() {
+#ifdef FPLBASE_TEXTURE_STAGING
+  for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+    if (it->fence) glDeleteSync(static_cast<GLsync>(it->fence));
+    if (it->data) {
+      GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, it->id));
+      GL_CALL(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+    }
+    GLuint id = it->id;
+    GL_CALL(glDeleteBuffers(1, &id));
+  }
+  GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+#endif  // FPLBASE_TEXTURE_STAGING
+}
+
+bool TextureStagingPool::Initialize(size_t buffer_size, int num_buffers) {
+  assert(slots_.empty());
+#ifdef FPLBASE_TEXTURE_STAGING
+  if (RendererBase::Get()->feature_level() < kFeatureLevel30) return false;
+#ifdef FPLBASE_TEXTURE_STAGING_OPTIONAL
+  if (!glMapBufferRange || !glFenceSync || !glClientWaitSync ||
+      !glDeleteSync) {
+    return false;
+  }
+#endif
+  buffer_size_ = buffer_size;
+  use_16bpp_ = MipmapGeneration16bppSupported();
+#ifdef FPLBASE_TEXTURE_STAGING_PERSISTENT
+  persistent_ = SupportsBufferStorage();
+#endif
+  slots_.resize(num_buffers);
+  for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+    it->data = nullptr;
+    it->size = buffer_size;
+    it->fence = nullptr;
+    it->in_use = false;
+    it->uploaded = false;
+    GLuint id = 0;
+    GL_CALL(glGenBuffers(1, &id));
+    it->id = id;
+    GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, id));
+#ifdef FPLBASE_TEXTURE_STAGING_PERSISTENT
+    if (persistent_) {
+      GL_CALL(glBufferStorage(GL_PIXEL_UNPACK_BUFFER, buffer_size, nullptr,
+                              GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                                  GL_MAP_COHERENT_BIT));
+    }
+#endif  // FPLBASE_TEXTURE_STAGING_PERSISTENT
+    if (!persistent_) {
+      GL_CALL(glBufferData(GL_PIXEL_UNPACK_BUFFER, buffer_size, nullptr,
+                           GL_STREAM_DRAW));
+    }
+    if (!Map(&*it)) {
+      LogError(kError, "TextureStagingPool: can't map a %d byte buffer.",
+               static_cast<int>(buffer_size));
+      GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+      return false;
+    }
+  }
+  GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+  return true;
+#else
+  (void)buffer_size;
+  (void)num_buffers;
+  return false;
+#endif  // FPLBASE_TEXTURE_STAGING
+}
+
+// Map `slot`, which must be bound as the pixel unpack buffer.
+bool TextureStagingPool::Map(Slot *slot) {
+#ifdef FPLBASE_TEXTURE_STAGING
+  GLbitfield access = GL_MAP_WRITE_BIT;
+#ifdef FPLBASE_TEXTURE_STAGING_PERSISTENT
+  if (persistent_) access |= GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+#endif
+  // The previous contents have been uploaded, so needn't be kept.
+  if (!persistent_) access |= GL_MAP_INVALIDATE_BUFFER_BIT;
+  slot->data = static_cast<uint8_t *>(
+      glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slot->size, access));
+  return slot->data != nullptr;
+#else
+  (void)slot;
+  return false;
+#endif  // FPLBASE_TEXTURE_STAGING
+}
+
+TextureStagingBuffer *TextureStagingPool::Acquire(size_t size) {
+  if (size > buffer_size_) return nullptr;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+    if (!it->in_use) {
+      it->in_use = true;
+      return &*it;
+    }
+  }
+  return nullptr;
+}
+
+void TextureStagingPool::Release(TextureStagingBuffer *buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  SlotOf(buffer)->in_use = false;
+}
+
+void TextureStagingPool::BeginUpload(TextureStagingBuffer *buffer) {
+#ifdef FPLBASE_TEXTURE_STAGING
+  Slot *slot = SlotOf(buffer);
+  GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->id));
+  if (!persistent_) {
+    GL_CALL(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+    slot->data = nullptr;
+  }
+#else
+  (void)buffer;
+#endif  // FPLBASE_TEXTURE_STAGING
+}
+
+void TextureStagingPool::EndUpload(TextureStagingBuffer *buffer) {
+#ifdef FPLBASE_TEXTURE_STAGING
+  GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+  Slot *slot = SlotOf(buffer);
+  slot->uploaded = true;
+  slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // Without a fence, wait for the upload here rather than risk overwriting
+  // the buffer while it's read.
+  if (!slot->fence) GL_CALL(glFinish());
+#else
+  (void)buffer;
+#endif  // FPLBASE_TEXTURE_STAGING
+}
+
+void TextureStagingPool::Update() {
+#ifdef FPLBASE_TEXTURE_STAGING
+  bool bound = false;
+  for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+    if (!it->uploaded) continue;
+    if (it->fence) {
+      // Poll, rather than wait, so as not to stall the frame.
+      GLsync fence = static_cast<GLsync>(it->fence);
+      if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) continue;
+      glDeleteSync(fence);
+      it->fence = nullptr;
+    }
+    if (!persistent_) {
+      GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, it->id));
+      bound = true;
+      // If mapping fails, try again next frame.
+      if (!Map(&*it)) continue;
+    }
+    it->uploaded = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    it->in_use = false;
+  }
+  if (bound) GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+#endif  // FPLBASE_TEXTURE_STAGING
+}
+
+}  // namespace fplbase
@@ -0,0 +1,189 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Times vertex deduplication of triangulated grids, as FlatMesh does it, with
+// - the unordered_set it used before, hashing with FNV-1a up to the first
+//   zero byte,
+// - the same unordered_set, hashing every byte with HashBytes64,
+// - and VertexDedupTable.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <unordered_set>
+#include <vector>
+
+#include "vertex_dedup.h"
+
+namespace {
+
+// The layout of FlatMesh::Vertex: position, normal, tangent, orientation,
+// uv, uv_alt, color and skin binding, without padding.
+struct Vertex {
+  float position[3];
+  float normal[3];
+  float tangent[4];
+  float orientation[4];
+  float uv[2];
+  float uv_alt[2];
+  uint8_t color[4];
+  uint16_t bone_indices[4];
+  uint8_t bone_weights[4];
+};
+
+struct VertexRef {
+  const Vertex* ref;
+  uint32_t index;
+};
+
+// The hash FlatMesh used: flatbuffers::HashFnv1a() of a C string.
+struct CStringHash {
+  size_t operator()(const VertexRef& v) const {
+    const char* s = reinterpret_cast<const char*>(v.ref);
+    uint64_t hash = 0xcbf29ce484222645ULL;
+    for (; *s; ++s) {
+      hash ^= static_cast<uint8_t>(*s);
+      hash *= 0x100000001b3ULL;
+    }
+    return static_cast<size_t>(hash);
+  }
+};
+
+struct FullHash {
+  size_t operator()(const VertexRef& v) const {
+    return static_cast<size_t>(fplbase::HashPod(*v.ref));
+  }
+};
+
+struct VerticesEqual {
+  bool operator()(const VertexRef& a, const VertexRef& b) const {
+    return memcmp(a.ref, b.ref, sizeof(*a.ref)) == 0;
+  }
+};
+
+// The vertices of a `size` x `size` grid of quads, in the order the
+// triangles reference them, so that each interior vertex appears six times.
+std::vector<Vertex> GridTriangles(int size) {
+  std::vector<Vertex> grid((size + 1) * (size + 1));
+  for (int y = 0; y <= size; ++y) {
+    for (int x = 0; x <= size; ++x) {
+      Vertex& v = grid[y * (size + 1) + x];
+      memset(&v, 0, sizeof(v));
+      v.position[0] = static_cast<float>(x);
+      v.position[1] = static_cast<float>(y);
+      v.normal[2] = 1.0f;
+      v.tangent[0] = v.tangent[3] = 1.0f;
+      v.orientation[3] = 1.0f;
+      v.uv[0] = static_cast<float>(x) / size;
+      v.uv[1] = static_cast<float>(y) / size;
+      v.color[0] = v.color[1] = v.color[2] = v.color[3] = 255;
+      v.bone_weights[0] = 255;
+    }
+  }
+  static const int kCorners[6][2] = {{0, 0}, {1, 0}, {1, 1},
+                                     {0, 0}, {1, 1}, {0, 1}};
+  std::vector<Vertex> triangles;
+  triangles.reserve(size * size * 6);
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      for (int i = 0; i < 6; ++i) {
+        triangles.push_back(
+            grid[(y + kCorners[i][1]) * (size + 1) + x + kCorners[i][0]]);
+      }
+    }
+  }
+  return triangles;
+}
+
+typedef std::chrono::steady_clock Clock;
+
+double MillisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Dedup `input` as FlatMesh::AppendPolyVert() does, appending each vertex and
+// removing it again if an equal one is already in the set.
+template <class Hash>
+double DedupWithSet(const std::vector<Vertex>& input, size_t* unique) {
+  const auto start = Clock::now();
+  std::vector<Vertex> points;
+  // The set holds pointers into `points`, so it can't reallocate.
+  points.reserve(input.size());
+  std::unordered_set<VertexRef, Hash, VerticesEqual> set;
+  std::vector<uint32_t> indices;
+  indices.reserve(input.size());
+  for (size_t i = 0; i < input.size(); ++i) {
+    points.push_back(input[i]);
+    VertexRef ref = {&points.back(), static_cast<uint32_t>(points.size() - 1)};
+    auto insertion = set.insert(ref);
+    if (!insertion.second) points.pop_back();
+    indices.push_back(insertion.first->index);
+  }
+  *unique = points.size();
+  return MillisecondsSince(start);
+}
+
+double DedupWithTable(const std::vector<Vertex>& input, size_t* unique) {
+  const auto start = Clock::now();
+  std::vector<Vertex> points;
+  fplbase::VertexDedupTable table;
+  std::vector<uint32_t> indices;
+  indices.reserve(input.size());
+  for (size_t i = 0; i < input.size(); ++i) {
+    points.push_back(input[i]);
+    const uint32_t new_index = static_cast<uint32_t>(points.size() - 1);
+    const uint32_t index = table.FindOrInsert(points.data(), new_index);
+    if (index != new_index) points.pop_back();
+    indices.push_back(index);
+  }
+  *unique = points.size();
+  return MillisecondsSince(start);
+}
+
+}  // namespace
+
+extern "C" int FPL_main(int /*argc*/, char* /*argv*/[]) {
+  // The C string hash makes dedup quadratic, so it's skipped on large grids.
+  static const int kMaxCStringHashSize = 128;
+  // A grid of size n has 2n^2 triangles; the largest is about 2M triangles,
+  // the scale of a dense scanned mesh, and needs about 600MB of memory.
+  static const int kSizes[] = {32, 128, 512, 1024};
+  printf("%10s %10s %14s %14s %14s\n", "vertices", "unique", "fnv1a cstr ms",
+         "xxhash set ms", "table ms");
+  for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i) {
+    const std::vector<Vertex> input = GridTriangles(kSizes[i]);
+    size_t unique = 0;
+    double cstring_ms = -1.0;
+    if (kSizes[i] <= kMaxCStringHashSize) {
+      cstring_ms = DedupWithSet<CStringHash>(input, &unique);
+    }
+    const double set_ms = DedupWithSet<FullHash>(input, &unique);
+    size_t table_unique = 0;
+    const double table_ms = DedupWithTable(input, &table_unique);
+    if (table_unique != unique) {
+      printf("Mismatch: %d unique vertices in the set, %d in the table.\n",
+             static_cast<int>(unique), static_cast<int>(table_unique));
+      return 1;
+    }
+    char cstring_column[32] = "skipped";
+    if (cstring_ms >= 0.0) {
+      snprintf(cstring_column, sizeof(cstring_column), "%.2f", cstring_ms);
+    }
+    printf("%10d %10d %14s %14.2f %14.2f\n", static_cast<int>(input.size()),
+           static_cast<int>(unique), cstring_column, set_ms, table_ms);
+  }
+  return 0;
+}
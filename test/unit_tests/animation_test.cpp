@@ -0,0 +1,150 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fplbase/animation.h"
+#include "anim_generated.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+const float kEpsilon = 0.001f;
+
+// Ways for BuildClip() to break the clip.
+enum Corruption {
+  kNoCorruption,
+  kTooFewValues,    // The root has fewer values than its keys need.
+  kChildIsParent,   // The child bone is its own parent.
+  kUnsortedFrames,  // The root's keys are in descending order.
+};
+
+// Build a clip of two bones over one second at 10 frames per second. The root
+// moves from x = 0 to x = 10. Its child sits at y = 1 and never moves.
+void BuildClip(std::string *buffer, Corruption corruption = kNoCorruption) {
+  flatbuffers::FlatBufferBuilder fbb;
+
+  const uint16_t sorted_frames[] = {0, 10};
+  const uint16_t unsorted_frames[] = {10, 0};
+  const uint16_t root_values[] = {0, 0, 0, 0xFFFF, 0, 0};
+  const Vec4 root_min(0.0f, 0.0f, 0.0f, 0.0f);
+  const Vec4 root_scale(10.0f / 0xFFFF, 0.0f, 0.0f, 0.0f);
+  const auto root_translation = animdef::CreateChannel(
+      fbb,
+      fbb.CreateVector(
+          corruption == kUnsortedFrames ? unsorted_frames : sorted_frames, 2),
+      fbb.CreateVector(root_values, corruption == kTooFewValues ? 5 : 6),
+      &root_min, &root_scale);
+
+  const uint16_t child_frames[] = {0};
+  const uint16_t child_values[] = {0, 0, 0};
+  const Vec4 child_min(0.0f, 1.0f, 0.0f, 0.0f);
+  const Vec4 child_scale(0.0f, 0.0f, 0.0f, 0.0f);
+  const auto child_translation = animdef::CreateChannel(
+      fbb, fbb.CreateVector(child_frames, 1),
+      fbb.CreateVector(child_values, 3), &child_min, &child_scale);
+
+  const flatbuffers::Offset<animdef::BoneAnim> bones[] = {
+      animdef::CreateBoneAnim(fbb, root_translation),
+      animdef::CreateBoneAnim(fbb, child_translation)};
+  const uint8_t child_parent = corruption == kChildIsParent ? 1 : 0;
+  const uint8_t parents[] = {0xFF, child_parent};
+  animdef::FinishAnimClipBuffer(
+      fbb, animdef::CreateAnimClip(
+               fbb, fbb.CreateString("move"), 10.0f, 11, 0,
+               fbb.CreateVector(parents, 2), fbb.CreateVector(bones, 2),
+               animdef::AnimVersion_MostRecent));
+  buffer->assign(reinterpret_cast<const char *>(fbb.GetBufferPointer()),
+                 fbb.GetSize());
+}
+
+mathfu::vec3 Translation(const mathfu::AffineTransform &transform) {
+  return mathfu::mat4::FromAffineTransform(transform).TranslationVector3D();
+}
+
+}  // namespace
+
+class AnimationTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    std::string buffer;
+    BuildClip(&buffer);
+    ASSERT_TRUE(clip_.LoadFromMemory(buffer.data(), buffer.size()));
+  }
+  virtual void TearDown() {}
+
+  AnimClip clip_;
+};
+
+TEST_F(AnimationTests, LoadRejectsInvalidBuffers) {
+  AnimClip clip;
+  const char garbage[] = "not an animation clip";
+  EXPECT_FALSE(clip.LoadFromMemory(garbage, sizeof(garbage)));
+  EXPECT_FALSE(clip.IsValid());
+
+  EXPECT_TRUE(clip_.IsValid());
+  EXPECT_EQ(clip_.num_bones(), 2U);
+  EXPECT_NEAR(clip_.duration(), 1.0f, kEpsilon);
+}
+
+TEST_F(AnimationTests, LoadRejectsMalformedClips) {
+  const Corruption corruptions[] = {kTooFewValues, kChildIsParent,
+                                    kUnsortedFrames};
+  for (size_t i = 0; i < sizeof(corruptions) / sizeof(corruptions[0]); ++i) {
+    std::string buffer;
+    BuildClip(&buffer, corruptions[i]);
+    AnimClip clip;
+    EXPECT_FALSE(clip.LoadFromMemory(buffer.data(), buffer.size()))
+        << "corruption " << corruptions[i];
+    EXPECT_FALSE(clip.IsValid());
+  }
+}
+
+TEST_F(AnimationTests, SampleInterpolatesAndWraps) {
+  AnimPose pose;
+  pose.Sample(clip_, 0.5f, false);
+  EXPECT_NEAR(pose.translations()[0].data[0], 5.0f, kEpsilon);
+  EXPECT_NEAR(pose.translations()[1].data[1], 1.0f, kEpsilon);
+  EXPECT_NEAR(pose.rotations()[0].data[3], 1.0f, kEpsilon);
+  EXPECT_NEAR(pose.scales()[0].data[0], 1.0f, kEpsilon);
+
+  pose.Sample(clip_, 1.25f, true);
+  EXPECT_NEAR(pose.translations()[0].data[0], 2.5f, kEpsilon);
+
+  pose.Sample(clip_, 2.0f, false);
+  EXPECT_NEAR(pose.translations()[0].data[0], 10.0f, kEpsilon);
+}
+
+TEST_F(AnimationTests, BlendAndConcatenate) {
+  AnimPose pose;
+  AnimPose other;
+  pose.Sample(clip_, 0.0f, false);
+  other.Sample(clip_, 1.0f, false);
+  pose.Blend(other, 0.25f);
+  EXPECT_NEAR(pose.translations()[0].data[0], 2.5f, kEpsilon);
+
+  mathfu::AffineTransform transforms[2];
+  pose.GlobalTransforms(clip_.bone_parents(), transforms);
+  const mathfu::vec3 root = Translation(transforms[0]);
+  const mathfu::vec3 child = Translation(transforms[1]);
+  EXPECT_NEAR(root.x, 2.5f, kEpsilon);
+  EXPECT_NEAR(child.x, 2.5f, kEpsilon);
+  EXPECT_NEAR(child.y, 1.0f, kEpsilon);
+}
+
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,93 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdio.h>
+#include <string>
+
+#include "fplbase/asset_manager.h"
+#include "fplbase/renderer.h"
+#include "fplbase/utilities.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+const char kFileA[] = "asset_handle_test_a.txt";
+const char kFileB[] = "asset_handle_test_b.txt";
+
+}  // namespace
+
+// File assets don't need a GL context, so the renderer is never initialized.
+class AssetHandleTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    SaveFile(kFileA, std::string("a"));
+    SaveFile(kFileB, std::string("b"));
+  }
+  virtual void TearDown() {
+    remove(kFileA);
+    remove(kFileB);
+  }
+
+  Renderer renderer_;
+};
+
+TEST_F(AssetHandleTests, HandlesResolveToLoadedAssets) {
+  AssetManager asset_manager(renderer_);
+  FileAsset *file = asset_manager.LoadFileAsset(kFileA);
+  ASSERT_NE(nullptr, file);
+  const FileAssetHandle handle = asset_manager.GetHandle(file);
+  EXPECT_FALSE(handle.is_null());
+  EXPECT_EQ(file, asset_manager.Get(handle));
+  EXPECT_EQ(nullptr, asset_manager.Get(FileAssetHandle()));
+  EXPECT_TRUE(
+      asset_manager.GetHandle(static_cast<FileAsset *>(nullptr)).is_null());
+}
+
+TEST_F(AssetHandleTests, HandlesOfUnloadedAssetsDontResolve) {
+  AssetManager asset_manager(renderer_);
+  FileAsset *a = asset_manager.LoadFileAsset(kFileA);
+  ASSERT_NE(nullptr, a);
+  const FileAssetHandle handle_a = asset_manager.GetHandle(a);
+  asset_manager.UnloadFileAsset(kFileA);
+  EXPECT_EQ(nullptr, asset_manager.Get(handle_a));
+
+  // The next file asset reuses the slot `a` was in.
+  FileAsset *b = asset_manager.LoadFileAsset(kFileB);
+  ASSERT_NE(nullptr, b);
+  const FileAssetHandle handle_b = asset_manager.GetHandle(b);
+  EXPECT_EQ(handle_a.pool_handle().index(), handle_b.pool_handle().index());
+  EXPECT_NE(handle_a, handle_b);
+  EXPECT_EQ(nullptr, asset_manager.Get(handle_a));
+  EXPECT_EQ(b, asset_manager.Get(handle_b));
+}
+
+TEST_F(AssetHandleTests, HandlesOnlyResolveInTheirAssetManager) {
+  AssetManager first(renderer_);
+  AssetManager second(renderer_);
+  FileAsset *file = first.LoadFileAsset(kFileA);
+  ASSERT_NE(nullptr, file);
+  const FileAssetHandle handle = first.GetHandle(file);
+  EXPECT_EQ(file, first.Get(handle));
+  EXPECT_EQ(nullptr, second.Get(handle));
+  EXPECT_TRUE(second.GetHandle(file).is_null());
+}
+
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
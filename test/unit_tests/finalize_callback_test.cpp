@@ -0,0 +1,164 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <vector>
+
+#include "fplbase/async_loader.h"
+#include "fplbase/finalize_callback.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+// An asset that finalizes without loading anything.
+class TestAsset : public AsyncAsset {
+ public:
+  explicit TestAsset(size_t size = 0) : AsyncAsset("test") {
+    data_size_ = size;
+  }
+  virtual void Load() {}
+  virtual bool Finalize() {
+    CallFinalizeCallback();
+    return true;
+  }
+  virtual bool IsValid() { return true; }
+};
+
+}  // namespace
+
+TEST(FinalizeCallbackTest, SmallAndLargeFunctors) {
+  int calls = 0;
+  FinalizeCallback small([&calls]() { calls++; });
+  char padding[FinalizeCallback::kInlineSize * 2] = {1};
+  FinalizeCallback large([&calls, padding]() { calls += padding[0]; });
+  EXPECT_TRUE(static_cast<bool>(small));
+  small();
+  large();
+  EXPECT_EQ(2, calls);
+
+  FinalizeCallback moved(std::move(large));
+  EXPECT_FALSE(static_cast<bool>(large));
+  moved();
+  EXPECT_EQ(3, calls);
+}
+
+TEST(FinalizeCallbackTest, DestroysCapturesOnce) {
+  std::shared_ptr<int> shared(new int(0));
+  {
+    FinalizeCallback callback([shared]() {});
+    FinalizeCallback moved(std::move(callback));
+    EXPECT_EQ(2, shared.use_count());
+  }
+  EXPECT_EQ(1, shared.use_count());
+}
+
+TEST(FinalizeCallbackTest, ListCallsInOrder) {
+  std::vector<int> order;
+  FinalizeCallbackList list;
+  for (int i = 0; i < 1000; ++i) {
+    list.Add([&order, i]() { order.push_back(i); });
+  }
+  // Callbacks added while calling are called too.
+  list.Add([&order, &list]() {
+    list.Add([&order]() { order.push_back(-1); });
+  });
+  list.CallAll();
+  EXPECT_TRUE(list.empty());
+  ASSERT_EQ(1001u, order.size());
+  for (int i = 0; i < 1000; ++i) EXPECT_EQ(i, order[i]);
+  EXPECT_EQ(-1, order.back());
+}
+
+TEST(FinalizeCallbackTest, AssetCallbacks) {
+  TestAsset asset;
+  int calls = 0;
+  EXPECT_TRUE(asset.AddFinalizeCallback([&calls]() { calls++; }));
+  asset.Finalize();
+  EXPECT_EQ(1, calls);
+  EXPECT_FALSE(asset.AddFinalizeCallback([&calls]() { calls++; }));
+  EXPECT_EQ(1, calls);
+}
+
+TEST(FinalizeCallbackTest, GroupCompletesOnce) {
+  TestAsset assets[3];
+  assets[0].Finalize();
+  int completions = 0;
+  FinalizeGroup group;
+  for (int i = 0; i < 3; ++i) group.Add(&assets[i]);
+  group.OnComplete([&completions]() { completions++; });
+  EXPECT_EQ(3, group.size());
+  EXPECT_EQ(1, group.num_finalized());
+
+  assets[1].Finalize();
+  EXPECT_FALSE(group.IsComplete());
+  EXPECT_EQ(0, completions);
+  assets[2].Finalize();
+  EXPECT_TRUE(group.IsComplete());
+  EXPECT_EQ(1, completions);
+}
+
+TEST(FinalizeCallbackTest, GroupCountsDestroyedAssets) {
+  int completions = 0;
+  FinalizeGroup group;
+  {
+    TestAsset asset;
+    group.Add(&asset);
+    group.OnComplete([&completions]() { completions++; });
+  }
+  EXPECT_TRUE(group.IsComplete());
+  EXPECT_EQ(1, completions);
+}
+
+TEST(FinalizeCallbackTest, AssetOutlivesGroup) {
+  TestAsset asset;
+  int completions = 0;
+  {
+    FinalizeGroup group;
+    group.Add(&asset);
+    group.OnComplete([&completions]() { completions++; });
+  }
+  asset.Finalize();
+  EXPECT_EQ(0, completions);
+}
+
+TEST(FinalizeCallbackTest, GroupProgressAndFuture) {
+  TestAsset small(100), large(1000);
+  FinalizeGroup::Future future;
+  {
+    FinalizeGroup group;
+    group.Add(&small);
+    group.Add(&large);
+    future = group.GetFuture();
+    small.Finalize();
+    const LoadProgress progress = future.progress();
+    EXPECT_EQ(2, progress.num_assets);
+    EXPECT_EQ(1, progress.num_finalized);
+    EXPECT_EQ(100u, progress.bytes_loaded);
+    EXPECT_FLOAT_EQ(0.5f, progress.fraction());
+  }
+  // The future outlives the group.
+  EXPECT_FALSE(future.IsReady());
+  large.Finalize();
+  EXPECT_TRUE(future.IsReady());
+  EXPECT_EQ(1100u, future.progress().bytes_loaded);
+  EXPECT_EQ(0, future.progress().num_failed);
+}
+
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,79 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "flat_mesh.h"
+#include "gtest/gtest.h"
+#include "pipeline_utils.h"
+
+namespace fplbase {
+namespace {
+
+const VertexAttributeBitmask kAttributes =
+    kVertexAttributeBit_Position | kVertexAttributeBit_Normal |
+    kVertexAttributeBit_Tangent | kVertexAttributeBit_Uv;
+
+void AppendCorner(FlatMesh* mesh, float x, float y, float u, float v) {
+  mesh->AppendPolyVert(mathfu::vec3(x, y, 0.0f), mathfu::vec3(0.0f, 0.0f, 1.0f),
+                       mathfu::kZeros4f, mathfu::kOnes4f, mathfu::vec2(u, v),
+                       mathfu::kZeros2f, SkinBinding());
+}
+
+}  // namespace
+
+// Two triangles share the edge x = 0, with U mirrored across it. The right
+// triangle's copy of the origin is off by less than the position grid, so
+// quantization merges it, and tangent generation then splits both vertices
+// of the shared edge. The split copies mustn't offset the merged count.
+TEST(FlatMeshTests, QuantizationMergedCountExcludesSeamCopies) {
+  Logger log;
+  FlatMesh mesh(8, kAttributes, log);
+  VertexQuantization quantization;
+  quantization.position_grid = 0.01f;
+  mesh.set_quantization(quantization);
+  mesh.SetSurface(FlatTextures());
+  mesh.ReportSurfaceVertexAttributes(kAttributes);
+
+  AppendCorner(&mesh, -1.0f, 0.0f, 1.0f, 0.0f);
+  AppendCorner(&mesh, 0.0f, 0.0f, 0.0f, 0.0f);
+  AppendCorner(&mesh, 0.0f, 1.0f, 0.0f, 1.0f);
+  AppendCorner(&mesh, 0.001f, 0.0f, 0.0f, 0.0f);
+  AppendCorner(&mesh, 1.0f, 0.0f, 1.0f, 0.0f);
+  AppendCorner(&mesh, 0.0f, 1.0f, 0.0f, 1.0f);
+  EXPECT_EQ(4, mesh.NumVertices());
+  EXPECT_EQ(1, mesh.NumVerticesMergedByQuantization());
+
+  mesh.GenerateTangentFrames();
+  EXPECT_EQ(6, mesh.NumVertices());
+  EXPECT_EQ(1, mesh.NumVerticesMergedByQuantization());
+}
+
+TEST(FlatMeshTests, NothingMergedWithoutQuantization) {
+  Logger log;
+  FlatMesh mesh(8, kAttributes, log);
+  mesh.SetSurface(FlatTextures());
+  mesh.ReportSurfaceVertexAttributes(kAttributes);
+  AppendCorner(&mesh, 0.0f, 0.0f, 0.0f, 0.0f);
+  AppendCorner(&mesh, 0.001f, 0.0f, 0.0f, 0.0f);
+  AppendCorner(&mesh, 0.0f, 1.0f, 0.0f, 1.0f);
+  EXPECT_EQ(3, mesh.NumVertices());
+  EXPECT_EQ(0, mesh.NumVerticesMergedByQuantization());
+}
+
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,92 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <chrono>
+
+#include "fplbase/frame_pacer.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+typedef FramePacer::Clock Clock;
+
+const double kEpsilon = 0.00001;
+
+Clock::duration ToClock(double seconds) {
+  return std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(seconds));
+}
+
+double SecondsBetween(Clock::time_point from, Clock::time_point to) {
+  return std::chrono::duration<double>(to - from).count();
+}
+
+}  // namespace
+
+TEST(FramePacerTest, RefreshIntervalFollowsPresents) {
+  FramePacer pacer;
+  const Clock::time_point start = Clock::now();
+
+  // A 120Hz display is faster than the 60Hz assumed at first.
+  for (int i = 0; i < 100; ++i) {
+    pacer.FramePresented(start + ToClock(i / 120.0));
+  }
+  EXPECT_NEAR(1.0 / 120.0, pacer.refresh_interval(), kEpsilon);
+  EXPECT_EQ(100, pacer.vsync_frame_id());
+
+  // A missed refresh doesn't change the estimate, but is counted.
+  pacer.FramePresented(start + ToClock(101 / 120.0));
+  EXPECT_NEAR(1.0 / 120.0, pacer.refresh_interval(), kEpsilon);
+  EXPECT_EQ(102, pacer.vsync_frame_id());
+}
+
+TEST(FramePacerTest, FrameStartsBeforeDeadlineByWorkTime) {
+  FramePacer pacer;
+  pacer.set_target_frame_rate(30.0);
+  const Clock::time_point start = Clock::now();
+
+  // The first frame takes 4ms, which is weighted into the work estimate by
+  // half, since it's more than the 0 estimated so far.
+  pacer.FrameStarted(start);
+  pacer.FramePresenting(start + ToClock(0.004));
+  EXPECT_NEAR(0.002, pacer.frame_work_time(), kEpsilon);
+  const Clock::time_point present = start + ToClock(0.005);
+  pacer.FramePresented(present);
+
+  // At 30Hz on a 60Hz display, the next frame is due two refreshes later.
+  // It starts early enough to finish its work, with 1ms to spare.
+  EXPECT_NEAR(2.0 / 60.0 - 0.002 - 0.001,
+              SecondsBetween(present, pacer.FrameStartTime()), kEpsilon);
+}
+
+TEST(FramePacerTest, PacingIsOptIn) {
+  FramePacer pacer;
+  EXPECT_FALSE(pacer.pacing_enabled());
+  pacer.set_target_frame_rate(1.0);
+  pacer.FramePresented();
+
+  // The next frame is due in a second, but pacing is off, so it starts now.
+  const Clock::time_point before = Clock::now();
+  pacer.WaitForFrameStart();
+  EXPECT_LT(SecondsBetween(before, Clock::now()), 0.5);
+}
+
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,100 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <string>
+#include <vector>
+
+#include "fplbase/frame_pipeline.h"
+#include "fplbase/renderer.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+// Record a command that appends `name` to `log` when it runs.
+void AddLogCommand(FramePacket &packet, std::vector<std::string> *log,
+                   const std::string &name) {
+  packet.Add([log, name](Renderer &) { log->push_back(name); });
+}
+
+// The renderer is never initialized, so there's no GL context to hand over,
+// and the pipeline always takes its fallback path.
+class FramePipelineTests : public ::testing::Test {
+ protected:
+  Renderer renderer_;
+  std::vector<std::string> log_;
+};
+
+TEST_F(FramePipelineTests, PacketExecutesCommandsInOrder) {
+  FramePacket packet;
+  AddLogCommand(packet, &log_, "a");
+  AddLogCommand(packet, &log_, "b");
+  AddLogCommand(packet, &log_, "c");
+  EXPECT_EQ(3u, packet.size());
+
+  packet.Execute(renderer_);
+  ASSERT_EQ(3u, log_.size());
+  EXPECT_EQ("a", log_[0]);
+  EXPECT_EQ("b", log_[1]);
+  EXPECT_EQ("c", log_[2]);
+
+  packet.Clear();
+  EXPECT_EQ(0u, packet.size());
+  packet.Execute(renderer_);
+  EXPECT_EQ(3u, log_.size());
+}
+
+TEST_F(FramePipelineTests, FallbackPresentsEachFrameOnSubmit) {
+  std::vector<std::string> *log = &log_;
+  FramePipeline pipeline(renderer_,
+                         [log](Renderer &renderer, bool, double time) {
+                           log->push_back("present");
+                           // Resize the window, as presenting may.
+                           renderer.set_window_size(mathfu::vec2i(
+                               100 + static_cast<int>(time), 50));
+                         });
+  EXPECT_FALSE(pipeline.Start());
+  EXPECT_FALSE(pipeline.running());
+
+  static const char *kFrames[] = {"frame 0", "frame 1", "frame 2"};
+  for (int i = 0; i < 3; ++i) {
+    FramePacket &packet = pipeline.BeginFrame();
+    EXPECT_EQ(0u, packet.size());
+    AddLogCommand(packet, &log_, kFrames[i]);
+    const mathfu::vec2i window_size =
+        pipeline.SubmitFrame(false, static_cast<double>(i));
+    // The frame has been executed and presented before SubmitFrame()
+    // returns, so the window size is already the one it presented at.
+    ASSERT_EQ(2u * (i + 1), log_.size());
+    EXPECT_EQ(kFrames[i], log_[2 * i]);
+    EXPECT_EQ("present", log_[2 * i + 1]);
+    EXPECT_EQ(100 + i, window_size.x);
+    EXPECT_EQ(50, window_size.y);
+  }
+
+  // Nothing is left in flight, so neither blocks or presents again.
+  pipeline.Flush();
+  pipeline.Stop();
+  EXPECT_EQ(6u, log_.size());
+  EXPECT_FALSE(pipeline.running());
+}
+
+}  // namespace
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,129 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdint.h>
+#include <vector>
+
+#include "fplbase/object_pool.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+struct Counted {
+  explicit Counted(int value) : value(value) { ++num_alive; }
+  ~Counted() { --num_alive; }
+
+  int value;
+  static int num_alive;
+};
+
+int Counted::num_alive = 0;
+
+typedef ObjectPool<Counted, 4> CountedPool;
+
+}  // namespace
+
+TEST(ObjectPoolTest, SlotsAreCacheLineAligned) {
+  CountedPool pool;
+  std::vector<Counted *> objects;
+  // Span several blocks.
+  for (int i = 0; i < 10; ++i) objects.push_back(pool.New(i));
+  for (size_t i = 0; i < objects.size(); ++i) {
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(objects[i]) % kCacheLineSize);
+    EXPECT_TRUE(pool.Owns(objects[i]));
+    pool.Delete(objects[i]);
+  }
+  EXPECT_EQ(0, Counted::num_alive);
+  EXPECT_EQ(0u, pool.size());
+  EXPECT_EQ(12u, pool.capacity());
+  int not_in_pool;
+  EXPECT_FALSE(pool.Owns(&not_in_pool));
+}
+
+TEST(ObjectPoolTest, HandlesOfFreedObjectsDontResolve) {
+  CountedPool pool;
+  Counted *first = pool.New(1);
+  const CountedPool::Handle handle = pool.GetHandle(first);
+  EXPECT_EQ(first, pool.Get(handle));
+  pool.Delete(first);
+  EXPECT_EQ(nullptr, pool.Get(handle));
+
+  // The slot is reused, with a new generation.
+  Counted *second = pool.New(2);
+  EXPECT_EQ(static_cast<void *>(first), static_cast<void *>(second));
+  EXPECT_EQ(nullptr, pool.Get(handle));
+  EXPECT_NE(handle, pool.GetHandle(second));
+  EXPECT_EQ(second, pool.Get(pool.GetHandle(second)));
+  EXPECT_EQ(nullptr, pool.Get(CountedPool::Handle()));
+  pool.Delete(second);
+}
+
+TEST(ObjectPoolTest, HandlesPackIndexAndGeneration) {
+  const ObjectPoolHandle handle(ObjectPoolHandle::kMaxIndex,
+                                ObjectPoolHandle::kGenerationMask);
+  EXPECT_EQ(0xFFFFFFFFu, handle.value);
+  EXPECT_EQ(ObjectPoolHandle::kMaxIndex, handle.index());
+  EXPECT_EQ(ObjectPoolHandle::kGenerationMask, handle.generation());
+  EXPECT_EQ(5u, ObjectPoolHandle(5, 3).index());
+  EXPECT_EQ(3u, ObjectPoolHandle(5, 3).generation());
+  EXPECT_NE(ObjectPoolHandle(5, 3), ObjectPoolHandle(5, 5));
+}
+
+TEST(ObjectPoolTest, GenerationsWrapAround) {
+  CountedPool pool;
+  Counted *object = pool.New(0);
+  const CountedPool::Handle first = pool.GetHandle(object);
+  // Each reuse of the slot takes two generations: one allocated, one free.
+  const uint32_t kUses = (ObjectPoolHandle::kGenerationMask + 1) / 2;
+  for (uint32_t i = 1; i < kUses; ++i) {
+    pool.Delete(object);
+    object = pool.New(static_cast<int>(i));
+    const CountedPool::Handle handle = pool.GetHandle(object);
+    ASSERT_EQ(first.index(), handle.index());
+    ASSERT_NE(first, handle);
+    ASSERT_NE(0u, handle.generation());
+  }
+  // The next use of the slot has the first use's generation again.
+  pool.Delete(object);
+  object = pool.New(0);
+  EXPECT_EQ(first, pool.GetHandle(object));
+  // The slot was never retired, so the pool didn't grow.
+  EXPECT_EQ(4u, pool.capacity());
+  pool.Delete(object);
+}
+
+TEST(ObjectPoolTest, ForEachVisitsLiveObjectsInSlotOrder) {
+  CountedPool pool;
+  std::vector<Counted *> objects;
+  for (int i = 0; i < 6; ++i) objects.push_back(pool.New(i));
+  pool.Delete(objects[1]);
+  pool.Delete(objects[4]);
+  std::vector<int> values;
+  pool.ForEach([&values](Counted *c) { values.push_back(c->value); });
+  const std::vector<int> expected = {0, 2, 3, 5};
+  EXPECT_EQ(expected, values);
+  pool.Delete(objects[0]);
+  pool.Delete(objects[2]);
+  pool.Delete(objects[3]);
+  pool.Delete(objects[5]);
+}
+
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,171 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+#include <vector>
+
+#include "fplbase/tangent_space.h"
+#include "gtest/gtest.h"
+
+namespace fplbase {
+namespace {
+
+const float kEpsilon = 0.0001f;
+
+// A grid of `size` x `size` quads in the XY plane, facing +z. UVs follow x
+// and y, with u mirrored if `mirror_u` is set.
+struct Grid {
+  Grid(int size, bool mirror_u) {
+    const int row = size + 1;
+    for (int y = 0; y <= size; ++y) {
+      for (int x = 0; x <= size; ++x) {
+        const float fx = static_cast<float>(x);
+        const float fy = static_cast<float>(y);
+        positions.push_back(mathfu::vec3(fx, fy, 0.0f));
+        normals.push_back(mathfu::vec3(0.0f, 0.0f, 1.0f));
+        uvs.push_back(mathfu::vec2(mirror_u ? -fx : fx, fy));
+      }
+    }
+    for (int y = 0; y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+        const uint16_t i = static_cast<uint16_t>(y * row + x);
+        const uint16_t quad[] = {i,
+                                 static_cast<uint16_t>(i + 1),
+                                 static_cast<uint16_t>(i + row + 1),
+                                 i,
+                                 static_cast<uint16_t>(i + row + 1),
+                                 static_cast<uint16_t>(i + row)};
+        indices.insert(indices.end(), quad, quad + 6);
+      }
+    }
+  }
+
+  TangentSpaceMesh Mesh() const {
+    TangentSpaceMesh mesh;
+    mesh.positions =
+        VertexAttributeView(positions.data(), sizeof(positions[0]));
+    mesh.normals = VertexAttributeView(normals.data(), sizeof(normals[0]));
+    mesh.uvs = VertexAttributeView(uvs.data(), sizeof(uvs[0]));
+    mesh.num_vertices = positions.size();
+    mesh.indices16 = indices.data();
+    mesh.num_indices = indices.size();
+    return mesh;
+  }
+
+  std::vector<mathfu::vec3_packed> positions;
+  std::vector<mathfu::vec3_packed> normals;
+  std::vector<mathfu::vec2_packed> uvs;
+  std::vector<uint16_t> indices;
+};
+
+}  // namespace
+
+class TangentSpaceTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+TEST_F(TangentSpaceTests, TangentFollowsU) {
+  const Grid grid(1, false);
+  std::vector<mathfu::vec4_packed> tangents(grid.positions.size());
+  GenerateTangents(grid.Mesh(), tangents.data());
+  for (size_t i = 0; i < tangents.size(); ++i) {
+    const mathfu::vec4 t(tangents[i]);
+    EXPECT_NEAR(t.x, 1.0f, kEpsilon);
+    EXPECT_NEAR(t.y, 0.0f, kEpsilon);
+    EXPECT_NEAR(t.z, 0.0f, kEpsilon);
+    EXPECT_EQ(t.w, 1.0f);
+  }
+}
+
+TEST_F(TangentSpaceTests, MirroredUvsFlipHandedness) {
+  const Grid grid(1, true);
+  std::vector<mathfu::vec4_packed> tangents(grid.positions.size());
+  GenerateTangents(grid.Mesh(), tangents.data());
+  for (size_t i = 0; i < tangents.size(); ++i) {
+    const mathfu::vec4 t(tangents[i]);
+    EXPECT_NEAR(t.x, -1.0f, kEpsilon);
+    EXPECT_EQ(t.w, -1.0f);
+  }
+}
+
+TEST_F(TangentSpaceTests, MirroredSeamSplitsCorners) {
+  // Two quads whose UVs mirror about x = 1, so the vertices at x = 1 are
+  // shared by triangles of opposite handedness.
+  Grid grid(2, false);
+  for (size_t i = 0; i < grid.uvs.size(); ++i) {
+    grid.uvs[i].data[0] = fabsf(grid.positions[i].data[0] - 1.0f);
+  }
+  std::vector<mathfu::vec4_packed> corners(grid.indices.size());
+  GenerateCornerTangents(grid.Mesh(), corners.data());
+  for (size_t c = 0; c < corners.size(); ++c) {
+    // The first quad's six corners are mirrored.
+    const bool mirrored = c % 12 < 6;
+    const mathfu::vec4 t(corners[c]);
+    EXPECT_NEAR(t.x, mirrored ? -1.0f : 1.0f, kEpsilon);
+    EXPECT_EQ(t.w, mirrored ? -1.0f : 1.0f);
+  }
+
+  // Unsplit, each seam vertex takes one side's frame, not an average.
+  std::vector<mathfu::vec4_packed> tangents(grid.positions.size());
+  GenerateTangents(grid.Mesh(), tangents.data());
+  for (size_t i = 0; i < tangents.size(); ++i) {
+    const mathfu::vec4 t(tangents[i]);
+    EXPECT_NEAR(fabsf(t.x), 1.0f, kEpsilon);
+    EXPECT_EQ(t.x < 0.0f ? -1.0f : 1.0f, t.w);
+  }
+}
+
+TEST_F(TangentSpaceTests, ParallelMatchesSerial) {
+  // Enough triangles to be split into several jobs.
+  const Grid grid(80, false);
+  std::vector<mathfu::vec4_packed> serial(grid.positions.size());
+  std::vector<mathfu::vec4_packed> parallel(grid.positions.size());
+  GenerateTangents(grid.Mesh(), serial.data());
+
+  // Run the jobs backwards, to catch any dependence on their order.
+  size_t num_jobs = 0;
+  GenerateTangents(grid.Mesh(), parallel.data(),
+                   [&](size_t count, const std::function<void(size_t)> &fn) {
+                     num_jobs += count;
+                     for (size_t i = count; i > 0; --i) fn(i - 1);
+                   });
+  EXPECT_GT(num_jobs, 2U);
+  for (size_t i = 0; i < serial.size(); ++i) {
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_EQ(serial[i].data[j], parallel[i].data[j]);
+    }
+  }
+}
+
+TEST_F(TangentSpaceTests, CalculateOrientation) {
+  const mathfu::vec3 normal(0.0f, 0.0f, 1.0f);
+  const mathfu::vec4 right_handed =
+      CalculateOrientation(normal, mathfu::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+  EXPECT_NEAR(right_handed.w, 1.0f, kEpsilon);
+  EXPECT_NEAR(right_handed.xyz().Length(), 0.0f, kEpsilon);
+
+  // The scalar's sign carries the handedness.
+  const mathfu::vec4 left_handed =
+      CalculateOrientation(normal, mathfu::vec4(1.0f, 0.0f, 0.0f, -1.0f));
+  EXPECT_NEAR(left_handed.w, -1.0f, kEpsilon);
+}
+
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
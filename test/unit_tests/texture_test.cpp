@@ -0,0 +1,149 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <vector>
+
+#include "fplbase/fpl_common.h"
+#include "fplbase/texture.h"
+#include "gtest/gtest.h"
+
+using mathfu::vec2i;
+
+namespace fplbase {
+namespace {
+
+struct FormatInfo {
+  TextureFormat format;
+  int channels;
+};
+
+const FormatInfo kFormats[] = {
+    {kFormat8888, 4},
+    {kFormat888, 3},
+    {kFormatLuminance, 1},
+    {kFormatLuminanceAlpha, 2},
+};
+
+const vec2i kSizes[] = {vec2i(1, 1),    vec2i(3, 5),    vec2i(17, 1),
+                        vec2i(100, 60), vec2i(300, 200), vec2i(640, 480)};
+
+const TextureResampleFilter kFilters[] = {
+    kTextureResampleFilterDefault, kTextureResampleFilterBox,
+    kTextureResampleFilterTriangle, kTextureResampleFilterCatmullRom,
+    kTextureResampleFilterMitchell};
+
+bool IsPowerOfTwo(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+// Every channel of every pixel is `channel + 1` times 40.
+std::vector<uint8_t> FlatImage(const vec2i &size, int channels) {
+  std::vector<uint8_t> image(size.x * size.y * channels);
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<uint8_t>(40 * (i % channels + 1));
+  }
+  return image;
+}
+
+}  // namespace
+
+TEST(TextureTest, NearestPowerOfTwoSize) {
+  EXPECT_EQ(vec2i(1, 1), Texture::NearestPowerOfTwoSize(vec2i(1, 1)));
+  EXPECT_EQ(vec2i(4, 4), Texture::NearestPowerOfTwoSize(vec2i(3, 5)));
+  EXPECT_EQ(vec2i(512, 1024), Texture::NearestPowerOfTwoSize(vec2i(640, 900)));
+  EXPECT_EQ(vec2i(256, 256), Texture::NearestPowerOfTwoSize(vec2i(256, 256)));
+}
+
+TEST(TextureTest, NearestPowerOfTwoSizeRoundsTiesUp) {
+  EXPECT_EQ(vec2i(4, 16), Texture::NearestPowerOfTwoSize(vec2i(3, 12)));
+  EXPECT_EQ(vec2i(8, 64), Texture::NearestPowerOfTwoSize(vec2i(6, 48)));
+  // Just below a tie still rounds down.
+  EXPECT_EQ(vec2i(8, 32), Texture::NearestPowerOfTwoSize(vec2i(11, 47)));
+}
+
+TEST(TextureTest, RequiresNpotSupport) {
+  const vec2i npot(100, 64);
+  EXPECT_TRUE(Texture::RequiresNpotSupport(npot, kTextureFlagsUseMipMaps));
+  EXPECT_TRUE(Texture::RequiresNpotSupport(npot, kTextureFlagsNone));
+  EXPECT_FALSE(Texture::RequiresNpotSupport(npot, kTextureFlagsClampToEdge));
+  EXPECT_FALSE(
+      Texture::RequiresNpotSupport(vec2i(128, 64), kTextureFlagsUseMipMaps));
+  // Cubemap faces are stacked vertically.
+  EXPECT_FALSE(Texture::RequiresNpotSupport(
+      vec2i(32, 192), kTextureFlagsUseMipMaps | kTextureFlagsIsCubeMap));
+}
+
+// Resampling a flat image to a power of two keeps it flat, for every size,
+// format and filter.
+TEST(TextureTest, ResampleMatrix) {
+  for (size_t f = 0; f < FPL_ARRAYSIZE(kFormats); ++f) {
+    for (size_t s = 0; s < FPL_ARRAYSIZE(kSizes); ++s) {
+      for (size_t k = 0; k < FPL_ARRAYSIZE(kFilters); ++k) {
+        const FormatInfo &format = kFormats[f];
+        const vec2i &size = kSizes[s];
+        const std::vector<uint8_t> image = FlatImage(size, format.channels);
+        vec2i new_size;
+        uint8_t *resampled = Texture::ResampleToPowerOfTwo(
+            image.data(), size, format.format, kTextureFlagsUseMipMaps,
+            kFilters[k], &new_size);
+        ASSERT_NE(nullptr, resampled);
+        EXPECT_EQ(Texture::NearestPowerOfTwoSize(size), new_size);
+        EXPECT_TRUE(IsPowerOfTwo(new_size.x) && IsPowerOfTwo(new_size.y));
+        const int num_values = new_size.x * new_size.y * format.channels;
+        for (int i = 0; i < num_values; ++i) {
+          EXPECT_NEAR(40 * (i % format.channels + 1), resampled[i], 1)
+              << "format " << format.format << ", size " << size.x << "x"
+              << size.y << ", filter " << kFilters[k];
+        }
+        free(resampled);
+      }
+    }
+  }
+}
+
+TEST(TextureTest, ResampleCubeMapKeepsFacesSquare) {
+  const vec2i size(24, 24 * 6);
+  std::vector<uint8_t> image(size.x * size.y * 3);
+  // Give each face its own color, so bleeding between faces shows.
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<uint8_t>(40 * (i / (image.size() / 6)));
+  }
+  vec2i new_size;
+  uint8_t *resampled = Texture::ResampleToPowerOfTwo(
+      image.data(), size, kFormat888,
+      kTextureFlagsUseMipMaps | kTextureFlagsIsCubeMap,
+      kTextureResampleFilterDefault, &new_size);
+  ASSERT_NE(nullptr, resampled);
+  EXPECT_EQ(vec2i(32, 32 * 6), new_size);
+  const int face_values = 32 * 32 * 3;
+  for (int i = 0; i < face_values * 6; ++i) {
+    EXPECT_EQ(40 * (i / face_values), resampled[i]);
+  }
+  free(resampled);
+}
+
+TEST(TextureTest, ResampleRejectsCompressedFormats) {
+  const uint8_t block[16] = {0};
+  vec2i new_size;
+  EXPECT_EQ(nullptr, Texture::ResampleToPowerOfTwo(
+                         block, vec2i(4, 4), kFormatPKM,
+                         kTextureFlagsUseMipMaps,
+                         kTextureResampleFilterDefault, &new_size));
+}
+
+}  // namespace fplbase
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,93 @@
+// Copyright 2017 Google Inc. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "vertex_dedup.h"
+
+namespace {
+
+struct TestVertex {
+  float position[3];
+  float uv[2];
+  uint32_t color;
+};
+
+TestVertex MakeVertex(float x, float y, float z, uint32_t color) {
+  TestVertex v;
+  memset(&v, 0, sizeof(v));
+  v.position[0] = x;
+  v.position[1] = y;
+  v.position[2] = z;
+  v.color = color;
+  return v;
+}
+
+}  // namespace
+
+class VertexDedupTests : public ::testing::Test {
+ protected:
+  virtual void SetUp() {}
+  virtual void TearDown() {}
+};
+
+// Known xxHash64 outputs for seed 0.
+TEST_F(VertexDedupTests, HashMatchesReference) {
+  EXPECT_EQ(0xEF46DB3751D8E999ULL, fplbase::HashBytes64("", 0));
+  EXPECT_EQ(0xD24EC4F1A98C6E5BULL, fplbase::HashBytes64("a", 1));
+  EXPECT_EQ(0x44BC2CF5AD770999ULL, fplbase::HashBytes64("abc", 3));
+}
+
+// The old hash stopped at the first zero byte. Make sure leading zeros don't
+// cause everything to collide.
+TEST_F(VertexDedupTests, HashUsesAllBytes) {
+  std::set<uint64_t> hashes;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    hashes.insert(fplbase::HashPod(MakeVertex(0.0f, 0.0f, 0.0f, i)));
+  }
+  EXPECT_EQ(1000u, hashes.size());
+}
+
+TEST_F(VertexDedupTests, FindOrInsert) {
+  fplbase::VertexDedupTable table;
+  std::vector<TestVertex> vertices;
+  std::vector<uint32_t> indices;
+
+  // Insert a grid of vertices twice. The second pass must find every vertex
+  // from the first pass, and the table must grow past its initial size.
+  for (int pass = 0; pass < 2; ++pass) {
+    for (uint32_t i = 0; i < 5000; ++i) {
+      vertices.push_back(MakeVertex(static_cast<float>(i % 100), 0.0f,
+                                    static_cast<float>(i / 100), 0));
+      const uint32_t new_index = static_cast<uint32_t>(vertices.size() - 1);
+      const uint32_t index = table.FindOrInsert(vertices.data(), new_index);
+      if (index != new_index) vertices.pop_back();
+      indices.push_back(index);
+    }
+  }
+
+  EXPECT_EQ(5000u, vertices.size());
+  EXPECT_EQ(5000u, table.size());
+  for (uint32_t i = 0; i < 5000; ++i) {
+    EXPECT_EQ(i, indices[i]);
+    EXPECT_EQ(i, indices[i + 5000]);
+  }
+}
+
+extern "C" int FPL_main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}